@@ -0,0 +1,545 @@
+#include "adaptive_thresholds.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef HAVE_OPENCV
+#include <opencv2/core/hal/intrin.hpp>
+#endif
+
+// Same fixed-width universal intrinsics condition as the image kernels
+#if defined(HAVE_OPENCV) && CV_SIMD && !CV_SIMD_SCALABLE
+#define ADAPTIVE_VECTORIZED 1
+#else
+#define ADAPTIVE_VECTORIZED 0
+#endif
+
+namespace {
+    const int kGainOne = 1 << ADAPTIVE_GAIN_BITS;
+    const int kGainHalf = 1 << (ADAPTIVE_GAIN_BITS - 1);
+    const int kRampBits = 8;
+
+    // Fixed-point gain (rounded like cvRound)
+    inline int roundGain(float gain) {
+        return static_cast<int>(std::nearbyint(gain));
+    }
+
+    // Derivative times a fixed-point gain, rounded and saturated
+    inline int16_t applyGain(int value, int gain) {
+        const int scaled = (value * gain + kGainHalf) >> ADAPTIVE_GAIN_BITS;
+        return static_cast<int16_t>(std::min(32767, std::max(-32768, scaled)));
+    }
+
+    // Histogram bins of one row: (|dx| + |dy|) >> shift, saturated to the last bin
+    void magnitudeBins(const int16_t* gx, const int16_t* gy, int count, int shift, uint8_t* bins) {
+        int i = 0;
+#if ADAPTIVE_VECTORIZED
+        using namespace cv;
+        const int lanes = VTraits<v_int16>::vlanes();
+        for (; i + 2 * lanes <= count; i += 2 * lanes) {
+            const v_uint16 lo = v_shr(v_add_wrap(
+                v_abs(vx_load(gx + i)), v_abs(vx_load(gy + i))), shift);
+            const v_uint16 hi = v_shr(v_add_wrap(
+                v_abs(vx_load(gx + i + lanes)), v_abs(vx_load(gy + i + lanes))), shift);
+            v_store(bins + i, v_pack(lo, hi));
+        }
+#endif
+        for (; i < count; i++) {
+            const int magnitude = (std::abs(gx[i]) + std::abs(gy[i])) >> shift;
+            bins[i] = static_cast<uint8_t>(std::min(magnitude, ADAPTIVE_HISTOGRAM_BINS - 1));
+        }
+    }
+
+    // Vertical half of a Sobel row: smoothing and derivative taps over the
+    // aperture's rows (replicated at the top and bottom), written one
+    // aperture radius into padded rows whose ends repeat the edge columns
+    void sobelColumns(const uint8_t* image, int width, int height, int y, int radius,
+                      int16_t* smooth, int16_t* diff) {
+        const uint8_t* rows[5];
+        for (int k = -radius; k <= radius; k++) {
+            rows[k + radius] = image + static_cast<size_t>(std::min(height - 1, std::max(0, y + k))) * width;
+        }
+        int16_t* s = smooth + radius;
+        int16_t* d = diff + radius;
+        int x = 0;
+        if (radius == 1) {
+            const uint8_t* r0 = rows[0];
+            const uint8_t* r1 = rows[1];
+            const uint8_t* r2 = rows[2];
+#if ADAPTIVE_VECTORIZED
+            using namespace cv;
+            const int lanes = VTraits<v_uint16>::vlanes();
+            for (; x + lanes <= width; x += lanes) {
+                const v_uint16 a = vx_load_expand(r0 + x);
+                const v_uint16 b = vx_load_expand(r1 + x);
+                const v_uint16 c = vx_load_expand(r2 + x);
+                v_store(s + x, v_reinterpret_as_s16(v_add(v_add(a, c), v_shl<1>(b))));
+                v_store(d + x, v_sub(v_reinterpret_as_s16(c), v_reinterpret_as_s16(a)));
+            }
+#endif
+            for (; x < width; x++) {
+                s[x] = static_cast<int16_t>(r0[x] + 2 * r1[x] + r2[x]);
+                d[x] = static_cast<int16_t>(r2[x] - r0[x]);
+            }
+        } else {
+            const uint8_t* r0 = rows[0];
+            const uint8_t* r1 = rows[1];
+            const uint8_t* r2 = rows[2];
+            const uint8_t* r3 = rows[3];
+            const uint8_t* r4 = rows[4];
+#if ADAPTIVE_VECTORIZED
+            using namespace cv;
+            const int lanes = VTraits<v_uint16>::vlanes();
+            const v_uint16 six = vx_setall_u16(6);
+            for (; x + lanes <= width; x += lanes) {
+                const v_uint16 a = vx_load_expand(r0 + x);
+                const v_uint16 b = vx_load_expand(r1 + x);
+                const v_uint16 c = vx_load_expand(r2 + x);
+                const v_uint16 e = vx_load_expand(r3 + x);
+                const v_uint16 f = vx_load_expand(r4 + x);
+                v_store(s + x, v_reinterpret_as_s16(
+                    v_add(v_add(v_add(a, f), v_shl<2>(v_add(b, e))), v_mul(c, six))));
+                v_store(d + x, v_add(
+                    v_sub(v_reinterpret_as_s16(f), v_reinterpret_as_s16(a)),
+                    v_shl<1>(v_sub(v_reinterpret_as_s16(e), v_reinterpret_as_s16(b)))));
+            }
+#endif
+            for (; x < width; x++) {
+                s[x] = static_cast<int16_t>(r0[x] + r4[x] + 4 * (r1[x] + r3[x]) + 6 * r2[x]);
+                d[x] = static_cast<int16_t>(r4[x] - r0[x] + 2 * (r3[x] - r1[x]));
+            }
+        }
+        for (int k = 1; k <= radius; k++) {
+            s[-k] = s[0];
+            d[-k] = d[0];
+            s[width - 1 + k] = s[width - 1];
+            d[width - 1 + k] = d[width - 1];
+        }
+    }
+
+    // Derivatives read from planes
+    struct PlaneGradients {
+        const int16_t* gx;
+        const int16_t* gy;
+
+#if ADAPTIVE_VECTORIZED
+        void load(int i, cv::v_int16& x, cv::v_int16& y) const {
+            x = cv::vx_load(gx + i);
+            y = cv::vx_load(gy + i);
+        }
+#endif
+        void at(int i, int& x, int& y) const {
+            x = gx[i];
+            y = gy[i];
+        }
+    };
+
+    // Derivatives finished from sobelColumns' rows as they are read (the
+    // horizontal half of the Sobel); s and d point at the run's first pixel
+    template <int Radius>
+    struct SobelGradients {
+        const int16_t* s;
+        const int16_t* d;
+
+#if ADAPTIVE_VECTORIZED
+        void load(int i, cv::v_int16& x, cv::v_int16& y) const {
+            using namespace cv;
+            if (Radius == 1) {
+                x = v_sub(vx_load(s + i + 1), vx_load(s + i - 1));
+                y = v_add(v_add(vx_load(d + i - 1), vx_load(d + i + 1)), v_shl<1>(vx_load(d + i)));
+            } else {
+                x = v_add(v_sub(vx_load(s + i + 2), vx_load(s + i - 2)),
+                          v_shl<1>(v_sub(vx_load(s + i + 1), vx_load(s + i - 1))));
+                y = v_add(v_add(v_add(vx_load(d + i - 2), vx_load(d + i + 2)),
+                                v_shl<2>(v_add(vx_load(d + i - 1), vx_load(d + i + 1)))),
+                          v_mul(vx_load(d + i), vx_setall_s16(6)));
+            }
+        }
+#endif
+        void at(int i, int& x, int& y) const {
+            if (Radius == 1) {
+                x = s[i + 1] - s[i - 1];
+                y = d[i - 1] + 2 * d[i] + d[i + 1];
+            } else {
+                x = s[i + 2] - s[i - 2] + 2 * (s[i + 1] - s[i - 1]);
+                y = d[i - 2] + d[i + 2] + 4 * (d[i - 1] + d[i + 1]) + 6 * d[i];
+            }
+        }
+    };
+
+    // Unscaled derivatives of one row from sobelColumns' padded rows
+    template <int Radius>
+    void sobelRow(const int16_t* smooth, const int16_t* diff, int width, int16_t* gx, int16_t* gy) {
+        const SobelGradients<Radius> source = {smooth + Radius, diff + Radius};
+        int x = 0;
+#if ADAPTIVE_VECTORIZED
+        using namespace cv;
+        const int lanes = VTraits<v_int16>::vlanes();
+        for (; x + lanes <= width; x += lanes) {
+            v_int16 vx, vy;
+            source.load(x, vx, vy);
+            v_store(gx + x, vx);
+            v_store(gy + x, vy);
+        }
+#endif
+        for (; x < width; x++) {
+            int vx, vy;
+            source.at(x, vx, vy);
+            gx[x] = static_cast<int16_t>(vx);
+            gy[x] = static_cast<int16_t>(vy);
+        }
+    }
+
+    // Rescale one run of pixels whose fixed-point gain is base + step * i,
+    // both with kRampBits more fraction bits: the gains are exact integer
+    // steps, the same in the vector and scalar loops. Narrow derivatives
+    // (3x3 aperture, |d| < 2^10) take a 16-bit multiply with the same result.
+    template <bool Narrow, typename Gradients>
+    void rescaleRun(const Gradients& source, int count, int32_t base, int32_t step,
+                    int16_t* outX, int16_t* outY) {
+        base += 1 << (kRampBits - 1);
+        int i = 0;
+#if ADAPTIVE_VECTORIZED
+        using namespace cv;
+        const int lanes = VTraits<v_int16>::vlanes();
+        const int half = VTraits<v_int32>::vlanes();
+        int32_t ramp[VTraits<v_int32>::max_nlanes];
+        for (int k = 0; k < half; k++) {
+            ramp[k] = base + step * k;
+        }
+        v_int32 rampLo = vx_load(ramp);
+        v_int32 rampHi = v_add(rampLo, vx_setall_s32(step * half));
+        const v_int32 advance = vx_setall_s32(step * lanes);
+        const v_int32 rounding = vx_setall_s32(kGainHalf);
+        const v_int16 one = vx_setall_s16(1);
+        for (; i + lanes <= count; i += lanes) {
+            // Gains stay below 2^15 (scales of at least ADAPTIVE_MIN_SCALE), so
+            // 16x16-bit products do the multiply
+            const v_int16 gain = v_pack(v_shr<kRampBits>(rampLo), v_shr<kRampBits>(rampHi));
+            rampLo = v_add(rampLo, advance);
+            rampHi = v_add(rampHi, advance);
+
+            v_int16 gx, gy;
+            source.load(i, gx, gy);
+            if (Narrow) {
+                // Below 2^10 the derivative shifted into the top bits leaves a
+                // high product with one bit to spare for the rounding
+                const int shift = 16 - ADAPTIVE_GAIN_BITS + 1;
+                v_store(outX + i, v_shr<1>(v_add(v_mul_hi(v_shl<shift>(gx), gain), one)));
+                v_store(outY + i, v_shr<1>(v_add(v_mul_hi(v_shl<shift>(gy), gain), one)));
+                continue;
+            }
+            v_int32 xLo, xHi, yLo, yHi;
+            v_mul_expand(gx, gain, xLo, xHi);
+            v_mul_expand(gy, gain, yLo, yHi);
+            xLo = v_shr<ADAPTIVE_GAIN_BITS>(v_add(xLo, rounding));
+            xHi = v_shr<ADAPTIVE_GAIN_BITS>(v_add(xHi, rounding));
+            yLo = v_shr<ADAPTIVE_GAIN_BITS>(v_add(yLo, rounding));
+            yHi = v_shr<ADAPTIVE_GAIN_BITS>(v_add(yHi, rounding));
+            v_store(outX + i, v_pack(xLo, xHi));
+            v_store(outY + i, v_pack(yLo, yHi));
+        }
+#endif
+        for (; i < count; i++) {
+            const int gain = (base + step * i) >> kRampBits;
+            int gx, gy;
+            source.at(i, gx, gy);
+            outX[i] = applyGain(gx, gain);
+            outY[i] = applyGain(gy, gain);
+        }
+    }
+
+    // Magnitude at the given percentile of a histogram (bin centre)
+    template <typename Count>
+    float percentile(const Count* histogram, uint64_t count, int shift) {
+        const uint64_t rank = static_cast<uint64_t>(std::ceil(count * static_cast<double>(ADAPTIVE_PERCENTILE)));
+        uint64_t cumulative = 0;
+        int bin = 0;
+        for (; bin < ADAPTIVE_HISTOGRAM_BINS - 1; bin++) {
+            cumulative += histogram[bin];
+            if (cumulative >= rank) {
+                break;
+            }
+        }
+        return static_cast<float>((bin << shift) + (1 << shift) / 2);
+    }
+
+    // Upper tile centre and weight of the lower one for a row
+    void interpolationWeight(int position, int tileSize, int tiles, int& tile, float& weight) {
+        const float f = (position + 0.5f) / tileSize - 0.5f;
+        tile = static_cast<int>(std::floor(f));
+        weight = f - tile;
+        if (tile < 0) {
+            tile = 0;
+            weight = 0.0f;
+        } else if (tile >= tiles - 1) {
+            tile = tiles - 1;
+            weight = 0.0f;
+        }
+    }
+}
+
+// Constructor
+AdaptiveThresholds::AdaptiveThresholds()
+    : mEnabled(false)
+    , mTileSize(ADAPTIVE_DEFAULT_TILE)
+    , mTilesX(0)
+    , mTilesY(0)
+    , mHistogramShift(ADAPTIVE_HISTOGRAM_SHIFT)
+    , mApertureSize(3)
+    , mStats()
+{
+}
+
+void AdaptiveThresholds::configure(bool enabled, int tileSize) {
+    mEnabled = enabled;
+    mTileSize = std::min(ADAPTIVE_MAX_TILE, std::max(ADAPTIVE_MIN_TILE, tileSize));
+}
+
+// Step-edge gain over the 3x3 kernel (4): derivative taps times smoothing
+// sum, 48 for 5x5 and 640 for 7x7, rounded up to a power of two
+int AdaptiveThresholds::histogramShift(int apertureSize) {
+    int gain = 4;
+    if (apertureSize == 5) {
+        gain = 3 * 16;
+    } else if (apertureSize == 7) {
+        gain = 10 * 64;
+    }
+    int shift = ADAPTIVE_HISTOGRAM_SHIFT;
+    while ((4 << (shift - ADAPTIVE_HISTOGRAM_SHIFT)) < gain) {
+        shift++;
+    }
+    return shift;
+}
+
+// Per-tile histograms, scales, then the rescale pass
+void AdaptiveThresholds::normalize(const int16_t* dx, const int16_t* dy, int width, int height, int apertureSize) {
+    auto start = std::chrono::steady_clock::now();
+    begin(width, height, apertureSize);
+    buildHistograms(nullptr, dx, dy, width, height);
+    computeScales();
+    rescale(nullptr, dx, dy, width, height);
+    finish(start);
+}
+
+// Same passes deriving each row as it is needed (sampled rows twice:
+// storing them would cost more memory traffic than the Sobel)
+void AdaptiveThresholds::normalize(const uint8_t* smoothed, int width, int height, int apertureSize) {
+    auto start = std::chrono::steady_clock::now();
+    begin(width, height, apertureSize);
+    buildHistograms(smoothed, mDx.data(), mDy.data(), width, height);
+    computeScales();
+    rescale(smoothed, mDx.data(), mDy.data(), width, height);
+    finish(start);
+}
+
+// Tile grid, output and scratch rows of a frame
+void AdaptiveThresholds::begin(int width, int height, int apertureSize) {
+    mHistogramShift = histogramShift(apertureSize);
+    mApertureSize = apertureSize;
+    mTilesX = (width + mTileSize - 1) / mTileSize;
+    mTilesY = (height + mTileSize - 1) / mTileSize;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    if (mDx.size() != pixels) {
+        mDx.resize(pixels);
+        mDy.resize(pixels);
+    }
+    const size_t scratch = static_cast<size_t>(mTilesY) * 4 * (static_cast<size_t>(width) + 4);
+    if (mRowScratch.size() < scratch) {
+        mRowScratch.resize(scratch);
+    }
+}
+
+// Frame counters
+void AdaptiveThresholds::finish(std::chrono::steady_clock::time_point start) {
+    mStats.frames++;
+    mStats.tilesX = mTilesX;
+    mStats.tilesY = mTilesY;
+    mStats.lastMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+// L1 magnitude histogram of every tile from sampled rows (one task per tile
+// row); with a source plane each sampled row is derived into scratch rows
+void AdaptiveThresholds::buildHistograms(const uint8_t* smoothed, const int16_t* dx, const int16_t* dy,
+                                         int width, int height) {
+    // Every other sample counts into a second set of histograms after the
+    // first: flat areas put long runs into one bin, and alternating halves
+    // the dependent increments
+    const int rowStep = std::max(1, mTileSize / ADAPTIVE_SAMPLE_ROWS);
+    const size_t histograms = static_cast<size_t>(mTilesX) * mTilesY * ADAPTIVE_HISTOGRAM_BINS;
+    mHistograms.assign(2 * histograms, 0);
+
+    WorkerPool::shared().parallelFor(mTilesY, [&](int tileRow) {
+        const int y0 = tileRow * mTileSize;
+        const int y1 = std::min(height, y0 + mTileSize);
+        uint16_t* rowHistograms = mHistograms.data() + static_cast<size_t>(tileRow) * mTilesX * ADAPTIVE_HISTOGRAM_BINS;
+        uint16_t* rowOdd = rowHistograms + histograms;
+        const size_t rowSize = static_cast<size_t>(width) + 4;
+        int16_t* smooth = mRowScratch.data() + static_cast<size_t>(tileRow) * 4 * rowSize;
+        int16_t* diff = smooth + rowSize;
+        int16_t* rowX = diff + rowSize;
+        int16_t* rowY = rowX + rowSize;
+        uint8_t bins[ADAPTIVE_MAX_TILE];
+        for (int y = y0; y < y1; y += rowStep) {
+            const int16_t* gx = dx + static_cast<size_t>(y) * width;
+            const int16_t* gy = dy + static_cast<size_t>(y) * width;
+            if (smoothed != nullptr) {
+                sobelColumns(smoothed, width, height, y, mApertureSize / 2, smooth, diff);
+                if (mApertureSize == 3) {
+                    sobelRow<1>(smooth, diff, width, rowX, rowY);
+                } else {
+                    sobelRow<2>(smooth, diff, width, rowX, rowY);
+                }
+                gx = rowX;
+                gy = rowY;
+            }
+            for (int tile = 0; tile < mTilesX; tile++) {
+                uint16_t* histogram = rowHistograms + static_cast<size_t>(tile) * ADAPTIVE_HISTOGRAM_BINS;
+                uint16_t* odd = rowOdd + static_cast<size_t>(tile) * ADAPTIVE_HISTOGRAM_BINS;
+                const int x0 = tile * mTileSize;
+                const int count = std::min(width, x0 + mTileSize) - x0;
+                magnitudeBins(gx + x0, gy + x0, count, mHistogramShift, bins);
+                int x = 0;
+                for (; x + 2 < count; x += 4) {
+                    histogram[bins[x]]++;
+                    odd[bins[x + 2]]++;
+                }
+                if (x < count) {
+                    histogram[bins[x]]++;
+                }
+            }
+        }
+        for (size_t bin = 0; bin < static_cast<size_t>(mTilesX) * ADAPTIVE_HISTOGRAM_BINS; bin++) {
+            rowHistograms[bin] += rowOdd[bin];
+        }
+    });
+}
+
+// Tile percentile relative to the frame percentile, clamped
+void AdaptiveThresholds::computeScales() {
+    const int tiles = mTilesX * mTilesY;
+    uint32_t frameHistogram[ADAPTIVE_HISTOGRAM_BINS] = {};
+    uint64_t frameCount = 0;
+    for (int tile = 0; tile < tiles; tile++) {
+        const uint16_t* histogram = mHistograms.data() + static_cast<size_t>(tile) * ADAPTIVE_HISTOGRAM_BINS;
+        for (int bin = 0; bin < ADAPTIVE_HISTOGRAM_BINS; bin++) {
+            frameHistogram[bin] += histogram[bin];
+            frameCount += histogram[bin];
+        }
+    }
+    const float frameLevel = percentile(frameHistogram, frameCount, mHistogramShift);
+
+    mScales.resize(tiles);
+    mGains.resize(tiles);
+    mStats.minScale = ADAPTIVE_MAX_SCALE;
+    mStats.maxScale = ADAPTIVE_MIN_SCALE;
+    for (int tile = 0; tile < tiles; tile++) {
+        const uint16_t* histogram = mHistograms.data() + static_cast<size_t>(tile) * ADAPTIVE_HISTOGRAM_BINS;
+        uint64_t count = 0;
+        for (int bin = 0; bin < ADAPTIVE_HISTOGRAM_BINS; bin++) {
+            count += histogram[bin];
+        }
+        const float scale = std::min(ADAPTIVE_MAX_SCALE,
+            std::max(ADAPTIVE_MIN_SCALE, percentile(histogram, count, mHistogramShift) / frameLevel));
+        mScales[tile] = scale;
+        mGains[tile] = kGainOne / scale;
+        mStats.minScale = std::min(mStats.minScale, scale);
+        mStats.maxScale = std::max(mStats.maxScale, scale);
+    }
+}
+
+// Multiply the derivatives by the gain interpolated between tile centres;
+// with a source plane the vertical Sobel half of each row goes to scratch
+// rows and the horizontal half is taken as the gain is applied
+void AdaptiveThresholds::rescale(const uint8_t* smoothed, const int16_t* dx, const int16_t* dy,
+                                 int width, int height) {
+    WorkerPool::shared().parallelFor(mTilesY, [&](int tileRow) {
+        const int y0 = tileRow * mTileSize;
+        const int y1 = std::min(height, y0 + mTileSize);
+        // One spare entry so the right neighbour of the last centre is valid
+        std::vector<float> rowGains(mTilesX + 1);
+        const size_t rowSize = static_cast<size_t>(width) + 4;
+        int16_t* smooth = mRowScratch.data() + static_cast<size_t>(tileRow) * 4 * rowSize;
+        int16_t* diff = smooth + rowSize;
+        for (int y = y0; y < y1; y++) {
+            int tileY;
+            float weightY;
+            interpolationWeight(y, mTileSize, mTilesY, tileY, weightY);
+            const float* above = mGains.data() + static_cast<size_t>(tileY) * mTilesX;
+            const float* below = above + (tileY + 1 < mTilesY ? mTilesX : 0);
+            for (int tile = 0; tile < mTilesX; tile++) {
+                rowGains[tile] = above[tile] + (below[tile] - above[tile]) * weightY;
+            }
+            rowGains[mTilesX] = rowGains[mTilesX - 1];
+
+            const size_t offset = static_cast<size_t>(y) * width;
+            const int16_t* gx = dx + offset;
+            const int16_t* gy = dy + offset;
+            if (smoothed != nullptr) {
+                sobelColumns(smoothed, width, height, y, mApertureSize / 2, smooth, diff);
+            }
+            int16_t* outX = mDx.data() + offset;
+            int16_t* outY = mDy.data() + offset;
+
+            // Segments between adjacent tile centres (constant gain before the
+            // first and after the last), so the inner loop has no gathers
+            const int half = mTileSize / 2;
+            for (int segment = -1; segment < mTilesX; segment++) {
+                const int x0 = segment < 0 ? 0 : std::min(width, segment * mTileSize + half);
+                const int x1 = segment + 1 < mTilesX ? std::min(width, (segment + 1) * mTileSize + half) : width;
+                const float left = rowGains[std::max(0, segment)];
+                const float step = segment < 0 || segment + 1 >= mTilesX
+                    ? 0.0f
+                    : (rowGains[segment + 1] - left) / mTileSize;
+                // Pixel centres sit half a pixel right of the segment start
+                const float base = left + step * (0.5f - (mTileSize & 1) * 0.5f);
+                const int32_t baseRamp = roundGain(base * (1 << kRampBits));
+                const int32_t stepRamp = roundGain(step * (1 << kRampBits));
+                const int count = x1 - x0;
+                if (smoothed == nullptr) {
+                    const PlaneGradients source = {gx + x0, gy + x0};
+                    if (mApertureSize == 3) {
+                        rescaleRun<true>(source, count, baseRamp, stepRamp, outX + x0, outY + x0);
+                    } else {
+                        rescaleRun<false>(source, count, baseRamp, stepRamp, outX + x0, outY + x0);
+                    }
+                } else if (mApertureSize == 3) {
+                    const SobelGradients<1> source = {smooth + 1 + x0, diff + 1 + x0};
+                    rescaleRun<true>(source, count, baseRamp, stepRamp, outX + x0, outY + x0);
+                } else {
+                    const SobelGradients<2> source = {smooth + 2 + x0, diff + 2 + x0};
+                    rescaleRun<false>(source, count, baseRamp, stepRamp, outX + x0, outY + x0);
+                }
+            }
+        }
+    });
+}
+
+// Counter summary
+std::string AdaptiveThresholds::getStatistics() const {
+    char buffer[192];
+    snprintf(buffer, sizeof(buffer),
+        "Adaptive thresholds: %s, tile %dpx, %llu frames, %dx%d tiles, scale %.2f-%.2f, last %.2fms",
+        mEnabled ? "on" : "off",
+        mTileSize,
+        static_cast<unsigned long long>(mStats.frames),
+        mStats.tilesX,
+        mStats.tilesY,
+        mStats.frames > 0 ? mStats.minScale : 1.0f,
+        mStats.frames > 0 ? mStats.maxScale : 1.0f,
+        mStats.lastMs);
+    return std::string(buffer);
+}
+
+// Free histograms and gradient buffers
+size_t AdaptiveThresholds::release() {
+    size_t released = releaseTracked(mHistograms);
+    released += releaseTracked(mDx);
+    released += releaseTracked(mDy);
+    released += releaseTracked(mRowScratch);
+    return released;
+}
@@ -0,0 +1,146 @@
+#ifndef EDGEDETECTOR_ADAPTIVE_THRESHOLDS_H
+#define EDGEDETECTOR_ADAPTIVE_THRESHOLDS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "native_memory.h"
+
+// Tile side in processing-plane pixels
+#define ADAPTIVE_DEFAULT_TILE 64
+#define ADAPTIVE_MIN_TILE 16
+#define ADAPTIVE_MAX_TILE 512
+
+// Gradient histogram: L1 magnitude >> shift, saturated into the last bin.
+// The shift is for the 3x3 aperture; larger apertures add the log2 of
+// their extra gain so the bins cover the same share of the range.
+#define ADAPTIVE_HISTOGRAM_BINS 256
+#define ADAPTIVE_HISTOGRAM_SHIFT 2
+
+// Evenly spaced rows of a tile that feed its histogram, every second pixel
+// of each (percentiles need no full census; counts fit 16 bits)
+#define ADAPTIVE_SAMPLE_ROWS 16
+
+// Magnitude percentile taken as the tile's contrast level
+#define ADAPTIVE_PERCENTILE 0.9f
+
+// Threshold scale range relative to the global Canny thresholds
+#define ADAPTIVE_MIN_SCALE 0.25f
+#define ADAPTIVE_MAX_SCALE 4.0f
+
+// Fixed-point gain applied to the derivatives
+#define ADAPTIVE_GAIN_BITS 12
+
+// Adaptive threshold counters
+struct AdaptiveThresholdStats {
+    uint64_t frames;
+    int tilesX;
+    int tilesY;
+    float minScale;         // Extremes of the last frame's tile scales
+    float maxScale;
+    double lastMs;          // Histogram and rescale passes of the last frame (with
+                            // the derivatives when taken from the smoothed plane)
+};
+
+/**
+ * Locally adaptive Canny thresholds. A histogram of L1 gradient magnitude
+ * is built per tile (from ADAPTIVE_SAMPLE_ROWS of its rows); the ratio of
+ * a tile's contrast percentile to the frame's gives its threshold scale
+ * (clamped), so low-contrast tiles in shadow get lower thresholds and busy
+ * bright tiles higher ones. Instead of a custom hysteresis the derivatives
+ * are multiplied by a gain, the reciprocal of the tile scale, interpolated
+ * bilinearly between tile centres (interpolating the gain rather than the
+ * scale keeps a division out of the per-pixel pass): the global thresholds
+ * on the rescaled gradients then act as per-pixel thresholds, and OpenCV's
+ * Canny(dx, dy) does suppression and hysteresis unchanged. Non-maximum
+ * suppression compares rescaled neighbours, which only differs from the
+ * exact per-pixel test where the scale changes between adjacent pixels (a
+ * fraction of a percent per pixel). Both passes run per tile row on the
+ * worker pool, vectorized with universal intrinsics when available.
+ */
+class AdaptiveThresholds {
+public:
+    using ShortBuffer = std::vector<int16_t, TrackedAllocator<int16_t>>;
+
+    AdaptiveThresholds();
+
+    /**
+     * @param enabled Adaptive thresholds on the OpenCV Canny path
+     * @param tileSize Tile side in pixels (clamped to ADAPTIVE_MIN_TILE..ADAPTIVE_MAX_TILE)
+     */
+    void configure(bool enabled, int tileSize);
+
+    bool isEnabled() const { return mEnabled; }
+    int tileSize() const { return mTileSize; }
+
+    /**
+     * Rescale derivatives into gradientX()/gradientY()
+     * @param dx Horizontal Sobel derivative (may be gradientX().data())
+     * @param dy Vertical Sobel derivative (may be gradientY().data())
+     * @param apertureSize Sobel aperture the derivatives were taken with
+     */
+    void normalize(const int16_t* dx, const int16_t* dy, int width, int height, int apertureSize);
+
+    /**
+     * Sobel derivatives of a smoothed plane (replicated borders, as
+     * cv::Sobel on CV_16S), rescaled into gradientX()/gradientY(). Each row
+     * is derived once, inside the histogram or the rescale pass, so no
+     * separate derivative planes are read back; the result equals
+     * normalize() on the cv::Sobel derivatives.
+     * @param apertureSize 3 or 5
+     */
+    void normalize(const uint8_t* smoothed, int width, int height, int apertureSize);
+
+    /**
+     * Histogram shift for a Sobel aperture (3, 5 or 7)
+     */
+    static int histogramShift(int apertureSize);
+
+    /**
+     * Output derivatives (also usable as input storage for normalize)
+     */
+    ShortBuffer& gradientX() { return mDx; }
+    ShortBuffer& gradientY() { return mDy; }
+
+    /**
+     * Threshold scale per tile of the last frame (row-major, tilesX x tilesY)
+     */
+    const std::vector<float>& tileScales() const { return mScales; }
+
+    AdaptiveThresholdStats stats() const { return mStats; }
+    std::string getStatistics() const;
+
+    /**
+     * Release histograms and gradient buffers
+     * @return Bytes released
+     */
+    size_t release();
+
+private:
+    // A tile samples at most ADAPTIVE_SAMPLE_ROWS * ADAPTIVE_MAX_TILE / 2 pixels
+    using CountBuffer = std::vector<uint16_t, TrackedAllocator<uint16_t>>;
+
+    bool mEnabled;
+    int mTileSize;
+    int mTilesX;
+    int mTilesY;
+    int mHistogramShift;
+    int mApertureSize;              // Sobel aperture of the current frame
+    CountBuffer mHistograms;        // ADAPTIVE_HISTOGRAM_BINS per tile, then the alternate samples
+    std::vector<float> mScales;
+    std::vector<float> mGains;      // ADAPTIVE_GAIN_BITS fixed-point reciprocal scales
+    ShortBuffer mDx;
+    ShortBuffer mDy;
+    ShortBuffer mRowScratch;        // Four padded rows per tile row
+    AdaptiveThresholdStats mStats;
+
+    void begin(int width, int height, int apertureSize);
+    void finish(std::chrono::steady_clock::time_point start);
+    void buildHistograms(const uint8_t* smoothed, const int16_t* dx, const int16_t* dy, int width, int height);
+    void computeScales();
+    void rescale(const uint8_t* smoothed, const int16_t* dx, const int16_t* dy, int width, int height);
+};
+
+#endif // EDGEDETECTOR_ADAPTIVE_THRESHOLDS_H
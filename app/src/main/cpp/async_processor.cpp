@@ -0,0 +1,245 @@
+#include "async_processor.h"
+#include "content_hash.h"
+#include <chrono>
+
+// Constructor
+AsyncProcessor::AsyncProcessor(WorkerPool& pool)
+    : mPool(pool)
+    , mNextTicket(1)
+    , mConfigurationGeneration(0)
+    , mResultCache(nullptr)
+{
+}
+
+// Destructor
+AsyncProcessor::~AsyncProcessor() {
+    cancelAll();
+
+    // Pool tasks reference this object until they have delivered
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdle.wait(lock, [this] { return mRequests.empty(); });
+}
+
+// Submit an RGBA frame
+uint64_t AsyncProcessor::submit(
+    const uint8_t* inputData,
+    int width,
+    int height,
+    ProcessingMode mode,
+    int priority,
+    int64_t deadlineMs
+) {
+    if (inputData == nullptr || width <= 0 || height <= 0) {
+        LOGE("Invalid async request: %dx%d", width, height);
+        return 0;
+    }
+
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->width = width;
+    request->height = height;
+    request->mode = mode;
+    request->deadlineMs = deadlineMs;
+    request->input.assign(inputData, inputData + static_cast<size_t>(width) * height * 4);
+    request->state.store(REQUEST_QUEUED);
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        request->ticket = mNextTicket++;
+        mRequests[request->ticket] = request;
+    }
+
+    mPool.submit([this, request] { runRequest(request); }, priority);
+    return request->ticket;
+}
+
+// Cancel a request that has not started
+bool AsyncProcessor::cancel(uint64_t ticket) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mRequests.find(ticket);
+    if (it == mRequests.end()) {
+        return false;
+    }
+    int expected = REQUEST_QUEUED;
+    return it->second->state.compare_exchange_strong(expected, REQUEST_CANCELLED);
+}
+
+// Cancel every request that has not started
+void AsyncProcessor::cancelAll() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& entry : mRequests) {
+        int expected = REQUEST_QUEUED;
+        entry.second->state.compare_exchange_strong(expected, REQUEST_CANCELLED);
+    }
+}
+
+// Route completions to a callback or the queue
+void AsyncProcessor::setCompletionCallback(AsyncCallback callback) {
+    std::lock_guard<std::mutex> lock(mCallbackMutex);
+    mCallback = std::move(callback);
+}
+
+// Take the next completion without blocking
+bool AsyncProcessor::pollCompletion(AsyncCompletion& completion) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCompletions.empty()) {
+        return false;
+    }
+    completion = std::move(mCompletions.front());
+    mCompletions.pop_front();
+    return true;
+}
+
+// Take the next completion, waiting up to timeoutMs
+bool AsyncProcessor::waitCompletion(AsyncCompletion& completion, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (!mCompletionReady.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                   [this] { return !mCompletions.empty(); })) {
+        return false;
+    }
+    completion = std::move(mCompletions.front());
+    mCompletions.pop_front();
+    return true;
+}
+
+// Snapshot the configuration for pooled processors
+void AsyncProcessor::setConfiguration(OpenCVProcessor& source) {
+    std::vector<uint8_t> blob;
+    source.saveState(blob);
+    std::lock_guard<std::mutex> lock(mProcessorMutex);
+    mConfiguration.swap(blob);
+    mConfigurationGeneration++;
+}
+
+// Attach or detach the result cache
+void AsyncProcessor::setResultCache(ResultCache* cache) {
+    mResultCache.store(cache);
+}
+
+size_t AsyncProcessor::inFlight() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRequests.size();
+}
+
+// Run one request on a pool thread
+void AsyncProcessor::runRequest(const std::shared_ptr<Request>& request) {
+    AsyncCompletion completion;
+    completion.ticket = request->ticket;
+    completion.metrics = {0, request->width, request->height, request->mode, false, false, 0};
+
+    int expected = REQUEST_QUEUED;
+    if (!request->state.compare_exchange_strong(expected, REQUEST_RUNNING)) {
+        completion.status = ASYNC_CANCELLED;
+    } else {
+        PooledProcessor pooled = acquireProcessor();
+        ResultCache* cache = mResultCache.load();
+        const bool cacheable = cache != nullptr && cache->isOpen() &&
+                               !pooled.processor->hasFrameSideOutputs(request->mode);
+        ResultCacheKey key = {0, 0};
+        bool cached = false;
+        if (cacheable) {
+            int64_t lookupStart = FrameDeadline::nowMs();
+            key.content = ContentHash::xxh64(request->input.data(), request->input.size());
+            key.parameters = ContentHash::combine(pooled.processor->configurationHash(),
+                                                  static_cast<uint64_t>(request->mode));
+            key.parameters = ContentHash::combine(key.parameters,
+                (static_cast<uint64_t>(request->width) << 32) | static_cast<uint32_t>(request->height));
+            int width = 0;
+            int height = 0;
+            cached = cache->lookup(key, width, height, completion.output, pooled.processor->kernels()) &&
+                     width == request->width && height == request->height;
+            if (cached) {
+                completion.metrics.processingTimeMs = FrameDeadline::nowMs() - lookupStart;
+                completion.metrics.success = true;
+                pooled.processor->recordCachedFrame(completion.metrics);
+            }
+        }
+        if (!cached) {
+            completion.output.resize(request->input.size());
+            completion.metrics = pooled.processor->processFrame(
+                request->input.data(),
+                request->width,
+                request->height,
+                request->mode,
+                completion.output.data(),
+                request->deadlineMs
+            );
+            if (completion.metrics.success && cacheable) {
+                cache->store(key, completion.output.data(), request->width, request->height);
+            }
+        }
+        releaseProcessor(std::move(pooled));
+
+        if (completion.metrics.success) {
+            completion.status = ASYNC_COMPLETED;
+        } else {
+            completion.status = completion.metrics.abandoned ? ASYNC_ABANDONED : ASYNC_FAILED;
+        }
+        if (!completion.metrics.success) {
+            releaseTracked(completion.output);
+        }
+    }
+
+    // The input copy is no longer needed while the completion waits
+    releaseTracked(request->input);
+    deliver(completion);
+    releaseTracked(completion.output);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRequests.erase(request->ticket);
+    mIdle.notify_all();
+}
+
+// Hand a completion to the callback or the queue
+void AsyncProcessor::deliver(AsyncCompletion& completion) {
+    {
+        std::lock_guard<std::mutex> lock(mCallbackMutex);
+        if (mCallback) {
+            mCallback(completion);
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCompletions.push_back(std::move(completion));
+    mCompletionReady.notify_one();
+}
+
+// Take an idle processor or create one
+AsyncProcessor::PooledProcessor AsyncProcessor::acquireProcessor() {
+    PooledProcessor pooled;
+    std::vector<uint8_t> configuration;
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mProcessorMutex);
+        generation = mConfigurationGeneration;
+        if (!mIdleProcessors.empty()) {
+            pooled = std::move(mIdleProcessors.back());
+            mIdleProcessors.pop_back();
+        }
+        if (!pooled.processor || pooled.configurationGeneration != generation) {
+            configuration = mConfiguration;
+        }
+    }
+
+    if (!pooled.processor) {
+        pooled.processor.reset(new OpenCVProcessor());
+        pooled.processor->initialize();
+        pooled.configurationGeneration = generation + 1;
+    }
+    if (pooled.configurationGeneration != generation) {
+        // Settings only; scratch planes grow to this processor's own frames
+        if (!configuration.empty() &&
+            pooled.processor->restoreState(configuration.data(), configuration.size(), false)) {
+            pooled.processor->setSubpixelEdgesEnabled(false);
+            pooled.processor->setEdgeHashEnabled(false);
+        }
+        pooled.configurationGeneration = generation;
+    }
+    return pooled;
+}
+
+// Return a processor to the idle list
+void AsyncProcessor::releaseProcessor(PooledProcessor processor) {
+    std::lock_guard<std::mutex> lock(mProcessorMutex);
+    mIdleProcessors.push_back(std::move(processor));
+}
@@ -0,0 +1,174 @@
+#ifndef EDGEDETECTOR_ASYNC_PROCESSOR_H
+#define EDGEDETECTOR_ASYNC_PROCESSOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "native_memory.h"
+#include "opencv_processor.h"
+#include "result_cache.h"
+#include "worker_pool.h"
+
+// Final state of an asynchronous request
+enum AsyncStatus {
+    ASYNC_COMPLETED = 0,
+    ASYNC_CANCELLED = 1,
+    ASYNC_FAILED = 2,
+    ASYNC_ABANDONED = 3         // Deadline passed (metrics.abandonedStage says where)
+};
+
+// Result delivered for every submitted ticket
+struct AsyncCompletion {
+    uint64_t ticket;
+    int status;                 // AsyncStatus
+    ProcessingMetrics metrics;
+    TrackedBytes output;        // RGBA result (empty unless completed)
+};
+
+// Called on a pool thread once a request finishes
+using AsyncCallback = std::function<void(AsyncCompletion&)>;
+
+/**
+ * Runs processFrame requests on the shared worker pool. Each request copies
+ * its input, so the caller's buffer is free as soon as submit() returns.
+ * Concurrent requests use separate OpenCVProcessor instances from an idle
+ * list, so small frames overlap instead of queueing behind one processor.
+ * Completions go to the callback when one is set, otherwise to a queue
+ * drained by pollCompletion()/waitCompletion().
+ */
+class AsyncProcessor {
+public:
+    explicit AsyncProcessor(WorkerPool& pool = WorkerPool::shared());
+
+    /**
+     * Cancels queued requests and waits for running ones
+     */
+    ~AsyncProcessor();
+
+    /**
+     * Submit an RGBA frame
+     * @param inputData Input RGBA frame data (copied)
+     * @param width Frame width
+     * @param height Frame height
+     * @param mode Processing mode
+     * @param priority Larger runs earlier
+     * @param deadlineMs Steady-clock deadline (FrameDeadline::nowMs()), 0 = none;
+     *        a request still queued at its deadline is dropped before any work
+     * @return Ticket (0 if the request was rejected)
+     */
+    uint64_t submit(
+        const uint8_t* inputData,
+        int width,
+        int height,
+        ProcessingMode mode,
+        int priority,
+        int64_t deadlineMs = 0
+    );
+
+    /**
+     * Cancel a request that has not started yet
+     * @return true if it will complete as ASYNC_CANCELLED
+     */
+    bool cancel(uint64_t ticket);
+
+    /**
+     * Cancel every request that has not started yet
+     */
+    void cancelAll();
+
+    /**
+     * Deliver completions to a callback instead of the queue (nullptr to
+     * return to polling). Returns only once no callback is running.
+     */
+    void setCompletionCallback(AsyncCallback callback);
+
+    /**
+     * Take the next queued completion without blocking
+     * @return false if none is ready
+     */
+    bool pollCompletion(AsyncCompletion& completion);
+
+    /**
+     * Take the next queued completion, waiting up to timeoutMs
+     * @return false on timeout
+     */
+    bool waitCompletion(AsyncCompletion& completion, int timeoutMs);
+
+    /**
+     * Copy the configuration of source (thresholds, aperture, blur, adaptive
+     * thresholds, fragment filter, distance options, implementation) to all
+     * pooled processors. Each picks it up the next time it is acquired.
+     * Sub-pixel edges and the edge hash stay off: completions carry only
+     * the RGBA result.
+     */
+    void setConfiguration(OpenCVProcessor& source);
+
+    /**
+     * Serve repeated inputs from a result cache and store new results in it
+     * (keyed on the RGBA input, its size, the mode and the pooled processor
+     * configuration). Requests whose mode has processor side outputs
+     * enabled bypass it. The cache must outlive this processor or be
+     * detached with nullptr first.
+     */
+    void setResultCache(ResultCache* cache);
+
+    /**
+     * Requests submitted but not yet completed
+     */
+    size_t inFlight() const;
+
+private:
+    enum RequestState {
+        REQUEST_QUEUED = 0,
+        REQUEST_RUNNING = 1,
+        REQUEST_CANCELLED = 2
+    };
+
+    struct Request {
+        uint64_t ticket;
+        int width;
+        int height;
+        ProcessingMode mode;
+        int64_t deadlineMs;
+        TrackedBytes input;
+        std::atomic<int> state;
+    };
+
+    struct PooledProcessor {
+        std::unique_ptr<OpenCVProcessor> processor;
+        uint32_t configurationGeneration;
+    };
+
+    WorkerPool& mPool;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCompletionReady;
+    std::condition_variable mIdle;
+    std::unordered_map<uint64_t, std::shared_ptr<Request>> mRequests;
+    std::deque<AsyncCompletion> mCompletions;
+    uint64_t mNextTicket;
+
+    // Held while a callback runs so replacing it cannot race a delivery
+    std::mutex mCallbackMutex;
+    AsyncCallback mCallback;
+
+    std::mutex mProcessorMutex;
+    std::vector<PooledProcessor> mIdleProcessors;
+    std::vector<uint8_t> mConfiguration;    // saveState() blob (empty = defaults)
+    uint32_t mConfigurationGeneration;
+
+    std::atomic<ResultCache*> mResultCache;
+
+    void runRequest(const std::shared_ptr<Request>& request);
+    void deliver(AsyncCompletion& completion);
+    PooledProcessor acquireProcessor();
+    void releaseProcessor(PooledProcessor processor);
+};
+
+#endif // EDGEDETECTOR_ASYNC_PROCESSOR_H
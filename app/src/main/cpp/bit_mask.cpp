@@ -0,0 +1,323 @@
+#include "bit_mask.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const uint64_t kAllSet = ~uint64_t(0);
+
+    // dst bit x = src bit (x - dx); bits from outside the row read as fill
+    void shiftRow(const uint64_t* src, uint64_t* dst, int words, int dx, uint64_t fill) {
+        const int distance = dx >= 0 ? dx : -dx;
+        const int wordShift = distance >> 6;
+        const int bitShift = distance & 63;
+        auto at = [&](int index) {
+            return index >= 0 && index < words ? src[index] : fill;
+        };
+
+        for (int i = 0; i < words; i++) {
+            if (dx >= 0) {
+                const uint64_t high = at(i - wordShift);
+                dst[i] = bitShift == 0 ? high
+                    : (high << bitShift) | (at(i - wordShift - 1) >> (64 - bitShift));
+            } else {
+                const uint64_t low = at(i + wordShift);
+                dst[i] = bitShift == 0 ? low
+                    : (low >> bitShift) | (at(i + wordShift + 1) << (64 - bitShift));
+            }
+        }
+    }
+
+    // Any set bit in [begin, end) of a row
+    bool anyInRange(const uint64_t* words, int begin, int end) {
+        const int first = begin >> 6;
+        const int last = (end - 1) >> 6;
+        const uint64_t low = kAllSet << (begin & 63);
+        const uint64_t high = kAllSet >> (63 - ((end - 1) & 63));
+        if (first == last) {
+            return (words[first] & low & high) != 0;
+        }
+        if ((words[first] & low) != 0) {
+            return true;
+        }
+        for (int i = first + 1; i < last; i++) {
+            if (words[i] != 0) {
+                return true;
+            }
+        }
+        return (words[last] & high) != 0;
+    }
+}
+
+// Constructor
+BitMask::BitMask()
+    : mWidth(0)
+    , mHeight(0)
+    , mWordsPerRow(0)
+{
+}
+
+// Valid bits of the last word in a row
+uint64_t BitMask::tailMask() const {
+    const int bits = mWidth & 63;
+    return bits == 0 ? kAllSet : (uint64_t(1) << bits) - 1;
+}
+
+void BitMask::resize(int width, int height) {
+    mWidth = std::max(0, width);
+    mHeight = std::max(0, height);
+    mWordsPerRow = (mWidth + 63) >> 6;
+    mWords.assign(static_cast<size_t>(mWordsPerRow) * mHeight, 0);
+}
+
+void BitMask::clear() {
+    std::fill(mWords.begin(), mWords.end(), 0);
+}
+
+// Pack a byte mask with the packMask kernel, one row at a time
+void BitMask::pack(const uint8_t* mask, int width, int height, int stride, const ImageKernels* kernels) {
+    mWidth = std::max(0, width);
+    mHeight = std::max(0, height);
+    mWordsPerRow = (mWidth + 63) >> 6;
+    mWords.resize(static_cast<size_t>(mWordsPerRow) * mHeight);
+    if (empty()) {
+        return;
+    }
+    if (stride <= 0) {
+        stride = mWidth;
+    }
+    const ImageKernels& packer = kernels != nullptr ? *kernels : SimdKernels::vectorized();
+
+    for (int y = 0; y < mHeight; y++) {
+        uint64_t* words = row(y);
+        const uint8_t* source = mask + static_cast<size_t>(y) * stride;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        (void)packer;
+        std::memset(words, 0, mWordsPerRow * sizeof(uint64_t));
+        for (int x = 0; x < mWidth; x++) {
+            if (source[x] != 0) {
+                words[x >> 6] |= uint64_t(1) << (x & 63);
+            }
+        }
+#else
+        // Bytes past (width + 7) / 8 are padding the kernel does not write
+        words[mWordsPerRow - 1] = 0;
+        packer.packMask(source, static_cast<size_t>(mWidth), reinterpret_cast<uint8_t*>(words));
+#endif
+    }
+}
+
+// Expand every row
+void BitMask::unpack(uint8_t* mask, uint8_t value, int stride) const {
+    if (stride <= 0) {
+        stride = mWidth;
+    }
+    for (int y = 0; y < mHeight; y++) {
+        unpackRow(y, mask + static_cast<size_t>(y) * stride, value);
+    }
+}
+
+// Expand eight bits at a time into eight bytes
+void BitMask::unpackRow(int y, uint8_t* out, uint8_t value) const {
+    const uint8_t* bits = reinterpret_cast<const uint8_t*>(row(y));
+    const uint64_t fill = value * 0x0101010101010101ULL;
+    int x = 0;
+    for (; x + 8 <= mWidth; x += 8) {
+        // Byte i of spread keeps bit i; the carry trick turns each into 0x01
+        const uint64_t spread = (bits[x >> 3] * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+        const uint64_t ones = ((((spread + 0x7F7F7F7F7F7F7F7FULL) | spread) & 0x8080808080808080ULL) >> 7);
+        uint64_t expanded = (ones * 0xFF) & fill;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        expanded = __builtin_bswap64(expanded);
+#endif
+        std::memcpy(out + x, &expanded, sizeof(expanded));
+    }
+    for (; x < mWidth; x++) {
+        out[x] = test(x, y) ? value : 0;
+    }
+}
+
+bool BitMask::andWith(const BitMask& other) {
+    if (other.mWidth != mWidth || other.mHeight != mHeight) {
+        return false;
+    }
+    for (size_t i = 0; i < mWords.size(); i++) {
+        mWords[i] &= other.mWords[i];
+    }
+    return true;
+}
+
+bool BitMask::orWith(const BitMask& other) {
+    if (other.mWidth != mWidth || other.mHeight != mHeight) {
+        return false;
+    }
+    for (size_t i = 0; i < mWords.size(); i++) {
+        mWords[i] |= other.mWords[i];
+    }
+    return true;
+}
+
+bool BitMask::xorWith(const BitMask& other) {
+    if (other.mWidth != mWidth || other.mHeight != mHeight) {
+        return false;
+    }
+    for (size_t i = 0; i < mWords.size(); i++) {
+        mWords[i] ^= other.mWords[i];
+    }
+    return true;
+}
+
+// Translate by whole rows and word-level bit shifts
+void BitMask::shift(int dx, int dy, BitMask& out) const {
+    out.resize(mWidth, mHeight);
+    if (empty()) {
+        return;
+    }
+    const uint64_t tail = tailMask();
+    for (int y = 0; y < mHeight; y++) {
+        const int sourceRow = y - dy;
+        if (sourceRow < 0 || sourceRow >= mHeight) {
+            continue;
+        }
+        uint64_t* words = out.row(y);
+        shiftRow(row(sourceRow), words, mWordsPerRow, dx, 0);
+        words[mWordsPerRow - 1] &= tail;
+    }
+}
+
+// Horizontal OR of each row with its neighbours, then OR of adjacent rows
+void BitMask::dilate(BitMask& out) const {
+    out.resize(mWidth, mHeight);
+    if (empty()) {
+        return;
+    }
+    const uint64_t tail = tailMask();
+    uint64_t* left = out.scratchRows(4, mWordsPerRow);
+    uint64_t* right = left + mWordsPerRow;
+    uint64_t* previous = right + mWordsPerRow;
+    uint64_t* current = previous + mWordsPerRow;
+    for (int y = 0; y < mHeight; y++) {
+        const uint64_t* source = row(y);
+        uint64_t* words = out.row(y);
+        shiftRow(source, left, mWordsPerRow, 1, 0);
+        shiftRow(source, right, mWordsPerRow, -1, 0);
+        for (int i = 0; i < mWordsPerRow; i++) {
+            words[i] = source[i] | left[i] | right[i];
+        }
+        words[mWordsPerRow - 1] &= tail;
+    }
+
+    // Rows are combined in place, keeping the horizontal result of the row above
+    std::fill(previous, previous + mWordsPerRow, 0);
+    for (int y = 0; y < mHeight; y++) {
+        uint64_t* words = out.row(y);
+        const uint64_t* below = y + 1 < mHeight ? out.row(y + 1) : nullptr;
+        std::memcpy(current, words, mWordsPerRow * sizeof(uint64_t));
+        for (int i = 0; i < mWordsPerRow; i++) {
+            words[i] |= previous[i] | (below != nullptr ? below[i] : 0);
+        }
+        std::swap(previous, current);
+    }
+}
+
+// Horizontal AND with neighbours (outside and padding count as set), then AND of adjacent rows
+void BitMask::erode(BitMask& out) const {
+    out.resize(mWidth, mHeight);
+    if (empty()) {
+        return;
+    }
+    const uint64_t tail = tailMask();
+    uint64_t* padded = out.scratchRows(5, mWordsPerRow);
+    uint64_t* left = padded + mWordsPerRow;
+    uint64_t* right = left + mWordsPerRow;
+    uint64_t* previous = right + mWordsPerRow;
+    uint64_t* current = previous + mWordsPerRow;
+    for (int y = 0; y < mHeight; y++) {
+        std::memcpy(padded, row(y), mWordsPerRow * sizeof(uint64_t));
+        padded[mWordsPerRow - 1] |= ~tail;
+        uint64_t* words = out.row(y);
+        shiftRow(padded, left, mWordsPerRow, 1, kAllSet);
+        shiftRow(padded, right, mWordsPerRow, -1, kAllSet);
+        for (int i = 0; i < mWordsPerRow; i++) {
+            words[i] = padded[i] & left[i] & right[i];
+        }
+    }
+
+    std::fill(previous, previous + mWordsPerRow, kAllSet);
+    for (int y = 0; y < mHeight; y++) {
+        uint64_t* words = out.row(y);
+        const uint64_t* below = y + 1 < mHeight ? out.row(y + 1) : nullptr;
+        std::memcpy(current, words, mWordsPerRow * sizeof(uint64_t));
+        for (int i = 0; i < mWordsPerRow; i++) {
+            words[i] &= previous[i] & (below != nullptr ? below[i] : kAllSet);
+        }
+        words[mWordsPerRow - 1] &= tail;
+        std::swap(previous, current);
+    }
+}
+
+size_t BitMask::popcount() const {
+    size_t count = 0;
+    for (uint64_t word : mWords) {
+        count += static_cast<size_t>(__builtin_popcountll(word));
+    }
+    return count;
+}
+
+size_t BitMask::rowPopcount(int y) const {
+    const uint64_t* words = row(y);
+    size_t count = 0;
+    for (int i = 0; i < mWordsPerRow; i++) {
+        count += static_cast<size_t>(__builtin_popcountll(words[i]));
+    }
+    return count;
+}
+
+// OR the rows of each band, then test each column span
+void BitMask::downscaleAny(int outWidth, int outHeight, BitMask& out) const {
+    outWidth = std::max(1, std::min(outWidth, mWidth));
+    outHeight = std::max(1, std::min(outHeight, mHeight));
+    out.resize(outWidth, outHeight);
+    if (empty()) {
+        return;
+    }
+
+    std::vector<int, TrackedAllocator<int>>& columnStart = out.mColumns;
+    columnStart.resize(outWidth + 1);
+    for (int x = 0; x <= outWidth; x++) {
+        columnStart[x] = static_cast<int>(static_cast<int64_t>(x) * mWidth / outWidth);
+    }
+    uint64_t* band = out.scratchRows(1, mWordsPerRow);
+    for (int y = 0; y < outHeight; y++) {
+        const int rowBegin = static_cast<int>(static_cast<int64_t>(y) * mHeight / outHeight);
+        const int rowEnd = static_cast<int>(static_cast<int64_t>(y + 1) * mHeight / outHeight);
+        std::fill(band, band + mWordsPerRow, 0);
+        for (int sourceRow = rowBegin; sourceRow < rowEnd; sourceRow++) {
+            const uint64_t* words = row(sourceRow);
+            for (int i = 0; i < mWordsPerRow; i++) {
+                band[i] |= words[i];
+            }
+        }
+        for (int x = 0; x < outWidth; x++) {
+            if (anyInRange(band, columnStart[x], columnStart[x + 1])) {
+                out.set(x, y);
+            }
+        }
+    }
+}
+
+size_t BitMask::release() {
+    mWidth = 0;
+    mHeight = 0;
+    mWordsPerRow = 0;
+    return releaseTracked(mWords) + releaseTracked(mScratch) + releaseTracked(mColumns);
+}
+
+// Row scratch owned by this mask, grown on demand and kept between calls
+uint64_t* BitMask::scratchRows(int rows, int wordsPerRow) {
+    const size_t words = static_cast<size_t>(rows) * wordsPerRow;
+    if (mScratch.size() < words) {
+        mScratch.resize(words);
+    }
+    return mScratch.data();
+}
@@ -0,0 +1,152 @@
+#ifndef EDGEDETECTOR_BIT_MASK_H
+#define EDGEDETECTOR_BIT_MASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "native_memory.h"
+
+struct ImageKernels;
+
+/**
+ * Binary image at one bit per pixel. Each row starts on a 64-bit word and
+ * holds pixel x in bit (x % 64) of word x / 64, so a row read as bytes is
+ * the LSB-first layout of the packMask kernel. Padding bits past the width
+ * are always zero, which lets popcounts, logic operations and scans run a
+ * word at a time without masking.
+ *
+ * Edge masks are an eighth the size of the byte planes they come from;
+ * post-processing (fragment filtering, sub-pixel scanning) and the stream
+ * mask encoder read this form directly.
+ */
+class BitMask {
+public:
+    using WordBuffer = std::vector<uint64_t, TrackedAllocator<uint64_t>>;
+
+    BitMask();
+
+    /**
+     * Resize and clear every pixel
+     */
+    void resize(int width, int height);
+
+    /**
+     * Clear every pixel
+     */
+    void clear();
+
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+    int wordsPerRow() const { return mWordsPerRow; }
+    bool empty() const { return mWidth == 0 || mHeight == 0; }
+
+    uint64_t* row(int y) { return mWords.data() + static_cast<size_t>(y) * mWordsPerRow; }
+    const uint64_t* row(int y) const { return mWords.data() + static_cast<size_t>(y) * mWordsPerRow; }
+
+    bool test(int x, int y) const {
+        return (row(y)[x >> 6] >> (x & 63)) & 1;
+    }
+    void set(int x, int y) {
+        row(y)[x >> 6] |= uint64_t(1) << (x & 63);
+    }
+    void reset(int x, int y) {
+        row(y)[x >> 6] &= ~(uint64_t(1) << (x & 63));
+    }
+
+    /**
+     * Pack a byte mask (non-zero = set), resizing to its size
+     * @param stride Source row stride in bytes (0 = width)
+     * @param kernels Kernel set doing the packing (nullptr = vectorized)
+     */
+    void pack(const uint8_t* mask, int width, int height, int stride = 0,
+              const ImageKernels* kernels = nullptr);
+
+    /**
+     * Expand to a byte mask
+     * @param mask Output of height rows
+     * @param value Byte written for set pixels (clear pixels get 0)
+     * @param stride Output row stride in bytes (0 = width)
+     */
+    void unpack(uint8_t* mask, uint8_t value = 255, int stride = 0) const;
+
+    /**
+     * Expand row y into width bytes (set pixels get value, clear pixels 0)
+     */
+    void unpackRow(int y, uint8_t* out, uint8_t value = 255) const;
+
+    /**
+     * In-place logic with a mask of the same size
+     * @return false if the sizes differ (mask unchanged)
+     */
+    bool andWith(const BitMask& other);
+    bool orWith(const BitMask& other);
+    bool xorWith(const BitMask& other);
+
+    /**
+     * Translate by (dx, dy); pixels shifted in from outside are clear
+     * @param out Output mask (resized; must not be this mask)
+     */
+    void shift(int dx, int dy, BitMask& out) const;
+
+    /**
+     * 3x3 morphology from row shifts and word logic. Erosion treats pixels
+     * outside the image as set, so the border does not erode (the OpenCV
+     * default). Row scratch is kept in the output mask, so reusing it
+     * across frames does not allocate.
+     * @param out Output mask (resized; must not be this mask)
+     */
+    void dilate(BitMask& out) const;
+    void erode(BitMask& out) const;
+
+    /**
+     * Set pixels in the whole mask or one row
+     */
+    size_t popcount() const;
+    size_t rowPopcount(int y) const;
+
+    /**
+     * First set pixel at or after x in row y
+     * @return width if there is none
+     */
+    int nextSet(int y, int x) const {
+        if (x >= mWidth) {
+            return mWidth;
+        }
+        const uint64_t* words = row(y);
+        int index = x >> 6;
+        uint64_t word = words[index] & (~uint64_t(0) << (x & 63));
+        while (word == 0) {
+            if (++index >= mWordsPerRow) {
+                return mWidth;
+            }
+            word = words[index];
+        }
+        return (index << 6) + __builtin_ctzll(word);
+    }
+
+    /**
+     * Reduce to outWidth x outHeight; an output pixel is set when any pixel
+     * of its source cell is (the same cells as MultiOutputWriter averaging)
+     * @param out Output mask (resized, holds the row scratch; must not be this mask)
+     */
+    void downscaleAny(int outWidth, int outHeight, BitMask& out) const;
+
+    /**
+     * Release the word storage
+     * @return Bytes released
+     */
+    size_t release();
+
+private:
+    int mWidth;
+    int mHeight;
+    int mWordsPerRow;
+    WordBuffer mWords;
+    WordBuffer mScratch;        // Row buffers for operations writing into this mask
+    std::vector<int, TrackedAllocator<int>> mColumns;
+
+    uint64_t tailMask() const;
+    uint64_t* scratchRows(int rows, int wordsPerRow);
+};
+
+#endif // EDGEDETECTOR_BIT_MASK_H
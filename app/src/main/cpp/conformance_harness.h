@@ -0,0 +1,105 @@
+#ifndef EDGEDETECTOR_CONFORMANCE_HARNESS_H
+#define EDGEDETECTOR_CONFORMANCE_HARNESS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "perf_baseline.h"
+
+// Allowed difference between an implementation and the reference
+struct ConformanceTolerance {
+    int maxAbsDiff;              // Per-pixel channel difference
+    double maxMismatchFraction;  // Fraction of bytes that may differ at all
+    double minEdgeAgreement;     // EDGE: reference edges with a candidate edge within 1px
+    double minEdgePrecision;     // EDGE: candidate edges with a reference edge within 1px
+    double maxFartherFraction;   // DISTANCE: pixels more than 2 farther from an edge than in the reference
+};
+
+// Harness configuration
+struct ConformanceConfig {
+    int width;                   // Synthetic corpus frame size
+    int height;
+    std::string recordedDir;     // Optional directory of <name>_<W>x<H>.rgba frames
+    int timingIterations;
+    int warmupIterations;
+};
+
+// One corpus frame
+struct ConformanceCase {
+    std::string name;
+    int width;
+    int height;
+    std::vector<uint8_t> rgba;
+};
+
+// Comparison of one implementation against the reference
+struct ConformanceResult {
+    std::string caseName;
+    int mode;
+    int implementation;
+    int maxAbsDiff;
+    double mismatchFraction;
+    double edgeAgreement;
+    double edgePrecision;
+    double fartherFraction;
+    bool passed;
+};
+
+/**
+ * Runs every processing mode over a fixed corpus with each available
+ * implementation, checks the results against the reference implementation
+ * (OpenCV when compiled in, otherwise the fallback) and records timing
+ * baselines for PerfBaseline::compare.
+ */
+class ConformanceHarness {
+public:
+    explicit ConformanceHarness(const ConformanceConfig& config);
+
+    /**
+     * Stated tolerances per processing mode
+     */
+    static ConformanceTolerance toleranceFor(int mode);
+
+    /**
+     * Build the synthetic corpus and load any recorded frames
+     */
+    void buildCorpus();
+
+    /**
+     * Compare all implementations against the reference
+     */
+    std::vector<ConformanceResult> runConformance();
+
+    /**
+     * Time every case, mode and implementation
+     */
+    PerfBaseline runTiming();
+
+    /**
+     * Summarize conformance results
+     */
+    static std::string formatResults(const std::vector<ConformanceResult>& results);
+
+    /**
+     * Load raw RGBA frames named <name>_<width>x<height>.rgba
+     */
+    static bool loadRecordedFrames(const std::string& directory, std::vector<ConformanceCase>& cases);
+
+    const std::vector<ConformanceCase>& corpus() const { return mCorpus; }
+
+private:
+    ConformanceConfig mConfig;
+    std::vector<ConformanceCase> mCorpus;
+
+    static std::vector<int> availableImplementations();
+    static void compareOutputs(
+        const std::vector<uint8_t>& reference,
+        const std::vector<uint8_t>& candidate,
+        int width,
+        int height,
+        int mode,
+        ConformanceResult& result
+    );
+};
+
+#endif // EDGEDETECTOR_CONFORMANCE_HARNESS_H
@@ -0,0 +1,108 @@
+#include "content_hash.h"
+#include <cstring>
+
+namespace {
+    const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+    inline uint64_t rotateLeft(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // Unaligned little-endian loads (memcpy compiles to a single load)
+    inline uint64_t read64(const uint8_t* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap64(value);
+#endif
+        return value;
+    }
+
+    inline uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap32(value);
+#endif
+        return value;
+    }
+
+    inline uint64_t round(uint64_t accumulator, uint64_t input) {
+        accumulator += input * kPrime2;
+        accumulator = rotateLeft(accumulator, 31);
+        return accumulator * kPrime1;
+    }
+
+    inline uint64_t mergeRound(uint64_t hash, uint64_t accumulator) {
+        hash ^= round(0, accumulator);
+        return hash * kPrime1 + kPrime4;
+    }
+
+    inline uint64_t avalanche(uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+}
+
+namespace ContentHash {
+    uint64_t xxh64(const void* data, size_t size, uint64_t seed) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const uint8_t* end = p + size;
+        uint64_t hash;
+
+        if (size >= 32) {
+            // Four independent lanes over 32-byte stripes
+            uint64_t v1 = seed + kPrime1 + kPrime2;
+            uint64_t v2 = seed + kPrime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - kPrime1;
+            const uint8_t* limit = end - 32;
+            do {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+            hash = mergeRound(hash, v1);
+            hash = mergeRound(hash, v2);
+            hash = mergeRound(hash, v3);
+            hash = mergeRound(hash, v4);
+        } else {
+            hash = seed + kPrime5;
+        }
+        hash += static_cast<uint64_t>(size);
+
+        // Tail: 8, then 4, then single bytes
+        while (p + 8 <= end) {
+            hash ^= round(0, read64(p));
+            hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+            p += 8;
+        }
+        if (p + 4 <= end) {
+            hash ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+            hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+            p += 4;
+        }
+        while (p < end) {
+            hash ^= (*p) * kPrime5;
+            hash = rotateLeft(hash, 11) * kPrime1;
+            p++;
+        }
+        return avalanche(hash);
+    }
+
+    uint64_t combine(uint64_t hash, uint64_t value) {
+        return xxh64(&value, sizeof(value), hash);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef EDGEDETECTOR_CONTENT_HASH_H
+#define EDGEDETECTOR_CONTENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * XXH64 (xxHash, 64-bit) for content-addressed keys. Output matches the
+ * reference implementation for every input and seed, so keys stay valid
+ * across builds and architectures.
+ */
+namespace ContentHash {
+    /**
+     * Hash a byte range
+     * @param data Input bytes (may be null when size is 0)
+     * @param size Input size
+     * @param seed Hash seed
+     */
+    uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0);
+
+    /**
+     * Fold a value into a running hash (for combining parameters)
+     */
+    uint64_t combine(uint64_t hash, uint64_t value);
+}
+
+#endif // EDGEDETECTOR_CONTENT_HASH_H
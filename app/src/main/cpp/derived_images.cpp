@@ -0,0 +1,186 @@
+#include "derived_images.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    const char* const kImageNames[DERIVED_IMAGE_COUNT] = {
+        "luma", "blurred", "pyramid", "gradients", "edges", "distance"
+    };
+}
+
+void DerivedImageReport::clear() {
+    std::fill(computed, computed + DERIVED_IMAGE_COUNT, 0);
+    std::fill(reused, reused + DERIVED_IMAGE_COUNT, 0);
+}
+
+int DerivedImageReport::totalComputed() const {
+    int total = 0;
+    for (int i = 0; i < DERIVED_IMAGE_COUNT; i++) {
+        total += computed[i];
+    }
+    return total;
+}
+
+int DerivedImageReport::totalReused() const {
+    int total = 0;
+    for (int i = 0; i < DERIVED_IMAGE_COUNT; i++) {
+        total += reused[i];
+    }
+    return total;
+}
+
+// Images that were touched this frame, with their counts
+std::string DerivedImageReport::toString() const {
+    std::string result;
+    char buffer[64];
+    for (int i = 0; i < DERIVED_IMAGE_COUNT; i++) {
+        if (computed[i] == 0 && reused[i] == 0) {
+            continue;
+        }
+        snprintf(buffer, sizeof(buffer), "%s%s computed %d reused %d",
+                 result.empty() ? "" : ", ", kImageNames[i], computed[i], reused[i]);
+        result += buffer;
+    }
+    return result.empty() ? std::string("nothing derived") : result;
+}
+
+// Constructor
+DerivedImageCache::DerivedImageCache()
+    : mWidth(0)
+    , mHeight(0)
+    , mValid(0)
+    , mValidLevels(0)
+{
+    mReport.clear();
+}
+
+// Start a new frame
+void DerivedImageCache::begin(int width, int height) {
+    mWidth = width;
+    mHeight = height;
+    mValid = 0;
+    mValidLevels = 0;
+    mReport.clear();
+}
+
+bool DerivedImageCache::isValid(DerivedImage image, int level) const {
+    if (image == DERIVED_PYRAMID && level > 0) {
+        return (mValidLevels & (1u << level)) != 0;
+    }
+    return (mValid & DERIVED_IMAGE_BIT(image)) != 0;
+}
+
+bool DerivedImageCache::reuse(DerivedImage image, int level) {
+    if (!isValid(image, level)) {
+        return false;
+    }
+    mReport.reused[image]++;
+    return true;
+}
+
+void DerivedImageCache::markComputed(DerivedImage image, int level) {
+    if (image == DERIVED_PYRAMID && level > 0) {
+        mValidLevels |= 1u << level;
+    } else {
+        mValid |= DERIVED_IMAGE_BIT(image);
+    }
+    mReport.computed[image]++;
+}
+
+TrackedBytes& DerivedImageCache::plane(DerivedImage image) {
+    switch (image) {
+        case DERIVED_BLURRED:
+            return mBlurred;
+        case DERIVED_EDGES:
+            return mEdges;
+        case DERIVED_DISTANCE:
+            return mDistance;
+        default:
+            return mLuma;
+    }
+}
+
+TrackedBytes& DerivedImageCache::pyramidLevel(int level) {
+    const int index = std::min(std::max(level, 1), DERIVED_PYRAMID_LEVELS) - 1;
+    return mPyramid[index];
+}
+
+const uint8_t* DerivedImageCache::image(DerivedImage image, int level) const {
+    if (!isValid(image, level)) {
+        return nullptr;
+    }
+    switch (image) {
+        case DERIVED_LUMA:
+            return mLuma.data();
+        case DERIVED_BLURRED:
+            return mBlurred.data();
+        case DERIVED_PYRAMID:
+            return level > 0 && level <= DERIVED_PYRAMID_LEVELS ? mPyramid[level - 1].data() : mLuma.data();
+        case DERIVED_EDGES:
+            return mEdges.data();
+        case DERIVED_DISTANCE:
+            return mDistance.data();
+        default:
+            return nullptr;
+    }
+}
+
+const int16_t* DerivedImageCache::gradientXData() const {
+    return isValid(DERIVED_GRADIENTS) ? mGradientX.data() : nullptr;
+}
+
+const int16_t* DerivedImageCache::gradientYData() const {
+    return isValid(DERIVED_GRADIENTS) ? mGradientY.data() : nullptr;
+}
+
+// Free all planes
+size_t DerivedImageCache::release() {
+    size_t released = releaseTracked(mLuma);
+    released += releaseTracked(mBlurred);
+    released += releaseTracked(mEdges);
+    released += releaseTracked(mDistance);
+    for (TrackedBytes& level : mPyramid) {
+        released += releaseTracked(level);
+    }
+    released += releaseTracked(mGradientX);
+    released += releaseTracked(mGradientY);
+    mValid = 0;
+    mValidLevels = 0;
+    return released;
+}
+
+// 2x2 average, rounded the same way as rgbaToGrayHalf
+void DerivedImageCache::halveGray(const uint8_t* input, int width, int height, uint8_t* output) {
+    const int halfWidth = width / 2;
+    const int halfHeight = height / 2;
+
+    for (int y = 0; y < halfHeight; y++) {
+        const uint8_t* top = input + static_cast<size_t>(2 * y) * width;
+        const uint8_t* bottom = top + width;
+        uint8_t* out = output + static_cast<size_t>(y) * halfWidth;
+        for (int x = 0; x < halfWidth; x++) {
+            int sum = top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1];
+            out[x] = static_cast<uint8_t>((sum + 2) >> 2);
+        }
+    }
+}
+
+// Sobel dx = [-1 0 1; -2 0 2; -1 0 1], dy its transpose, borders replicated
+void DerivedImageCache::sobelGradients(const uint8_t* gray, int width, int height, int16_t* dx, int16_t* dy) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t* above = gray + static_cast<size_t>(std::max(y - 1, 0)) * width;
+        const uint8_t* row = gray + static_cast<size_t>(y) * width;
+        const uint8_t* below = gray + static_cast<size_t>(std::min(y + 1, height - 1)) * width;
+        int16_t* outX = dx + static_cast<size_t>(y) * width;
+        int16_t* outY = dy + static_cast<size_t>(y) * width;
+
+        for (int x = 0; x < width; x++) {
+            const int left = std::max(x - 1, 0);
+            const int right = std::min(x + 1, width - 1);
+            outX[x] = static_cast<int16_t>(
+                (above[right] - above[left]) + 2 * (row[right] - row[left]) + (below[right] - below[left]));
+            outY[x] = static_cast<int16_t>(
+                (below[left] - above[left]) + 2 * (below[x] - above[x]) + (below[right] - above[right]));
+        }
+    }
+}
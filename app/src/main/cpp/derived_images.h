@@ -0,0 +1,136 @@
+#ifndef EDGEDETECTOR_DERIVED_IMAGES_H
+#define EDGEDETECTOR_DERIVED_IMAGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "native_memory.h"
+
+// Pyramid levels kept below the luma plane (1/2 .. 1/16)
+#define DERIVED_PYRAMID_LEVELS 4
+
+// Intermediate images derived from one input frame
+enum DerivedImage {
+    DERIVED_LUMA = 0,           // Gray plane (half size under memory pressure)
+    DERIVED_BLURRED = 1,        // Pre-Canny blur of the luma (only when a blur applies)
+    DERIVED_PYRAMID = 2,        // 2x2-average reductions of the luma, per level
+    DERIVED_GRADIENTS = 3,      // 16-bit Sobel dx/dy of the blurred luma
+    DERIVED_EDGES = 4,          // Canny mask (after fragment removal)
+    DERIVED_DISTANCE = 5,       // u8 distance to the nearest edge
+    DERIVED_IMAGE_COUNT = 6
+};
+
+// Bit for an image in processFrameRequests' extraImages mask
+#define DERIVED_IMAGE_BIT(image) (1u << (image))
+
+// What one frame computed and what it served from the cache
+struct DerivedImageReport {
+    int computed[DERIVED_IMAGE_COUNT];
+    int reused[DERIVED_IMAGE_COUNT];
+
+    void clear();
+    int totalComputed() const;
+    int totalReused() const;
+
+    /**
+     * One line per frame, e.g. "luma computed, edges computed 1 reused 1, ..."
+     */
+    std::string toString() const;
+};
+
+/**
+ * Lazily evaluated images derived from a single frame. Each image is
+ * produced at most once per frame: the processor asks reuse() before
+ * computing and markComputed() after, and the cache keeps the planes and
+ * the computed/reused report. begin() starts a new frame; plane storage is
+ * kept across frames so steady-state frames do not allocate.
+ */
+class DerivedImageCache {
+public:
+    using ShortBuffer = std::vector<int16_t, TrackedAllocator<int16_t>>;
+
+    DerivedImageCache();
+
+    /**
+     * Invalidate every image for a new frame of the given plane size
+     */
+    void begin(int width, int height);
+
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+
+    /**
+     * Whether an image (pyramid: level 1..DERIVED_PYRAMID_LEVELS) is valid
+     */
+    bool isValid(DerivedImage image, int level = 0) const;
+
+    /**
+     * Count a reuse if the image is valid
+     * @return true if valid (the caller must not recompute it)
+     */
+    bool reuse(DerivedImage image, int level = 0);
+
+    /**
+     * Mark an image valid after computing it
+     */
+    void markComputed(DerivedImage image, int level = 0);
+
+    const DerivedImageReport& report() const { return mReport; }
+
+    /**
+     * Plane storage, sized for the current frame by the caller
+     */
+    TrackedBytes& plane(DerivedImage image);
+    TrackedBytes& pyramidLevel(int level);
+    ShortBuffer& gradientX() { return mGradientX; }
+    ShortBuffer& gradientY() { return mGradientY; }
+
+    /**
+     * Read access to the last frame's images (nullptr when not computed)
+     */
+    const uint8_t* image(DerivedImage image, int level = 0) const;
+    const int16_t* gradientXData() const;
+    const int16_t* gradientYData() const;
+
+    /**
+     * Size of a pyramid level (level 0 = luma)
+     */
+    int levelWidth(int level) const { return mWidth >> level; }
+    int levelHeight(int level) const { return mHeight >> level; }
+
+    /**
+     * Release all planes
+     * @return Bytes released
+     */
+    size_t release();
+
+    /**
+     * Halve a gray plane by 2x2 averaging (rounded, odd edges dropped)
+     * @param output Plane of (width / 2) x (height / 2)
+     */
+    static void halveGray(const uint8_t* input, int width, int height, uint8_t* output);
+
+    /**
+     * 3x3 Sobel derivatives with replicated borders (matches cv::Sobel on
+     * CV_16S with BORDER_REPLICATE)
+     */
+    static void sobelGradients(const uint8_t* gray, int width, int height, int16_t* dx, int16_t* dy);
+
+private:
+    int mWidth;
+    int mHeight;
+    uint32_t mValid;            // DerivedImage bits
+    uint32_t mValidLevels;      // Pyramid level bits
+    DerivedImageReport mReport;
+
+    TrackedBytes mLuma;
+    TrackedBytes mBlurred;
+    TrackedBytes mEdges;
+    TrackedBytes mDistance;
+    TrackedBytes mPyramid[DERIVED_PYRAMID_LEVELS];
+    ShortBuffer mGradientX;
+    ShortBuffer mGradientY;
+};
+
+#endif // EDGEDETECTOR_DERIVED_IMAGES_H
@@ -0,0 +1,271 @@
+#include "distance_transform.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // Column distance for columns without edges (larger than any frame side)
+    const int32_t kInfinite = std::numeric_limits<int32_t>::max() / 4;
+
+    // Stored distance for rows without edges; real squared distances are
+    // clamped just below it
+    const uint32_t kNoEdge = std::numeric_limits<uint32_t>::max();
+
+    // Columns per strip: a multiple of a cache line of int32
+    const int kStripColumns = 64;
+}
+
+// Constructor
+DistanceTransform::DistanceTransform()
+    : mWidth(0)
+    , mHeight(0)
+    , mMetric(DISTANCE_EUCLIDEAN)
+    , mTrackNearest(false)
+{
+}
+
+// Vertical distances for columns [x0, x1), swept row by row (branch-free so the sweeps vectorize)
+template <bool TrackRows>
+void DistanceTransform::columnPass(const uint8_t* edges, int x0, int x1) {
+    const int width = mWidth;
+    int32_t* column = mColumn.data();
+    int32_t* rows = mColumnRow.data();
+
+    // Downward sweep: distance to the nearest edge at or above
+    for (int y = 0; y < mHeight; y++) {
+        const uint8_t* mask = edges + static_cast<size_t>(y) * width;
+        int32_t* current = column + static_cast<size_t>(y) * width;
+        int32_t* currentRow = rows + static_cast<size_t>(y) * width;
+        if (y == 0) {
+            for (int x = x0; x < x1; x++) {
+                current[x] = mask[x] != 0 ? 0 : kInfinite;
+                if (TrackRows) {
+                    currentRow[x] = mask[x] != 0 ? 0 : -1;
+                }
+            }
+            continue;
+        }
+        const int32_t* previous = current - width;
+        const int32_t* previousRow = currentRow - width;
+        for (int x = x0; x < x1; x++) {
+            const int32_t below = std::min(previous[x] + 1, kInfinite);
+            current[x] = mask[x] != 0 ? 0 : below;
+            if (TrackRows) {
+                currentRow[x] = mask[x] != 0 ? y : previousRow[x];
+            }
+        }
+    }
+
+    // Upward sweep: keep the nearer of above and below
+    for (int y = mHeight - 2; y >= 0; y--) {
+        int32_t* current = column + static_cast<size_t>(y) * width;
+        int32_t* currentRow = rows + static_cast<size_t>(y) * width;
+        const int32_t* next = current + width;
+        const int32_t* nextRow = currentRow + width;
+        for (int x = x0; x < x1; x++) {
+            const int32_t fromBelow = next[x] + 1;
+            const bool closer = fromBelow < current[x];
+            current[x] = closer ? fromBelow : current[x];
+            if (TrackRows) {
+                currentRow[x] = closer ? nextRow[x] : currentRow[x];
+            }
+        }
+    }
+}
+
+// Lower envelope of parabolas f(q) + (x - q)^2 along one row
+void DistanceTransform::euclideanRow(int y, RowScratch& scratch) {
+    const int width = mWidth;
+    const size_t base = static_cast<size_t>(y) * width;
+    const int32_t* column = mColumn.data() + base;
+    uint32_t* distance = mDistance.data() + base;
+
+    std::vector<int>& sites = scratch.sites;
+    std::vector<double>& bounds = scratch.bounds;
+    std::vector<double>& heights = scratch.heights;
+    sites.resize(width);
+    bounds.resize(width + 1);
+    heights.resize(width);
+
+    // Columns without edges contribute no parabola
+    int k = -1;
+    for (int q = 0; q < width; q++) {
+        if (column[q] >= kInfinite) {
+            continue;
+        }
+        const double fq = static_cast<double>(column[q]) * column[q] + static_cast<double>(q) * q;
+        double s = 0.0;
+        while (k >= 0) {
+            s = (fq - heights[k]) / (2.0 * (q - sites[k]));
+            if (s > bounds[k]) {
+                break;
+            }
+            k--;
+        }
+        k++;
+        sites[k] = q;
+        heights[k] = fq;
+        bounds[k] = k == 0 ? -std::numeric_limits<double>::infinity() : s;
+        bounds[k + 1] = std::numeric_limits<double>::infinity();
+    }
+
+    if (k < 0) {
+        std::fill(distance, distance + width, kNoEdge);
+        if (mTrackNearest) {
+            std::fill(mNearest.data() + base, mNearest.data() + base + width, -1);
+        }
+        return;
+    }
+
+    const int32_t* rows = mColumnRow.data() + base;
+    int32_t* nearest = mTrackNearest ? mNearest.data() + base : nullptr;
+    int segment = 0;
+    for (int x = 0; x < width; x++) {
+        while (bounds[segment + 1] < x) {
+            segment++;
+        }
+        const int v = sites[segment];
+        const int64_t dx = x - v;
+        const int64_t squared = dx * dx + static_cast<int64_t>(column[v]) * column[v];
+        distance[x] = static_cast<uint32_t>(std::min<int64_t>(squared, kNoEdge - 1));
+        if (nearest != nullptr) {
+            nearest[x] = rows[v] * width + v;
+        }
+    }
+}
+
+// Running minimum of column distance plus horizontal steps
+void DistanceTransform::cityBlockRow(int y) {
+    const int width = mWidth;
+    const size_t base = static_cast<size_t>(y) * width;
+    const int32_t* column = mColumn.data() + base;
+    const int32_t* rows = mColumnRow.data() + base;
+    uint32_t* distance = mDistance.data() + base;
+    int32_t* nearest = mTrackNearest ? mNearest.data() + base : nullptr;
+
+    // Forward: best site at or left of x
+    int site = -1;
+    for (int x = 0; x < width; x++) {
+        if (column[x] < kInfinite && (site < 0 || column[x] <= column[site] + (x - site))) {
+            site = x;
+        }
+        distance[x] = site < 0 ? kNoEdge : static_cast<uint32_t>(column[site] + (x - site));
+        if (nearest != nullptr) {
+            nearest[x] = site < 0 ? -1 : rows[site] * width + site;
+        }
+    }
+
+    // Backward: take a site on the right if it is nearer
+    site = -1;
+    for (int x = width - 1; x >= 0; x--) {
+        if (column[x] < kInfinite && (site < 0 || column[x] <= column[site] + (site - x))) {
+            site = x;
+        }
+        if (site >= 0 && static_cast<uint32_t>(column[site] + (site - x)) < distance[x]) {
+            distance[x] = static_cast<uint32_t>(column[site] + (site - x));
+            if (nearest != nullptr) {
+                nearest[x] = rows[site] * width + site;
+            }
+        }
+    }
+}
+
+// Compute the transform
+bool DistanceTransform::compute(const uint8_t* edges, int width, int height, int metric, bool trackNearest,
+                                const FrameDeadline* deadline) {
+    if (edges == nullptr || width <= 0 || height <= 0 ||
+        (metric != DISTANCE_EUCLIDEAN && metric != DISTANCE_CITY_BLOCK)) {
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mMetric = metric;
+    mTrackNearest = trackNearest;
+
+    const size_t pixels = static_cast<size_t>(width) * height;
+    mColumn.resize(pixels);
+    mColumnRow.resize(pixels);
+    mDistance.resize(pixels);
+    if (trackNearest) {
+        mNearest.resize(pixels);
+    }
+
+    WorkerPool& pool = WorkerPool::shared();
+
+    // Column strips keep each worker's sweeps on whole cache lines
+    const int strips = (width + kStripColumns - 1) / kStripColumns;
+    const int stripTasks = std::min(strips, pool.threadCount());
+    pool.parallelFor(stripTasks, [&](int task) {
+        const int first = strips * task / stripTasks;
+        const int last = strips * (task + 1) / stripTasks;
+        const int x1 = std::min(width, last * kStripColumns);
+        if (mTrackNearest) {
+            columnPass<true>(edges, first * kStripColumns, x1);
+        } else {
+            columnPass<false>(edges, first * kStripColumns, x1);
+        }
+    });
+
+    if (deadline != nullptr && deadline->expired()) {
+        return false;
+    }
+
+    const int bands = std::max(1, std::min(pool.threadCount(), height));
+    mRowScratch.resize(bands);
+    pool.parallelFor(bands, [&](int band) {
+        const int y0 = static_cast<int>(static_cast<int64_t>(height) * band / bands);
+        const int y1 = static_cast<int>(static_cast<int64_t>(height) * (band + 1) / bands);
+        for (int y = y0; y < y1; y++) {
+            if (mMetric == DISTANCE_EUCLIDEAN) {
+                euclideanRow(y, mRowScratch[band]);
+            } else {
+                cityBlockRow(y);
+            }
+        }
+    });
+
+    return true;
+}
+
+// Scaled distances clamped to a maximum; no-edge pixels get the maximum
+template <typename T>
+void DistanceTransform::writeScaled(T* output, float scale, float maximum) const {
+    const size_t pixels = static_cast<size_t>(mWidth) * mHeight;
+    const uint32_t* distance = mDistance.data();
+    if (mMetric == DISTANCE_EUCLIDEAN) {
+        for (size_t i = 0; i < pixels; i++) {
+            const float value = std::sqrt(static_cast<float>(distance[i])) * scale + 0.5f;
+            output[i] = static_cast<T>(distance[i] == kNoEdge ? maximum : std::min(value, maximum));
+        }
+    } else {
+        for (size_t i = 0; i < pixels; i++) {
+            const float value = static_cast<float>(distance[i]) * scale + 0.5f;
+            output[i] = static_cast<T>(distance[i] == kNoEdge ? maximum : std::min(value, maximum));
+        }
+    }
+}
+
+// Write u8 distances
+void DistanceTransform::toU8(uint8_t* output, float scale) const {
+    writeScaled(output, scale, 255.0f);
+}
+
+// Write u16 distances
+void DistanceTransform::toU16(uint16_t* output, float scale) const {
+    writeScaled(output, scale, 65535.0f);
+}
+
+// Release scratch planes
+size_t DistanceTransform::release() {
+    size_t released = releaseTracked(mColumn);
+    released += releaseTracked(mColumnRow);
+    released += releaseTracked(mDistance);
+    released += releaseTracked(mNearest);
+    mRowScratch.clear();
+    mRowScratch.shrink_to_fit();
+    mWidth = 0;
+    mHeight = 0;
+    return released;
+}
@@ -0,0 +1,99 @@
+#ifndef EDGEDETECTOR_DISTANCE_TRANSFORM_H
+#define EDGEDETECTOR_DISTANCE_TRANSFORM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frame_deadline.h"
+#include "native_memory.h"
+
+// Distance metrics for the edge distance transform
+enum DistanceMetric {
+    DISTANCE_EUCLIDEAN = 0,     // Exact Euclidean (Felzenszwalb lower envelope)
+    DISTANCE_CITY_BLOCK = 1     // City-block (L1: unit axial steps, diagonals cost 2)
+};
+
+/**
+ * Distance from every pixel to the nearest edge pixel of a mask, in linear
+ * time. Both metrics are separable: a column pass finds the vertical
+ * distance to the nearest edge in each column (two row-major sweeps, split
+ * into column strips across the worker pool), then a row pass combines
+ * columns per row (split into row bands). The Euclidean row pass takes the
+ * lower envelope of parabolas (Felzenszwalb & Huttenlocher); the city-block
+ * row pass is a forward/backward running minimum. Nearest-edge indices
+ * (y * width + x) can be tracked alongside at the cost of one more plane.
+ */
+class DistanceTransform {
+public:
+    DistanceTransform();
+
+    /**
+     * Compute distances for a mask
+     * @param edges Edge mask (non-zero = edge)
+     * @param width Mask width
+     * @param height Mask height
+     * @param metric DistanceMetric
+     * @param trackNearest Also record the nearest edge pixel per pixel
+     * @param deadline Checked between the column and row passes (nullptr = none)
+     * @return false for invalid arguments or once the deadline has passed
+     */
+    bool compute(const uint8_t* edges, int width, int height, int metric, bool trackNearest,
+                 const FrameDeadline* deadline = nullptr);
+
+    /**
+     * Write distances as u8 (rounded, clamped to 255; no edges = 255)
+     * @param scale Multiplier applied before rounding (e.g. 2 for a half-size mask)
+     */
+    void toU8(uint8_t* output, float scale) const;
+
+    /**
+     * Write distances as u16 (rounded, clamped to 65535; no edges = 65535)
+     * @param scale Multiplier applied before rounding (e.g. 16 for 1/16 pixel units)
+     */
+    void toU16(uint16_t* output, float scale) const;
+
+    /**
+     * Nearest edge index per pixel (-1 if the mask has no edges)
+     * Only valid after compute() with trackNearest
+     */
+    const int32_t* nearest() const { return mTrackNearest ? mNearest.data() : nullptr; }
+
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+
+    /**
+     * Release scratch planes
+     * @return Bytes released
+     */
+    size_t release();
+
+private:
+    using IntBuffer = std::vector<int32_t, TrackedAllocator<int32_t>>;
+    using DistanceBuffer = std::vector<uint32_t, TrackedAllocator<uint32_t>>;
+
+    int mWidth;
+    int mHeight;
+    int mMetric;
+    bool mTrackNearest;
+    IntBuffer mColumn;          // Vertical distance to the nearest edge in the column
+    IntBuffer mColumnRow;       // Row of that edge
+    DistanceBuffer mDistance;   // Squared Euclidean or city-block distance (UINT32_MAX = no edge)
+    IntBuffer mNearest;
+
+    // Per-band row-pass scratch
+    struct RowScratch {
+        std::vector<int> sites;
+        std::vector<double> bounds;    // Exact for squared sizes beyond 2^24
+        std::vector<double> heights;
+    };
+    std::vector<RowScratch> mRowScratch;
+
+    template <bool TrackRows>
+    void columnPass(const uint8_t* edges, int x0, int x1);
+    void euclideanRow(int y, RowScratch& scratch);
+    void cityBlockRow(int y);
+    template <typename T>
+    void writeScaled(T* output, float scale, float maximum) const;
+};
+
+#endif // EDGEDETECTOR_DISTANCE_TRANSFORM_H
@@ -0,0 +1,295 @@
+#include "document_rectify.h"
+#include "lens_undistort.h"
+#include "opencv_processor.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#ifdef HAVE_OPENCV
+#include <opencv2/imgproc.hpp>
+#endif
+
+namespace {
+    // Denominators below this are treated as points at infinity
+    const double kMinDenominator = 1e-9;
+
+    int fixedPoint(double value) {
+        const double limit = 1 << 30;
+        return static_cast<int>(std::lround(std::min(limit, std::max(-limit, value * UNDISTORT_INTER_SIZE))));
+    }
+}
+
+// Constructor
+DocumentRectifier::DocumentRectifier()
+    : mTolerance(RECTIFY_DEFAULT_TOLERANCE)
+    , mTableValid(false)
+    , mTableQuad()
+    , mSourceWidth(0)
+    , mSourceHeight(0)
+    , mOutWidth(0)
+    , mOutHeight(0)
+    , mStats()
+{
+}
+
+void DocumentRectifier::setTolerance(float pixels) {
+    mTolerance = std::max(0.0f, pixels);
+}
+
+// Homography from output pixel centres to the quad (8x8 solve with partial pivoting)
+bool DocumentRectifier::computeHomography(const float* quad, int outWidth, int outHeight, double* h) {
+    if (quad == nullptr || outWidth < 2 || outHeight < 2) {
+        return false;
+    }
+    const double corners[4][2] = {
+        {0.0, 0.0},
+        {outWidth - 1.0, 0.0},
+        {outWidth - 1.0, outHeight - 1.0},
+        {0.0, outHeight - 1.0}
+    };
+
+    double a[8][9];
+    for (int i = 0; i < 4; i++) {
+        const double u = corners[i][0];
+        const double v = corners[i][1];
+        const double x = quad[2 * i];
+        const double y = quad[2 * i + 1];
+        if (!std::isfinite(x) || !std::isfinite(y)) {
+            return false;
+        }
+        double* rowX = a[2 * i];
+        double* rowY = a[2 * i + 1];
+        rowX[0] = u; rowX[1] = v; rowX[2] = 1.0; rowX[3] = 0.0; rowX[4] = 0.0; rowX[5] = 0.0;
+        rowX[6] = -u * x; rowX[7] = -v * x; rowX[8] = x;
+        rowY[0] = 0.0; rowY[1] = 0.0; rowY[2] = 0.0; rowY[3] = u; rowY[4] = v; rowY[5] = 1.0;
+        rowY[6] = -u * y; rowY[7] = -v * y; rowY[8] = y;
+    }
+
+    for (int column = 0; column < 8; column++) {
+        int pivot = column;
+        for (int row = column + 1; row < 8; row++) {
+            if (std::fabs(a[row][column]) > std::fabs(a[pivot][column])) {
+                pivot = row;
+            }
+        }
+        if (std::fabs(a[pivot][column]) < 1e-12) {
+            return false;
+        }
+        if (pivot != column) {
+            std::swap_ranges(a[pivot], a[pivot] + 9, a[column]);
+        }
+        for (int row = 0; row < 8; row++) {
+            if (row == column) {
+                continue;
+            }
+            const double factor = a[row][column] / a[column][column];
+            for (int k = column; k < 9; k++) {
+                a[row][k] -= factor * a[column][k];
+            }
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        h[i] = a[i][8] / a[i][i];
+    }
+    h[8] = 1.0;
+
+    // Every corner must map in front of the camera (rules out folded quads)
+    for (int i = 0; i < 4; i++) {
+        if (h[6] * corners[i][0] + h[7] * corners[i][1] + h[8] <= kMinDenominator) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether the cached table can serve this frame
+bool DocumentRectifier::tableMatches(const float* quad, int width, int height, int outWidth, int outHeight) const {
+    if (!mTableValid || width != mSourceWidth || height != mSourceHeight ||
+        outWidth != mOutWidth || outHeight != mOutHeight) {
+        return false;
+    }
+    // Compared with the corners the table was built for, not the previous frame's
+    for (int i = 0; i < 4; i++) {
+        const float dx = quad[2 * i] - mTableQuad[2 * i];
+        const float dy = quad[2 * i + 1] - mTableQuad[2 * i + 1];
+        if (dx * dx + dy * dy > mTolerance * mTolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Fill the fixed-point table in row bands
+void DocumentRectifier::buildTable(const double* h, int width, int height, int outWidth, int outHeight) {
+    const size_t pixels = static_cast<size_t>(outWidth) * outHeight;
+    mXy.resize(pixels * 2);
+    mFraction.resize(pixels);
+    const int bands = (outHeight + RECTIFY_BAND_ROWS - 1) / RECTIFY_BAND_ROWS;
+
+    WorkerPool::shared().parallelFor(bands, [&](int band) {
+        const int v0 = band * RECTIFY_BAND_ROWS;
+        const int v1 = std::min(outHeight, v0 + RECTIFY_BAND_ROWS);
+        for (int v = v0; v < v1; v++) {
+            int16_t* xy = mXy.data() + static_cast<size_t>(v) * outWidth * 2;
+            uint16_t* fraction = mFraction.data() + static_cast<size_t>(v) * outWidth;
+
+            // Projective coordinates advance by (h0, h3, h6) per output pixel
+            double numeratorX = h[1] * v + h[2];
+            double numeratorY = h[4] * v + h[5];
+            double denominator = h[7] * v + h[8];
+            for (int u = 0; u < outWidth; u++) {
+                int ix = -UNDISTORT_INTER_SIZE;
+                int iy = -UNDISTORT_INTER_SIZE;
+                if (denominator > kMinDenominator) {
+                    const double scale = 1.0 / denominator;
+                    ix = fixedPoint(numeratorX * scale);
+                    iy = fixedPoint(numeratorY * scale);
+                }
+                xy[2 * u] = static_cast<int16_t>(std::min(32767, std::max(-32768, ix >> UNDISTORT_INTER_BITS)));
+                xy[2 * u + 1] = static_cast<int16_t>(std::min(32767, std::max(-32768, iy >> UNDISTORT_INTER_BITS)));
+                fraction[u] = static_cast<uint16_t>(
+                    ((iy & (UNDISTORT_INTER_SIZE - 1)) << UNDISTORT_INTER_BITS) | (ix & (UNDISTORT_INTER_SIZE - 1)));
+
+                numeratorX += h[0];
+                numeratorY += h[3];
+                denominator += h[6];
+            }
+            LensUndistort::clampToFrame(xy, fraction, outWidth, width, height);
+        }
+    });
+}
+
+// Bilinear gather through the table
+void DocumentRectifier::gather(
+    const uint8_t* source,
+    int width,
+    int height,
+    int stride,
+    int channels,
+    uint8_t* output,
+    int outStride
+) const {
+#ifdef HAVE_OPENCV
+    try {
+        cv::Mat sourceMat(height, width, CV_8UC(channels), (void*)source, stride);
+        cv::Mat outputMat(mOutHeight, mOutWidth, CV_8UC(channels), output, outStride);
+        cv::Mat xyMat(mOutHeight, mOutWidth, CV_16SC2, (void*)mXy.data());
+        cv::Mat fractionMat(mOutHeight, mOutWidth, CV_16UC1, (void*)mFraction.data());
+        cv::remap(sourceMat, outputMat, xyMat, fractionMat, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+        if (outputMat.data == output) {
+            return;
+        }
+        LOGW("remap reallocated its output, using the built-in gather");
+    } catch (const std::exception& e) {
+        LOGE("OpenCV remap failed: %s", e.what());
+    }
+#else
+    (void)width;
+    (void)height;
+#endif
+
+    const int bands = (mOutHeight + RECTIFY_BAND_ROWS - 1) / RECTIFY_BAND_ROWS;
+    WorkerPool::shared().parallelFor(bands, [&](int band) {
+        const int v0 = band * RECTIFY_BAND_ROWS;
+        const int v1 = std::min(mOutHeight, v0 + RECTIFY_BAND_ROWS);
+        const int half = 1 << (2 * UNDISTORT_INTER_BITS - 1);
+        for (int v = v0; v < v1; v++) {
+            const int16_t* xy = mXy.data() + static_cast<size_t>(v) * mOutWidth * 2;
+            const uint16_t* fraction = mFraction.data() + static_cast<size_t>(v) * mOutWidth;
+            uint8_t* out = output + static_cast<size_t>(v) * outStride;
+            for (int u = 0; u < mOutWidth; u++) {
+                const int fx = fraction[u] & (UNDISTORT_INTER_SIZE - 1);
+                const int fy = fraction[u] >> UNDISTORT_INTER_BITS;
+                const int right = fx != 0 ? channels : 0;
+                const uint8_t* top = source + static_cast<size_t>(xy[2 * u + 1]) * stride +
+                                     static_cast<size_t>(xy[2 * u]) * channels;
+                const uint8_t* bottom = fy != 0 ? top + stride : top;
+                for (int c = 0; c < channels; c++) {
+                    const int upper = top[c] * (UNDISTORT_INTER_SIZE - fx) + top[right + c] * fx;
+                    const int lower = bottom[c] * (UNDISTORT_INTER_SIZE - fx) + bottom[right + c] * fx;
+                    const int value = upper * (UNDISTORT_INTER_SIZE - fy) + lower * fy;
+                    out[u * channels + c] = static_cast<uint8_t>((value + half) >> (2 * UNDISTORT_INTER_BITS));
+                }
+            }
+        }
+    });
+}
+
+// Rectify one frame
+bool DocumentRectifier::rectify(
+    const uint8_t* source,
+    int width,
+    int height,
+    int stride,
+    int channels,
+    const float* quad,
+    uint8_t* output,
+    int outWidth,
+    int outHeight,
+    int outStride
+) {
+    if (source == nullptr || output == nullptr || quad == nullptr ||
+        (channels != 1 && channels != 4) || width < 2 || height < 2 ||
+        outWidth < 2 || outHeight < 2) {
+        LOGE("Invalid rectification arguments");
+        return false;
+    }
+    if (stride == 0) {
+        stride = width * channels;
+    }
+    if (outStride == 0) {
+        outStride = outWidth * channels;
+    }
+    if (stride < width * channels || outStride < outWidth * channels) {
+        LOGE("Rectification stride too small");
+        return false;
+    }
+
+    if (tableMatches(quad, width, height, outWidth, outHeight)) {
+        mStats.tableReuses++;
+    } else {
+        double h[9];
+        if (!computeHomography(quad, outWidth, outHeight, h)) {
+            LOGE("Degenerate document quad");
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        buildTable(h, width, height, outWidth, outHeight);
+        mStats.lastBuildMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        mStats.tableBuilds++;
+        std::copy(quad, quad + 8, mTableQuad);
+        mSourceWidth = width;
+        mSourceHeight = height;
+        mOutWidth = outWidth;
+        mOutHeight = outHeight;
+        mTableValid = true;
+    }
+
+    gather(source, width, height, stride, channels, output, outStride);
+    mStats.frames++;
+    return true;
+}
+
+// Counter summary
+std::string DocumentRectifier::getStatistics() const {
+    char buffer[160];
+    snprintf(buffer, sizeof(buffer),
+        "Rectify: %llu frames, %llu table builds (last %.2fms), %llu reuses, tolerance %.2fpx",
+        static_cast<unsigned long long>(mStats.frames),
+        static_cast<unsigned long long>(mStats.tableBuilds),
+        mStats.lastBuildMs,
+        static_cast<unsigned long long>(mStats.tableReuses),
+        mTolerance);
+    return std::string(buffer);
+}
+
+// Free the table
+size_t DocumentRectifier::release() {
+    size_t released = releaseTracked(mXy);
+    released += releaseTracked(mFraction);
+    mTableValid = false;
+    return released;
+}
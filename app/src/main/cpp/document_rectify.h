@@ -0,0 +1,121 @@
+#ifndef EDGEDETECTOR_DOCUMENT_RECTIFY_H
+#define EDGEDETECTOR_DOCUMENT_RECTIFY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "native_memory.h"
+
+// Corner movement (source pixels) below which the cached remap table is kept
+#define RECTIFY_DEFAULT_TOLERANCE 0.5f
+
+// Output rows per table-building band on the worker pool
+#define RECTIFY_BAND_ROWS 32
+
+// Rectifier counters
+struct RectifyStats {
+    uint64_t frames;
+    uint64_t tableBuilds;
+    uint64_t tableReuses;
+    double lastBuildMs;
+};
+
+/**
+ * Warps a document quad to a flat rectangle through a cached fixed-point
+ * remap table (CV_16SC2 + CV_16UC1, 1/32 pixel, same layout as
+ * LensUndistort). The table for the current homography is kept while every
+ * corner stays within the tolerance of the corners it was built for (so
+ * small jitter cannot drift it), and rebuilt in row bands across the worker
+ * pool when they move further. Each row is evaluated incrementally: the
+ * projective numerators and denominator advance by a constant per pixel.
+ * The gather (cv::remap, or the built-in bilinear loop without OpenCV)
+ * writes straight into the caller's buffer. Samples outside the frame
+ * replicate the border.
+ */
+class DocumentRectifier {
+public:
+    DocumentRectifier();
+
+    /**
+     * Corner movement that forces a table rebuild (0 = rebuild every frame)
+     */
+    void setTolerance(float pixels);
+
+    /**
+     * Rectify one frame
+     * @param source Source pixels (1 = gray, 4 = RGBA channels)
+     * @param width Source width
+     * @param height Source height
+     * @param stride Source row stride in bytes (0 = width * channels)
+     * @param channels 1 or 4
+     * @param quad Corners as x, y pairs: top-left, top-right, bottom-right, bottom-left
+     * @param output Destination (same channel count)
+     * @param outWidth Output width
+     * @param outHeight Output height
+     * @param outStride Output row stride in bytes (0 = outWidth * channels)
+     * @return false for invalid arguments or a degenerate quad
+     */
+    bool rectify(
+        const uint8_t* source,
+        int width,
+        int height,
+        int stride,
+        int channels,
+        const float* quad,
+        uint8_t* output,
+        int outWidth,
+        int outHeight,
+        int outStride
+    );
+
+    /**
+     * Force a rebuild on the next frame
+     */
+    void invalidate() { mTableValid = false; }
+
+    RectifyStats stats() const { return mStats; }
+    std::string getStatistics() const;
+
+    /**
+     * Release the table
+     * @return Bytes released
+     */
+    size_t release();
+
+    /**
+     * Homography mapping output pixel centres (0,0)..(outWidth-1,outHeight-1)
+     * to the quad corners, row-major with h[8] = 1
+     * @return false for a degenerate quad
+     */
+    static bool computeHomography(const float* quad, int outWidth, int outHeight, double* h);
+
+private:
+    using ShortBuffer = std::vector<int16_t, TrackedAllocator<int16_t>>;
+    using UShortBuffer = std::vector<uint16_t, TrackedAllocator<uint16_t>>;
+
+    float mTolerance;
+    bool mTableValid;
+    float mTableQuad[8];        // Corners the table was built for
+    int mSourceWidth;
+    int mSourceHeight;
+    int mOutWidth;
+    int mOutHeight;
+    ShortBuffer mXy;
+    UShortBuffer mFraction;
+    RectifyStats mStats;
+
+    bool tableMatches(const float* quad, int width, int height, int outWidth, int outHeight) const;
+    void buildTable(const double* h, int width, int height, int outWidth, int outHeight);
+    void gather(
+        const uint8_t* source,
+        int width,
+        int height,
+        int stride,
+        int channels,
+        uint8_t* output,
+        int outStride
+    ) const;
+};
+
+#endif // EDGEDETECTOR_DOCUMENT_RECTIFY_H
@@ -0,0 +1,329 @@
+#include "edge_components.h"
+#include "worker_pool.h"
+#include <algorithm>
+
+namespace {
+    // Rows per band below which splitting costs more than it saves
+    const int kMinBandRows = 32;
+}
+
+// Constructor
+EdgeComponentFilter::EdgeComponentFilter()
+    : mMinPixels(0)
+    , mMinExtent(0)
+    , mRemovedPixels(0)
+{
+}
+
+void EdgeComponentFilter::setThresholds(int minPixels, int minExtent) {
+    mMinPixels = std::max(0, minPixels);
+    mMinExtent = std::max(0, minExtent);
+}
+
+// Root with path halving; parents never point forward in raster order
+int32_t EdgeComponentFilter::findRoot(int32_t index) {
+    int32_t* parents = mParents.data();
+    while (parents[index] != index) {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+// Link the later root under the earlier one
+void EdgeComponentFilter::unite(int32_t a, int32_t b) {
+    a = findRoot(a);
+    b = findRoot(b);
+    if (a < b) {
+        mParents[b] = a;
+    } else if (b < a) {
+        mParents[a] = b;
+    }
+}
+
+// First pass over one band, ignoring pixels above it
+void EdgeComponentFilter::labelBand(const BitMask& edges, int rowBegin, int rowEnd,
+                                    std::vector<int32_t>& roots) {
+    int32_t* parents = mParents.data();
+    const int width = edges.width();
+    roots.clear();
+
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const bool hasAbove = y > rowBegin;
+        const int32_t base = y * width;
+
+        for (int x = edges.nextSet(y, 0); x < width; x = edges.nextSet(y, x + 1)) {
+            const int32_t index = base + x;
+            const bool w = x > 0 && edges.test(x - 1, y);
+            const bool n = hasAbove && edges.test(x, y - 1);
+            const bool nw = hasAbove && x > 0 && edges.test(x - 1, y - 1);
+            const bool ne = hasAbove && x + 1 < width && edges.test(x + 1, y - 1);
+
+            // N touches W, NW and NE, so they are already joined to it; pixels
+            // attach to their neighbour's root to keep the trees shallow
+            if (n) {
+                parents[index] = findRoot(index - width);
+            } else if (ne) {
+                if (w) {
+                    unite(index - width + 1, index - 1);
+                } else if (nw) {
+                    unite(index - width + 1, index - width - 1);
+                }
+                parents[index] = findRoot(index - width + 1);
+            } else if (w) {
+                parents[index] = findRoot(index - 1);
+            } else if (nw) {
+                parents[index] = findRoot(index - width - 1);
+            } else {
+                parents[index] = index;
+                roots.push_back(index);
+            }
+        }
+    }
+}
+
+// Join the first row of a band to the last row of the band above
+void EdgeComponentFilter::mergeSeam(const BitMask& edges, int row) {
+    const int width = edges.width();
+    const int32_t base = row * width;
+
+    for (int x = edges.nextSet(row, 0); x < width; x = edges.nextSet(row, x + 1)) {
+        const int32_t index = base + x;
+        if (edges.test(x, row - 1)) {
+            unite(index, index - width);
+            continue;
+        }
+        if (x > 0 && edges.test(x - 1, row - 1)) {
+            unite(index, index - width - 1);
+        }
+        if (x + 1 < width && edges.test(x + 1, row - 1)) {
+            unite(index, index - width + 1);
+        }
+    }
+}
+
+// Label, measure and filter components
+size_t EdgeComponentFilter::filter(BitMask& edges, const FrameDeadline* deadline) {
+    mComponents.clear();
+    mRemovedPixels = 0;
+    const int width = edges.width();
+    const int height = edges.height();
+    if (edges.empty()) {
+        return 0;
+    }
+
+    const size_t pixels = static_cast<size_t>(width) * height;
+    mParents.resize(pixels);
+    mLabels.resize(pixels);
+
+    WorkerPool& pool = WorkerPool::shared();
+    const int bands = std::max(1, std::min(pool.threadCount(), height / kMinBandRows));
+    mBandRows.resize(bands + 1);
+    for (int b = 0; b <= bands; b++) {
+        mBandRows[b] = static_cast<int>(static_cast<int64_t>(height) * b / bands);
+    }
+
+    // Local union-find per band; new roots are listed in raster order
+    mBandRootLists.resize(bands);
+    pool.parallelFor(bands, [&](int b) {
+        labelBand(edges, mBandRows[b], mBandRows[b + 1], mBandRootLists[b]);
+    });
+
+    if (deadline != nullptr && deadline->expired()) {
+        return 0;
+    }
+
+    // Seams are one row each, cheaper to merge serially than to synchronize
+    for (int b = 1; b < bands; b++) {
+        mergeSeam(edges, mBandRows[b]);
+    }
+
+    // Number the surviving roots in raster order
+    mBandRoots.assign(bands + 1, 0);
+    for (int b = 0; b < bands; b++) {
+        int32_t count = 0;
+        for (int32_t root : mBandRootLists[b]) {
+            count += mParents[root] == root ? 1 : 0;
+        }
+        mBandRoots[b + 1] = mBandRoots[b] + count;
+    }
+    const int32_t componentCount = mBandRoots[bands];
+
+    pool.parallelFor(bands, [&](int b) {
+        int32_t* parents = mParents.data();
+        int32_t next = mBandRoots[b];
+        for (int32_t root : mBandRootLists[b]) {
+            if (parents[root] == root) {
+                parents[root] = -(next++ + 1);
+            }
+        }
+    });
+
+    if (deadline != nullptr && deadline->expired()) {
+        return 0;
+    }
+
+    // Resolve labels (read-only walk of the forest) and gather statistics.
+    // A band writes its own components (ids numbered from its roots)
+    // straight into mComponents. Components rooted in an earlier band cross
+    // the band's first row, so they are collected from that row up front
+    // and accumulated in a small per-band table merged afterwards.
+    mComponents.resize(componentCount);
+    mBandForeign.resize(bands);
+    mBandStats.resize(bands);
+    pool.parallelFor(bands, [&](int b) {
+        const int32_t* parents = mParents.data();
+        int32_t* labels = mLabels.data();
+        const int32_t firstOwn = mBandRoots[b];
+        const EdgeComponent empty = {width, height, -1, -1, 0, false};
+        std::fill(mComponents.begin() + firstOwn, mComponents.begin() + mBandRoots[b + 1], empty);
+
+        auto resolve = [parents](int32_t node) {
+            while (parents[node] >= 0) {
+                node = parents[node];
+            }
+            return -parents[node] - 1;
+        };
+
+        std::vector<int32_t>& foreign = mBandForeign[b];
+        foreign.clear();
+        const int firstRow = mBandRows[b];
+        if (b > 0) {
+            for (int x = edges.nextSet(firstRow, 0); x < width; x = edges.nextSet(firstRow, x + 1)) {
+                const int32_t id = resolve(firstRow * width + x);
+                if (id < firstOwn) {
+                    foreign.push_back(id);
+                }
+            }
+            std::sort(foreign.begin(), foreign.end());
+            foreign.erase(std::unique(foreign.begin(), foreign.end()), foreign.end());
+        }
+        std::vector<EdgeComponent>& foreignStats = mBandStats[b];
+        foreignStats.assign(foreign.size(), empty);
+
+        int32_t lastForeign = -1;
+        EdgeComponent* lastForeignStats = nullptr;
+        // Parents point backwards in raster order, so a parent inside the
+        // band already carries its label and the walk stops there
+        const int32_t bandStart = firstRow * width;
+        for (int y = firstRow; y < mBandRows[b + 1]; y++) {
+            for (int x = edges.nextSet(y, 0); x < width; x = edges.nextSet(y, x + 1)) {
+                const int32_t index = y * width + x;
+                const int32_t parent = parents[index];
+                const int32_t id = parent < 0 ? -parent - 1
+                    : parent >= bandStart ? labels[parent] : resolve(parent);
+                labels[index] = id;
+
+                EdgeComponent* component;
+                if (id >= firstOwn) {
+                    component = &mComponents[id];
+                } else if (id == lastForeign) {
+                    component = lastForeignStats;
+                } else {
+                    const size_t slot = std::lower_bound(foreign.begin(), foreign.end(), id) - foreign.begin();
+                    component = &foreignStats[slot];
+                    lastForeign = id;
+                    lastForeignStats = component;
+                }
+                component->minX = std::min(component->minX, x);
+                component->maxX = std::max(component->maxX, x);
+                component->minY = std::min(component->minY, y);
+                component->maxY = std::max(component->maxY, y);
+                component->pixels++;
+            }
+        }
+    });
+
+    if (deadline != nullptr && deadline->expired()) {
+        mComponents.clear();
+        return 0;
+    }
+
+    // Fold in the parts of components that continue into later bands
+    for (int b = 1; b < bands; b++) {
+        for (size_t i = 0; i < mBandForeign[b].size(); i++) {
+            const EdgeComponent& part = mBandStats[b][i];
+            EdgeComponent& component = mComponents[mBandForeign[b][i]];
+            component.minX = std::min(component.minX, part.minX);
+            component.maxX = std::max(component.maxX, part.maxX);
+            component.minY = std::min(component.minY, part.minY);
+            component.maxY = std::max(component.maxY, part.maxY);
+            component.pixels += part.pixels;
+        }
+    }
+
+    size_t kept = 0;
+    size_t removed = 0;
+    size_t removedArea = 0;
+    for (EdgeComponent& component : mComponents) {
+        const int boxWidth = component.maxX - component.minX + 1;
+        const int boxHeight = component.maxY - component.minY + 1;
+        component.kept = component.pixels >= static_cast<uint32_t>(mMinPixels) &&
+            std::max(boxWidth, boxHeight) >= mMinExtent;
+        if (component.kept) {
+            kept++;
+        } else {
+            removed += component.pixels;
+            removedArea += static_cast<size_t>(boxWidth) * boxHeight;
+        }
+    }
+    mRemovedPixels = removed;
+
+    // Clear dropped fragments: visit only their boxes unless those cover much of the frame
+    const int32_t* labels = mLabels.data();
+    if (removed > 0 && removedArea < pixels / 4) {
+        for (int32_t id = 0; id < componentCount; id++) {
+            const EdgeComponent& component = mComponents[id];
+            if (component.kept) {
+                continue;
+            }
+            for (int y = component.minY; y <= component.maxY; y++) {
+                for (int x = edges.nextSet(y, component.minX); x <= component.maxX;
+                     x = edges.nextSet(y, x + 1)) {
+                    if (labels[y * width + x] == id) {
+                        edges.reset(x, y);
+                    }
+                }
+            }
+        }
+    } else if (removed > 0) {
+        pool.parallelFor(bands, [&](int b) {
+            for (int y = mBandRows[b]; y < mBandRows[b + 1]; y++) {
+                for (int x = edges.nextSet(y, 0); x < width; x = edges.nextSet(y, x + 1)) {
+                    if (!mComponents[labels[y * width + x]].kept) {
+                        edges.reset(x, y);
+                    }
+                }
+            }
+        });
+    }
+
+    return kept;
+}
+
+// Map bounds to full resolution
+void EdgeComponentFilter::scaleComponents(int factor) {
+    for (EdgeComponent& component : mComponents) {
+        component.minX *= factor;
+        component.minY *= factor;
+        component.maxX = component.maxX * factor + factor - 1;
+        component.maxY = component.maxY * factor + factor - 1;
+    }
+}
+
+// Allocate label planes (zero-filled, so every page is touched)
+void EdgeComponentFilter::reserve(size_t pixels) {
+    mParents.resize(pixels);
+    mLabels.resize(pixels);
+}
+
+// Release label scratch
+size_t EdgeComponentFilter::release() {
+    mBandStats.clear();
+    mBandStats.shrink_to_fit();
+    mBandForeign.clear();
+    mBandForeign.shrink_to_fit();
+    mBandRootLists.clear();
+    mBandRootLists.shrink_to_fit();
+    return releaseTracked(mParents) + releaseTracked(mLabels);
+}
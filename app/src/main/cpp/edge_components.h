@@ -0,0 +1,108 @@
+#ifndef EDGEDETECTOR_EDGE_COMPONENTS_H
+#define EDGEDETECTOR_EDGE_COMPONENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_mask.h"
+#include "frame_deadline.h"
+#include "native_memory.h"
+
+// One 8-connected edge component
+struct EdgeComponent {
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+    uint32_t pixels;
+    bool kept;          // Passed the fragment thresholds
+};
+
+/**
+ * Removes short fragments from a bit-packed edge mask. Components are labeled
+ * with block-based union-find: each horizontal band is scanned on its own
+ * worker (8-connected decision tree, parents always point backwards in
+ * raster order), the seam rows between bands are merged, and a final
+ * parallel pass resolves labels and accumulates per-component statistics.
+ * Roots are the first pixel of each component in raster order, so labels
+ * do not depend on the band count. Rows are scanned a word at a time with
+ * count-trailing-zeros, so empty stretches of the mask cost almost nothing.
+ */
+class EdgeComponentFilter {
+public:
+    EdgeComponentFilter();
+
+    /**
+     * Set fragment thresholds (0 disables a threshold)
+     * @param minPixels Components with fewer pixels are removed
+     * @param minExtent Components whose bounding box is smaller than this on
+     *                  both axes are removed
+     */
+    void setThresholds(int minPixels, int minExtent);
+
+    /**
+     * Whether any threshold is active
+     */
+    bool isEnabled() const { return mMinPixels > 0 || mMinExtent > 0; }
+    int minPixels() const { return mMinPixels; }
+    int minExtent() const { return mMinExtent; }
+
+    /**
+     * Label components and clear the ones below the thresholds
+     * @param edges Edge mask, modified in place
+     * @param deadline Checked between the labeling, numbering and
+     *        measuring passes (nullptr = none); once it has passed the
+     *        mask is left untouched and no components are reported
+     * @return Number of components kept
+     */
+    size_t filter(BitMask& edges, const FrameDeadline* deadline = nullptr);
+
+    /**
+     * All components from the last filter() call, in raster order of their first pixel
+     */
+    const std::vector<EdgeComponent>& components() const { return mComponents; }
+
+    /**
+     * Map component bounds from a reduced-resolution mask to full resolution
+     * @param factor Resolution divisor the mask was labeled at
+     */
+    void scaleComponents(int factor);
+
+    /**
+     * Edge pixels cleared by the last filter() call
+     */
+    size_t removedPixels() const { return mRemovedPixels; }
+
+    /**
+     * Allocate label planes for masks of this many pixels ahead of the first frame
+     */
+    void reserve(size_t pixels);
+
+    /**
+     * Release label scratch
+     * @return Bytes released
+     */
+    size_t release();
+
+private:
+    using LabelBuffer = std::vector<int32_t, TrackedAllocator<int32_t>>;
+
+    int mMinPixels;
+    int mMinExtent;
+    LabelBuffer mParents;               // Union-find forest; roots hold -(id + 1) once numbered
+    LabelBuffer mLabels;                // Component id per edge pixel
+    std::vector<int> mBandRows;         // First row of each band, plus the height
+    std::vector<std::vector<int32_t>> mBandRootLists;   // Roots created per band
+    std::vector<int32_t> mBandRoots;    // First component id per band
+    std::vector<std::vector<int32_t>> mBandForeign;     // Ids rooted above each band, sorted
+    std::vector<std::vector<EdgeComponent>> mBandStats; // Their statistics within the band
+    std::vector<EdgeComponent> mComponents;
+    size_t mRemovedPixels;
+
+    void labelBand(const BitMask& edges, int rowBegin, int rowEnd, std::vector<int32_t>& roots);
+    void mergeSeam(const BitMask& edges, int row);
+    int32_t findRoot(int32_t index);
+    void unite(int32_t a, int32_t b);
+};
+
+#endif // EDGEDETECTOR_EDGE_COMPONENTS_H
@@ -0,0 +1,62 @@
+#ifndef EDGEDETECTOR_FRAME_DEADLINE_H
+#define EDGEDETECTOR_FRAME_DEADLINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Rows per band for stages that check the deadline between bands
+#define DEADLINE_BAND_ROWS 64
+
+// Pipeline stages a late frame can be abandoned at
+enum PipelineStage {
+    STAGE_INPUT = 0,    // Already late before any work
+    STAGE_BLUR = 1,     // Pre-Canny blur
+    STAGE_EDGES = 2,    // Canny or the built-in detector
+    STAGE_POST = 3,     // Fragment filter, sub-pixel refinement, distance transform
+    STAGE_OUTPUT = 4,   // Before writing the targets
+    STAGE_COUNT = 5
+};
+
+/**
+ * Steady-clock deadline shared by the stages of one frame. Once expired it
+ * stays expired, so band workers on several threads agree on abandoning.
+ */
+class FrameDeadline {
+public:
+    /**
+     * @param deadlineMs Steady-clock time in ms (FrameDeadline::nowMs()), 0 = none
+     */
+    explicit FrameDeadline(int64_t deadlineMs = 0)
+        : mDeadlineMs(deadlineMs)
+        , mExpired(false)
+    {
+    }
+
+    static int64_t nowMs() {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    }
+
+    bool isSet() const { return mDeadlineMs > 0; }
+
+    bool expired() const {
+        if (mDeadlineMs <= 0) {
+            return false;
+        }
+        if (mExpired.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (nowMs() >= mDeadlineMs) {
+            mExpired.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    int64_t mDeadlineMs;
+    mutable std::atomic<bool> mExpired;
+};
+
+#endif // EDGEDETECTOR_FRAME_DEADLINE_H
@@ -0,0 +1,475 @@
+#include "frame_output.h"
+#include "opencv_processor.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // BT.601 limited-range RGB to YUV (inverse of ImageUtils::yuv420ToRgba)
+    inline uint8_t rgbToY(int r, int g, int b) {
+        return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+
+    inline uint8_t rgbToU(int r, int g, int b) {
+        return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    }
+
+    inline uint8_t rgbToV(int r, int g, int b) {
+        return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+}
+
+// Constructor
+MultiOutputWriter::MultiOutputWriter()
+    : mKernels(&SimdKernels::vectorized())
+{
+}
+
+// Bytes per pixel for an output format
+int MultiOutputWriter::bytesPerPixel(int format) {
+    switch (format) {
+        case OUTPUT_FORMAT_RGBA:
+            return 4;
+        case OUTPUT_FORMAT_GRAY:
+        case OUTPUT_FORMAT_NV12:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Validate output target against source size
+bool MultiOutputWriter::validateTarget(const OutputTarget& target, int srcWidth, int srcHeight) {
+    if (target.data == nullptr) {
+        LOGE("Output target has no buffer");
+        return false;
+    }
+
+    int bpp = bytesPerPixel(target.format);
+    if (bpp == 0) {
+        LOGE("Unknown output format: %d", target.format);
+        return false;
+    }
+
+    // Either a pure downscale or a pure upscale
+    const bool smaller = target.width <= srcWidth && target.height <= srcHeight;
+    const bool larger = target.width >= srcWidth && target.height >= srcHeight;
+    if (target.width <= 0 || target.height <= 0 || (!smaller && !larger)) {
+        LOGE("Invalid output size %dx%d for %dx%d source",
+             target.width, target.height, srcWidth, srcHeight);
+        return false;
+    }
+
+    if (target.stride != 0 && target.stride < target.width * bpp) {
+        LOGE("Output stride %d too small for width %d", target.stride, target.width);
+        return false;
+    }
+
+    if (target.format == OUTPUT_FORMAT_NV12) {
+        if ((target.width % 2) != 0 || (target.height % 2) != 0) {
+            LOGE("NV12 output needs even dimensions, got %dx%d", target.width, target.height);
+            return false;
+        }
+        if (target.uvData == nullptr) {
+            LOGE("NV12 output has no UV plane");
+            return false;
+        }
+        if (target.uvStride != 0 && target.uvStride < target.width) {
+            LOGE("NV12 UV stride %d too small for width %d", target.uvStride, target.width);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Copy camera YUV planes into a full-size NV12 target
+bool MultiOutputWriter::writeNv12Passthrough(
+    const YuvPlanes& planes,
+    int width,
+    int height,
+    const OutputTarget& target
+) {
+    if (target.format != OUTPUT_FORMAT_NV12 ||
+        target.width != width || target.height != height ||
+        !validateTarget(target, width, height)) {
+        LOGE("NV12 passthrough needs a full-size NV12 target");
+        return false;
+    }
+
+    const int yStride = target.stride != 0 ? target.stride : width;
+    const int uvStride = target.uvStride != 0 ? target.uvStride : width;
+
+    for (int y = 0; y < height; y++) {
+        std::memcpy(target.data + static_cast<size_t>(y) * yStride,
+                    planes.y + static_cast<size_t>(y) * planes.yRowStride, width);
+    }
+
+    const int chromaWidth = width / 2;
+    for (int y = 0; y < height / 2; y++) {
+        const uint8_t* uRow = planes.u + static_cast<size_t>(y) * planes.uvRowStride;
+        const uint8_t* vRow = planes.v + static_cast<size_t>(y) * planes.uvRowStride;
+        uint8_t* out = target.uvData + static_cast<size_t>(y) * uvStride;
+
+        // Camera already delivered interleaved NV12 chroma
+        if (planes.uvPixelStride == 2 && vRow == uRow + 1) {
+            std::memcpy(out, uRow, static_cast<size_t>(chromaWidth) * 2);
+            continue;
+        }
+
+        for (int x = 0; x < chromaWidth; x++) {
+            out[x * 2] = uRow[x * planes.uvPixelStride];
+            out[x * 2 + 1] = vRow[x * planes.uvPixelStride];
+        }
+    }
+
+    return true;
+}
+
+// Write source plane to all targets in one traversal
+bool MultiOutputWriter::write(
+    const uint8_t* source,
+    int width,
+    int height,
+    int channels,
+    const OutputTarget* targets,
+    int targetCount
+) {
+    bool needLuma = false;
+    if (source == nullptr || !beginWrite(width, height, channels, targets, targetCount, needLuma)) {
+        return false;
+    }
+
+    // Single pass over source rows
+    const size_t srcRowBytes = static_cast<size_t>(width) * channels;
+    for (int y = 0; y < height; y++) {
+        writeSourceRow(y, source + y * srcRowBytes, width, height, channels, needLuma);
+    }
+
+    return true;
+}
+
+// Write a bit mask, expanding one row at a time instead of the whole plane
+bool MultiOutputWriter::write(
+    const BitMask& mask,
+    const OutputTarget* targets,
+    int targetCount
+) {
+    const int width = mask.width();
+    const int height = mask.height();
+    bool needLuma = false;
+    if (mask.empty() || !beginWrite(width, height, 1, targets, targetCount, needLuma)) {
+        return false;
+    }
+
+    mMaskRow.resize(width);
+    for (int y = 0; y < height; y++) {
+        mask.unpackRow(y, mMaskRow.data());
+        writeSourceRow(y, mMaskRow.data(), width, height, 1, needLuma);
+    }
+
+    return true;
+}
+
+// Validate targets and set up per-target state for one traversal
+bool MultiOutputWriter::beginWrite(
+    int width,
+    int height,
+    int channels,
+    const OutputTarget* targets,
+    int targetCount,
+    bool& needLuma
+) {
+    if (targets == nullptr || targetCount <= 0) {
+        LOGE("Invalid output writer arguments");
+        return false;
+    }
+
+    if (channels != 1 && channels != 4) {
+        LOGE("Unsupported source channel count: %d", channels);
+        return false;
+    }
+
+    for (int i = 0; i < targetCount; i++) {
+        if (!validateTarget(targets[i], width, height)) {
+            return false;
+        }
+    }
+
+    // Set up per-target state
+    mStates.resize(targetCount);
+    needLuma = false;
+
+    for (int i = 0; i < targetCount; i++) {
+        TargetState& state = mStates[i];
+        const OutputTarget& target = targets[i];
+
+        state.target = target;
+        state.stride = target.stride != 0
+            ? target.stride
+            : target.width * bytesPerPixel(target.format);
+        state.uvStride = target.uvStride != 0 ? target.uvStride : target.width;
+        state.fullSize = target.width == width && target.height == height;
+        state.upscale = !state.fullSize && target.width >= width && target.height >= height;
+        state.fromLuma = channels == 4 && target.format == OUTPUT_FORMAT_GRAY;
+        state.accChannels = state.fromLuma ? 1 : channels;
+        state.nextRow = 0;
+        state.rowStart = 0;
+        state.rowEnd = height / target.height;
+        needLuma = needLuma || state.fromLuma;
+
+        if (state.upscale) {
+            state.xStart.resize(target.width);
+            for (int dx = 0; dx < target.width; dx++) {
+                state.xStart[dx] = static_cast<int>(static_cast<int64_t>(dx) * width / target.width);
+            }
+            state.rowBuffer.resize(static_cast<size_t>(target.width) * state.accChannels);
+        } else if (!state.fullSize) {
+            state.xStart.resize(target.width);
+            state.xEnd.resize(target.width);
+            for (int dx = 0; dx < target.width; dx++) {
+                state.xStart[dx] = static_cast<int>(static_cast<int64_t>(dx) * width / target.width);
+                state.xEnd[dx] = static_cast<int>(static_cast<int64_t>(dx + 1) * width / target.width);
+            }
+            state.acc.assign(static_cast<size_t>(target.width) * state.accChannels, 0);
+            state.rowBuffer.resize(static_cast<size_t>(target.width) * state.accChannels);
+        }
+
+        if (target.format == OUTPUT_FORMAT_NV12) {
+            state.evenRow.resize(static_cast<size_t>(target.width) * state.accChannels);
+        }
+    }
+
+    if (needLuma) {
+        mLumaRow.resize(width);
+    }
+    return true;
+}
+
+// Hand one source row to every target
+void MultiOutputWriter::writeSourceRow(
+    int y,
+    const uint8_t* row,
+    int width,
+    int height,
+    int channels,
+    bool needLuma
+) {
+    if (needLuma) {
+        mKernels->rgbaToGray(row, width, 1, mLumaRow.data());
+    }
+
+    for (TargetState& state : mStates) {
+        const uint8_t* rowData = state.fromLuma ? mLumaRow.data() : row;
+        int rowChannels = state.fromLuma ? 1 : channels;
+
+        if (state.fullSize) {
+            writeTargetRow(state, y, rowData, rowChannels);
+            continue;
+        }
+
+        if (state.upscale) {
+            writeUpscaledRows(state, y, height, rowData, rowChannels);
+            continue;
+        }
+
+        accumulateRow(state, rowData, rowChannels);
+        if (y + 1 == state.rowEnd) {
+            emitRow(state, height);
+        }
+    }
+}
+
+// Add one source row to the target's band accumulator
+void MultiOutputWriter::accumulateRow(TargetState& state, const uint8_t* row, int channels) {
+    const int targetWidth = state.target.width;
+    uint32_t* acc = state.acc.data();
+
+    if (channels == 1) {
+        for (int dx = 0; dx < targetWidth; dx++) {
+            uint32_t sum = 0;
+            for (int x = state.xStart[dx]; x < state.xEnd[dx]; x++) {
+                sum += row[x];
+            }
+            acc[dx] += sum;
+        }
+        return;
+    }
+
+    for (int dx = 0; dx < targetWidth; dx++) {
+        uint32_t r = 0, g = 0, b = 0, a = 0;
+        for (int x = state.xStart[dx]; x < state.xEnd[dx]; x++) {
+            const uint8_t* px = row + x * 4;
+            r += px[0];
+            g += px[1];
+            b += px[2];
+            a += px[3];
+        }
+        uint32_t* out = acc + dx * 4;
+        out[0] += r;
+        out[1] += g;
+        out[2] += b;
+        out[3] += a;
+    }
+}
+
+// Emit the averaged band as one target row and start the next band
+void MultiOutputWriter::emitRow(TargetState& state, int srcHeight) {
+    const int targetWidth = state.target.width;
+    const int channels = state.accChannels;
+    const uint32_t bandRows = static_cast<uint32_t>(state.rowEnd - state.rowStart);
+    const uint32_t* acc = state.acc.data();
+    uint8_t* values = state.rowBuffer.data();
+
+    for (int dx = 0; dx < targetWidth; dx++) {
+        const uint32_t count = bandRows * static_cast<uint32_t>(state.xEnd[dx] - state.xStart[dx]);
+        const uint32_t half = count / 2;
+        for (int c = 0; c < channels; c++) {
+            values[dx * channels + c] = static_cast<uint8_t>((acc[dx * channels + c] + half) / count);
+        }
+    }
+
+    writeTargetRow(state, state.nextRow, values, channels);
+
+    std::fill(state.acc.begin(), state.acc.end(), 0u);
+    state.nextRow++;
+    state.rowStart = state.rowEnd;
+    state.rowEnd = static_cast<int>(static_cast<int64_t>(state.nextRow + 1) * srcHeight / state.target.height);
+}
+
+// Replicate one source row into every target row that maps to it
+void MultiOutputWriter::writeUpscaledRows(
+    TargetState& state,
+    int srcRow,
+    int srcHeight,
+    const uint8_t* row,
+    int channels
+) {
+    const int targetWidth = state.target.width;
+    const int targetHeight = state.target.height;
+    uint8_t* values = state.rowBuffer.data();
+
+    if (channels == 1) {
+        for (int dx = 0; dx < targetWidth; dx++) {
+            values[dx] = row[state.xStart[dx]];
+        }
+    } else {
+        for (int dx = 0; dx < targetWidth; dx++) {
+            std::memcpy(values + dx * 4, row + state.xStart[dx] * 4, 4);
+        }
+    }
+
+    // Target rows ty with ty * srcHeight / targetHeight == srcRow
+    int first = static_cast<int>((static_cast<int64_t>(srcRow) * targetHeight + srcHeight - 1) / srcHeight);
+    int end = static_cast<int>((static_cast<int64_t>(srcRow + 1) * targetHeight + srcHeight - 1) / srcHeight);
+    for (int ty = first; ty < end && ty < targetHeight; ty++) {
+        writeTargetRow(state, ty, values, channels);
+    }
+}
+
+// Allocate row buffers ahead of the first frame
+void MultiOutputWriter::reserveBuffers(int width, int targetCount) {
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    mLumaRow.resize(width);
+    mMaskRow.resize(width);
+    mStates.resize(targetCount);
+    for (TargetState& state : mStates) {
+        state.xStart.reserve(width);
+        state.xEnd.reserve(width);
+        state.acc.reserve(rowBytes);
+        state.rowBuffer.resize(rowBytes);
+        state.evenRow.resize(rowBytes);
+    }
+}
+
+// Release retained row buffers
+size_t MultiOutputWriter::releaseBuffers() {
+    size_t released = releaseTracked(mLumaRow);
+    released += releaseTracked(mMaskRow);
+    for (TargetState& state : mStates) {
+        released += releaseTracked(state.rowBuffer);
+        released += releaseTracked(state.evenRow);
+    }
+    mStates.clear();
+    return released;
+}
+
+// Write one target-width row in the target's format
+void MultiOutputWriter::writeTargetRow(
+    TargetState& state,
+    int row,
+    const uint8_t* values,
+    int channels
+) {
+    if (state.target.format == OUTPUT_FORMAT_NV12) {
+        writeNv12Row(state, row, values, channels);
+        return;
+    }
+
+    convertRow(values, state.target.width, channels, state.target.format,
+               state.target.data + static_cast<size_t>(row) * state.stride);
+}
+
+// Write NV12 luma, and chroma once both rows of a pair are available
+void MultiOutputWriter::writeNv12Row(
+    TargetState& state,
+    int row,
+    const uint8_t* values,
+    int channels
+) {
+    const int width = state.target.width;
+    uint8_t* yRow = state.target.data + static_cast<size_t>(row) * state.stride;
+
+    // Processed planes go straight into Y, colour frames are converted
+    if (channels == 1) {
+        std::memcpy(yRow, values, width);
+    } else {
+        for (int x = 0; x < width; x++) {
+            const uint8_t* px = values + x * 4;
+            yRow[x] = rgbToY(px[0], px[1], px[2]);
+        }
+    }
+
+    if ((row & 1) == 0) {
+        std::memcpy(state.evenRow.data(), values, static_cast<size_t>(width) * channels);
+        return;
+    }
+
+    uint8_t* uvRow = state.target.uvData + static_cast<size_t>(row / 2) * state.uvStride;
+
+    // Gray results carry no colour
+    if (channels == 1) {
+        std::memset(uvRow, 128, width);
+        return;
+    }
+
+    const uint8_t* top = state.evenRow.data();
+    for (int x = 0; x < width; x += 2) {
+        const uint8_t* a = top + x * 4;
+        const uint8_t* b = values + x * 4;
+        int r = (a[0] + a[4] + b[0] + b[4] + 2) >> 2;
+        int g = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;
+        int bl = (a[2] + a[6] + b[2] + b[6] + 2) >> 2;
+        uvRow[x] = rgbToU(r, g, bl);
+        uvRow[x + 1] = rgbToV(r, g, bl);
+    }
+}
+
+// Convert one full-width row to the target format
+void MultiOutputWriter::convertRow(
+    const uint8_t* row,
+    int width,
+    int channels,
+    int format,
+    uint8_t* out
+) {
+    if (channels == 1 && format == OUTPUT_FORMAT_GRAY) {
+        std::memcpy(out, row, width);
+    } else if (channels == 4 && format == OUTPUT_FORMAT_RGBA) {
+        std::memcpy(out, row, static_cast<size_t>(width) * 4);
+    } else if (channels == 1) {
+        mKernels->expandGrayToRgba(row, width, 1, out);
+    } else {
+        mKernels->rgbaToGray(row, width, 1, out);
+    }
+}
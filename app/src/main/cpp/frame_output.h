@@ -0,0 +1,202 @@
+#ifndef EDGEDETECTOR_FRAME_OUTPUT_H
+#define EDGEDETECTOR_FRAME_OUTPUT_H
+
+#include <cstdint>
+#include <vector>
+#include "bit_mask.h"
+#include "native_memory.h"
+
+struct ImageKernels;
+
+// Output pixel formats for processFrame targets
+enum OutputFormat {
+    OUTPUT_FORMAT_RGBA = 0, // 4 bytes per pixel
+    OUTPUT_FORMAT_GRAY = 1, // 1 byte per pixel
+    OUTPUT_FORMAT_NV12 = 2  // Y plane + interleaved UV plane at half resolution
+};
+
+// Caller-provided output target (one per requested size/format)
+struct OutputTarget {
+    uint8_t* data;     // Destination buffer (NV12: Y plane), pre-allocated
+    int width;         // Target width (at most the source width)
+    int height;        // Target height (at most the source height)
+    int format;        // OutputFormat
+    int stride;        // Row stride in bytes (0 = tightly packed)
+    uint8_t* uvData;   // NV12 only: interleaved UV plane
+    int uvStride;      // NV12 only: UV row stride in bytes (0 = width)
+};
+
+// YUV_420_888 input planes as delivered by the camera
+struct YuvPlanes {
+    const uint8_t* y;
+    const uint8_t* u;
+    const uint8_t* v;
+    int yRowStride;
+    int uvRowStride;
+    int uvPixelStride;
+};
+
+/**
+ * Writes one processed plane to several output targets in a single
+ * top-to-bottom traversal. Each source row is visited once: full-size
+ * targets get a converted copy of the row and smaller targets accumulate
+ * it into an area-average row that is emitted when its band is complete.
+ * Targets larger than the source (half-resolution processing under memory
+ * pressure) are filled by nearest-neighbour row and column replication.
+ */
+class MultiOutputWriter {
+public:
+    MultiOutputWriter();
+
+    /**
+     * Select the conversion kernels (the processor's scalar reference or
+     * vectorized set)
+     */
+    void setKernels(const ImageKernels* kernels) { mKernels = kernels; }
+
+    /**
+     * Bytes per pixel for an output format (0 if unknown)
+     */
+    static int bytesPerPixel(int format);
+
+    /**
+     * Check that a target can be produced from a source of the given size
+     * @return true if the target is valid
+     */
+    static bool validateTarget(const OutputTarget& target, int srcWidth, int srcHeight);
+
+    /**
+     * Release retained row buffers
+     * @return Bytes released
+     */
+    size_t releaseBuffers();
+
+    /**
+     * Allocate row buffers for up to targetCount targets of a width-pixel
+     * source ahead of the first frame
+     */
+    void reserveBuffers(int width, int targetCount);
+
+    /**
+     * Targets set up by the last write()
+     */
+    int targetCount() const { return static_cast<int>(mStates.size()); }
+
+    /**
+     * Copy camera YUV planes to a full-size NV12 target unchanged
+     * @return true if successful
+     */
+    static bool writeNv12Passthrough(
+        const YuvPlanes& planes,
+        int width,
+        int height,
+        const OutputTarget& target
+    );
+
+    /**
+     * Write source plane to all targets
+     * @param source Source plane (1 = gray, 4 = RGBA channels)
+     * @param width Source width
+     * @param height Source height
+     * @param channels Source channel count (1 or 4)
+     * @param targets Output targets
+     * @param targetCount Number of targets
+     * @return true if all targets were written
+     */
+    bool write(
+        const uint8_t* source,
+        int width,
+        int height,
+        int channels,
+        const OutputTarget* targets,
+        int targetCount
+    );
+
+    /**
+     * Write a bit mask (set pixels 255) to all targets. Rows are expanded
+     * one at a time as the traversal reaches them, so the mask never has
+     * to be unpacked into a full byte plane first.
+     * @param mask Source mask
+     * @param targets Output targets
+     * @param targetCount Number of targets
+     * @return true if all targets were written
+     */
+    bool write(
+        const BitMask& mask,
+        const OutputTarget* targets,
+        int targetCount
+    );
+
+private:
+    // Per-target traversal state
+    struct TargetState {
+        OutputTarget target;
+        int stride;
+        int uvStride;
+        int accChannels;            // Channels accumulated (1 or 4)
+        bool fullSize;
+        bool upscale;               // Target larger than the source
+        bool fromLuma;              // RGBA source reduced to gray
+        int nextRow;                // Next target row to emit
+        int rowEnd;                 // Source row ending the current band
+        int rowStart;               // Source row starting the current band
+        std::vector<int> xStart;    // Source column span (upscale: source column) per target column
+        std::vector<int> xEnd;
+        std::vector<uint32_t> acc;  // Accumulated sums for the current band
+        TrackedBytes rowBuffer;     // Averaged or replicated row ready to write
+        TrackedBytes evenRow;       // NV12: previous row for chroma pairs
+    };
+
+    const ImageKernels* mKernels;
+    std::vector<TargetState> mStates;
+    TrackedBytes mLumaRow;
+    TrackedBytes mMaskRow;
+
+    bool beginWrite(
+        int width,
+        int height,
+        int channels,
+        const OutputTarget* targets,
+        int targetCount,
+        bool& needLuma
+    );
+    void writeSourceRow(
+        int y,
+        const uint8_t* row,
+        int width,
+        int height,
+        int channels,
+        bool needLuma
+    );
+
+    void accumulateRow(TargetState& state, const uint8_t* row, int channels);
+    void emitRow(TargetState& state, int srcHeight);
+    void writeUpscaledRows(
+        TargetState& state,
+        int srcRow,
+        int srcHeight,
+        const uint8_t* row,
+        int channels
+    );
+    void writeTargetRow(
+        TargetState& state,
+        int row,
+        const uint8_t* values,
+        int channels
+    );
+    static void writeNv12Row(
+        TargetState& state,
+        int row,
+        const uint8_t* values,
+        int channels
+    );
+    void convertRow(
+        const uint8_t* row,
+        int width,
+        int channels,
+        int format,
+        uint8_t* out
+    );
+};
+
+#endif // EDGEDETECTOR_FRAME_OUTPUT_H
@@ -0,0 +1,485 @@
+#include "gray_codec.h"
+#include "opencv_processor.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+    const uint8_t kMagic[4] = {'E', 'G', 'C', '1'};
+    const size_t kHeaderSize = 16;
+
+    // rANS parameters: 12-bit probabilities, 32-bit state, byte renormalization
+    const int kProbBits = 12;
+    const uint32_t kProbScale = 1u << kProbBits;
+    const uint32_t kRansLow = 1u << 23;
+
+    const uint8_t kMethodStored = 0;
+    const uint8_t kMethodRans = 1;
+    const size_t kTableSize = 256 * 2;
+
+    void writeLe16(uint8_t* p, uint32_t value) {
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    void writeLe32(uint8_t* p, uint32_t value) {
+        writeLe16(p, value & 0xFFFF);
+        writeLe16(p + 2, value >> 16);
+    }
+
+    uint32_t readLe16(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8);
+    }
+
+    uint32_t readLe32(const uint8_t* p) {
+        return readLe16(p) | (readLe16(p + 2) << 16);
+    }
+
+    // Residuals of one row (wrapping mod 256); up is null on a band's first row
+    void predictRow(const uint8_t* cur, const uint8_t* up, int width, int predictor, uint8_t* residual) {
+        if (up == nullptr) {
+            residual[0] = cur[0];
+            for (int x = 1; x < width; x++) {
+                residual[x] = static_cast<uint8_t>(cur[x] - cur[x - 1]);
+            }
+            return;
+        }
+
+        if (predictor == PREDICT_UP) {
+            for (int x = 0; x < width; x++) {
+                residual[x] = static_cast<uint8_t>(cur[x] - up[x]);
+            }
+            return;
+        }
+
+        residual[0] = static_cast<uint8_t>(cur[0] - up[0]);
+        if (predictor == PREDICT_LEFT) {
+            for (int x = 1; x < width; x++) {
+                residual[x] = static_cast<uint8_t>(cur[x] - cur[x - 1]);
+            }
+            return;
+        }
+
+        // Branch-free median edge detector on bytes so the loop vectorizes;
+        // a + b - c lies between low and high whenever it is selected, so
+        // wrapping byte arithmetic gives the exact value
+        for (int x = 1; x < width; x++) {
+            uint8_t a = cur[x - 1];
+            uint8_t b = up[x];
+            uint8_t c = up[x - 1];
+            uint8_t high = a > b ? a : b;
+            uint8_t low = a < b ? a : b;
+            uint8_t gradient = static_cast<uint8_t>(a + b - c);
+            uint8_t prediction = c >= high ? low : (c <= low ? high : gradient);
+            residual[x] = static_cast<uint8_t>(cur[x] - prediction);
+        }
+    }
+
+    // Rebuild one row in place from its residuals
+    void reconstructRow(uint8_t* row, const uint8_t* up, int width, int predictor) {
+        if (up == nullptr) {
+            for (int x = 1; x < width; x++) {
+                row[x] = static_cast<uint8_t>(row[x] + row[x - 1]);
+            }
+            return;
+        }
+
+        if (predictor == PREDICT_UP) {
+            for (int x = 0; x < width; x++) {
+                row[x] = static_cast<uint8_t>(row[x] + up[x]);
+            }
+            return;
+        }
+
+        row[0] = static_cast<uint8_t>(row[0] + up[0]);
+        if (predictor == PREDICT_LEFT) {
+            for (int x = 1; x < width; x++) {
+                row[x] = static_cast<uint8_t>(row[x] + row[x - 1]);
+            }
+            return;
+        }
+
+        for (int x = 1; x < width; x++) {
+            int a = row[x - 1];
+            int b = up[x];
+            int c = up[x - 1];
+            int high = std::max(a, b);
+            int low = std::min(a, b);
+            int prediction = c >= high ? low : (c <= low ? high : a + b - c);
+            row[x] = static_cast<uint8_t>(row[x] + prediction);
+        }
+    }
+
+    // Scale symbol counts to sum to kProbScale, keeping every used symbol >= 1
+    void normalizeFrequencies(const uint32_t* counts, size_t total, uint32_t* freq) {
+        int64_t sum = 0;
+        for (int s = 0; s < 256; s++) {
+            freq[s] = counts[s] == 0
+                ? 0
+                : std::max<uint32_t>(1, static_cast<uint32_t>(static_cast<uint64_t>(counts[s]) * kProbScale / total));
+            sum += freq[s];
+        }
+
+        int64_t diff = static_cast<int64_t>(kProbScale) - sum;
+        while (diff != 0) {
+            int largest = static_cast<int>(std::max_element(freq, freq + 256) - freq);
+            if (diff > 0) {
+                freq[largest] += static_cast<uint32_t>(diff);
+                diff = 0;
+            } else {
+                // Take from the largest symbol, but never below 1
+                uint32_t take = static_cast<uint32_t>(std::min<int64_t>(-diff, freq[largest] - 1));
+                freq[largest] -= take;
+                diff += take;
+                if (take == 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Encoder symbol with division replaced by a reciprocal multiply
+    struct EncodeSymbol {
+        uint32_t limit;         // Renormalize while state >= limit
+        uint32_t reciprocal;
+        uint32_t bias;
+        uint32_t complement;    // kProbScale - freq
+        uint32_t shift;
+    };
+
+    void initEncodeSymbol(EncodeSymbol& symbol, uint32_t start, uint32_t freq) {
+        symbol.limit = ((kRansLow >> kProbBits) << 8) * freq;
+        symbol.complement = kProbScale - freq;
+        if (freq < 2) {
+            // freq 1: q == state, so state + bias + q * (scale - 1) == state * scale + start
+            symbol.reciprocal = ~0u;
+            symbol.shift = 0;
+            symbol.bias = start + kProbScale - 1;
+        } else {
+            uint32_t shift = 0;
+            while (freq > (1u << shift)) {
+                shift++;
+            }
+            symbol.reciprocal = static_cast<uint32_t>(((1ull << (shift + 31)) + freq - 1) / freq);
+            symbol.shift = shift - 1;
+            symbol.bias = start;
+        }
+    }
+
+    inline void encodePut(uint32_t& state, uint8_t*& ptr, const EncodeSymbol& symbol) {
+        while (state >= symbol.limit) {
+            *--ptr = static_cast<uint8_t>(state);
+            state >>= 8;
+        }
+        uint32_t q = static_cast<uint32_t>((static_cast<uint64_t>(state) * symbol.reciprocal) >> 32) >> symbol.shift;
+        state += symbol.bias + q * symbol.complement;
+    }
+
+    // Band payload capacity: method + table + state + worst-case rANS bytes
+    size_t payloadCapacity(size_t pixels) {
+        return 1 + kTableSize + 8 + pixels * 2;
+    }
+
+    // Entropy code one band's residuals; returns payload size
+    size_t encodeBand(const uint8_t* residuals, size_t count, uint8_t* out) {
+        // Four tables so runs of one residual (mostly 0) do not serialize
+        // on a single counter
+        uint32_t partial[4][256] = {{0}};
+        size_t i4 = 0;
+        for (; i4 + 4 <= count; i4 += 4) {
+            partial[0][residuals[i4]]++;
+            partial[1][residuals[i4 + 1]]++;
+            partial[2][residuals[i4 + 2]]++;
+            partial[3][residuals[i4 + 3]]++;
+        }
+        for (; i4 < count; i4++) {
+            partial[0][residuals[i4]]++;
+        }
+        uint32_t counts[256];
+        for (int s = 0; s < 256; s++) {
+            counts[s] = partial[0][s] + partial[1][s] + partial[2][s] + partial[3][s];
+        }
+
+        if (count > 0) {
+            uint32_t freq[256];
+            EncodeSymbol symbols[256];
+            normalizeFrequencies(counts, count, freq);
+            uint32_t cumulative = 0;
+            for (int s = 0; s < 256; s++) {
+                initEncodeSymbol(symbols[s], cumulative, freq[s]);
+                cumulative += freq[s];
+            }
+
+            // rANS encodes backwards, writing down from the end of the buffer.
+            // Even and odd symbols use separate states so decoding has two
+            // independent dependency chains.
+            uint8_t* end = out + payloadCapacity(count);
+            uint8_t* ptr = end;
+            uint32_t even = kRansLow;
+            uint32_t odd = kRansLow;
+            size_t i = count;
+            if (i & 1) {
+                i--;
+                encodePut(even, ptr, symbols[residuals[i]]);
+            }
+            while (i > 0) {
+                encodePut(odd, ptr, symbols[residuals[i - 1]]);
+                encodePut(even, ptr, symbols[residuals[i - 2]]);
+                i -= 2;
+            }
+            ptr -= 4;
+            writeLe32(ptr, odd);
+            ptr -= 4;
+            writeLe32(ptr, even);
+
+            const size_t streamSize = static_cast<size_t>(end - ptr);
+            if (kTableSize + streamSize < count) {
+                out[0] = kMethodRans;
+                for (int s = 0; s < 256; s++) {
+                    writeLe16(out + 1 + s * 2, freq[s]);
+                }
+                std::memmove(out + 1 + kTableSize, ptr, streamSize);
+                return 1 + kTableSize + streamSize;
+            }
+        }
+
+        out[0] = kMethodStored;
+        std::memcpy(out + 1, residuals, count);
+        return 1 + count;
+    }
+
+    // Decode one band's residuals
+    bool decodeBand(const uint8_t* data, size_t size, uint8_t* residuals, size_t count) {
+        if (size < 1) {
+            return false;
+        }
+        if (data[0] == kMethodStored) {
+            if (size != 1 + count) {
+                return false;
+            }
+            std::memcpy(residuals, data + 1, count);
+            return true;
+        }
+        if (data[0] != kMethodRans || size < 1 + kTableSize + 8) {
+            return false;
+        }
+
+        uint32_t freq[256];
+        uint32_t start[256];
+        uint32_t cumulative = 0;
+        for (int s = 0; s < 256; s++) {
+            freq[s] = readLe16(data + 1 + s * 2);
+            start[s] = cumulative;
+            cumulative += freq[s];
+        }
+        if (cumulative != kProbScale) {
+            return false;
+        }
+
+        uint8_t slotSymbol[kProbScale];
+        for (int s = 0; s < 256; s++) {
+            std::memset(slotSymbol + start[s], s, freq[s]);
+        }
+
+        const uint8_t* ptr = data + 1 + kTableSize;
+        const uint8_t* end = data + size;
+        if (end - ptr < 8) {
+            return false;
+        }
+        uint32_t even = readLe32(ptr);
+        uint32_t odd = readLe32(ptr + 4);
+        ptr += 8;
+
+        auto decodeGet = [&](uint32_t& state) -> bool {
+            const uint32_t slot = state & (kProbScale - 1);
+            const uint8_t symbol = slotSymbol[slot];
+            state = freq[symbol] * (state >> kProbBits) + slot - start[symbol];
+            while (state < kRansLow) {
+                if (ptr >= end) {
+                    return false;
+                }
+                state = (state << 8) | *ptr++;
+            }
+            return true;
+        };
+
+        size_t i = 0;
+        for (; i + 1 < count; i += 2) {
+            residuals[i] = slotSymbol[even & (kProbScale - 1)];
+            residuals[i + 1] = slotSymbol[odd & (kProbScale - 1)];
+            if (!decodeGet(even) || !decodeGet(odd)) {
+                return false;
+            }
+        }
+        if (i < count) {
+            residuals[i] = slotSymbol[even & (kProbScale - 1)];
+            if (!decodeGet(even)) {
+                return false;
+            }
+        }
+        return ptr == end;
+    }
+}
+
+// Constructor
+GrayCodec::GrayCodec() {
+}
+
+// Encode a plane
+bool GrayCodec::encode(
+    const uint8_t* gray,
+    int width,
+    int height,
+    int stride,
+    TrackedBytes& output,
+    int predictor,
+    int bandCount,
+    const FrameDeadline* deadline
+) {
+    if (gray == nullptr || width <= 0 || height <= 0 || width > 0x7FFF || height > 0x7FFF) {
+        LOGE("Invalid plane for lossless encode: %dx%d", width, height);
+        return false;
+    }
+    if (predictor < PREDICT_LEFT || predictor > PREDICT_MED) {
+        LOGE("Unknown predictor: %d", predictor);
+        return false;
+    }
+    if (stride <= 0) {
+        stride = width;
+    }
+
+    WorkerPool& pool = WorkerPool::shared();
+    if (bandCount <= 0) {
+        bandCount = pool.threadCount();
+    }
+    bandCount = std::max(1, std::min(bandCount, std::min(height, 0xFFFF)));
+
+    mResiduals.resize(bandCount);
+    mPayloads.resize(bandCount);
+    mPayloadSizes.assign(bandCount, 0);
+
+    pool.parallelFor(bandCount, [&](int band) {
+        const int rowStart = static_cast<int>(static_cast<int64_t>(band) * height / bandCount);
+        const int rowEnd = static_cast<int>(static_cast<int64_t>(band + 1) * height / bandCount);
+        const size_t pixels = static_cast<size_t>(rowEnd - rowStart) * width;
+
+        TrackedBytes& residuals = mResiduals[band];
+        residuals.resize(pixels);
+        for (int y = rowStart; y < rowEnd; y++) {
+            if (deadline != nullptr && (y - rowStart) % DEADLINE_BAND_ROWS == 0 && deadline->expired()) {
+                return;
+            }
+            const uint8_t* row = gray + static_cast<size_t>(y) * stride;
+            const uint8_t* up = y > rowStart ? row - stride : nullptr;
+            predictRow(row, up, width, predictor, residuals.data() + static_cast<size_t>(y - rowStart) * width);
+        }
+
+        if (deadline != nullptr && deadline->expired()) {
+            return;
+        }
+        TrackedBytes& payload = mPayloads[band];
+        payload.resize(payloadCapacity(pixels));
+        mPayloadSizes[band] = encodeBand(residuals.data(), pixels, payload.data());
+    });
+    if (deadline != nullptr && deadline->expired()) {
+        return false;
+    }
+
+    size_t total = kHeaderSize + static_cast<size_t>(bandCount) * 4;
+    for (size_t size : mPayloadSizes) {
+        total += size;
+    }
+    output.resize(total);
+
+    uint8_t* p = output.data();
+    std::memcpy(p, kMagic, 4);
+    writeLe32(p + 4, static_cast<uint32_t>(width));
+    writeLe32(p + 8, static_cast<uint32_t>(height));
+    writeLe16(p + 12, static_cast<uint32_t>(bandCount));
+    p[14] = static_cast<uint8_t>(predictor);
+    p[15] = 0;
+    p += kHeaderSize;
+
+    for (int band = 0; band < bandCount; band++) {
+        writeLe32(p, static_cast<uint32_t>(mPayloadSizes[band]));
+        p += 4;
+    }
+    for (int band = 0; band < bandCount; band++) {
+        std::memcpy(p, mPayloads[band].data(), mPayloadSizes[band]);
+        p += mPayloadSizes[band];
+    }
+    return true;
+}
+
+// Read plane size from a stream header
+bool GrayCodec::readHeader(const uint8_t* data, size_t size, int& width, int& height) {
+    if (data == nullptr || size < kHeaderSize || std::memcmp(data, kMagic, 4) != 0) {
+        return false;
+    }
+    uint32_t w = readLe32(data + 4);
+    uint32_t h = readLe32(data + 8);
+    if (w == 0 || h == 0 || w > 0x7FFF || h > 0x7FFF) {
+        return false;
+    }
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    return true;
+}
+
+// Decode a stream
+bool GrayCodec::decode(const uint8_t* data, size_t size, uint8_t* gray, int width, int height) {
+    int streamWidth = 0;
+    int streamHeight = 0;
+    if (gray == nullptr || !readHeader(data, size, streamWidth, streamHeight) ||
+        streamWidth != width || streamHeight != height) {
+        LOGE("Lossless stream header does not match %dx%d", width, height);
+        return false;
+    }
+
+    const int bandCount = static_cast<int>(readLe16(data + 12));
+    const int predictor = data[14];
+    if (bandCount <= 0 || bandCount > height || predictor > PREDICT_MED ||
+        size < kHeaderSize + static_cast<size_t>(bandCount) * 4) {
+        LOGE("Malformed lossless stream");
+        return false;
+    }
+
+    // Locate band payloads
+    std::vector<size_t> offsets(bandCount + 1);
+    offsets[0] = kHeaderSize + static_cast<size_t>(bandCount) * 4;
+    for (int band = 0; band < bandCount; band++) {
+        offsets[band + 1] = offsets[band] + readLe32(data + kHeaderSize + band * 4);
+        if (offsets[band + 1] > size) {
+            LOGE("Truncated lossless stream");
+            return false;
+        }
+    }
+    if (offsets[bandCount] != size) {
+        LOGE("Lossless stream has %zu trailing bytes", size - offsets[bandCount]);
+        return false;
+    }
+
+    std::atomic<bool> valid(true);
+    WorkerPool::shared().parallelFor(bandCount, [&](int band) {
+        const int rowStart = static_cast<int>(static_cast<int64_t>(band) * height / bandCount);
+        const int rowEnd = static_cast<int>(static_cast<int64_t>(band + 1) * height / bandCount);
+        uint8_t* bandData = gray + static_cast<size_t>(rowStart) * width;
+        const size_t pixels = static_cast<size_t>(rowEnd - rowStart) * width;
+
+        // Residuals land in the output and are rebuilt in place
+        if (!decodeBand(data + offsets[band], offsets[band + 1] - offsets[band], bandData, pixels)) {
+            valid = false;
+            return;
+        }
+        for (int y = rowStart; y < rowEnd; y++) {
+            uint8_t* row = gray + static_cast<size_t>(y) * width;
+            reconstructRow(row, y > rowStart ? row - width : nullptr, width, predictor);
+        }
+    });
+
+    if (!valid) {
+        LOGE("Corrupt lossless band");
+    }
+    return valid;
+}
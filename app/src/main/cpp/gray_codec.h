@@ -0,0 +1,79 @@
+#ifndef EDGEDETECTOR_GRAY_CODEC_H
+#define EDGEDETECTOR_GRAY_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frame_deadline.h"
+#include "native_memory.h"
+
+// Spatial predictors for the lossless gray codec
+enum GrayPredictor {
+    PREDICT_LEFT = 0,   // Pixel to the left
+    PREDICT_UP = 1,     // Pixel above
+    PREDICT_MED = 2     // LOCO-I median edge detector of left, up, up-left
+};
+
+/**
+ * Lossless codec for 8-bit planes. The frame is cut into horizontal bands
+ * that are predicted and coded independently (so bands encode and decode
+ * in parallel on the worker pool): each band's prediction residuals go
+ * through an order-0 rANS coder with a 12-bit frequency table, falling
+ * back to stored bytes when that would not be smaller.
+ *
+ * Stream layout (little-endian):
+ *   "EGC1" | u32 width | u32 height | u16 bands | u8 predictor | u8 0
+ *   | u32 band size x bands | band payloads
+ * Band payload: u8 method (0 stored, 1 rANS), then for rANS a u16 x 256
+ * frequency table, two u32 final states (even and odd symbols are coded
+ * with interleaved states) and the renormalization bytes.
+ */
+class GrayCodec {
+public:
+    GrayCodec();
+
+    /**
+     * Encode a plane
+     * @param gray Input plane
+     * @param width Plane width
+     * @param height Plane height
+     * @param stride Row stride in bytes (0 = width)
+     * @param output Encoded stream (replaced)
+     * @param predictor GrayPredictor
+     * @param bandCount Bands to code independently (0 = one per pool thread)
+     * @param deadline Checked every DEADLINE_BAND_ROWS rows of prediction
+     *        and before each band's entropy coding (nullptr = none)
+     * @return true if successful (planes are limited to 0x7FFF per side);
+     *         false with output untouched once the deadline has passed
+     */
+    bool encode(
+        const uint8_t* gray,
+        int width,
+        int height,
+        int stride,
+        TrackedBytes& output,
+        int predictor = PREDICT_MED,
+        int bandCount = 0,
+        const FrameDeadline* deadline = nullptr
+    );
+
+    /**
+     * Read plane size from a stream header
+     */
+    static bool readHeader(const uint8_t* data, size_t size, int& width, int& height);
+
+    /**
+     * Decode a stream into a width x height plane
+     * @param gray Output plane (must hold width * height bytes)
+     * @return false for malformed streams
+     */
+    static bool decode(const uint8_t* data, size_t size, uint8_t* gray, int width, int height);
+
+private:
+    // Per-band scratch kept between frames
+    std::vector<TrackedBytes> mResiduals;
+    std::vector<TrackedBytes> mPayloads;
+    std::vector<size_t> mPayloadSizes;
+};
+
+#endif // EDGEDETECTOR_GRAY_CODEC_H
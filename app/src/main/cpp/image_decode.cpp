@@ -0,0 +1,456 @@
+#include "image_decode.h"
+#include "content_hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_OPENCV
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#endif
+
+namespace {
+    int64_t nowMs() {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    }
+
+    uint32_t readBigEndian16(const uint8_t* p) {
+        return (static_cast<uint32_t>(p[0]) << 8) | p[1];
+    }
+
+    uint32_t readBigEndian32(const uint8_t* p) {
+        return (readBigEndian16(p) << 16) | readBigEndian16(p + 2);
+    }
+
+    // Read-only mapping of a whole file
+    struct MappedFile {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        explicit MappedFile(const std::string& path) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+                    data = static_cast<const uint8_t*>(mapped);
+                    size = static_cast<size_t>(info.st_size);
+                }
+            }
+            close(fd);
+        }
+
+        ~MappedFile() {
+            if (data != nullptr) {
+                munmap(const_cast<uint8_t*>(data), size);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+#ifdef HAVE_OPENCV
+    // Peak resident set since the last reset (VmHWM)
+    long peakRssKb() {
+        FILE* file = fopen("/proc/self/status", "r");
+        if (file == nullptr) {
+            return 0;
+        }
+        char line[128];
+        long peak = 0;
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            if (sscanf(line, "VmHWM: %ld kB", &peak) == 1) {
+                break;
+            }
+        }
+        fclose(file);
+        return peak;
+    }
+
+    // Reset VmHWM to the current resident set
+    void resetPeakRss() {
+        FILE* file = fopen("/proc/self/clear_refs", "w");
+        if (file != nullptr) {
+            fputs("5", file);
+            fclose(file);
+        }
+    }
+
+    // Longer side scaled to at most maxSize, aspect preserved
+    void outputSize(int width, int height, int maxSize, int& outWidth, int& outHeight) {
+        const int longer = std::max(width, height);
+        if (maxSize <= 0 || longer <= maxSize) {
+            outWidth = width;
+            outHeight = height;
+            return;
+        }
+        outWidth = std::max(1, static_cast<int>((static_cast<int64_t>(width) * maxSize + longer / 2) / longer));
+        outHeight = std::max(1, static_cast<int>((static_cast<int64_t>(height) * maxSize + longer / 2) / longer));
+    }
+#endif
+}
+
+namespace ImageDecode {
+    bool readImageSize(const uint8_t* data, size_t size, int& width, int& height) {
+        static const uint8_t pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+        // PNG: IHDR is always the first chunk
+        if (size >= 24 && std::memcmp(data, pngSignature, 8) == 0) {
+            width = static_cast<int>(readBigEndian32(data + 16));
+            height = static_cast<int>(readBigEndian32(data + 20));
+            return width > 0 && height > 0;
+        }
+
+        // JPEG: walk marker segments up to the start-of-frame
+        if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+            return false;
+        }
+        size_t pos = 2;
+        while (pos + 4 <= size) {
+            if (data[pos] != 0xFF) {
+                return false;
+            }
+            while (pos < size && data[pos] == 0xFF) {
+                pos++;
+            }
+            if (pos >= size) {
+                return false;
+            }
+            const uint8_t marker = data[pos++];
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+                continue;
+            }
+            if (marker == 0xD9 || marker == 0xDA || pos + 2 > size) {
+                return false;
+            }
+
+            const uint32_t length = readBigEndian16(data + pos);
+            const bool startOfFrame = marker >= 0xC0 && marker <= 0xCF &&
+                marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+            if (startOfFrame) {
+                if (pos + 7 > size) {
+                    return false;
+                }
+                height = static_cast<int>(readBigEndian16(data + pos + 3));
+                width = static_cast<int>(readBigEndian16(data + pos + 5));
+                return width > 0 && height > 0;
+            }
+            pos += length;
+        }
+        return false;
+    }
+
+    int chooseReduction(int width, int height, int maxSize) {
+        const int longer = std::max(width, height);
+        if (maxSize <= 0) {
+            return 1;
+        }
+        int reduction = 1;
+        while (reduction < 8 && longer / (reduction * 2) >= maxSize) {
+            reduction *= 2;
+        }
+        return reduction;
+    }
+
+    bool processEncodedBuffer(
+        OpenCVProcessor& processor,
+        const uint8_t* data,
+        size_t size,
+        ProcessingMode mode,
+        int maxSize,
+        DecodedImage& result,
+        ResultCache* cache
+    ) {
+        result.metrics = {0, 0, 0, mode, false, false, 0};
+        result.cached = false;
+        if (data == nullptr || size == 0) {
+            LOGE("Empty encoded image");
+            return false;
+        }
+
+        // Cached results skip the decode entirely (not while the processor
+        // has per-frame side outputs a cached image cannot restore)
+        ResultCacheKey key = {0, 0};
+        const bool cacheable = cache != nullptr && cache->isOpen() && !processor.hasFrameSideOutputs(mode);
+        if (cacheable) {
+            int64_t lookupStart = nowMs();
+            key.content = ContentHash::xxh64(data, size);
+            key.parameters = ContentHash::combine(
+                ContentHash::combine(processor.configurationHash(), static_cast<uint64_t>(mode)),
+                static_cast<uint64_t>(maxSize));
+            if (cache->lookup(key, result.width, result.height, result.rgba, processor.kernels())) {
+                result.decodedWidth = 0;
+                result.decodedHeight = 0;
+                result.reduction = 0;
+                result.decodeTimeMs = 0;
+                result.cached = true;
+                result.metrics = {nowMs() - lookupStart, result.width, result.height, mode, true, false, 0};
+                processor.recordCachedFrame(result.metrics);
+                return true;
+            }
+        }
+
+#ifdef HAVE_OPENCV
+        int sourceWidth = 0;
+        int sourceHeight = 0;
+        result.reduction = readImageSize(data, size, sourceWidth, sourceHeight)
+            ? chooseReduction(sourceWidth, sourceHeight, maxSize)
+            : 1;
+
+        // Gray modes never need colour; RAW needs RGBA
+        const bool grayDecode = mode != MODE_RAW;
+        int flags;
+        switch (result.reduction) {
+            case 2: flags = grayDecode ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2; break;
+            case 4: flags = grayDecode ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4; break;
+            case 8: flags = grayDecode ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8; break;
+            default: flags = grayDecode ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR; break;
+        }
+
+        int64_t decodeStart = nowMs();
+        cv::Mat decoded;
+        try {
+            cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<uint8_t*>(data));
+            decoded = cv::imdecode(encoded, flags);
+        } catch (const std::exception& e) {
+            LOGE("Image decode failed: %s", e.what());
+            return false;
+        }
+        if (decoded.empty()) {
+            LOGE("Unsupported or corrupt image (%zu bytes)", size);
+            return false;
+        }
+
+        result.decodedWidth = decoded.cols;
+        result.decodedHeight = decoded.rows;
+        outputSize(decoded.cols, decoded.rows, maxSize, result.width, result.height);
+        result.rgba.resize(static_cast<size_t>(result.width) * result.height * 4);
+        OutputTarget target = {result.rgba.data(), result.width, result.height, OUTPUT_FORMAT_RGBA, 0, nullptr, 0};
+
+        if (grayDecode) {
+            if (!decoded.isContinuous()) {
+                decoded = decoded.clone();
+            }
+            result.decodeTimeMs = nowMs() - decodeStart;
+            result.metrics = processor.processGrayFrame(decoded.data, decoded.cols, decoded.rows,
+                                                        mode, &target, 1);
+        } else {
+            TrackedBytes rgba(static_cast<size_t>(decoded.cols) * decoded.rows * 4);
+            cv::Mat rgbaMat(decoded.rows, decoded.cols, CV_8UC4, rgba.data());
+            cv::cvtColor(decoded, rgbaMat, cv::COLOR_BGR2RGBA);
+            decoded.release();
+            result.decodeTimeMs = nowMs() - decodeStart;
+            result.metrics = processor.processFrame(rgba.data(), rgbaMat.cols, rgbaMat.rows,
+                                                    mode, &target, 1);
+        }
+
+        if (!result.metrics.success) {
+            releaseTracked(result.rgba);
+        } else if (cacheable) {
+            cache->store(key, result.rgba.data(), result.width, result.height);
+        }
+        return result.metrics.success;
+#else
+        LOGE("Image decoding requires OpenCV imgcodecs");
+        return false;
+#endif
+    }
+
+    bool processImageFile(
+        OpenCVProcessor& processor,
+        const std::string& path,
+        ProcessingMode mode,
+        int maxSize,
+        DecodedImage& result,
+        ResultCache* cache
+    ) {
+        MappedFile file(path);
+        if (file.data == nullptr) {
+            LOGE("Cannot map image file: %s", path.c_str());
+            result.metrics = {0, 0, 0, mode, false, false, 0};
+            result.cached = false;
+            return false;
+        }
+        return processEncodedBuffer(processor, file.data, file.size, mode, maxSize, result, cache);
+    }
+
+    int processImageBatch(
+        OpenCVProcessor& processor,
+        const std::vector<std::string>& paths,
+        ProcessingMode mode,
+        int maxSize,
+        std::vector<DecodedImage>& results,
+        ResultCache* cache
+    ) {
+        results.clear();
+        results.resize(paths.size());
+        int processed = 0;
+        int hits = 0;
+        for (size_t i = 0; i < paths.size(); i++) {
+            DecodedImage& result = results[i];
+            if (processImageFile(processor, paths[i], mode, maxSize, result, cache)) {
+                processed++;
+                hits += result.cached ? 1 : 0;
+            } else {
+                result.width = 0;
+                result.height = 0;
+                releaseTracked(result.rgba);
+            }
+        }
+        LOGI("Image batch: %d/%zu processed, %d from cache", processed, paths.size(), hits);
+        return processed;
+    }
+
+    bool hashEncodedBuffer(const uint8_t* data, size_t size, EdgeHash& hash) {
+        std::memset(hash.words, 0, sizeof(hash.words));
+        if (data == nullptr || size == 0) {
+            return false;
+        }
+
+#ifdef HAVE_OPENCV
+        int sourceWidth = 0;
+        int sourceHeight = 0;
+        const int reduction = readImageSize(data, size, sourceWidth, sourceHeight)
+            ? chooseReduction(sourceWidth, sourceHeight, EDGE_HASH_DECODE_SIZE)
+            : 1;
+        int flags;
+        switch (reduction) {
+            case 2: flags = cv::IMREAD_REDUCED_GRAYSCALE_2; break;
+            case 4: flags = cv::IMREAD_REDUCED_GRAYSCALE_4; break;
+            case 8: flags = cv::IMREAD_REDUCED_GRAYSCALE_8; break;
+            default: flags = cv::IMREAD_GRAYSCALE; break;
+        }
+
+        cv::Mat decoded;
+        try {
+            cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<uint8_t*>(data));
+            decoded = cv::imdecode(encoded, flags);
+        } catch (const std::exception& e) {
+            LOGE("Image decode failed: %s", e.what());
+            return false;
+        }
+        if (decoded.empty()) {
+            LOGE("Unsupported or corrupt image (%zu bytes)", size);
+            return false;
+        }
+        return PerceptualHash::compute(decoded.data, decoded.cols, decoded.rows,
+                                       static_cast<int>(decoded.step), hash);
+#else
+        LOGE("Image decoding requires OpenCV imgcodecs");
+        return false;
+#endif
+    }
+
+    int hashImageFiles(
+        const std::vector<std::string>& paths,
+        std::vector<EdgeHash>& hashes,
+        std::vector<bool>& valid
+    ) {
+        hashes.assign(paths.size(), EdgeHash());
+        valid.assign(paths.size(), false);
+        int hashed = 0;
+        int64_t start = nowMs();
+        for (size_t i = 0; i < paths.size(); i++) {
+            MappedFile file(paths[i]);
+            if (file.data == nullptr) {
+                LOGE("Cannot map image file: %s", paths[i].c_str());
+                continue;
+            }
+            if (hashEncodedBuffer(file.data, file.size, hashes[i])) {
+                valid[i] = true;
+                hashed++;
+            }
+        }
+        LOGI("Edge hashes: %d/%zu images in %lld ms", hashed, paths.size(),
+             static_cast<long long>(nowMs() - start));
+        return hashed;
+    }
+
+#ifdef HAVE_OPENCV
+    std::string benchmark(const std::string& path, ProcessingMode mode, int maxSize, int iterations) {
+        MappedFile file(path);
+        if (file.data == nullptr) {
+            return "Cannot map image file: " + path;
+        }
+        iterations = std::max(1, iterations);
+
+        OpenCVProcessor processor;
+        processor.initialize();
+
+        int64_t reducedMs = 0;
+        int64_t fullMs = 0;
+        long reducedPeakKb = 0;
+        long fullPeakKb = 0;
+        DecodedImage reduced = {};
+        int fullWidth = 0;
+        int fullHeight = 0;
+
+        for (int i = 0; i < iterations; i++) {
+            // Reduced-scale decode straight into the pipeline
+            resetPeakRss();
+            long baseKb = peakRssKb();
+            int64_t start = nowMs();
+            if (!processEncodedBuffer(processor, file.data, file.size, mode, maxSize, reduced)) {
+                return "Decode failed: " + path;
+            }
+            reducedMs += nowMs() - start;
+            reducedPeakKb = std::max(reducedPeakKb, peakRssKb() - baseKb);
+            releaseTracked(reduced.rgba);
+
+            // Current route: full RGBA decode, then processFrame downscaling to the same output
+            resetPeakRss();
+            baseKb = peakRssKb();
+            start = nowMs();
+            {
+                cv::Mat encoded(1, static_cast<int>(file.size), CV_8UC1, const_cast<uint8_t*>(file.data));
+                cv::Mat bgr = cv::imdecode(encoded, cv::IMREAD_COLOR);
+                if (bgr.empty()) {
+                    return "Decode failed: " + path;
+                }
+                fullWidth = bgr.cols;
+                fullHeight = bgr.rows;
+                TrackedBytes rgba(static_cast<size_t>(fullWidth) * fullHeight * 4);
+                cv::Mat rgbaMat(fullHeight, fullWidth, CV_8UC4, rgba.data());
+                cv::cvtColor(bgr, rgbaMat, cv::COLOR_BGR2RGBA);
+                bgr.release();
+
+                int outWidth;
+                int outHeight;
+                outputSize(fullWidth, fullHeight, maxSize, outWidth, outHeight);
+                TrackedBytes output(static_cast<size_t>(outWidth) * outHeight * 4);
+                OutputTarget target = {output.data(), outWidth, outHeight, OUTPUT_FORMAT_RGBA, 0, nullptr, 0};
+                processor.processFrame(rgba.data(), fullWidth, fullHeight, mode, &target, 1);
+            }
+            fullMs += nowMs() - start;
+            fullPeakKb = std::max(fullPeakKb, peakRssKb() - baseKb);
+        }
+
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer),
+            "Image %dx%d -> %dx%d, mode %d, %d iteration(s)\n"
+            "Reduced decode (1/%d, %s): %.1f ms avg, peak +%ld KiB\n"
+            "Full RGBA decode + processFrame: %.1f ms avg, peak +%ld KiB",
+            fullWidth, fullHeight, reduced.width, reduced.height, mode, iterations,
+            reduced.reduction, mode == MODE_RAW ? "color" : "gray",
+            static_cast<double>(reducedMs) / iterations, reducedPeakKb,
+            static_cast<double>(fullMs) / iterations, fullPeakKb);
+        return std::string(buffer);
+    }
+#else
+    std::string benchmark(const std::string& /* path */, ProcessingMode /* mode */, int /* maxSize */,
+                          int /* iterations */) {
+        return "Image decoding requires OpenCV imgcodecs";
+    }
+#endif
+}
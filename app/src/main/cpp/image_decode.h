@@ -0,0 +1,130 @@
+#ifndef EDGEDETECTOR_IMAGE_DECODE_H
+#define EDGEDETECTOR_IMAGE_DECODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "native_memory.h"
+#include "opencv_processor.h"
+#include "perceptual_hash.h"
+#include "result_cache.h"
+
+// Longer side the gray decode for edge hashing is reduced towards
+#define EDGE_HASH_DECODE_SIZE 64
+
+// Decoded and processed still image
+struct DecodedImage {
+    int width;                  // Output size (longer side at most maxSize)
+    int height;
+    int decodedWidth;           // Size produced by the decoder (0 when cached)
+    int decodedHeight;
+    int reduction;              // Decoder scale-down factor (1, 2, 4 or 8; 0 when cached)
+    int64_t decodeTimeMs;
+    bool cached;                // Served from the result cache without decoding
+    ProcessingMetrics metrics;
+    TrackedBytes rgba;          // Processed RGBA output
+};
+
+/**
+ * Gallery decode path. JPEG/PNG headers are read first so the decoder can be
+ * asked for a 1/2, 1/4 or 1/8 scale image (DCT-domain scaling for JPEG) that
+ * is still at least as large as the requested output. EDGE and GRAYSCALE
+ * decode straight to gray, so no full-size RGBA image is ever built.
+ * With a result cache, the encoded bytes are hashed and looked up before
+ * anything is decoded; the key also covers the processor configuration,
+ * mode and output size.
+ */
+namespace ImageDecode {
+    /**
+     * Read image dimensions from a JPEG or PNG header
+     * @return false for other formats or truncated headers
+     */
+    bool readImageSize(const uint8_t* data, size_t size, int& width, int& height);
+
+    /**
+     * Largest decoder reduction that keeps the longer side at least maxSize
+     * @param maxSize Requested longer side (0 = full size)
+     */
+    int chooseReduction(int width, int height, int maxSize);
+
+    /**
+     * Decode and process an encoded image held in memory
+     * @param processor Initialized processor
+     * @param data Encoded JPEG/PNG/... bytes
+     * @param size Encoded size
+     * @param mode Processing mode
+     * @param maxSize Longer side of the output (0 = decoded size)
+     * @param result Output image and timings
+     * @param cache Result cache consulted before decoding and filled after
+     *        processing (nullptr or closed = no caching; bypassed while the
+     *        processor has side outputs for the mode)
+     * @return true if successful
+     */
+    bool processEncodedBuffer(
+        OpenCVProcessor& processor,
+        const uint8_t* data,
+        size_t size,
+        ProcessingMode mode,
+        int maxSize,
+        DecodedImage& result,
+        ResultCache* cache = nullptr
+    );
+
+    /**
+     * Memory-map an image file and process it with processEncodedBuffer
+     */
+    bool processImageFile(
+        OpenCVProcessor& processor,
+        const std::string& path,
+        ProcessingMode mode,
+        int maxSize,
+        DecodedImage& result,
+        ResultCache* cache = nullptr
+    );
+
+    /**
+     * Process a list of image files with processImageFile
+     * @param results One entry per path (empty rgba for failures)
+     * @return Number of images processed or served from the cache
+     */
+    int processImageBatch(
+        OpenCVProcessor& processor,
+        const std::vector<std::string>& paths,
+        ProcessingMode mode,
+        int maxSize,
+        std::vector<DecodedImage>& results,
+        ResultCache* cache = nullptr
+    );
+
+    /**
+     * Perceptual edge hash of an encoded image, decoded straight to gray at
+     * the largest reduction that keeps the longer side at least
+     * EDGE_HASH_DECODE_SIZE (usually 1/8 scale), so near-duplicates can be
+     * found without processing them
+     * @return false if the image cannot be decoded
+     */
+    bool hashEncodedBuffer(const uint8_t* data, size_t size, EdgeHash& hash);
+
+    /**
+     * Hash a list of image files with hashEncodedBuffer
+     * @param hashes One entry per path (cleared for failures)
+     * @param valid One entry per path, true where the hash was computed
+     * @return Number of images hashed
+     */
+    int hashImageFiles(
+        const std::vector<std::string>& paths,
+        std::vector<EdgeHash>& hashes,
+        std::vector<bool>& valid
+    );
+
+    /**
+     * Compare this path against a full-size RGBA decode followed by
+     * processFrame (the Bitmap route) for decode-plus-process time and
+     * peak resident memory
+     * @return Human-readable report
+     */
+    std::string benchmark(const std::string& path, ProcessingMode mode, int maxSize, int iterations);
+}
+
+#endif // EDGEDETECTOR_IMAGE_DECODE_H
@@ -0,0 +1,253 @@
+#include "lens_undistort.h"
+#include "opencv_processor.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef HAVE_OPENCV
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+#endif
+
+namespace {
+    // Intrinsics of a calibration scaled to another image size (pixel centres stay aligned)
+    struct Intrinsics {
+        double fx;
+        double fy;
+        double cx;
+        double cy;
+    };
+
+    Intrinsics scaleIntrinsics(const LensCalibration& calibration, int width, int height) {
+        const double sx = static_cast<double>(width) / calibration.width;
+        const double sy = static_cast<double>(height) / calibration.height;
+        return {
+            calibration.fx * sx,
+            calibration.fy * sy,
+            (calibration.cx + 0.5) * sx - 0.5,
+            (calibration.cy + 0.5) * sy - 0.5
+        };
+    }
+
+    int16_t saturateShort(int value) {
+        return static_cast<int16_t>(std::min(32767, std::max(-32768, value)));
+    }
+
+    int roundToInt(double value) {
+        const double limit = 2147483647.0;
+        return static_cast<int>(std::lround(std::min(limit, std::max(-limit, value))));
+    }
+}
+
+// Constructor
+LensUndistort::LensUndistort()
+    : mCalibration()
+    , mEnabled(false)
+    , mUseCounter(0)
+    , mTableBuilds(0)
+    , mTableReuses(0)
+{
+    // Same video-range expansion as ImageUtils::lumaFromVideoRange
+    for (int i = 0; i < 256; i++) {
+        int value = (298 * (i - 16) + 128) >> 8;
+        mRangeTable[i] = static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+}
+
+// Set calibration
+bool LensUndistort::setCalibration(const LensCalibration& calibration) {
+    clear();
+    if (calibration.width <= 0 || calibration.height <= 0 ||
+        !(calibration.fx > 0.0) || !(calibration.fy > 0.0) ||
+        !std::isfinite(calibration.cx) || !std::isfinite(calibration.cy) ||
+        !std::isfinite(calibration.k1) || !std::isfinite(calibration.k2) ||
+        !std::isfinite(calibration.p1) || !std::isfinite(calibration.p2) ||
+        !std::isfinite(calibration.k3)) {
+        LOGE("Invalid lens calibration");
+        return false;
+    }
+    mCalibration = calibration;
+    mEnabled = true;
+    return true;
+}
+
+// Disable undistortion
+void LensUndistort::clear() {
+    mEnabled = false;
+    mTables.clear();
+    mTableBuilds = 0;
+    mTableReuses = 0;
+}
+
+// Free cached tables
+size_t LensUndistort::release() {
+    size_t released = 0;
+    for (RemapTable& table : mTables) {
+        released += releaseTracked(table.xy);
+        released += releaseTracked(table.fraction);
+    }
+    mTables.clear();
+    return released;
+}
+
+// Cached table for a size, built on first use (least recently used one is replaced)
+LensUndistort::RemapTable* LensUndistort::table(int width, int height, int outWidth, int outHeight) {
+    mUseCounter++;
+    for (RemapTable& table : mTables) {
+        if (table.width == width && table.height == height &&
+            table.outWidth == outWidth && table.outHeight == outHeight) {
+            table.lastUse = mUseCounter;
+            mTableReuses++;
+            return &table;
+        }
+    }
+
+    if (mTables.size() >= UNDISTORT_CACHED_TABLES) {
+        auto oldest = std::min_element(mTables.begin(), mTables.end(),
+            [](const RemapTable& a, const RemapTable& b) { return a.lastUse < b.lastUse; });
+        mTables.erase(oldest);
+    }
+    mTables.emplace_back();
+    RemapTable& table = mTables.back();
+    table.width = width;
+    table.height = height;
+    table.outWidth = outWidth;
+    table.outHeight = outHeight;
+    table.lastUse = mUseCounter;
+    buildTable(table);
+    clampToFrame(table.xy.data(), table.fraction.data(),
+                 static_cast<size_t>(outWidth) * outHeight, width, height);
+    mTableBuilds++;
+    LOGI("Built %dx%d undistortion table for %dx%d frames", outWidth, outHeight, width, height);
+    return &table;
+}
+
+// Fixed-point map from output pixels to source positions
+void LensUndistort::buildTable(RemapTable& table) const {
+    const Intrinsics source = scaleIntrinsics(mCalibration, table.width, table.height);
+    const Intrinsics output = scaleIntrinsics(mCalibration, table.outWidth, table.outHeight);
+    const size_t pixels = static_cast<size_t>(table.outWidth) * table.outHeight;
+    table.xy.resize(pixels * 2);
+    table.fraction.resize(pixels);
+
+#ifdef HAVE_OPENCV
+    try {
+        cv::Mat cameraMatrix = (cv::Mat_<double>(3, 3) <<
+            source.fx, 0.0, source.cx, 0.0, source.fy, source.cy, 0.0, 0.0, 1.0);
+        cv::Mat newCameraMatrix = (cv::Mat_<double>(3, 3) <<
+            output.fx, 0.0, output.cx, 0.0, output.fy, output.cy, 0.0, 0.0, 1.0);
+        cv::Mat distortion = (cv::Mat_<double>(1, 5) <<
+            mCalibration.k1, mCalibration.k2, mCalibration.p1, mCalibration.p2, mCalibration.k3);
+
+        cv::Mat mapX;
+        cv::Mat mapY;
+        cv::initUndistortRectifyMap(cameraMatrix, distortion, cv::noArray(), newCameraMatrix,
+                                    cv::Size(table.outWidth, table.outHeight), CV_32FC1, mapX, mapY);
+
+        // Convert straight into the table storage
+        cv::Mat xyMat(table.outHeight, table.outWidth, CV_16SC2, table.xy.data());
+        cv::Mat fractionMat(table.outHeight, table.outWidth, CV_16UC1, table.fraction.data());
+        cv::convertMaps(mapX, mapY, xyMat, fractionMat, CV_16SC2, false);
+        if (xyMat.data == reinterpret_cast<uchar*>(table.xy.data()) &&
+            fractionMat.data == reinterpret_cast<uchar*>(table.fraction.data())) {
+            return;
+        }
+        LOGW("convertMaps reallocated its outputs, using the built-in table");
+    } catch (const std::exception& e) {
+        LOGE("OpenCV undistortion map failed: %s", e.what());
+    }
+#endif
+
+    // Built-in equivalent of initUndistortRectifyMap + convertMaps
+    const LensCalibration& c = mCalibration;
+    for (int v = 0; v < table.outHeight; v++) {
+        const double y = (v - output.cy) / output.fy;
+        int16_t* xy = table.xy.data() + static_cast<size_t>(v) * table.outWidth * 2;
+        uint16_t* fraction = table.fraction.data() + static_cast<size_t>(v) * table.outWidth;
+        for (int u = 0; u < table.outWidth; u++) {
+            const double x = (u - output.cx) / output.fx;
+            const double x2 = x * x;
+            const double y2 = y * y;
+            const double r2 = x2 + y2;
+            const double radial = 1.0 + r2 * (c.k1 + r2 * (c.k2 + r2 * c.k3));
+            const double xd = x * radial + 2.0 * c.p1 * x * y + c.p2 * (r2 + 2.0 * x2);
+            const double yd = y * radial + c.p1 * (r2 + 2.0 * y2) + 2.0 * c.p2 * x * y;
+
+            const int ix = roundToInt((source.fx * xd + source.cx) * UNDISTORT_INTER_SIZE);
+            const int iy = roundToInt((source.fy * yd + source.cy) * UNDISTORT_INTER_SIZE);
+            xy[2 * u] = saturateShort(ix >> UNDISTORT_INTER_BITS);
+            xy[2 * u + 1] = saturateShort(iy >> UNDISTORT_INTER_BITS);
+            fraction[u] = static_cast<uint16_t>(
+                ((iy & (UNDISTORT_INTER_SIZE - 1)) << UNDISTORT_INTER_BITS) | (ix & (UNDISTORT_INTER_SIZE - 1)));
+        }
+    }
+}
+
+// Pin every sample inside the frame; past the last column or row it becomes
+// that pixel with a zero fraction, so replication is exact
+void LensUndistort::clampToFrame(int16_t* xy, uint16_t* fraction, size_t count, int width, int height) {
+    const int maxX = width - 1;
+    const int maxY = height - 1;
+    for (size_t i = 0; i < count; i++) {
+        int sx = xy[2 * i];
+        int sy = xy[2 * i + 1];
+        int fx = fraction[i] & (UNDISTORT_INTER_SIZE - 1);
+        int fy = fraction[i] >> UNDISTORT_INTER_BITS;
+        if (sx < 0 || sx > maxX || (sx == maxX && fx > 0)) {
+            sx = sx < 0 ? 0 : maxX;
+            fx = 0;
+        }
+        if (sy < 0 || sy > maxY || (sy == maxY && fy > 0)) {
+            sy = sy < 0 ? 0 : maxY;
+            fy = 0;
+        }
+        xy[2 * i] = static_cast<int16_t>(sx);
+        xy[2 * i + 1] = static_cast<int16_t>(sy);
+        fraction[i] = static_cast<uint16_t>((fy << UNDISTORT_INTER_BITS) | fx);
+    }
+}
+
+// Gather, interpolate and expand in one pass over output tiles
+bool LensUndistort::lumaFromVideoRange(
+    const uint8_t* yData,
+    int width,
+    int height,
+    int yRowStride,
+    int outWidth,
+    int outHeight,
+    uint8_t* gray
+) {
+    if (!mEnabled || yData == nullptr || gray == nullptr || width < 2 || height < 2 ||
+        outWidth <= 0 || outHeight <= 0) {
+        return false;
+    }
+    const RemapTable* remap = table(width, height, outWidth, outHeight);
+    const uint8_t* range = mRangeTable;
+    const int tileRows = (outHeight + UNDISTORT_TILE_HEIGHT - 1) / UNDISTORT_TILE_HEIGHT;
+
+    WorkerPool::shared().parallelFor(tileRows, [&](int tileRow) {
+        const int y0 = tileRow * UNDISTORT_TILE_HEIGHT;
+        const int y1 = std::min(outHeight, y0 + UNDISTORT_TILE_HEIGHT);
+        for (int x0 = 0; x0 < outWidth; x0 += UNDISTORT_TILE_WIDTH) {
+            const int x1 = std::min(outWidth, x0 + UNDISTORT_TILE_WIDTH);
+            for (int y = y0; y < y1; y++) {
+                const size_t rowOffset = static_cast<size_t>(y) * outWidth;
+                const int16_t* xy = remap->xy.data() + rowOffset * 2;
+                const uint16_t* fraction = remap->fraction.data() + rowOffset;
+                uint8_t* out = gray + rowOffset;
+                for (int x = x0; x < x1; x++) {
+                    const int fx = fraction[x] & (UNDISTORT_INTER_SIZE - 1);
+                    const int fy = fraction[x] >> UNDISTORT_INTER_BITS;
+                    const int right = fx != 0 ? 1 : 0;
+                    const uint8_t* top = yData + static_cast<size_t>(xy[2 * x + 1]) * yRowStride + xy[2 * x];
+                    const uint8_t* bottom = fy != 0 ? top + yRowStride : top;
+                    const int upper = top[0] * (UNDISTORT_INTER_SIZE - fx) + top[right] * fx;
+                    const int lower = bottom[0] * (UNDISTORT_INTER_SIZE - fx) + bottom[right] * fx;
+                    const int value = upper * (UNDISTORT_INTER_SIZE - fy) + lower * fy;
+                    out[x] = range[(value + (1 << (2 * UNDISTORT_INTER_BITS - 1))) >> (2 * UNDISTORT_INTER_BITS)];
+                }
+            }
+        }
+    });
+    return true;
+}
@@ -0,0 +1,138 @@
+#ifndef EDGEDETECTOR_LENS_UNDISTORT_H
+#define EDGEDETECTOR_LENS_UNDISTORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "native_memory.h"
+
+// Fixed-point remap precision (OpenCV's INTER_BITS: 1/32 pixel)
+#define UNDISTORT_INTER_BITS 5
+#define UNDISTORT_INTER_SIZE (1 << UNDISTORT_INTER_BITS)
+
+// Output tile walked by one inner loop (source rows stay in cache)
+#define UNDISTORT_TILE_WIDTH 64
+#define UNDISTORT_TILE_HEIGHT 32
+
+// Remap tables kept for distinct frame/output sizes (e.g. full and half resolution)
+#define UNDISTORT_CACHED_TABLES 2
+
+// Pinhole intrinsics and Brown-Conrady distortion (OpenCV's 5-coefficient model)
+struct LensCalibration {
+    int width;          // Image size the calibration was measured at
+    int height;
+    double fx;
+    double fy;
+    double cx;
+    double cy;
+    double k1;
+    double k2;
+    double p1;
+    double p2;
+    double k3;
+};
+
+/**
+ * Lens undistortion fused into luma ingest. For each frame/output size a
+ * fixed-point table is built once (initUndistortRectifyMap to float maps,
+ * then convertMaps to CV_16SC2 + CV_16UC1 interpolation indices; the same
+ * math in scalar code without OpenCV) with the intrinsics scaled from the
+ * calibration resolution. Ingest then gathers the camera Y plane
+ * bilinearly through the table and expands video range in the same pass,
+ * tile by tile, so undistortion replaces the luma conversion instead of
+ * adding a remap pass. Samples outside the frame replicate the border.
+ */
+class LensUndistort {
+public:
+    LensUndistort();
+
+    /**
+     * Set calibration (drops cached tables)
+     * @return false for invalid intrinsics (undistortion left disabled)
+     */
+    bool setCalibration(const LensCalibration& calibration);
+
+    /**
+     * Disable undistortion and drop cached tables
+     */
+    void clear();
+
+    bool isEnabled() const { return mEnabled; }
+
+    /**
+     * Calibration last set (meaningful only while enabled)
+     */
+    const LensCalibration& calibration() const { return mCalibration; }
+
+    /**
+     * Undistorted full-range gray from video-range luma in one pass
+     * @param yData Camera Y plane
+     * @param width Frame width
+     * @param height Frame height
+     * @param yRowStride Y row stride in bytes
+     * @param outWidth Output width (frame width, or half under memory pressure)
+     * @param outHeight Output height
+     * @param gray Output plane of outWidth x outHeight
+     * @return false if disabled or the frame is smaller than 2x2
+     */
+    bool lumaFromVideoRange(
+        const uint8_t* yData,
+        int width,
+        int height,
+        int yRowStride,
+        int outWidth,
+        int outHeight,
+        uint8_t* gray
+    );
+
+    /**
+     * Tables built, and frames served from a cached table, since the
+     * calibration was set
+     */
+    int tableBuilds() const { return mTableBuilds; }
+    uint64_t tableReuses() const { return mTableReuses; }
+
+    /**
+     * Release cached tables (rebuilt on the next frame)
+     * @return Bytes released
+     */
+    size_t release();
+
+    /**
+     * Pin every sample of a fixed-point table inside a width x height frame
+     * (border replication). Samples past the last column or row become that
+     * pixel with a zero fraction, so gathers need no checks as long as they
+     * skip the second column or row when its fraction is zero.
+     * @param xy Integer source x, y pairs (CV_16SC2)
+     * @param fraction (fy << INTER_BITS) | fx indices (CV_16UC1)
+     * @param count Entries
+     */
+    static void clampToFrame(int16_t* xy, uint16_t* fraction, size_t count, int width, int height);
+
+private:
+    using ShortBuffer = std::vector<int16_t, TrackedAllocator<int16_t>>;
+    using UShortBuffer = std::vector<uint16_t, TrackedAllocator<uint16_t>>;
+
+    struct RemapTable {
+        int width;              // Source frame size
+        int height;
+        int outWidth;
+        int outHeight;
+        uint64_t lastUse;
+        ShortBuffer xy;         // Integer source x, y per output pixel (CV_16SC2)
+        UShortBuffer fraction;  // (fy << INTER_BITS) | fx (CV_16UC1)
+    };
+
+    LensCalibration mCalibration;
+    bool mEnabled;
+    std::vector<RemapTable> mTables;
+    uint64_t mUseCounter;
+    int mTableBuilds;
+    uint64_t mTableReuses;
+    uint8_t mRangeTable[256];
+
+    RemapTable* table(int width, int height, int outWidth, int outHeight);
+    void buildTable(RemapTable& table) const;
+};
+
+#endif // EDGEDETECTOR_LENS_UNDISTORT_H
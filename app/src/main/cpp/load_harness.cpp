@@ -0,0 +1,262 @@
+#include "load_harness.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+
+// Format report as a single human-readable block
+std::string LoadTestReport::toString() const {
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+        "Duration: %.1fs, Offered: %llu, Processed: %llu, Dropped: %llu (%.2f%%), Failed: %llu\n"
+        "Sustained: %.2f fps\n"
+        "Latency ms: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n"
+        "RSS KiB: start %ld, peak %ld, end %ld, growth %ld",
+        durationSeconds,
+        static_cast<unsigned long long>(framesOffered),
+        static_cast<unsigned long long>(framesProcessed),
+        static_cast<unsigned long long>(framesDropped),
+        dropRate * 100.0,
+        static_cast<unsigned long long>(framesFailed),
+        sustainedFps,
+        latencyP50Ms, latencyP90Ms, latencyP99Ms, latencyMaxMs,
+        rssStartKb, rssPeakKb, rssEndKb, rssEndKb - rssStartKb);
+    return std::string(buffer);
+}
+
+// Constructor
+LoadHarness::LoadHarness(const LoadTestConfig& config)
+    : mConfig(config)
+    , mSource(config.source)
+{
+    mConfig.pipelineCount = std::max(1, mConfig.pipelineCount);
+    mConfig.preGeneratedFrames = std::max(1, mConfig.preGeneratedFrames);
+    if (mConfig.targetFps <= 0.0) {
+        mConfig.targetFps = 30.0;
+    }
+}
+
+// Destructor
+LoadHarness::~LoadHarness() {
+    for (auto& pipeline : mPipelines) {
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            pipeline->stop = true;
+        }
+        pipeline->ready.notify_one();
+        if (pipeline->thread.joinable()) {
+            pipeline->thread.join();
+        }
+    }
+}
+
+// Run the sustained-load test
+LoadTestReport LoadHarness::run() {
+    LoadTestReport report = {};
+
+    if (!mSource.isValid()) {
+        LOGE("Load test source configuration is invalid");
+        return report;
+    }
+
+    // Render the replay loop up front so generation cost stays out of the figures;
+    // the ring is shallower when the native memory budget is under pressure
+    const int depth = MemoryBudget::instance().recommendedDepth(mConfig.preGeneratedFrames);
+    if (depth < mConfig.preGeneratedFrames) {
+        LOGW("Replay ring reduced to %d frame(s) by memory pressure", depth);
+    }
+    mFrames.assign(depth, TrackedBytes(mSource.frameSize()));
+    for (size_t i = 0; i < mFrames.size(); i++) {
+        mSource.generate(i, mFrames[i].data());
+    }
+
+    const int width = mConfig.source.width;
+    const int height = mConfig.source.height;
+    const size_t rgbaSize = static_cast<size_t>(width) * height * 4;
+    const int64_t periodUs = static_cast<int64_t>(1000000.0 / mConfig.targetFps);
+    const int64_t expectedFrames = static_cast<int64_t>(mConfig.targetFps * mConfig.durationSeconds);
+
+    mPipelines.clear();
+    for (int i = 0; i < mConfig.pipelineCount; i++) {
+        std::unique_ptr<Pipeline> pipeline(new Pipeline());
+        pipeline->processor.initialize();
+        pipeline->rgba.resize(rgbaSize);
+        pipeline->output.resize(rgbaSize);
+        pipeline->latenciesUs.reserve(static_cast<size_t>(std::max<int64_t>(expectedFrames, 0)));
+        mPipelines.push_back(std::move(pipeline));
+    }
+
+    report.rssStartKb = currentRssKb();
+    report.rssPeakKb = report.rssStartKb;
+
+    for (auto& pipeline : mPipelines) {
+        pipeline->thread = std::thread(&LoadHarness::pipelineLoop, this, pipeline.get());
+    }
+
+    LOGI("Load test: %d pipeline(s), %dx%d, mode %d, %.1f fps for %ds",
+         mConfig.pipelineCount, width, height, mConfig.mode,
+         mConfig.targetFps, mConfig.durationSeconds);
+
+    // Offer frames on a fixed schedule
+    const int64_t startUs = nowUs();
+    const int64_t endUs = startUs + static_cast<int64_t>(mConfig.durationSeconds) * 1000000;
+    const int64_t rssSampleEvery = std::max<int64_t>(1, static_cast<int64_t>(mConfig.targetFps));
+    int64_t tick = 0;
+
+    for (;; tick++) {
+        int64_t dueUs = startUs + tick * periodUs;
+        if (dueUs >= endUs) {
+            break;
+        }
+        std::this_thread::sleep_until(
+            std::chrono::steady_clock::time_point(std::chrono::microseconds(dueUs)));
+
+        const int64_t offeredAtUs = nowUs();
+        const size_t slot = static_cast<size_t>(tick) % mFrames.size();
+
+        for (auto& pipeline : mPipelines) {
+            report.framesOffered++;
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            if (pipeline->pending) {
+                report.framesDropped++;
+                continue;
+            }
+            pipeline->pending = true;
+            pipeline->frameSlot = slot;
+            pipeline->offeredAtUs = offeredAtUs;
+            pipeline->ready.notify_one();
+        }
+
+        if (tick % rssSampleEvery == 0) {
+            report.rssPeakKb = std::max(report.rssPeakKb, currentRssKb());
+        }
+    }
+
+    // Drain and stop pipelines
+    for (auto& pipeline : mPipelines) {
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            pipeline->stop = true;
+        }
+        pipeline->ready.notify_one();
+        pipeline->thread.join();
+    }
+
+    report.durationSeconds = static_cast<double>(nowUs() - startUs) / 1e6;
+    report.rssEndKb = currentRssKb();
+    report.rssPeakKb = std::max(report.rssPeakKb, report.rssEndKb);
+
+    std::vector<int64_t> latencies;
+    for (auto& pipeline : mPipelines) {
+        report.framesProcessed += pipeline->processed;
+        report.framesFailed += pipeline->failed;
+        latencies.insert(latencies.end(), pipeline->latenciesUs.begin(), pipeline->latenciesUs.end());
+    }
+
+    report.sustainedFps = report.durationSeconds > 0.0
+        ? static_cast<double>(report.framesProcessed) / report.durationSeconds
+        : 0.0;
+    report.dropRate = report.framesOffered > 0
+        ? static_cast<double>(report.framesDropped) / report.framesOffered
+        : 0.0;
+
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) {
+            size_t index = static_cast<size_t>(p * (latencies.size() - 1) + 0.5);
+            return static_cast<double>(latencies[index]) / 1000.0;
+        };
+        report.latencyP50Ms = percentile(0.50);
+        report.latencyP90Ms = percentile(0.90);
+        report.latencyP99Ms = percentile(0.99);
+        report.latencyMaxMs = static_cast<double>(latencies.back()) / 1000.0;
+    }
+
+    LOGI("Load test finished:\n%s", report.toString().c_str());
+    return report;
+}
+
+// Worker loop for one pipeline
+void LoadHarness::pipelineLoop(Pipeline* pipeline) {
+    for (;;) {
+        size_t slot;
+        int64_t offeredAtUs;
+        {
+            std::unique_lock<std::mutex> lock(pipeline->mutex);
+            pipeline->ready.wait(lock, [pipeline] { return pipeline->pending || pipeline->stop; });
+            if (!pipeline->pending) {
+                return;
+            }
+            slot = pipeline->frameSlot;
+            offeredAtUs = pipeline->offeredAtUs;
+        }
+
+        bool success = runPipelineFrame(pipeline, slot);
+        int64_t latencyUs = nowUs() - offeredAtUs;
+
+        std::lock_guard<std::mutex> lock(pipeline->mutex);
+        if (success) {
+            pipeline->processed++;
+            pipeline->latenciesUs.push_back(latencyUs);
+        } else {
+            pipeline->failed++;
+        }
+        pipeline->pending = false;
+    }
+}
+
+// Ingest and process one frame
+bool LoadHarness::runPipelineFrame(Pipeline* pipeline, size_t frameSlot) {
+    const uint8_t* frame = mFrames[frameSlot].data();
+    const int width = mConfig.source.width;
+    const int height = mConfig.source.height;
+    const uint8_t* rgba = frame;
+
+    if (mConfig.source.format == SYNTHETIC_YUV420) {
+        SimdKernels::vectorized().yuv420ToRgba(
+            frame,
+            frame + mSource.uPlaneOffset(),
+            frame + mSource.vPlaneOffset(),
+            width,
+            height,
+            mSource.yRowStride(),
+            mSource.uvRowStride(),
+            1,
+            pipeline->rgba.data()
+        );
+        rgba = pipeline->rgba.data();
+    }
+
+    ProcessingMetrics metrics = pipeline->processor.processFrame(
+        rgba,
+        width,
+        height,
+        static_cast<ProcessingMode>(mConfig.mode),
+        pipeline->output.data()
+    );
+    return metrics.success;
+}
+
+// Resident set size from /proc
+long LoadHarness::currentRssKb() {
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+
+    long totalPages = 0;
+    long residentPages = 0;
+    int fields = fscanf(file, "%ld %ld", &totalPages, &residentPages);
+    fclose(file);
+
+    if (fields != 2) {
+        return 0;
+    }
+    return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Monotonic time in microseconds
+int64_t LoadHarness::nowUs() {
+    auto now = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+}
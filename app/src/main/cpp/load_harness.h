@@ -0,0 +1,93 @@
+#ifndef EDGEDETECTOR_LOAD_HARNESS_H
+#define EDGEDETECTOR_LOAD_HARNESS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "opencv_processor.h"
+#include "synthetic_source.h"
+
+// Sustained-load test configuration
+struct LoadTestConfig {
+    SyntheticConfig source;
+    int mode;                 // ProcessingMode
+    int pipelineCount;        // Independent OpenCVProcessor instances
+    double targetFps;         // Offered frame rate per pipeline
+    int durationSeconds;
+    int preGeneratedFrames;   // Frames rendered up front and replayed in a loop
+};
+
+// Sustained-load test results
+struct LoadTestReport {
+    uint64_t framesOffered;
+    uint64_t framesProcessed;
+    uint64_t framesDropped;   // Offered while the pipeline was still busy
+    uint64_t framesFailed;
+    double durationSeconds;
+    double sustainedFps;      // Processed frames per second, all pipelines
+    double dropRate;
+    double latencyP50Ms;      // Offer-to-completion latency
+    double latencyP90Ms;
+    double latencyP99Ms;
+    double latencyMaxMs;
+    long rssStartKb;
+    long rssPeakKb;
+    long rssEndKb;
+
+    std::string toString() const;
+};
+
+/**
+ * Drives one or more processing pipelines from a synthetic source at a
+ * fixed frame rate. Each pipeline has a single-frame mailbox: a frame offered
+ * while the previous one is still being processed counts as dropped, which
+ * matches how the camera analyzer behaves under backpressure.
+ */
+class LoadHarness {
+public:
+    explicit LoadHarness(const LoadTestConfig& config);
+    ~LoadHarness();
+
+    /**
+     * Run the test for the configured duration (blocks the caller)
+     * @return Collected throughput, drop, latency and memory figures
+     */
+    LoadTestReport run();
+
+    /**
+     * Current resident set size in KiB (0 if unavailable)
+     */
+    static long currentRssKb();
+
+private:
+    struct Pipeline {
+        OpenCVProcessor processor;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable ready;
+        bool pending = false;
+        bool stop = false;
+        size_t frameSlot = 0;
+        int64_t offeredAtUs = 0;
+        TrackedBytes rgba;
+        TrackedBytes output;
+        std::vector<int64_t> latenciesUs;
+        uint64_t processed = 0;
+        uint64_t failed = 0;
+    };
+
+    LoadTestConfig mConfig;
+    std::vector<TrackedBytes> mFrames;
+    std::vector<std::unique_ptr<Pipeline>> mPipelines;
+    SyntheticFrameSource mSource;
+
+    void pipelineLoop(Pipeline* pipeline);
+    bool runPipelineFrame(Pipeline* pipeline, size_t frameSlot);
+    static int64_t nowUs();
+};
+
+#endif // EDGEDETECTOR_LOAD_HARNESS_H
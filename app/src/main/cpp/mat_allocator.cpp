@@ -0,0 +1,517 @@
+#include "mat_allocator.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef HAVE_OPENCV
+#include <opencv2/core.hpp>
+#endif
+
+namespace {
+    // Quarter-octave classes from 64 bytes to BLOCK_POOL_MAX_BLOCK (2^26)
+    const int kMinShift = 6;
+    const int kMaxShift = 26;
+    const int kClassCount = (kMaxShift - kMinShift) * 4 + 1;
+
+    // Read the clock once per this many pool operations on a thread
+    const uint32_t kClockInterval = 64;
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    // Precedes every pooled block, padded so the data keeps the pool alignment
+    struct BlockHeader {
+        BlockPool::ThreadCache* owner;
+        int32_t sizeClass;
+    };
+    const size_t kHeaderBytes = BLOCK_POOL_ALIGNMENT;
+    static_assert(sizeof(BlockHeader) <= kHeaderBytes, "Block header must fit the alignment padding");
+
+    BlockHeader* headerOf(void* block) {
+        return reinterpret_cast<BlockHeader*>(static_cast<uint8_t*>(block) - kHeaderBytes);
+    }
+
+    int64_t nowMs() {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    }
+}
+
+// Free lists owned by one thread (the mutex is only contended by trim).
+// Other threads push the blocks they free onto remote; the owner moves them
+// onto its lists. Caches outlive their thread: a retired cache is adopted
+// by the next new thread, so block owners stay valid.
+struct BlockPool::ThreadCache {
+    std::mutex mutex;
+    std::atomic<FreeBlock*> remote;
+    bool retired;                   // Guarded by the registry mutex
+    FreeBlock* lists[kClassCount];
+    uint32_t counts[kClassCount];
+    int64_t lastUseMs[kClassCount];
+    size_t cachedBytes;
+    int64_t clockMs;
+    int64_t nextSweepMs;
+    uint32_t operations;
+
+    ThreadCache()
+        : remote(nullptr)
+        , retired(false)
+        , cachedBytes(0)
+        , clockMs(nowMs())
+        , nextSweepMs(clockMs + BLOCK_POOL_IDLE_MS)
+        , operations(0)
+    {
+        std::fill(lists, lists + kClassCount, nullptr);
+        std::fill(counts, counts + kClassCount, 0u);
+        std::fill(lastUseMs, lastUseMs + kClassCount, clockMs);
+    }
+
+    void tick() {
+        if (++operations % kClockInterval == 0) {
+            clockMs = nowMs();
+        }
+    }
+};
+
+// Drains and retires the calling thread's cache when the thread exits
+struct ThreadCacheOwner {
+    BlockPool::ThreadCache* cache = nullptr;
+
+    ~ThreadCacheOwner() {
+        if (cache != nullptr) {
+            BlockPool::instance().retireCache(cache);
+        }
+    }
+};
+
+namespace {
+    thread_local ThreadCacheOwner tCacheOwner;
+}
+
+// Singleton (never destroyed: thread caches and pooled Mats may outlive static destruction)
+BlockPool& BlockPool::instance() {
+    static BlockPool* pool = new BlockPool();
+    return *pool;
+}
+
+// Constructor
+BlockPool::BlockPool()
+    : mHits(0)
+    , mMisses(0)
+    , mOversized(0)
+    , mCachedFrees(0)
+    , mRemoteFrees(0)
+    , mReleasedFrees(0)
+    , mCachedBytes(0)
+    , mOutstandingBytes(0)
+{
+    MemoryBudget::instance().registerListener(this);
+}
+
+// Quarter-octave size class
+int BlockPool::sizeClass(size_t bytes) {
+    if (bytes > BLOCK_POOL_MAX_BLOCK) {
+        return -1;
+    }
+    if (bytes <= (size_t(1) << kMinShift)) {
+        return 0;
+    }
+    // 2^shift < bytes <= 2^(shift + 1)
+    const int shift = 63 - __builtin_clzll(static_cast<unsigned long long>(bytes - 1));
+    const size_t base = size_t(1) << shift;
+    const int step = static_cast<int>((bytes - 1 - base) >> (shift - 2));
+    return (shift - kMinShift) * 4 + step + 1;
+}
+
+size_t BlockPool::classSize(int sizeClass) {
+    if (sizeClass <= 0) {
+        return size_t(1) << kMinShift;
+    }
+    const int shift = (sizeClass - 1) / 4 + kMinShift;
+    const int step = (sizeClass - 1) % 4;
+    const size_t base = size_t(1) << shift;
+    return base + (step + 1) * (base / 4);
+}
+
+// Aligned system allocation accounted against the memory budget
+void* BlockPool::systemAllocate(size_t bytes) {
+    void* block = nullptr;
+    if (posix_memalign(&block, BLOCK_POOL_ALIGNMENT, std::max<size_t>(bytes, 1)) != 0) {
+        return nullptr;
+    }
+    MemoryBudget::instance().onAllocate(bytes);
+    return block;
+}
+
+void BlockPool::systemFree(void* block, size_t bytes) {
+    std::free(block);
+    MemoryBudget::instance().onFree(bytes);
+}
+
+// Calling thread's cache, adopting a retired one before creating another
+BlockPool::ThreadCache* BlockPool::localCache() {
+    if (tCacheOwner.cache == nullptr) {
+        std::lock_guard<std::mutex> lock(mRegistryMutex);
+        for (ThreadCache* cache : mCaches) {
+            if (cache->retired) {
+                cache->retired = false;
+                tCacheOwner.cache = cache;
+                break;
+            }
+        }
+        if (tCacheOwner.cache == nullptr) {
+            tCacheOwner.cache = new ThreadCache();
+            mCaches.push_back(tCacheOwner.cache);
+        }
+    }
+    return tCacheOwner.cache;
+}
+
+// Move blocks other threads handed back onto the free lists (cache mutex held)
+void BlockPool::collectRemote(ThreadCache* cache) {
+    FreeBlock* block = cache->remote.exchange(nullptr, std::memory_order_acquire);
+    while (block != nullptr) {
+        FreeBlock* next = block->next;
+        const int sizeClass = headerOf(block)->sizeClass;
+        const size_t size = classSize(sizeClass);
+        if (cache->cachedBytes + size <= BLOCK_POOL_THREAD_CACHE) {
+            block->next = cache->lists[sizeClass];
+            cache->lists[sizeClass] = block;
+            cache->counts[sizeClass]++;
+            cache->cachedBytes += size;
+        } else {
+            mCachedBytes.fetch_sub(size);
+            mReleasedFrees.fetch_add(1);
+            systemFree(headerOf(block), size + kHeaderBytes);
+        }
+        block = next;
+    }
+}
+
+// Free one class of a cache (cache mutex held)
+size_t BlockPool::drain(ThreadCache* cache, int sizeClass) {
+    const size_t size = classSize(sizeClass);
+    size_t released = 0;
+    FreeBlock* block = cache->lists[sizeClass];
+    while (block != nullptr) {
+        FreeBlock* next = block->next;
+        systemFree(headerOf(block), size + kHeaderBytes);
+        released += size;
+        block = next;
+    }
+    const uint32_t count = cache->counts[sizeClass];
+    cache->lists[sizeClass] = nullptr;
+    cache->counts[sizeClass] = 0;
+    cache->cachedBytes -= released;
+    mCachedBytes.fetch_sub(released);
+    mReleasedFrees.fetch_add(count);
+    return released;
+}
+
+// Empty a finished thread's cache and leave it for the next new thread.
+// Blocks still outstanding keep pointing at it; those freed before it is
+// adopted wait on its remote list for the adopter or the next trim.
+void BlockPool::retireCache(ThreadCache* cache) {
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        collectRemote(cache);
+        for (int sizeClass = 0; sizeClass < kClassCount; sizeClass++) {
+            drain(cache, sizeClass);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mRegistryMutex);
+    cache->retired = true;
+}
+
+// Return classes a thread has stopped using, e.g. after a resolution change (cache mutex held)
+void BlockPool::sweepIdle(ThreadCache* cache) {
+    if (cache->clockMs < cache->nextSweepMs) {
+        return;
+    }
+    for (int c = 0; c < kClassCount; c++) {
+        if (cache->lists[c] != nullptr && cache->clockMs - cache->lastUseMs[c] >= BLOCK_POOL_IDLE_MS) {
+            drain(cache, c);
+        }
+    }
+    cache->nextSweepMs = cache->clockMs + BLOCK_POOL_IDLE_MS / 2;
+}
+
+// Allocate from the calling thread's free list, falling back to the system
+void* BlockPool::allocate(size_t bytes) {
+    const int sizeClass = BlockPool::sizeClass(bytes);
+    if (sizeClass < 0) {
+        mOversized.fetch_add(1);
+        void* block = systemAllocate(bytes);
+        if (block != nullptr) {
+            mOutstandingBytes.fetch_add(bytes);
+        }
+        return block;
+    }
+
+    const size_t size = classSize(sizeClass);
+    ThreadCache* cache = localCache();
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->tick();
+        cache->lastUseMs[sizeClass] = cache->clockMs;
+        sweepIdle(cache);
+        FreeBlock* block = cache->lists[sizeClass];
+        if (block == nullptr && cache->remote.load(std::memory_order_relaxed) != nullptr) {
+            collectRemote(cache);
+            block = cache->lists[sizeClass];
+        }
+        if (block != nullptr) {
+            cache->lists[sizeClass] = block->next;
+            cache->counts[sizeClass]--;
+            cache->cachedBytes -= size;
+            mCachedBytes.fetch_sub(size);
+            mOutstandingBytes.fetch_add(size);
+            mHits.fetch_add(1);
+            return block;
+        }
+    }
+
+    mMisses.fetch_add(1);
+    uint8_t* raw = static_cast<uint8_t*>(systemAllocate(size + kHeaderBytes));
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(raw);
+    header->owner = cache;
+    header->sizeClass = sizeClass;
+    mOutstandingBytes.fetch_add(size);
+    return raw + kHeaderBytes;
+}
+
+// Return a block to its owner's free list (or the system)
+void BlockPool::deallocate(void* block, size_t bytes) {
+    if (block == nullptr) {
+        return;
+    }
+    const int sizeClass = BlockPool::sizeClass(bytes);
+    if (sizeClass < 0) {
+        mOutstandingBytes.fetch_sub(bytes);
+        mReleasedFrees.fetch_add(1);
+        systemFree(block, bytes);
+        return;
+    }
+
+    const size_t size = classSize(sizeClass);
+    mOutstandingBytes.fetch_sub(size);
+    ThreadCache* cache = headerOf(block)->owner;
+    if (cache != tCacheOwner.cache) {
+        // Freed on another thread: hand it back without taking the owner's lock
+        FreeBlock* freed = static_cast<FreeBlock*>(block);
+        FreeBlock* head = cache->remote.load(std::memory_order_relaxed);
+        do {
+            freed->next = head;
+        } while (!cache->remote.compare_exchange_weak(head, freed, std::memory_order_release,
+                                                      std::memory_order_relaxed));
+        mCachedBytes.fetch_add(size);
+        mCachedFrees.fetch_add(1);
+        mRemoteFrees.fetch_add(1);
+        return;
+    }
+
+    bool cached = false;
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        cache->tick();
+        cache->lastUseMs[sizeClass] = cache->clockMs;
+        if (cache->cachedBytes + size <= BLOCK_POOL_THREAD_CACHE) {
+            FreeBlock* freed = static_cast<FreeBlock*>(block);
+            freed->next = cache->lists[sizeClass];
+            cache->lists[sizeClass] = freed;
+            cache->counts[sizeClass]++;
+            cache->cachedBytes += size;
+            mCachedBytes.fetch_add(size);
+            mCachedFrees.fetch_add(1);
+            cached = true;
+        }
+        sweepIdle(cache);
+    }
+
+    if (!cached) {
+        mReleasedFrees.fetch_add(1);
+        systemFree(headerOf(block), size + kHeaderBytes);
+    }
+}
+
+// Free every cached block
+size_t BlockPool::releaseCached() {
+    std::lock_guard<std::mutex> registryLock(mRegistryMutex);
+    size_t released = 0;
+    for (ThreadCache* cache : mCaches) {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        collectRemote(cache);
+        for (int sizeClass = 0; sizeClass < kClassCount; sizeClass++) {
+            if (cache->lists[sizeClass] != nullptr) {
+                released += drain(cache, sizeClass);
+            }
+        }
+    }
+    return released;
+}
+
+// Release cached blocks on trimMemory
+size_t BlockPool::onTrimMemory(int /* level */) {
+    return releaseCached();
+}
+
+BlockPoolStats BlockPool::stats() const {
+    BlockPoolStats stats;
+    stats.hits = mHits.load();
+    stats.misses = mMisses.load();
+    stats.oversized = mOversized.load();
+    stats.cachedFrees = mCachedFrees.load();
+    stats.remoteFrees = mRemoteFrees.load();
+    stats.releasedFrees = mReleasedFrees.load();
+    stats.cachedBytes = mCachedBytes.load();
+    stats.outstandingBytes = mOutstandingBytes.load();
+    {
+        std::lock_guard<std::mutex> lock(const_cast<std::mutex&>(mRegistryMutex));
+        stats.threads = static_cast<int>(std::count_if(mCaches.begin(), mCaches.end(),
+            [](const ThreadCache* cache) { return !cache->retired; }));
+    }
+    return stats;
+}
+
+void BlockPool::resetCounters() {
+    mHits.store(0);
+    mMisses.store(0);
+    mOversized.store(0);
+    mCachedFrees.store(0);
+    mRemoteFrees.store(0);
+    mReleasedFrees.store(0);
+}
+
+// Counter summary
+std::string BlockPool::getStatistics() const {
+    BlockPoolStats s = stats();
+    const uint64_t requests = s.hits + s.misses;
+    char buffer[320];
+    snprintf(buffer, sizeof(buffer),
+        "Mat pool: %llu hits, %llu misses (%.1f%% hit), %llu oversized, %llu cross-thread frees, "
+        "cached %zu KiB, in use %zu KiB, %d thread cache(s), Installed: %s",
+        static_cast<unsigned long long>(s.hits),
+        static_cast<unsigned long long>(s.misses),
+        requests > 0 ? 100.0 * s.hits / requests : 0.0,
+        static_cast<unsigned long long>(s.oversized),
+        static_cast<unsigned long long>(s.remoteFrees),
+        s.cachedBytes / 1024,
+        s.outstandingBytes / 1024,
+        s.threads,
+        PooledMatAllocator::isInstalled() ? "Yes" : "No");
+    return std::string(buffer);
+}
+
+#ifdef HAVE_OPENCV
+namespace {
+    // cv::StdMatAllocator with data and UMatData headers taken from the pool
+    class PoolMatAllocator : public cv::MatAllocator {
+    public:
+        cv::UMatData* allocate(
+            int dims,
+            const int* sizes,
+            int type,
+            void* data0,
+            size_t* step,
+            cv::AccessFlag /* flags */,
+            cv::UMatUsageFlags /* usageFlags */
+        ) const override {
+            size_t total = CV_ELEM_SIZE(type);
+            for (int i = dims - 1; i >= 0; i--) {
+                if (step != nullptr) {
+                    if (data0 != nullptr && step[i] != cv::Mat::AUTO_STEP) {
+                        CV_Assert(total <= step[i]);
+                        total = step[i];
+                    } else {
+                        step[i] = total;
+                    }
+                }
+                total *= sizes[i];
+            }
+
+            BlockPool& pool = BlockPool::instance();
+            uchar* data = data0 != nullptr ? static_cast<uchar*>(data0) : static_cast<uchar*>(pool.allocate(total));
+            void* header = pool.allocate(sizeof(cv::UMatData));
+            if (data == nullptr || header == nullptr) {
+                if (data0 == nullptr) {
+                    pool.deallocate(data, total);
+                }
+                pool.deallocate(header, sizeof(cv::UMatData));
+                CV_Error(cv::Error::StsNoMem, "Mat pool allocation failed");
+            }
+
+            cv::UMatData* u = new (header) cv::UMatData(this);
+            u->data = u->origdata = data;
+            u->size = total;
+            if (data0 != nullptr) {
+                u->flags |= cv::UMatData::USER_ALLOCATED;
+            }
+            return u;
+        }
+
+        bool allocate(cv::UMatData* u, cv::AccessFlag /* accessFlags */, cv::UMatUsageFlags /* usageFlags */) const override {
+            return u != nullptr;
+        }
+
+        void deallocate(cv::UMatData* u) const override {
+            if (u == nullptr) {
+                return;
+            }
+            CV_Assert(u->urefcount == 0);
+            CV_Assert(u->refcount == 0);
+
+            BlockPool& pool = BlockPool::instance();
+            if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+                pool.deallocate(u->origdata, u->size);
+                u->origdata = nullptr;
+            }
+            u->~UMatData();
+            pool.deallocate(u, sizeof(cv::UMatData));
+        }
+    };
+
+    // Never destroyed: Mats allocated from it may be released during static destruction
+    PoolMatAllocator* poolAllocator() {
+        static PoolMatAllocator* allocator = new PoolMatAllocator();
+        return allocator;
+    }
+}
+#endif
+
+namespace PooledMatAllocator {
+    bool install() {
+#ifdef HAVE_OPENCV
+        if (!isInstalled()) {
+            cv::Mat::setDefaultAllocator(poolAllocator());
+            LOGI("Pooled Mat allocator installed");
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void uninstall() {
+#ifdef HAVE_OPENCV
+        if (isInstalled()) {
+            cv::Mat::setDefaultAllocator(cv::Mat::getStdAllocator());
+            LOGI("Standard Mat allocator restored");
+        }
+#endif
+    }
+
+    bool isInstalled() {
+#ifdef HAVE_OPENCV
+        return cv::Mat::getDefaultAllocator() == poolAllocator();
+#else
+        return false;
+#endif
+    }
+}
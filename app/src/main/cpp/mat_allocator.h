@@ -0,0 +1,122 @@
+#ifndef EDGEDETECTOR_MAT_ALLOCATOR_H
+#define EDGEDETECTOR_MAT_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "native_memory.h"
+
+// Block pool limits
+#define BLOCK_POOL_ALIGNMENT 64                     // Matches OpenCV's fastMalloc alignment
+#define BLOCK_POOL_MAX_BLOCK (64u * 1024u * 1024u)  // Larger requests bypass the pool
+#define BLOCK_POOL_THREAD_CACHE (48u * 1024u * 1024u)
+#define BLOCK_POOL_IDLE_MS 2000                     // Cached classes unused this long are freed
+
+// Pool counters since the last reset
+struct BlockPoolStats {
+    uint64_t hits;              // Served from a free list
+    uint64_t misses;            // Went to the system allocator
+    uint64_t oversized;         // Above BLOCK_POOL_MAX_BLOCK (not pooled)
+    uint64_t cachedFrees;       // Returned to a free list
+    uint64_t remoteFrees;       // Of those, freed on another thread and handed back to the owner
+    uint64_t releasedFrees;     // Returned to the system (cache full, idle or trimmed)
+    size_t cachedBytes;         // Currently held in free lists
+    size_t outstandingBytes;    // Currently handed out
+    int threads;                // Thread caches owned by a live thread
+};
+
+/**
+ * Size-classed block pool. Sizes are rounded up to quarter-octave classes
+ * (at most 25% slack). Each block remembers the thread cache it was
+ * allocated from and goes back there when freed: onto the owner's free
+ * list directly, or through a lock-free hand-off list when another thread
+ * frees it, which the owner collects the next time its own list runs dry.
+ * Steady-state allocation is a list pop with no shared lock, even when
+ * results are released on a different thread. Memory goes back to the
+ * system lazily: when a thread's cache is full, when a size class has been
+ * idle for BLOCK_POOL_IDLE_MS, or on trimMemory.
+ */
+class BlockPool : public MemoryTrimListener {
+public:
+    static BlockPool& instance();
+
+    /**
+     * Allocate at least bytes, aligned to BLOCK_POOL_ALIGNMENT
+     */
+    void* allocate(size_t bytes);
+
+    /**
+     * Free a block (bytes must be the size passed to allocate)
+     */
+    void deallocate(void* block, size_t bytes);
+
+    /**
+     * Free every cached block in every thread cache
+     * @return Bytes released
+     */
+    size_t releaseCached();
+
+    size_t onTrimMemory(int level) override;
+
+    BlockPoolStats stats() const;
+    void resetCounters();
+    std::string getStatistics() const;
+
+    /**
+     * Size class of a request (-1 when not pooled) and its block size
+     */
+    static int sizeClass(size_t bytes);
+    static size_t classSize(int sizeClass);
+
+    struct ThreadCache;
+
+private:
+    BlockPool();
+
+    std::mutex mRegistryMutex;
+    std::vector<ThreadCache*> mCaches;
+
+    std::atomic<uint64_t> mHits;
+    std::atomic<uint64_t> mMisses;
+    std::atomic<uint64_t> mOversized;
+    std::atomic<uint64_t> mCachedFrees;
+    std::atomic<uint64_t> mRemoteFrees;
+    std::atomic<uint64_t> mReleasedFrees;
+    std::atomic<size_t> mCachedBytes;
+    std::atomic<size_t> mOutstandingBytes;
+
+    ThreadCache* localCache();
+    void retireCache(ThreadCache* cache);
+    void collectRemote(ThreadCache* cache);
+    void sweepIdle(ThreadCache* cache);
+    size_t drain(ThreadCache* cache, int sizeClass);
+    static void* systemAllocate(size_t bytes);
+    static void systemFree(void* block, size_t bytes);
+
+    friend struct ThreadCacheOwner;
+};
+
+namespace PooledMatAllocator {
+    /**
+     * Make the pool OpenCV's default Mat allocator, so the temporaries inside
+     * Canny, GaussianBlur, cvtColor, ... come from the pool. The default
+     * allocator is process-wide; the pool's per-thread caches keep the
+     * processing threads from contending. Scratch OpenCV keeps outside Mats
+     * (AutoBuffer, filter ring buffers, Canny's map and stack) still goes
+     * through fastMalloc, which has no hook. No-op without OpenCV.
+     * @return true if installed (or already installed)
+     */
+    bool install();
+
+    /**
+     * Restore OpenCV's standard allocator for new Mats (pooled Mats stay valid)
+     */
+    void uninstall();
+
+    bool isInstalled();
+}
+
+#endif // EDGEDETECTOR_MAT_ALLOCATOR_H
@@ -1,9 +1,26 @@
 #include <jni.h>
 #include <android/log.h>
 #include <android/bitmap.h>
+#include <chrono>
 #include <cstring>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "opencv_processor.h"
+#include "async_processor.h"
+#include "gray_codec.h"
+#include "image_decode.h"
+#include "load_harness.h"
+#include "stream_loopback.h"
+#include "stream_sender.h"
+#include "native_memory.h"
+#include "mat_allocator.h"
+#include "output_policy.h"
+#include "conformance_harness.h"
+#include "document_rectify.h"
+#include "result_cache.h"
+#include "subpixel_edges.h"
 
 #define LOG_TAG "NativeLib"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -14,6 +31,42 @@
 // Global processor instance
 static OpenCVProcessor* g_processor = nullptr;
 
+// Per-consumer output policies for processFrameForConsumers
+static OutputSubscriptions g_subscriptions;
+
+// Asynchronous processing state
+static JavaVM* g_vm = nullptr;
+// g_asyncMutex guards all three; callers hold their own reference to the
+// processor, so releaseAsync never destroys it under a waiting poll
+static std::shared_ptr<AsyncProcessor> g_async;
+static jobject g_asyncCallback = nullptr;
+static jmethodID g_asyncCallbackMethod = nullptr;
+static std::mutex g_asyncMutex;
+
+// Pass the configured processor's settings on to the async processor, if any
+static void syncAsyncConfiguration() {
+    std::lock_guard<std::mutex> lock(g_asyncMutex);
+    if (g_async != nullptr && g_processor != nullptr) {
+        g_async->setConfiguration(*g_processor);
+    }
+}
+
+// Lossless codec for streamed GRAYSCALE frames (keeps band scratch between frames)
+static GrayCodec g_grayCodec;
+static std::mutex g_grayCodecMutex;
+
+// Document rectification (keeps the remap table while the quad is stable)
+static DocumentRectifier g_rectifier;
+static std::mutex g_rectifierMutex;
+
+// On-disk result cache (closed until openResultCache; thread-safe on its own)
+static ResultCache g_resultCache;
+
+// Network viewers of processed frames
+static StreamServer* g_streamServer = nullptr;
+static uint64_t g_streamFrameIndex = 0;
+static std::mutex g_streamMutex;
+
 // JNI method to initialize OpenCV
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_flam_edgedetector_NativeLib_initOpenCV(
@@ -139,156 +192,488 @@ Java_com_flam_edgedetector_NativeLib_processFrame(
     return metrics.processingTimeMs;
 }
 
-// JNI method to process frame from bitmap
+// JNI method to process frame into several output targets in one pass
 extern "C" JNIEXPORT jlong JNICALL
-Java_com_flam_edgedetector_NativeLib_processFrameBitmap(
+Java_com_flam_edgedetector_NativeLib_processFrameMulti(
     JNIEnv* env,
     jobject /* this */,
-    jobject inputBitmap,
+    jbyteArray inputArray,
+    jint width,
+    jint height,
     jint mode,
-    jobject outputBitmap
+    jobjectArray outputArrays,
+    jintArray outputWidths,
+    jintArray outputHeights,
+    jintArray outputFormats
 ) {
     if (g_processor == nullptr) {
         LOGE("Processor not initialized");
         return -1;
     }
     
-    if (inputBitmap == nullptr || outputBitmap == nullptr) {
-        LOGE("Input or output bitmap is null");
+    if (inputArray == nullptr || outputArrays == nullptr || outputWidths == nullptr ||
+        outputHeights == nullptr || outputFormats == nullptr) {
+        LOGE("Input or output arrays are null");
         return -1;
     }
     
-    // Get bitmap info
-    AndroidBitmapInfo inputInfo;
-    AndroidBitmapInfo outputInfo;
-    
-    if (AndroidBitmap_getInfo(env, inputBitmap, &inputInfo) < 0) {
-        LOGE("Failed to get input bitmap info");
+    jsize targetCount = env->GetArrayLength(outputArrays);
+    if (targetCount <= 0 ||
+        env->GetArrayLength(outputWidths) != targetCount ||
+        env->GetArrayLength(outputHeights) != targetCount ||
+        env->GetArrayLength(outputFormats) != targetCount) {
+        LOGE("Output description arrays have mismatched lengths");
         return -1;
     }
     
-    if (AndroidBitmap_getInfo(env, outputBitmap, &outputInfo) < 0) {
-        LOGE("Failed to get output bitmap info");
+    jsize expectedLength = width * height * 4; // RGBA format
+    if (env->GetArrayLength(inputArray) < expectedLength) {
+        LOGE("Input array too small, expected: %d", expectedLength);
         return -1;
     }
     
-    // Verify bitmap format
-    if (inputInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
-        LOGE("Input bitmap format not supported: %d", inputInfo.format);
+    std::vector<jint> widths(targetCount);
+    std::vector<jint> heights(targetCount);
+    std::vector<jint> formats(targetCount);
+    env->GetIntArrayRegion(outputWidths, 0, targetCount, widths.data());
+    env->GetIntArrayRegion(outputHeights, 0, targetCount, heights.data());
+    env->GetIntArrayRegion(outputFormats, 0, targetCount, formats.data());
+    
+    // Pin every output array and describe it as a target
+    std::vector<jbyteArray> arrays(targetCount, nullptr);
+    std::vector<jbyte*> bytes(targetCount, nullptr);
+    std::vector<OutputTarget> targets(targetCount);
+    bool valid = true;
+    
+    for (jsize i = 0; i < targetCount; i++) {
+        arrays[i] = static_cast<jbyteArray>(env->GetObjectArrayElement(outputArrays, i));
+        int bpp = MultiOutputWriter::bytesPerPixel(formats[i]);
+        if (arrays[i] == nullptr || bpp == 0 ||
+            env->GetArrayLength(arrays[i]) < widths[i] * heights[i] * bpp) {
+            LOGE("Output %d missing or too small for %dx%d format %d",
+                 i, widths[i], heights[i], formats[i]);
+            valid = false;
+            break;
+        }
+        bytes[i] = env->GetByteArrayElements(arrays[i], nullptr);
+        if (bytes[i] == nullptr) {
+            LOGE("Failed to get output %d elements", i);
+            valid = false;
+            break;
+        }
+        targets[i] = {reinterpret_cast<uint8_t*>(bytes[i]), widths[i], heights[i], formats[i], 0, nullptr, 0};
+    }
+    
+    jbyte* inputBytes = valid ? env->GetByteArrayElements(inputArray, nullptr) : nullptr;
+    
+    ProcessingMetrics metrics = {0, width, height, mode, false, false, 0};
+    if (inputBytes != nullptr) {
+        metrics = g_processor->processFrame(
+            reinterpret_cast<const uint8_t*>(inputBytes),
+            width,
+            height,
+            static_cast<ProcessingMode>(mode),
+            targets.data(),
+            targetCount
+        );
+        env->ReleaseByteArrayElements(inputArray, inputBytes, JNI_ABORT);
+    }
+    
+    // Release arrays
+    for (jsize i = 0; i < targetCount; i++) {
+        if (bytes[i] != nullptr) {
+            env->ReleaseByteArrayElements(arrays[i], bytes[i], metrics.success ? 0 : JNI_ABORT);
+        }
+        if (arrays[i] != nullptr) {
+            env->DeleteLocalRef(arrays[i]);
+        }
+    }
+    
+    if (!metrics.success) {
+        LOGE("Multi-output frame processing failed");
         return -1;
     }
     
-    if (outputInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
-        LOGE("Output bitmap format not supported: %d", outputInfo.format);
+    return metrics.processingTimeMs;
+}
+
+// JNI method to produce several modes from one frame (one output per mode entry;
+// entries with the same mode share one request)
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_flam_edgedetector_NativeLib_processFrameModes(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray inputArray,
+    jint width,
+    jint height,
+    jintArray outputModes,
+    jobjectArray outputArrays,
+    jintArray outputWidths,
+    jintArray outputHeights,
+    jintArray outputFormats
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
         return -1;
     }
     
-    // Lock bitmaps
-    void* inputPixels;
-    void* outputPixels;
+    if (inputArray == nullptr || outputModes == nullptr || outputArrays == nullptr ||
+        outputWidths == nullptr || outputHeights == nullptr || outputFormats == nullptr) {
+        LOGE("Input or output arrays are null");
+        return -1;
+    }
     
-    if (AndroidBitmap_lockPixels(env, inputBitmap, &inputPixels) < 0) {
-        LOGE("Failed to lock input bitmap");
+    jsize targetCount = env->GetArrayLength(outputArrays);
+    if (targetCount <= 0 ||
+        env->GetArrayLength(outputModes) != targetCount ||
+        env->GetArrayLength(outputWidths) != targetCount ||
+        env->GetArrayLength(outputHeights) != targetCount ||
+        env->GetArrayLength(outputFormats) != targetCount) {
+        LOGE("Output description arrays have mismatched lengths");
         return -1;
     }
     
-    if (AndroidBitmap_lockPixels(env, outputBitmap, &outputPixels) < 0) {
-        LOGE("Failed to lock output bitmap");
-        AndroidBitmap_unlockPixels(env, inputBitmap);
+    jsize expectedLength = width * height * 4; // RGBA format
+    if (env->GetArrayLength(inputArray) < expectedLength) {
+        LOGE("Input array too small, expected: %d", expectedLength);
         return -1;
     }
     
-    // Process frame
-    ProcessingMode processingMode = static_cast<ProcessingMode>(mode);
-    ProcessingMetrics metrics = g_processor->processFrame(
-        static_cast<const uint8_t*>(inputPixels),
-        inputInfo.width,
-        inputInfo.height,
-        processingMode,
-        static_cast<uint8_t*>(outputPixels)
-    );
+    std::vector<jint> modes(targetCount);
+    std::vector<jint> widths(targetCount);
+    std::vector<jint> heights(targetCount);
+    std::vector<jint> formats(targetCount);
+    env->GetIntArrayRegion(outputModes, 0, targetCount, modes.data());
+    env->GetIntArrayRegion(outputWidths, 0, targetCount, widths.data());
+    env->GetIntArrayRegion(outputHeights, 0, targetCount, heights.data());
+    env->GetIntArrayRegion(outputFormats, 0, targetCount, formats.data());
     
-    // Unlock bitmaps
-    AndroidBitmap_unlockPixels(env, inputBitmap);
-    AndroidBitmap_unlockPixels(env, outputBitmap);
+    // Group outputs by mode, keeping the first-seen order of modes
+    std::vector<jsize> order;
+    for (jsize i = 0; i < targetCount; i++) {
+        bool seen = false;
+        for (jsize j = 0; j < i && !seen; j++) {
+            seen = modes[j] == modes[i];
+        }
+        if (!seen) {
+            for (jsize j = i; j < targetCount; j++) {
+                if (modes[j] == modes[i]) {
+                    order.push_back(j);
+                }
+            }
+        }
+    }
+    
+    // Pin every output array and describe it as a target
+    std::vector<jbyteArray> arrays(targetCount, nullptr);
+    std::vector<jbyte*> bytes(targetCount, nullptr);
+    std::vector<OutputTarget> targets(targetCount);
+    bool valid = true;
+    
+    for (jsize k = 0; k < targetCount; k++) {
+        const jsize i = order[k];
+        arrays[k] = static_cast<jbyteArray>(env->GetObjectArrayElement(outputArrays, i));
+        int bpp = MultiOutputWriter::bytesPerPixel(formats[i]);
+        if (arrays[k] == nullptr || bpp == 0 ||
+            env->GetArrayLength(arrays[k]) < widths[i] * heights[i] * bpp) {
+            LOGE("Output %d missing or too small for %dx%d format %d",
+                 i, widths[i], heights[i], formats[i]);
+            valid = false;
+            break;
+        }
+        bytes[k] = env->GetByteArrayElements(arrays[k], nullptr);
+        if (bytes[k] == nullptr) {
+            LOGE("Failed to get output %d elements", i);
+            valid = false;
+            break;
+        }
+        targets[k] = {reinterpret_cast<uint8_t*>(bytes[k]), widths[i], heights[i], formats[i], 0, nullptr, 0};
+    }
+    
+    std::vector<FrameRequest> requests;
+    for (jsize k = 0; k < targetCount; k++) {
+        const int mode = modes[order[k]];
+        if (requests.empty() || requests.back().mode != mode) {
+            requests.push_back({mode, &targets[k], 0});
+        }
+        requests.back().targetCount++;
+    }
+    
+    jbyte* inputBytes = valid ? env->GetByteArrayElements(inputArray, nullptr) : nullptr;
+    
+    ProcessingMetrics metrics = {0, width, height, modes[0], false, false, 0};
+    if (inputBytes != nullptr) {
+        metrics = g_processor->processFrameRequests(
+            reinterpret_cast<const uint8_t*>(inputBytes),
+            width,
+            height,
+            requests.data(),
+            static_cast<int>(requests.size())
+        );
+        env->ReleaseByteArrayElements(inputArray, inputBytes, JNI_ABORT);
+    }
+    
+    // Release arrays
+    for (jsize k = 0; k < targetCount; k++) {
+        if (bytes[k] != nullptr) {
+            env->ReleaseByteArrayElements(arrays[k], bytes[k], metrics.success ? 0 : JNI_ABORT);
+        }
+        if (arrays[k] != nullptr) {
+            env->DeleteLocalRef(arrays[k]);
+        }
+    }
     
     if (!metrics.success) {
-        LOGE("Bitmap processing failed");
+        LOGE("Multi-mode frame processing failed");
         return -1;
     }
     
     return metrics.processingTimeMs;
 }
 
-// JNI method to set Canny thresholds
-extern "C" JNIEXPORT void JNICALL
-Java_com_flam_edgedetector_NativeLib_setCannyThresholds(
+// JNI method to report which derived images the last processFrameModes computed or reused
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getDerivedImageReport(
     JNIEnv* env,
-    jobject /* this */,
-    jdouble lowThreshold,
-    jdouble highThreshold
+    jobject /* this */
 ) {
-    if (g_processor != nullptr) {
-        g_processor->setCannyThresholds(lowThreshold, highThreshold);
-        LOGI("Canny thresholds set: low=%.1f, high=%.1f", lowThreshold, highThreshold);
-    } else {
-        LOGE("Processor not initialized");
+    if (g_processor == nullptr) {
+        return env->NewStringUTF("Processor not initialized");
     }
+    
+    std::string report = g_processor->getDerivedImages().report().toString();
+    return env->NewStringUTF(report.c_str());
 }
 
-// JNI method to get statistics
-extern "C" JNIEXPORT jstring JNICALL
-Java_com_flam_edgedetector_NativeLib_getStatistics(
+// JNI method to subscribe a consumer to processed frames
+extern "C" JNIEXPORT jint JNICALL
+Java_com_flam_edgedetector_NativeLib_addOutputConsumer(
     JNIEnv* env,
-    jobject /* this */
+    jobject /* this */,
+    jdouble targetFps,
+    jint maxWidth,
+    jint maxHeight,
+    jint format
+) {
+    return g_subscriptions.addConsumer({targetFps, maxWidth, maxHeight, format});
+}
+
+// JNI method to change a consumer's frame rate, size or format
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_updateOutputConsumer(
+    JNIEnv* env,
+    jobject /* this */,
+    jint consumerId,
+    jdouble targetFps,
+    jint maxWidth,
+    jint maxHeight,
+    jint format
+) {
+    return g_subscriptions.updateConsumer(consumerId, {targetFps, maxWidth, maxHeight, format})
+        ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to unsubscribe a consumer
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_removeOutputConsumer(
+    JNIEnv* env,
+    jobject /* this */,
+    jint consumerId
+) {
+    return g_subscriptions.removeConsumer(consumerId) ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to process a frame for the consumers due at this timestamp
+// Returns the number of consumers served (0 = frame skipped unprocessed), -1 on failure
+extern "C" JNIEXPORT jint JNICALL
+Java_com_flam_edgedetector_NativeLib_processFrameForConsumers(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray inputArray,
+    jint width,
+    jint height,
+    jint mode,
+    jlong timestampNs
 ) {
     if (g_processor == nullptr) {
-        return env->NewStringUTF("Processor not initialized");
+        LOGE("Processor not initialized");
+        return -1;
     }
     
-    std::string stats = g_processor->getStatistics();
-    return env->NewStringUTF(stats.c_str());
+    jsize expectedLength = width * height * 4; // RGBA format
+    if (inputArray == nullptr || env->GetArrayLength(inputArray) < expectedLength) {
+        LOGE("Input array missing or too small, expected: %d", expectedLength);
+        return -1;
+    }
+    
+    // Only consumers due for this frame get targets; nobody due means no work at all
+    std::vector<OutputTarget> targets;
+    int count = g_subscriptions.prepare(timestampNs / 1000, width, height, targets);
+    if (count == 0) {
+        g_subscriptions.commit(false);
+        return 0;
+    }
+    
+    jbyte* inputBytes = env->GetByteArrayElements(inputArray, nullptr);
+    ProcessingMetrics metrics = {0, width, height, mode, false, false, 0};
+    if (inputBytes != nullptr) {
+        metrics = g_processor->processFrame(
+            reinterpret_cast<const uint8_t*>(inputBytes),
+            width,
+            height,
+            static_cast<ProcessingMode>(mode),
+            targets.data(),
+            count
+        );
+        env->ReleaseByteArrayElements(inputArray, inputBytes, JNI_ABORT);
+    }
+    g_subscriptions.commit(metrics.success);
+    
+    if (!metrics.success) {
+        LOGE("Consumer frame processing failed");
+        return -1;
+    }
+    
+    return count;
 }
 
-// JNI method to release OpenCV
-extern "C" JNIEXPORT void JNICALL
-Java_com_flam_edgedetector_NativeLib_releaseOpenCV(
+// JNI method to copy a consumer's latest frame
+// outInfo receives [sequence, width, height, format, size]; sequence 0 means nothing delivered yet
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_readConsumerFrame(
     JNIEnv* env,
-    jobject /* this */
+    jobject /* this */,
+    jint consumerId,
+    jbyteArray outputArray,
+    jintArray outInfo
 ) {
-    LOGI("Releasing OpenCV native library");
+    jbyte* output = outputArray != nullptr ? env->GetByteArrayElements(outputArray, nullptr) : nullptr;
+    size_t capacity = output != nullptr ? static_cast<size_t>(env->GetArrayLength(outputArray)) : 0;
     
-    if (g_processor != nullptr) {
-        g_processor->release();
-        delete g_processor;
-        g_processor = nullptr;
-        LOGI("Processor released");
+    ConsumerFrameInfo info = {};
+    bool success = g_subscriptions.readLatest(consumerId, reinterpret_cast<uint8_t*>(output), capacity, info);
+    if (output != nullptr) {
+        env->ReleaseByteArrayElements(outputArray, output, success && info.sequence > 0 ? 0 : JNI_ABORT);
+    }
+    
+    if (success && outInfo != nullptr && env->GetArrayLength(outInfo) >= 5) {
+        jint values[5] = {
+            static_cast<jint>(info.sequence),
+            info.width,
+            info.height,
+            info.format,
+            static_cast<jint>(info.size)
+        };
+        env->SetIntArrayRegion(outInfo, 0, 5, values);
     }
+    
+    return success ? JNI_TRUE : JNI_FALSE;
 }
 
-// JNI_OnLoad - called when native library is loaded
-JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
-    LOGI("Native library loaded");
-    return JNI_VERSION_1_6;
+// JNI method to get per-consumer delivery statistics
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getConsumerStatistics(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    return env->NewStringUTF(g_subscriptions.getStatistics().c_str());
 }
 
-// JNI_OnUnload - called when native library is unloaded
-JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved) {
-    LOGI("Native library unloaded");
+// Describe a direct codec input ByteBuffer as an NV12 output target
+static bool describeNv12Buffer(
+    JNIEnv* env,
+    jobject codecBuffer,
+    jint width,
+    jint height,
+    jint yStride,
+    jint uvOffset,
+    jint uvStride,
+    OutputTarget* target
+) {
+    if (codecBuffer == nullptr) {
+        LOGE("Codec buffer is null");
+        return false;
+    }
     
-    // Clean up global processor if it still exists
-    if (g_processor != nullptr) {
-        g_processor->release();
-        delete g_processor;
-        g_processor = nullptr;
+    uint8_t* base = static_cast<uint8_t*>(env->GetDirectBufferAddress(codecBuffer));
+    jlong capacity = env->GetDirectBufferCapacity(codecBuffer);
+    if (base == nullptr || capacity <= 0) {
+        LOGE("Codec buffer is not a direct buffer");
+        return false;
+    }
+    
+    int rowStride = yStride != 0 ? yStride : width;
+    int chromaStride = uvStride != 0 ? uvStride : width;
+    jlong yEnd = static_cast<jlong>(rowStride) * (height - 1) + width;
+    jlong uvEnd = static_cast<jlong>(uvOffset) + static_cast<jlong>(chromaStride) * (height / 2 - 1) + width;
+    if (uvOffset < yEnd || uvEnd > capacity) {
+        LOGE("Codec buffer layout does not fit: capacity %lld, uvOffset %d",
+             static_cast<long long>(capacity), uvOffset);
+        return false;
     }
+    
+    *target = {base, width, height, OUTPUT_FORMAT_NV12, rowStride, base + uvOffset, chromaStride};
+    return true;
 }
 
-// Utility function to convert YUV to RGBA (for camera preview)
-extern "C" JNIEXPORT void JNICALL
-Java_com_flam_edgedetector_NativeLib_yuv420ToRgba(
+// JNI method to process RGBA frame into an NV12 codec input buffer
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_flam_edgedetector_NativeLib_processFrameToNv12(
     JNIEnv* env,
     jobject /* this */,
+    jbyteArray inputArray,
+    jint width,
+    jint height,
+    jint mode,
+    jobject codecBuffer,
+    jint yStride,
+    jint uvOffset,
+    jint uvStride
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return -1;
+    }
+    
+    if (inputArray == nullptr || env->GetArrayLength(inputArray) < width * height * 4) {
+        LOGE("Input array missing or too small");
+        return -1;
+    }
+    
+    OutputTarget target;
+    if (!describeNv12Buffer(env, codecBuffer, width, height, yStride, uvOffset, uvStride, &target)) {
+        return -1;
+    }
+    
+    jbyte* inputBytes = env->GetByteArrayElements(inputArray, nullptr);
+    if (inputBytes == nullptr) {
+        LOGE("Failed to get byte array elements");
+        return -1;
+    }
+    
+    ProcessingMetrics metrics = g_processor->processFrame(
+        reinterpret_cast<const uint8_t*>(inputBytes),
+        width,
+        height,
+        static_cast<ProcessingMode>(mode),
+        &target,
+        1
+    );
+    
+    env->ReleaseByteArrayElements(inputArray, inputBytes, JNI_ABORT);
+    
+    if (!metrics.success) {
+        LOGE("NV12 frame processing failed");
+        return -1;
+    }
+    
+    return metrics.processingTimeMs;
+}
+
+// Check that camera YUV planes hold every byte the YUV420 readers touch
+// (rows end at the last pixel, as in ImageProxy plane buffers)
+static bool yuvPlanesFit(
+    JNIEnv* env,
     jbyteArray yPlane,
     jbyteArray uPlane,
     jbyteArray vPlane,
@@ -296,60 +681,1618 @@ Java_com_flam_edgedetector_NativeLib_yuv420ToRgba(
     jint height,
     jint yRowStride,
     jint uvRowStride,
-    jint uvPixelStride,
-    jbyteArray outputArray
+    jint uvPixelStride
 ) {
-    // Get array elements
-    jbyte* yData = env->GetByteArrayElements(yPlane, nullptr);
-    jbyte* uData = env->GetByteArrayElements(uPlane, nullptr);
-    jbyte* vData = env->GetByteArrayElements(vPlane, nullptr);
-    jbyte* outData = env->GetByteArrayElements(outputArray, nullptr);
+    if (yPlane == nullptr || uPlane == nullptr || vPlane == nullptr) {
+        LOGE("YUV plane is null");
+        return false;
+    }
     
-    if (yData == nullptr || uData == nullptr || vData == nullptr || outData == nullptr) {
-        LOGE("Failed to get YUV array elements");
-        if (yData) env->ReleaseByteArrayElements(yPlane, yData, JNI_ABORT);
-        if (uData) env->ReleaseByteArrayElements(uPlane, uData, JNI_ABORT);
-        if (vData) env->ReleaseByteArrayElements(vPlane, vData, JNI_ABORT);
-        if (outData) env->ReleaseByteArrayElements(outputArray, outData, JNI_ABORT);
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    if (width <= 0 || height <= 0 || yRowStride < width || uvPixelStride <= 0 ||
+        uvRowStride < (chromaWidth - 1) * uvPixelStride + 1) {
+        LOGE("Invalid YUV layout: %dx%d, strides %d/%d/%d",
+             width, height, yRowStride, uvRowStride, uvPixelStride);
+        return false;
+    }
+    
+    jlong yNeeded = static_cast<jlong>(yRowStride) * (height - 1) + width;
+    jlong uvNeeded = static_cast<jlong>(uvRowStride) * (chromaHeight - 1) +
+        static_cast<jlong>(chromaWidth - 1) * uvPixelStride + 1;
+    jsize yLength = env->GetArrayLength(yPlane);
+    jsize uLength = env->GetArrayLength(uPlane);
+    jsize vLength = env->GetArrayLength(vPlane);
+    if (yLength < yNeeded || uLength < uvNeeded || vLength < uvNeeded) {
+        LOGE("YUV planes too small: %d/%d/%d bytes, expected %lld/%lld/%lld",
+             yLength, uLength, vLength, static_cast<long long>(yNeeded),
+             static_cast<long long>(uvNeeded), static_cast<long long>(uvNeeded));
+        return false;
+    }
+    return true;
+}
+
+// JNI method to process camera YUV planes into an NV12 codec input buffer
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_flam_edgedetector_NativeLib_processYuvToNv12(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray yPlane,
+    jbyteArray uPlane,
+    jbyteArray vPlane,
+    jint width,
+    jint height,
+    jint yRowStride,
+    jint uvRowStride,
+    jint uvPixelStride,
+    jint mode,
+    jobject codecBuffer,
+    jint yStride,
+    jint uvOffset,
+    jint uvStride
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return -1;
+    }
+    
+    if (!yuvPlanesFit(env, yPlane, uPlane, vPlane, width, height, yRowStride, uvRowStride, uvPixelStride)) {
+        return -1;
+    }
+    
+    OutputTarget target;
+    if (!describeNv12Buffer(env, codecBuffer, width, height, yStride, uvOffset, uvStride, &target)) {
+        return -1;
+    }
+    
+    // Get array elements
+    jbyte* yData = env->GetByteArrayElements(yPlane, nullptr);
+    jbyte* uData = env->GetByteArrayElements(uPlane, nullptr);
+    jbyte* vData = env->GetByteArrayElements(vPlane, nullptr);
+    
+    ProcessingMetrics metrics = {0, width, height, mode, false, false, 0};
+    if (yData != nullptr && uData != nullptr && vData != nullptr) {
+        YuvPlanes planes = {
+            reinterpret_cast<const uint8_t*>(yData),
+            reinterpret_cast<const uint8_t*>(uData),
+            reinterpret_cast<const uint8_t*>(vData),
+            yRowStride,
+            uvRowStride,
+            uvPixelStride
+        };
+        metrics = g_processor->processFrameYuv(
+            planes, width, height, static_cast<ProcessingMode>(mode), &target, 1);
+    } else {
+        LOGE("Failed to get YUV array elements");
+    }
+    
+    if (yData) env->ReleaseByteArrayElements(yPlane, yData, JNI_ABORT);
+    if (uData) env->ReleaseByteArrayElements(uPlane, uData, JNI_ABORT);
+    if (vData) env->ReleaseByteArrayElements(vPlane, vData, JNI_ABORT);
+    
+    if (!metrics.success) {
+        LOGE("YUV to NV12 processing failed");
+        return -1;
+    }
+    
+    return metrics.processingTimeMs;
+}
+
+// JNI method to process frame from bitmap
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_flam_edgedetector_NativeLib_processFrameBitmap(
+    JNIEnv* env,
+    jobject /* this */,
+    jobject inputBitmap,
+    jint mode,
+    jobject outputBitmap
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return -1;
+    }
+    
+    if (inputBitmap == nullptr || outputBitmap == nullptr) {
+        LOGE("Input or output bitmap is null");
+        return -1;
+    }
+    
+    // Get bitmap info
+    AndroidBitmapInfo inputInfo;
+    AndroidBitmapInfo outputInfo;
+    
+    if (AndroidBitmap_getInfo(env, inputBitmap, &inputInfo) < 0) {
+        LOGE("Failed to get input bitmap info");
+        return -1;
+    }
+    
+    if (AndroidBitmap_getInfo(env, outputBitmap, &outputInfo) < 0) {
+        LOGE("Failed to get output bitmap info");
+        return -1;
+    }
+    
+    // Verify bitmap format
+    if (inputInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Input bitmap format not supported: %d", inputInfo.format);
+        return -1;
+    }
+    
+    if (outputInfo.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        LOGE("Output bitmap format not supported: %d", outputInfo.format);
+        return -1;
+    }
+    
+    // Lock bitmaps
+    void* inputPixels;
+    void* outputPixels;
+    
+    if (AndroidBitmap_lockPixels(env, inputBitmap, &inputPixels) < 0) {
+        LOGE("Failed to lock input bitmap");
+        return -1;
+    }
+    
+    if (AndroidBitmap_lockPixels(env, outputBitmap, &outputPixels) < 0) {
+        LOGE("Failed to lock output bitmap");
+        AndroidBitmap_unlockPixels(env, inputBitmap);
+        return -1;
+    }
+    
+    // Process frame
+    ProcessingMode processingMode = static_cast<ProcessingMode>(mode);
+    ProcessingMetrics metrics = g_processor->processFrame(
+        static_cast<const uint8_t*>(inputPixels),
+        inputInfo.width,
+        inputInfo.height,
+        processingMode,
+        static_cast<uint8_t*>(outputPixels)
+    );
+    
+    // Unlock bitmaps
+    AndroidBitmap_unlockPixels(env, inputBitmap);
+    AndroidBitmap_unlockPixels(env, outputBitmap);
+    
+    if (!metrics.success) {
+        LOGE("Bitmap processing failed");
+        return -1;
+    }
+    
+    return metrics.processingTimeMs;
+}
+
+// JNI method to set Canny thresholds
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setCannyThresholds(
+    JNIEnv* env,
+    jobject /* this */,
+    jdouble lowThreshold,
+    jdouble highThreshold
+) {
+    if (g_processor != nullptr) {
+        g_processor->setCannyThresholds(lowThreshold, highThreshold);
+        syncAsyncConfiguration();
+        LOGI("Canny thresholds set: low=%.1f, high=%.1f", lowThreshold, highThreshold);
+    } else {
+        LOGE("Processor not initialized");
+    }
+}
+
+// JNI method to vary Canny thresholds per tile from local gradient statistics
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setAdaptiveThresholds(
+    JNIEnv* env,
+    jobject /* this */,
+    jboolean enabled,
+    jint tileSize
+) {
+    if (g_processor != nullptr) {
+        g_processor->setAdaptiveThresholds(enabled == JNI_TRUE, tileSize);
+        syncAsyncConfiguration();
+    } else {
+        LOGE("Processor not initialized");
+    }
+}
+
+// JNI method to get adaptive threshold tile counts and scale range
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getAdaptiveThresholdStatistics(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    if (g_processor == nullptr) {
+        return env->NewStringUTF("Processor not initialized");
+    }
+    return env->NewStringUTF(g_processor->getAdaptiveThresholds().getStatistics().c_str());
+}
+
+// JNI method to enable sub-pixel edge localization
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setSubpixelEdgesEnabled(
+    JNIEnv* env,
+    jobject /* this */,
+    jboolean enabled
+) {
+    if (g_processor != nullptr) {
+        g_processor->setSubpixelEdgesEnabled(enabled == JNI_TRUE);
+    } else {
+        LOGE("Processor not initialized");
+    }
+}
+
+// JNI method to get sub-pixel edges as packed (x, y) floats
+extern "C" JNIEXPORT jfloatArray JNICALL
+Java_com_flam_edgedetector_NativeLib_getSubpixelEdges(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return env->NewFloatArray(0);
+    }
+    
+    std::vector<float> points;
+    g_processor->getSubpixelEdges(points);
+    jsize count = static_cast<jsize>(points.size());
+    jfloatArray result = env->NewFloatArray(count);
+    if (result != nullptr && count > 0) {
+        env->SetFloatArrayRegion(result, 0, count, points.data());
+    }
+    return result;
+}
+
+// JNI method to get sub-pixel edges as packed (x, y) fixed point (SUBPIXEL_FIXED_SHIFT bits)
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_flam_edgedetector_NativeLib_getSubpixelEdgesFixed(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return env->NewIntArray(0);
+    }
+    
+    std::vector<float> points;
+    g_processor->getSubpixelEdges(points);
+    std::vector<int32_t> fixed;
+    SubpixelEdges::toFixed(points, fixed);
+    jsize count = static_cast<jsize>(fixed.size());
+    jintArray result = env->NewIntArray(count);
+    if (result != nullptr && count > 0) {
+        env->SetIntArrayRegion(result, 0, count, fixed.data());
+    }
+    return result;
+}
+
+// JNI method to enable the perceptual edge hash side output
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setEdgeHashEnabled(
+    JNIEnv* env,
+    jobject /* this */,
+    jboolean enabled
+) {
+    if (g_processor != nullptr) {
+        g_processor->setEdgeHashEnabled(enabled == JNI_TRUE);
+    } else {
+        LOGE("Processor not initialized");
+    }
+}
+
+// JNI method to get the edge hash of the last frame as EDGE_HASH_WORDS longs (null if none)
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_flam_edgedetector_NativeLib_getEdgeHash(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    EdgeHash hash;
+    if (g_processor == nullptr || !g_processor->getEdgeHash(hash)) {
+        return nullptr;
+    }
+    
+    jlongArray result = env->NewLongArray(EDGE_HASH_WORDS);
+    if (result != nullptr) {
+        jlong words[EDGE_HASH_WORDS];
+        for (int i = 0; i < EDGE_HASH_WORDS; i++) {
+            words[i] = static_cast<jlong>(hash.words[i]);
+        }
+        env->SetLongArrayRegion(result, 0, EDGE_HASH_WORDS, words);
+    }
+    return result;
+}
+
+// JNI method to configure edge fragment removal (0 disables a threshold)
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setFragmentFilter(
+    JNIEnv* env,
+    jobject /* this */,
+    jint minPixels,
+    jint minExtent
+) {
+    if (g_processor != nullptr) {
+        g_processor->setFragmentFilter(minPixels, minExtent);
+        syncAsyncConfiguration();
+    }
+}
+
+// JNI method to get kept edge components as packed (minX, minY, maxX, maxY, pixels)
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_flam_edgedetector_NativeLib_getEdgeComponents(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return env->NewIntArray(0);
+    }
+    
+    std::vector<jint> packed;
+    for (const EdgeComponent& component : g_processor->getEdgeComponents()) {
+        if (component.kept) {
+            packed.insert(packed.end(), {component.minX, component.minY, component.maxX, component.maxY,
+                                         static_cast<jint>(component.pixels)});
+        }
+    }
+    jsize count = static_cast<jsize>(packed.size());
+    jintArray result = env->NewIntArray(count);
+    if (result != nullptr && count > 0) {
+        env->SetIntArrayRegion(result, 0, count, packed.data());
+    }
+    return result;
+}
+
+// JNI method to configure DISTANCE mode (metric: 0 Euclidean, 1 city-block)
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setDistanceOptions(
+    JNIEnv* env,
+    jobject /* this */,
+    jint metric,
+    jboolean trackNearest
+) {
+    if (g_processor != nullptr) {
+        g_processor->setDistanceOptions(metric, trackNearest == JNI_TRUE);
+        syncAsyncConfiguration();
+    }
+}
+
+// JNI method to set the pre-Canny blur sigma
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setBlurSigma(
+    JNIEnv* env,
+    jobject /* this */,
+    jfloat sigma
+) {
+    if (g_processor != nullptr) {
+        g_processor->setBlurSigma(sigma);
+        syncAsyncConfiguration();
+    }
+}
+
+// JNI method to set lens calibration as {fx, fy, cx, cy, k1, k2, p1, p2, k3}
+// measured at calibrationWidth x calibrationHeight (null disables undistortion)
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_setLensCalibration(
+    JNIEnv* env,
+    jobject /* this */,
+    jdoubleArray parameters,
+    jint calibrationWidth,
+    jint calibrationHeight
+) {
+    if (g_processor == nullptr) {
+        return JNI_FALSE;
+    }
+    if (parameters == nullptr) {
+        return g_processor->setLensCalibration(nullptr) ? JNI_TRUE : JNI_FALSE;
+    }
+    if (env->GetArrayLength(parameters) < 9) {
+        LOGE("Lens calibration needs 9 parameters");
+        return JNI_FALSE;
+    }
+    
+    jdouble values[9];
+    env->GetDoubleArrayRegion(parameters, 0, 9, values);
+    LensCalibration calibration = {
+        calibrationWidth, calibrationHeight,
+        values[0], values[1], values[2], values[3],
+        values[4], values[5], values[6], values[7], values[8]
+    };
+    return g_processor->setLensCalibration(&calibration) ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to copy the last distance field as u16 (distance * scale, clamped)
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_getDistanceFieldU16(
+    JNIEnv* env,
+    jobject /* this */,
+    jshortArray outputArray,
+    jfloat scale
+) {
+    if (g_processor == nullptr || outputArray == nullptr) {
+        LOGE("Processor not initialized or output is null");
+        return JNI_FALSE;
+    }
+    
+    const DistanceTransform& field = g_processor->getDistanceField();
+    jsize pixels = field.width() * field.height();
+    if (pixels == 0 || env->GetArrayLength(outputArray) < pixels) {
+        LOGE("No distance field or output too small (%d pixels)", pixels);
+        return JNI_FALSE;
+    }
+    
+    std::vector<uint16_t> distances(pixels);
+    field.toU16(distances.data(), scale);
+    env->SetShortArrayRegion(outputArray, 0, pixels, reinterpret_cast<const jshort*>(distances.data()));
+    return JNI_TRUE;
+}
+
+// JNI method to copy nearest-edge indices (y * width + x, -1 without edges) of the last distance field
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_getNearestEdges(
+    JNIEnv* env,
+    jobject /* this */,
+    jintArray outputArray
+) {
+    if (g_processor == nullptr || outputArray == nullptr) {
+        LOGE("Processor not initialized or output is null");
+        return JNI_FALSE;
+    }
+    
+    const DistanceTransform& field = g_processor->getDistanceField();
+    jsize pixels = field.width() * field.height();
+    if (field.nearest() == nullptr || env->GetArrayLength(outputArray) < pixels) {
+        LOGE("Nearest edges not tracked or output too small");
+        return JNI_FALSE;
+    }
+    
+    env->SetIntArrayRegion(outputArray, 0, pixels, field.nearest());
+    return JNI_TRUE;
+}
+
+// JNI method to get statistics
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getStatistics(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    if (g_processor == nullptr) {
+        return env->NewStringUTF("Processor not initialized");
+    }
+    
+    std::string stats = g_processor->getStatistics();
+    return env->NewStringUTF(stats.c_str());
+}
+
+// JNI method to run a sustained-load test on synthetic frames (blocks the caller)
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_runLoadTest(
+    JNIEnv* env,
+    jobject /* this */,
+    jint width,
+    jint height,
+    jint mode,
+    jint pattern,
+    jint format,
+    jfloat edgeDensity,
+    jint pipelineCount,
+    jdouble targetFps,
+    jint durationSeconds
+) {
+    LoadTestConfig config = {};
+    config.source = {width, height, pattern, format, edgeDensity, 0x5EED1234u};
+    config.mode = mode;
+    config.pipelineCount = pipelineCount;
+    config.targetFps = targetFps;
+    config.durationSeconds = durationSeconds;
+    config.preGeneratedFrames = 60;
+    
+    LoadHarness harness(config);
+    LoadTestReport report = harness.run();
+    return env->NewStringUTF(report.toString().c_str());
+}
+
+// Read a Java string into std::string (empty for null)
+static std::string toStdString(JNIEnv* env, jstring value) {
+    if (value == nullptr) {
+        return std::string();
+    }
+    const char* chars = env->GetStringUTFChars(value, nullptr);
+    if (chars == nullptr) {
+        return std::string();
+    }
+    std::string result(chars);
+    env->ReleaseStringUTFChars(value, chars);
+    return result;
+}
+
+// JNI method to run conformance checks and optionally record a timing baseline
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_runConformance(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring recordedDir,
+    jstring baselinePath,
+    jint timingIterations
+) {
+    ConformanceConfig config = {320, 240, toStdString(env, recordedDir), timingIterations, 3};
+    ConformanceHarness harness(config);
+    harness.buildCorpus();
+    
+    std::string report = ConformanceHarness::formatResults(harness.runConformance());
+    
+    std::string path = toStdString(env, baselinePath);
+    if (!path.empty()) {
+        PerfBaseline baseline = harness.runTiming();
+        report += baseline.save(path) ? "\nBaseline written to " + path : "\nFailed to write baseline";
+    }
+    
+    return env->NewStringUTF(report.c_str());
+}
+
+// JNI method to compare two timing baselines for significant regressions
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_compareBaselines(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring baselinePath,
+    jstring currentPath,
+    jdouble alpha,
+    jdouble minRelativeChange
+) {
+    PerfBaseline baseline;
+    PerfBaseline current;
+    if (!baseline.load(toStdString(env, baselinePath)) || !current.load(toStdString(env, currentPath))) {
+        return env->NewStringUTF("Failed to read baseline files");
+    }
+    
+    std::vector<Regression> regressions = PerfBaseline::compare(baseline, current, alpha, minRelativeChange);
+    return env->NewStringUTF(PerfBaseline::formatRegressions(regressions).c_str());
+}
+
+// JNI method to set the process-wide native memory budget in bytes (0 = unlimited)
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setMemoryBudget(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong budgetBytes
+) {
+    MemoryBudget::instance().setBudget(budgetBytes > 0 ? static_cast<size_t>(budgetBytes) : 0);
+}
+
+// JNI method forwarding ComponentCallbacks2.onTrimMemory
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_flam_edgedetector_NativeLib_trimMemory(
+    JNIEnv* env,
+    jobject /* this */,
+    jint level
+) {
+    return static_cast<jlong>(MemoryBudget::instance().trimMemory(level));
+}
+
+// JNI method to get native memory usage as {current, peak, budget, pressure}
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_flam_edgedetector_NativeLib_getMemoryUsage(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    MemoryBudget& budget = MemoryBudget::instance();
+    jlong values[4] = {
+        static_cast<jlong>(budget.currentUsage()),
+        static_cast<jlong>(budget.peakUsage()),
+        static_cast<jlong>(budget.budget()),
+        static_cast<jlong>(budget.pressure())
+    };
+    
+    jlongArray result = env->NewLongArray(4);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 4, values);
+    }
+    return result;
+}
+
+// JNI method to enable or disable the pooled Mat allocator
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_setMatPoolEnabled(
+    JNIEnv* env,
+    jobject /* this */,
+    jboolean enabled
+) {
+    if (!enabled) {
+        PooledMatAllocator::uninstall();
+        BlockPool::instance().releaseCached();
+        return JNI_TRUE;
+    }
+    return PooledMatAllocator::install() ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to get Mat pool hit/miss counters
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getMatPoolStatistics(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    std::string stats = BlockPool::instance().getStatistics();
+    return env->NewStringUTF(stats.c_str());
+}
+
+// Copy a decoded image out to Java: RGBA bytes, with {width, height, reduction,
+// decodeMs, processMs} written to outInfo when it has room
+static jbyteArray decodedImageToJava(JNIEnv* env, const DecodedImage& image, jintArray outInfo) {
+    if (outInfo != nullptr && env->GetArrayLength(outInfo) >= 5) {
+        jint info[5] = {
+            image.width,
+            image.height,
+            image.reduction,
+            static_cast<jint>(image.decodeTimeMs),
+            static_cast<jint>(image.metrics.processingTimeMs)
+        };
+        env->SetIntArrayRegion(outInfo, 0, 5, info);
+    }
+    
+    jsize length = static_cast<jsize>(image.rgba.size());
+    jbyteArray result = env->NewByteArray(length);
+    if (result != nullptr) {
+        env->SetByteArrayRegion(result, 0, length, reinterpret_cast<const jbyte*>(image.rgba.data()));
+    }
+    return result;
+}
+
+// JNI method to decode an image file at reduced scale and process it
+// Returns RGBA bytes whose longer side is at most maxSize, or null on failure
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_flam_edgedetector_NativeLib_processImageFile(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring path,
+    jint mode,
+    jint maxSize,
+    jintArray outInfo
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return nullptr;
+    }
+    
+    DecodedImage image = {};
+    if (!ImageDecode::processImageFile(*g_processor, toStdString(env, path),
+                                       static_cast<ProcessingMode>(mode), maxSize, image,
+                                       &g_resultCache)) {
+        return nullptr;
+    }
+    return decodedImageToJava(env, image, outInfo);
+}
+
+// JNI method to decode an encoded image held in a byte array and process it
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_flam_edgedetector_NativeLib_processEncodedBuffer(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray encodedArray,
+    jint mode,
+    jint maxSize,
+    jintArray outInfo
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return nullptr;
+    }
+    
+    if (encodedArray == nullptr) {
+        LOGE("Encoded array is null");
+        return nullptr;
+    }
+    
+    jsize length = env->GetArrayLength(encodedArray);
+    jbyte* encoded = env->GetByteArrayElements(encodedArray, nullptr);
+    if (encoded == nullptr) {
+        LOGE("Failed to get encoded array elements");
+        return nullptr;
+    }
+    
+    DecodedImage image = {};
+    bool success = ImageDecode::processEncodedBuffer(
+        *g_processor, reinterpret_cast<const uint8_t*>(encoded), static_cast<size_t>(length),
+        static_cast<ProcessingMode>(mode), maxSize, image, &g_resultCache);
+    env->ReleaseByteArrayElements(encodedArray, encoded, JNI_ABORT);
+    
+    return success ? decodedImageToJava(env, image, outInfo) : nullptr;
+}
+
+// JNI method to process several image files; returns one RGBA array per path
+// (null for failures) and writes {width, height, cached} per path to outInfo
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_flam_edgedetector_NativeLib_processImageBatch(
+    JNIEnv* env,
+    jobject /* this */,
+    jobjectArray pathArray,
+    jint mode,
+    jint maxSize,
+    jintArray outInfo
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return nullptr;
+    }
+    
+    if (pathArray == nullptr) {
+        LOGE("Path array is null");
+        return nullptr;
+    }
+    
+    jsize count = env->GetArrayLength(pathArray);
+    std::vector<std::string> paths(static_cast<size_t>(count));
+    for (jsize i = 0; i < count; i++) {
+        jstring path = static_cast<jstring>(env->GetObjectArrayElement(pathArray, i));
+        paths[i] = toStdString(env, path);
+        env->DeleteLocalRef(path);
+    }
+    
+    std::vector<DecodedImage> images;
+    ImageDecode::processImageBatch(*g_processor, paths, static_cast<ProcessingMode>(mode), maxSize,
+                                   images, &g_resultCache);
+    
+    jclass byteArrayClass = env->FindClass("[B");
+    jobjectArray result = env->NewObjectArray(count, byteArrayClass, nullptr);
+    if (result == nullptr) {
+        return nullptr;
+    }
+    bool writeInfo = outInfo != nullptr && env->GetArrayLength(outInfo) >= count * 3;
+    for (jsize i = 0; i < count; i++) {
+        const DecodedImage& image = images[i];
+        if (writeInfo) {
+            jint info[3] = {image.width, image.height, image.cached ? 1 : 0};
+            env->SetIntArrayRegion(outInfo, i * 3, 3, info);
+        }
+        if (image.rgba.empty()) {
+            continue;
+        }
+        jbyteArray pixels = decodedImageToJava(env, image, nullptr);
+        env->SetObjectArrayElement(result, i, pixels);
+        env->DeleteLocalRef(pixels);
+    }
+    return result;
+}
+
+// JNI method to hash image files without processing them; returns EDGE_HASH_WORDS
+// longs per path and writes 1 (hashed) or 0 (failed) per path to outValid
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_flam_edgedetector_NativeLib_hashImageFiles(
+    JNIEnv* env,
+    jobject /* this */,
+    jobjectArray pathArray,
+    jintArray outValid
+) {
+    if (pathArray == nullptr) {
+        LOGE("Path array is null");
+        return nullptr;
+    }
+    
+    jsize count = env->GetArrayLength(pathArray);
+    std::vector<std::string> paths(static_cast<size_t>(count));
+    for (jsize i = 0; i < count; i++) {
+        jstring path = static_cast<jstring>(env->GetObjectArrayElement(pathArray, i));
+        paths[i] = toStdString(env, path);
+        env->DeleteLocalRef(path);
+    }
+    
+    std::vector<EdgeHash> hashes;
+    std::vector<bool> valid;
+    ImageDecode::hashImageFiles(paths, hashes, valid);
+    
+    std::vector<jlong> words(static_cast<size_t>(count) * EDGE_HASH_WORDS);
+    std::vector<jint> flags(static_cast<size_t>(count));
+    for (jsize i = 0; i < count; i++) {
+        for (int w = 0; w < EDGE_HASH_WORDS; w++) {
+            words[static_cast<size_t>(i) * EDGE_HASH_WORDS + w] = static_cast<jlong>(hashes[i].words[w]);
+        }
+        flags[i] = valid[i] ? 1 : 0;
+    }
+    if (outValid != nullptr && env->GetArrayLength(outValid) >= count) {
+        env->SetIntArrayRegion(outValid, 0, count, flags.data());
+    }
+    
+    jsize length = static_cast<jsize>(words.size());
+    jlongArray result = env->NewLongArray(length);
+    if (result != nullptr && length > 0) {
+        env->SetLongArrayRegion(result, 0, length, words.data());
+    }
+    return result;
+}
+
+// JNI method to cluster edge hashes (EDGE_HASH_WORDS longs each) by Hamming distance;
+// returns per hash the index of the first hash of its cluster
+extern "C" JNIEXPORT jintArray JNICALL
+Java_com_flam_edgedetector_NativeLib_clusterEdgeHashes(
+    JNIEnv* env,
+    jobject /* this */,
+    jlongArray hashArray,
+    jint maxDistance
+) {
+    if (hashArray == nullptr) {
+        LOGE("Hash array is null");
+        return nullptr;
+    }
+    
+    jsize length = env->GetArrayLength(hashArray);
+    if (length % EDGE_HASH_WORDS != 0) {
+        LOGE("Hash array length %d is not a multiple of %d", length, EDGE_HASH_WORDS);
+        return nullptr;
+    }
+    
+    std::vector<EdgeHash> hashes(static_cast<size_t>(length / EDGE_HASH_WORDS));
+    jlong* words = env->GetLongArrayElements(hashArray, nullptr);
+    if (words == nullptr) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < hashes.size(); i++) {
+        for (int w = 0; w < EDGE_HASH_WORDS; w++) {
+            hashes[i].words[w] = static_cast<uint64_t>(words[i * EDGE_HASH_WORDS + w]);
+        }
+    }
+    env->ReleaseLongArrayElements(hashArray, words, JNI_ABORT);
+    
+    std::vector<int> clusterOf;
+    int clusters = PerceptualHash::cluster(hashes, maxDistance, clusterOf);
+    LOGI("Edge hash clustering: %zu images in %d clusters", hashes.size(), clusters);
+    
+    jsize count = static_cast<jsize>(clusterOf.size());
+    jintArray result = env->NewIntArray(count);
+    if (result != nullptr && count > 0) {
+        env->SetIntArrayRegion(result, 0, count, clusterOf.data());
+    }
+    return result;
+}
+
+// JNI method to open the result cache consulted by the file, batch and async paths
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_openResultCache(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring directory,
+    jlong capacityBytes
+) {
+    if (capacityBytes <= 0) {
+        LOGE("Invalid result cache capacity: %lld", static_cast<long long>(capacityBytes));
+        return JNI_FALSE;
+    }
+    return g_resultCache.open(toStdString(env, directory), static_cast<uint64_t>(capacityBytes))
+        ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to save the result cache index and close the pack
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_closeResultCache(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    g_resultCache.close();
+}
+
+// JNI method to drop every cached result
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_clearResultCache(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    g_resultCache.clear();
+}
+
+// JNI method to save the result cache index (e.g. when the app is backgrounded)
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_flushResultCache(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    return g_resultCache.flush() ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to get result cache counters
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getResultCacheStatistics(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    std::string stats = g_resultCache.getStatistics();
+    return env->NewStringUTF(stats.c_str());
+}
+
+// JNI method to benchmark reduced-scale decode against the full RGBA route
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_benchmarkImageDecode(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring path,
+    jint mode,
+    jint maxSize,
+    jint iterations
+) {
+    std::string report = ImageDecode::benchmark(toStdString(env, path), static_cast<ProcessingMode>(mode),
+                                                maxSize, iterations);
+    return env->NewStringUTF(report.c_str());
+}
+
+// JNI method to warp a document quad {x0, y0, ... x3, y3} (TL, TR, BR, BL)
+// to a flat outWidth x outHeight image written straight into outputArray
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_rectifyDocument(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray inputArray,
+    jint width,
+    jint height,
+    jint channels,
+    jfloatArray quadArray,
+    jbyteArray outputArray,
+    jint outWidth,
+    jint outHeight
+) {
+    if (inputArray == nullptr || quadArray == nullptr || outputArray == nullptr ||
+        (channels != 1 && channels != 4) || width <= 0 || height <= 0 || outWidth <= 0 || outHeight <= 0 ||
+        env->GetArrayLength(quadArray) < 8 ||
+        env->GetArrayLength(inputArray) < width * height * channels ||
+        env->GetArrayLength(outputArray) < outWidth * outHeight * channels) {
+        LOGE("Invalid rectification arrays");
+        return JNI_FALSE;
+    }
+    
+    jfloat quad[8];
+    env->GetFloatArrayRegion(quadArray, 0, 8, quad);
+    
+    jbyte* inputBytes = env->GetByteArrayElements(inputArray, nullptr);
+    jbyte* outputBytes = env->GetByteArrayElements(outputArray, nullptr);
+    bool success = false;
+    if (inputBytes != nullptr && outputBytes != nullptr) {
+        std::lock_guard<std::mutex> lock(g_rectifierMutex);
+        success = g_rectifier.rectify(reinterpret_cast<const uint8_t*>(inputBytes), width, height, 0, channels,
+                                      quad, reinterpret_cast<uint8_t*>(outputBytes), outWidth, outHeight, 0);
+    }
+    if (inputBytes != nullptr) {
+        env->ReleaseByteArrayElements(inputArray, inputBytes, JNI_ABORT);
+    }
+    if (outputBytes != nullptr) {
+        env->ReleaseByteArrayElements(outputArray, outputBytes, success ? 0 : JNI_ABORT);
+    }
+    return success ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to set the corner movement (pixels) that rebuilds the rectification table
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_setRectifyTolerance(
+    JNIEnv* env,
+    jobject /* this */,
+    jfloat pixels
+) {
+    std::lock_guard<std::mutex> lock(g_rectifierMutex);
+    g_rectifier.setTolerance(pixels);
+}
+
+// JNI method to get rectification table build/reuse counters
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getRectifyStatistics(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    std::string stats;
+    {
+        std::lock_guard<std::mutex> lock(g_rectifierMutex);
+        stats = g_rectifier.getStatistics();
+    }
+    return env->NewStringUTF(stats.c_str());
+}
+
+// JNI method to losslessly encode an 8-bit gray plane for streaming
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_flam_edgedetector_NativeLib_encodeGrayLossless(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray grayArray,
+    jint width,
+    jint height,
+    jint predictor
+) {
+    if (grayArray == nullptr || width <= 0 || height <= 0 ||
+        env->GetArrayLength(grayArray) < width * height) {
+        LOGE("Invalid gray plane for lossless encode");
+        return nullptr;
+    }
+    
+    jbyte* grayBytes = env->GetByteArrayElements(grayArray, nullptr);
+    if (grayBytes == nullptr) {
+        LOGE("Failed to get gray array elements");
+        return nullptr;
+    }
+    
+    TrackedBytes encoded;
+    bool success;
+    {
+        std::lock_guard<std::mutex> lock(g_grayCodecMutex);
+        success = g_grayCodec.encode(reinterpret_cast<const uint8_t*>(grayBytes), width, height, 0,
+                                     encoded, predictor);
+    }
+    env->ReleaseByteArrayElements(grayArray, grayBytes, JNI_ABORT);
+    if (!success) {
+        return nullptr;
+    }
+    
+    jbyteArray result = env->NewByteArray(static_cast<jsize>(encoded.size()));
+    if (result != nullptr) {
+        env->SetByteArrayRegion(result, 0, static_cast<jsize>(encoded.size()),
+                                reinterpret_cast<const jbyte*>(encoded.data()));
+    }
+    return result;
+}
+
+// JNI method to decode a lossless gray stream into a pre-allocated plane
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_decodeGrayLossless(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray encodedArray,
+    jbyteArray grayArray
+) {
+    if (encodedArray == nullptr || grayArray == nullptr) {
+        LOGE("Encoded or output array is null");
+        return JNI_FALSE;
+    }
+    
+    jsize encodedLength = env->GetArrayLength(encodedArray);
+    jbyte* encoded = env->GetByteArrayElements(encodedArray, nullptr);
+    if (encoded == nullptr) {
+        LOGE("Failed to get encoded array elements");
+        return JNI_FALSE;
+    }
+    
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(encoded);
+    int width = 0;
+    int height = 0;
+    bool success = GrayCodec::readHeader(data, static_cast<size_t>(encodedLength), width, height) &&
+                   env->GetArrayLength(grayArray) >= width * height;
+    if (success) {
+        jbyte* gray = env->GetByteArrayElements(grayArray, nullptr);
+        success = gray != nullptr &&
+                  GrayCodec::decode(data, static_cast<size_t>(encodedLength),
+                                    reinterpret_cast<uint8_t*>(gray), width, height);
+        if (gray != nullptr) {
+            env->ReleaseByteArrayElements(grayArray, gray, success ? 0 : JNI_ABORT);
+        }
+    } else {
+        LOGE("Invalid lossless stream or output too small");
+    }
+    env->ReleaseByteArrayElements(encodedArray, encoded, JNI_ABORT);
+    
+    return success ? JNI_TRUE : JNI_FALSE;
+}
+
+// Keeps a pool thread attached to the VM until the thread exits
+struct AttachedThread {
+    JNIEnv* env = nullptr;
+    
+    ~AttachedThread() {
+        if (env != nullptr && g_vm != nullptr) {
+            g_vm->DetachCurrentThread();
+        }
+    }
+};
+
+// JNIEnv for the calling pool thread, attaching it on first use
+static JNIEnv* attachedEnv() {
+    thread_local AttachedThread attached;
+    if (attached.env == nullptr && g_vm != nullptr) {
+        if (g_vm->AttachCurrentThread(&attached.env, nullptr) != JNI_OK) {
+            LOGE("Failed to attach worker thread");
+            attached.env = nullptr;
+        }
+    }
+    return attached.env;
+}
+
+// Async processor, created on first use
+static std::shared_ptr<AsyncProcessor> asyncProcessor() {
+    std::lock_guard<std::mutex> lock(g_asyncMutex);
+    if (g_async == nullptr) {
+        g_async = std::make_shared<AsyncProcessor>();
+        g_async->setResultCache(&g_resultCache);
+        if (g_processor != nullptr) {
+            g_async->setConfiguration(*g_processor);
+        }
+    }
+    return g_async;
+}
+
+// Deliver a completion to the registered Kotlin callback
+static void deliverAsyncCompletion(AsyncCompletion& completion) {
+    JNIEnv* env = attachedEnv();
+    if (env == nullptr) {
         return;
     }
     
-    // Convert YUV420 to RGBA
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int yIndex = y * yRowStride + x;
-            int uvIndex = (y / 2) * uvRowStride + (x / 2) * uvPixelStride;
-            
-            int Y = yData[yIndex] & 0xFF;
-            int U = uData[uvIndex] & 0xFF;
-            int V = vData[uvIndex] & 0xFF;
-            
-            // YUV to RGB conversion
-            int C = Y - 16;
-            int D = U - 128;
-            int E = V - 128;
-            
-            int R = (298 * C + 409 * E + 128) >> 8;
-            int G = (298 * C - 100 * D - 208 * E + 128) >> 8;
-            int B = (298 * C + 516 * D + 128) >> 8;
-            
-            // Clamp values
-            R = R < 0 ? 0 : (R > 255 ? 255 : R);
-            G = G < 0 ? 0 : (G > 255 ? 255 : G);
-            B = B < 0 ? 0 : (B > 255 ? 255 : B);
-            
-            // Write RGBA
-            int outIndex = (y * width + x) * 4;
-            outData[outIndex] = static_cast<jbyte>(R);
-            outData[outIndex + 1] = static_cast<jbyte>(G);
-            outData[outIndex + 2] = static_cast<jbyte>(B);
-            outData[outIndex + 3] = static_cast<jbyte>(255);
+    // A local reference keeps the callback valid without holding the lock
+    // across the call, which may re-enter the async entry points
+    jobject callback;
+    jmethodID method;
+    {
+        std::lock_guard<std::mutex> lock(g_asyncMutex);
+        if (g_asyncCallback == nullptr) {
+            return;
+        }
+        callback = env->NewLocalRef(g_asyncCallback);
+        method = g_asyncCallbackMethod;
+    }
+    
+    jbyteArray output = nullptr;
+    if (!completion.output.empty()) {
+        jsize length = static_cast<jsize>(completion.output.size());
+        output = env->NewByteArray(length);
+        if (output != nullptr) {
+            env->SetByteArrayRegion(output, 0, length,
+                                    reinterpret_cast<const jbyte*>(completion.output.data()));
+        }
+    }
+    
+    env->CallVoidMethod(callback, method,
+                        static_cast<jlong>(completion.ticket),
+                        static_cast<jint>(completion.status),
+                        static_cast<jlong>(completion.metrics.processingTimeMs),
+                        output);
+    if (env->ExceptionCheck()) {
+        LOGE("Async completion callback threw");
+        env->ExceptionClear();
+    }
+    if (output != nullptr) {
+        env->DeleteLocalRef(output);
+    }
+    env->DeleteLocalRef(callback);
+}
+
+// JNI method to submit a frame for asynchronous processing
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_flam_edgedetector_NativeLib_submitFrameAsync(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray inputArray,
+    jint width,
+    jint height,
+    jint mode,
+    jint priority
+) {
+    if (inputArray == nullptr || width <= 0 || height <= 0) {
+        LOGE("Invalid async input");
+        return 0;
+    }
+    
+    jsize expectedLength = width * height * 4;
+    if (env->GetArrayLength(inputArray) < expectedLength) {
+        LOGE("Input array too small for %dx%d", width, height);
+        return 0;
+    }
+    
+    // The request keeps its own copy, so the array is released straight away
+    jbyte* inputBytes = env->GetByteArrayElements(inputArray, nullptr);
+    if (inputBytes == nullptr) {
+        LOGE("Failed to access input array");
+        return 0;
+    }
+    uint64_t ticket = asyncProcessor()->submit(
+        reinterpret_cast<const uint8_t*>(inputBytes), width, height,
+        static_cast<ProcessingMode>(mode), priority);
+    env->ReleaseByteArrayElements(inputArray, inputBytes, JNI_ABORT);
+    
+    return static_cast<jlong>(ticket);
+}
+
+// JNI method to submit a frame that must finish within budgetMs of now; a late
+// frame completes as ASYNC_ABANDONED at the next stage boundary
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_flam_edgedetector_NativeLib_submitFrameAsyncWithin(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray inputArray,
+    jint width,
+    jint height,
+    jint mode,
+    jint priority,
+    jint budgetMs
+) {
+    if (inputArray == nullptr || width <= 0 || height <= 0 || budgetMs <= 0) {
+        LOGE("Invalid async input");
+        return 0;
+    }
+    
+    jsize expectedLength = width * height * 4;
+    if (env->GetArrayLength(inputArray) < expectedLength) {
+        LOGE("Input array too small for %dx%d", width, height);
+        return 0;
+    }
+    
+    // The deadline starts before the copy, so queueing time counts against the budget
+    int64_t deadlineMs = FrameDeadline::nowMs() + budgetMs;
+    jbyte* inputBytes = env->GetByteArrayElements(inputArray, nullptr);
+    if (inputBytes == nullptr) {
+        LOGE("Failed to access input array");
+        return 0;
+    }
+    uint64_t ticket = asyncProcessor()->submit(
+        reinterpret_cast<const uint8_t*>(inputBytes), width, height,
+        static_cast<ProcessingMode>(mode), priority, deadlineMs);
+    env->ReleaseByteArrayElements(inputArray, inputBytes, JNI_ABORT);
+    
+    return static_cast<jlong>(ticket);
+}
+
+// JNI method to cancel a request that has not started
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_cancelFrameAsync(
+    JNIEnv* env,
+    jobject /* this */,
+    jlong ticket
+) {
+    return asyncProcessor()->cancel(static_cast<uint64_t>(ticket)) ? JNI_TRUE : JNI_FALSE;
+}
+
+// JNI method to register onFrameComplete(long ticket, int status, long timeMs, byte[] output)
+// callbacks (null returns to polling)
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_setAsyncCallback(
+    JNIEnv* env,
+    jobject /* this */,
+    jobject callback
+) {
+    std::shared_ptr<AsyncProcessor> async = asyncProcessor();
+    
+    jmethodID method = nullptr;
+    if (callback != nullptr) {
+        jclass callbackClass = env->GetObjectClass(callback);
+        method = env->GetMethodID(callbackClass, "onFrameComplete", "(JIJ[B)V");
+        env->DeleteLocalRef(callbackClass);
+        if (method == nullptr) {
+            LOGE("Callback has no onFrameComplete(long, int, long, byte[])");
+            env->ExceptionClear();
+            return JNI_FALSE;
+        }
+    }
+    
+    // Returns once no delivery is using the old reference
+    async->setCompletionCallback(nullptr);
+    jobject previous;
+    {
+        std::lock_guard<std::mutex> lock(g_asyncMutex);
+        previous = g_asyncCallback;
+        g_asyncCallback = callback != nullptr ? env->NewGlobalRef(callback) : nullptr;
+        g_asyncCallbackMethod = method;
+    }
+    if (previous != nullptr) {
+        env->DeleteGlobalRef(previous);
+    }
+    
+    if (callback != nullptr) {
+        async->setCompletionCallback(deliverAsyncCompletion);
+    }
+    return JNI_TRUE;
+}
+
+// JNI method to poll for a completion
+// Returns {ticket, status, processingTimeMs} or null, copying the result into outputArray
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_flam_edgedetector_NativeLib_pollFrameAsync(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray outputArray,
+    jint timeoutMs
+) {
+    AsyncCompletion completion;
+    std::shared_ptr<AsyncProcessor> async = asyncProcessor();
+    bool ready = timeoutMs > 0
+        ? async->waitCompletion(completion, timeoutMs)
+        : async->pollCompletion(completion);
+    if (!ready) {
+        return nullptr;
+    }
+    
+    if (outputArray != nullptr && !completion.output.empty()) {
+        jsize length = static_cast<jsize>(completion.output.size());
+        if (env->GetArrayLength(outputArray) >= length) {
+            env->SetByteArrayRegion(outputArray, 0, length,
+                                    reinterpret_cast<const jbyte*>(completion.output.data()));
+        } else {
+            LOGE("Output array too small for async result of %d bytes", length);
+            completion.status = ASYNC_FAILED;
+        }
+    }
+    
+    jlong values[3] = {
+        static_cast<jlong>(completion.ticket),
+        static_cast<jlong>(completion.status),
+        static_cast<jlong>(completion.metrics.processingTimeMs)
+    };
+    jlongArray result = env->NewLongArray(3);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 3, values);
+    }
+    return result;
+}
+
+// JNI method to cancel pending requests and release the async processor
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_releaseAsync(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    std::shared_ptr<AsyncProcessor> async;
+    jobject callback;
+    {
+        std::lock_guard<std::mutex> lock(g_asyncMutex);
+        async.swap(g_async);
+        callback = g_asyncCallback;
+        g_asyncCallback = nullptr;
+        g_asyncCallbackMethod = nullptr;
+    }
+    
+    // A poll still waiting keeps its own reference; the processor is
+    // destroyed when the last one goes, after running requests finish
+    if (async != nullptr) {
+        async->cancelAll();
+        async->setCompletionCallback(nullptr);
+    }
+    if (callback != nullptr) {
+        env->DeleteGlobalRef(callback);
+    }
+}
+
+// JNI method to snapshot processor state before going to background
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_flam_edgedetector_NativeLib_saveProcessorState(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    if (g_processor == nullptr) {
+        LOGE("Processor not initialized");
+        return env->NewByteArray(0);
+    }
+    
+    std::vector<uint8_t> blob;
+    g_processor->saveState(blob);
+    jsize size = static_cast<jsize>(blob.size());
+    jbyteArray result = env->NewByteArray(size);
+    if (result != nullptr && size > 0) {
+        env->SetByteArrayRegion(result, 0, size, reinterpret_cast<const jbyte*>(blob.data()));
+    }
+    return result;
+}
+
+// JNI method to create (if needed) and restore the processor from a snapshot
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_restoreProcessorState(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray stateArray
+) {
+    if (stateArray == nullptr) {
+        LOGE("State blob is null");
+        return JNI_FALSE;
+    }
+    
+    jsize size = env->GetArrayLength(stateArray);
+    std::vector<uint8_t> blob(static_cast<size_t>(size));
+    if (size > 0) {
+        env->GetByteArrayRegion(stateArray, 0, size, reinterpret_cast<jbyte*>(blob.data()));
+    }
+    
+    const bool created = g_processor == nullptr;
+    if (created) {
+        g_processor = new OpenCVProcessor();
+    }
+    if (!g_processor->restoreState(blob.data(), blob.size())) {
+        if (created) {
+            delete g_processor;
+            g_processor = nullptr;
         }
+        return JNI_FALSE;
+    }
+    syncAsyncConfiguration();
+    return JNI_TRUE;
+}
+
+// JNI method to release OpenCV
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_releaseOpenCV(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    LOGI("Releasing OpenCV native library");
+    
+    if (g_processor != nullptr) {
+        g_processor->release();
+        delete g_processor;
+        g_processor = nullptr;
+        LOGI("Processor released");
+    }
+}
+
+// JNI_OnLoad - called when native library is loaded
+JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+    LOGI("Native library loaded");
+    g_vm = vm;
+    return JNI_VERSION_1_6;
+}
+
+// JNI_OnUnload - called when native library is unloaded
+JNIEXPORT void JNI_OnUnload(JavaVM* vm, void* reserved) {
+    LOGI("Native library unloaded");
+    
+    // Clean up global processor if it still exists
+    if (g_processor != nullptr) {
+        g_processor->release();
+        delete g_processor;
+        g_processor = nullptr;
+    }
+}
+
+// Utility function to convert YUV to RGBA (for camera preview)
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_yuv420ToRgba(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray yPlane,
+    jbyteArray uPlane,
+    jbyteArray vPlane,
+    jint width,
+    jint height,
+    jint yRowStride,
+    jint uvRowStride,
+    jint uvPixelStride,
+    jbyteArray outputArray
+) {
+    if (!yuvPlanesFit(env, yPlane, uPlane, vPlane, width, height, yRowStride, uvRowStride, uvPixelStride)) {
+        return;
+    }
+    if (outputArray == nullptr || env->GetArrayLength(outputArray) < width * height * 4) {
+        LOGE("Output array missing or too small");
+        return;
+    }
+    
+    // Get array elements
+    jbyte* yData = env->GetByteArrayElements(yPlane, nullptr);
+    jbyte* uData = env->GetByteArrayElements(uPlane, nullptr);
+    jbyte* vData = env->GetByteArrayElements(vPlane, nullptr);
+    jbyte* outData = env->GetByteArrayElements(outputArray, nullptr);
+    
+    if (yData == nullptr || uData == nullptr || vData == nullptr || outData == nullptr) {
+        LOGE("Failed to get YUV array elements");
+        if (yData) env->ReleaseByteArrayElements(yPlane, yData, JNI_ABORT);
+        if (uData) env->ReleaseByteArrayElements(uPlane, uData, JNI_ABORT);
+        if (vData) env->ReleaseByteArrayElements(vPlane, vData, JNI_ABORT);
+        if (outData) env->ReleaseByteArrayElements(outputArray, outData, JNI_ABORT);
+        return;
     }
     
+    // Convert YUV420 to RGBA
+    SimdKernels::vectorized().yuv420ToRgba(
+        reinterpret_cast<const uint8_t*>(yData),
+        reinterpret_cast<const uint8_t*>(uData),
+        reinterpret_cast<const uint8_t*>(vData),
+        width,
+        height,
+        yRowStride,
+        uvRowStride,
+        uvPixelStride,
+        reinterpret_cast<uint8_t*>(outData)
+    );
+    
     // Release arrays
     env->ReleaseByteArrayElements(yPlane, yData, JNI_ABORT);
     env->ReleaseByteArrayElements(uPlane, uData, JNI_ABORT);
     env->ReleaseByteArrayElements(vPlane, vData, JNI_ABORT);
     env->ReleaseByteArrayElements(outputArray, outData, 0);
-}
\ No newline at end of file
+}
+// JNI method to start serving processed frames to network viewers
+extern "C" JNIEXPORT jint JNICALL
+Java_com_flam_edgedetector_NativeLib_startStreamServer(
+    JNIEnv* env,
+    jobject /* this */,
+    jint port,
+    jdouble sourceFps,
+    jboolean edges
+) {
+    std::lock_guard<std::mutex> lock(g_streamMutex);
+    if (g_streamServer == nullptr) {
+        g_streamServer = new StreamServer();
+    }
+    g_streamFrameIndex = 0;
+    return g_streamServer->start(port, sourceFps, edges == JNI_TRUE);
+}
+
+// JNI method to disconnect all viewers and stop listening
+extern "C" JNIEXPORT void JNICALL
+Java_com_flam_edgedetector_NativeLib_stopStreamServer(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    std::lock_guard<std::mutex> lock(g_streamMutex);
+    delete g_streamServer;
+    g_streamServer = nullptr;
+}
+
+// JNI method to offer a processed plane (and optional fixed-point sub-pixel edges) to viewers
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_flam_edgedetector_NativeLib_publishStreamFrame(
+    JNIEnv* env,
+    jobject /* this */,
+    jbyteArray planeArray,
+    jint width,
+    jint height,
+    jboolean edges,
+    jintArray pointsArray
+) {
+    const size_t planeSize = static_cast<size_t>(width) * height;
+    if (width <= 0 || height <= 0 || env->GetArrayLength(planeArray) < static_cast<jsize>(planeSize)) {
+        LOGE("Invalid stream frame");
+        return JNI_FALSE;
+    }
+    
+    std::shared_ptr<StreamFrame> frame = std::make_shared<StreamFrame>();
+    frame->width = width;
+    frame->height = height;
+    frame->edges = edges == JNI_TRUE;
+    if (frame->edges) {
+        // Edge maps are packed straight from the Java array and queued at one bit per pixel
+        jbyte* planeBytes = env->GetByteArrayElements(planeArray, nullptr);
+        if (planeBytes == nullptr) {
+            LOGE("Failed to access stream plane");
+            return JNI_FALSE;
+        }
+        frame->mask.pack(reinterpret_cast<const uint8_t*>(planeBytes), width, height);
+        env->ReleaseByteArrayElements(planeArray, planeBytes, JNI_ABORT);
+    } else {
+        frame->plane.resize(planeSize);
+        env->GetByteArrayRegion(planeArray, 0, static_cast<jsize>(planeSize),
+                                reinterpret_cast<jbyte*>(frame->plane.data()));
+    }
+    frame->hasPoints = pointsArray != nullptr;
+    if (frame->hasPoints) {
+        frame->points.resize(static_cast<size_t>(env->GetArrayLength(pointsArray)) & ~static_cast<size_t>(1));
+        env->GetIntArrayRegion(pointsArray, 0, static_cast<jsize>(frame->points.size()),
+                               reinterpret_cast<jint*>(frame->points.data()));
+    }
+    frame->capturedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    
+    std::lock_guard<std::mutex> lock(g_streamMutex);
+    if (g_streamServer == nullptr) {
+        return JNI_FALSE;
+    }
+    frame->index = g_streamFrameIndex++;
+    g_streamServer->publish(frame);
+    return JNI_TRUE;
+}
+
+// JNI method to get per-viewer streaming statistics
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_getStreamStatistics(
+    JNIEnv* env,
+    jobject /* this */
+) {
+    std::lock_guard<std::mutex> lock(g_streamMutex);
+    std::string stats = g_streamServer != nullptr ? g_streamServer->getStatistics() : "Stream server stopped";
+    return env->NewStringUTF(stats.c_str());
+}
+
+// JNI method to stream synthetic frames over a throttled loopback link
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_flam_edgedetector_NativeLib_runStreamLoopbackTest(
+    JNIEnv* env,
+    jobject /* this */,
+    jint width,
+    jint height,
+    jint mode,
+    jint pattern,
+    jdouble sourceFps,
+    jint durationSeconds,
+    jdouble linkBytesPerSecond
+) {
+    StreamLoopbackConfig config = {};
+    config.source = {width, height, pattern, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+    config.mode = mode;
+    config.sourceFps = sourceFps;
+    config.durationSeconds = durationSeconds;
+    config.linkBytesPerSecond = linkBytesPerSecond;
+    config.receiveBufferBytes = 4 * 1024;
+    
+    StreamLoopbackReport report = StreamLoopbackTest::run(config);
+    return env->NewStringUTF(report.toString().c_str());
+}
@@ -0,0 +1,200 @@
+#include "native_memory.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+    // Usage ratios at which each pressure level starts
+    const double kReduceDepthRatio = 0.75;
+    const double kLowerResolutionRatio = 0.85;
+    const double kDropCachesRatio = 0.95;
+
+    // Usage must fall this far below a threshold before the level drops
+    const double kHysteresis = 0.10;
+
+    // How long a trimMemory hint keeps pressure raised
+    const int64_t kTrimHintMs = 10000;
+
+    const size_t kDefaultBudget = 256u * 1024u * 1024u;
+
+    int64_t nowMs() {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    }
+
+    double thresholdFor(int level) {
+        switch (level) {
+            case PRESSURE_REDUCE_DEPTH: return kReduceDepthRatio;
+            case PRESSURE_LOWER_RESOLUTION: return kLowerResolutionRatio;
+            case PRESSURE_DROP_CACHES: return kDropCachesRatio;
+            default: return 0.0;
+        }
+    }
+}
+
+// Singleton instance
+MemoryBudget& MemoryBudget::instance() {
+    static MemoryBudget budget;
+    return budget;
+}
+
+// Constructor
+MemoryBudget::MemoryBudget()
+    : mBudget(kDefaultBudget)
+    , mCurrent(0)
+    , mPeak(0)
+    , mLevel(PRESSURE_NONE)
+    , mHintLevel(PRESSURE_NONE)
+    , mHintExpiresMs(0)
+{
+}
+
+// Set total budget
+void MemoryBudget::setBudget(size_t bytes) {
+    mBudget.store(bytes);
+    LOGI("Native memory budget set to %zu KiB", bytes / 1024);
+}
+
+size_t MemoryBudget::budget() const {
+    return mBudget.load();
+}
+
+size_t MemoryBudget::currentUsage() const {
+    return mCurrent.load();
+}
+
+size_t MemoryBudget::peakUsage() const {
+    return mPeak.load();
+}
+
+void MemoryBudget::resetPeak() {
+    mPeak.store(mCurrent.load());
+}
+
+// Account an allocation
+void MemoryBudget::onAllocate(size_t bytes) {
+    size_t current = mCurrent.fetch_add(bytes) + bytes;
+    size_t peak = mPeak.load();
+    while (current > peak && !mPeak.compare_exchange_weak(peak, current)) {
+    }
+}
+
+// Account a free
+void MemoryBudget::onFree(size_t bytes) {
+    mCurrent.fetch_sub(bytes);
+}
+
+// Current pressure level
+int MemoryBudget::pressure() {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    const size_t budget = mBudget.load();
+    const double ratio = budget > 0 ? static_cast<double>(mCurrent.load()) / budget : 0.0;
+
+    // Rise immediately, fall only once usage is clearly below the threshold
+    int level = mLevel.load();
+    while (level < PRESSURE_DROP_CACHES && ratio >= thresholdFor(level + 1)) {
+        level++;
+    }
+    while (level > PRESSURE_NONE && ratio < thresholdFor(level) - kHysteresis) {
+        level--;
+    }
+
+    if (level != mLevel.load()) {
+        LOGW("Memory pressure %d -> %d (%.0f%% of budget)", mLevel.load(), level, ratio * 100.0);
+        mLevel.store(level);
+    }
+
+    if (mHintLevel > level && nowMs() < mHintExpiresMs) {
+        return mHintLevel;
+    }
+    return level;
+}
+
+// Ring or queue depth for the current pressure
+int MemoryBudget::recommendedDepth(int desired) {
+    if (desired <= 1) {
+        return desired;
+    }
+    int level = pressure();
+    if (level >= PRESSURE_LOWER_RESOLUTION) {
+        return 1;
+    }
+    if (level >= PRESSURE_REDUCE_DEPTH) {
+        return std::max(1, desired / 2);
+    }
+    return desired;
+}
+
+void MemoryBudget::registerListener(MemoryTrimListener* listener) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (std::find(mListeners.begin(), mListeners.end(), listener) == mListeners.end()) {
+        mListeners.push_back(listener);
+    }
+}
+
+void MemoryBudget::unregisterListener(MemoryTrimListener* listener) {
+    std::lock_guard<std::mutex> trimLock(mTrimMutex);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mListeners.erase(std::remove(mListeners.begin(), mListeners.end(), listener), mListeners.end());
+}
+
+// Handle trimMemory from the app
+size_t MemoryBudget::trimMemory(int level) {
+    std::lock_guard<std::mutex> trimLock(mTrimMutex);
+    std::vector<MemoryTrimListener*> listeners;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // Running-app warnings also raise pressure for a while
+        if (level == TRIM_MEMORY_RUNNING_LOW || level == TRIM_MEMORY_RUNNING_CRITICAL) {
+            mHintLevel = level == TRIM_MEMORY_RUNNING_CRITICAL
+                ? PRESSURE_LOWER_RESOLUTION
+                : PRESSURE_REDUCE_DEPTH;
+            mHintExpiresMs = nowMs() + kTrimHintMs;
+        }
+        listeners = mListeners;
+    }
+
+    // Listeners run without the budget lock, so a frame holding its
+    // processor lock can still read pressure()
+    size_t released = 0;
+    for (MemoryTrimListener* listener : listeners) {
+        released += listener->onTrimMemory(level);
+    }
+
+    LOGI("trimMemory(%d) released %zu KiB, now %zu KiB",
+         level, released / 1024, mCurrent.load() / 1024);
+    return released;
+}
+
+// Usage summary
+std::string MemoryBudget::getStatistics() const {
+    char buffer[160];
+    snprintf(buffer, sizeof(buffer),
+        "Native memory: %zu KiB, Peak: %zu KiB, Budget: %zu KiB, Pressure: %d",
+        mCurrent.load() / 1024,
+        mPeak.load() / 1024,
+        mBudget.load() / 1024,
+        mLevel.load());
+    return std::string(buffer);
+}
+
+namespace NativeMemory {
+    void* allocate(size_t bytes) {
+        void* pointer = std::malloc(bytes);
+        if (pointer != nullptr) {
+            MemoryBudget::instance().onAllocate(bytes);
+        }
+        return pointer;
+    }
+
+    void deallocate(void* pointer, size_t bytes) {
+        if (pointer != nullptr) {
+            std::free(pointer);
+            MemoryBudget::instance().onFree(bytes);
+        }
+    }
+}
@@ -0,0 +1,164 @@
+#ifndef EDGEDETECTOR_NATIVE_MEMORY_H
+#define EDGEDETECTOR_NATIVE_MEMORY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+// Android ComponentCallbacks2 trim levels
+#define TRIM_MEMORY_RUNNING_MODERATE 5
+#define TRIM_MEMORY_RUNNING_LOW 10
+#define TRIM_MEMORY_RUNNING_CRITICAL 15
+#define TRIM_MEMORY_UI_HIDDEN 20
+#define TRIM_MEMORY_BACKGROUND 40
+#define TRIM_MEMORY_MODERATE 60
+#define TRIM_MEMORY_COMPLETE 80
+
+// Memory pressure levels, in increasing order of severity
+enum MemoryPressure {
+    PRESSURE_NONE = 0,
+    PRESSURE_REDUCE_DEPTH = 1,      // Shrink frame rings and queues
+    PRESSURE_LOWER_RESOLUTION = 2,  // Process at half resolution
+    PRESSURE_DROP_CACHES = 3        // Release scratch buffers after every frame
+};
+
+/**
+ * Implemented by anything that holds releasable native memory
+ */
+class MemoryTrimListener {
+public:
+    virtual ~MemoryTrimListener() = default;
+
+    /**
+     * Release idle buffers
+     * @param level Android trim level
+     * @return Bytes released
+     */
+    virtual size_t onTrimMemory(int level) = 0;
+};
+
+/**
+ * Process-wide accounting of native frame memory. Allocations are never
+ * refused; instead the pressure level rises as usage approaches the budget
+ * and components degrade (shallower rings, half-resolution processing,
+ * no retained scratch) until usage falls again.
+ */
+class MemoryBudget {
+public:
+    static MemoryBudget& instance();
+
+    /**
+     * Set total budget in bytes (0 = unlimited)
+     */
+    void setBudget(size_t bytes);
+    size_t budget() const;
+
+    size_t currentUsage() const;
+    size_t peakUsage() const;
+    void resetPeak();
+
+    /**
+     * Current pressure level (MemoryPressure), with hysteresis so the level
+     * does not flap when degrading brings usage just under a threshold
+     */
+    int pressure();
+
+    /**
+     * Ring or queue depth to use given the current pressure
+     */
+    int recommendedDepth(int desired);
+
+    void registerListener(MemoryTrimListener* listener);
+    void unregisterListener(MemoryTrimListener* listener);
+
+    /**
+     * Handle an Android trimMemory callback
+     * @return Bytes released by listeners
+     */
+    size_t trimMemory(int level);
+
+    std::string getStatistics() const;
+
+    // Accounting hooks for NativeMemory
+    void onAllocate(size_t bytes);
+    void onFree(size_t bytes);
+
+private:
+    MemoryBudget();
+
+    std::atomic<size_t> mBudget;
+    std::atomic<size_t> mCurrent;
+    std::atomic<size_t> mPeak;
+
+    std::mutex mMutex;
+    std::vector<MemoryTrimListener*> mListeners;
+    // Held while listeners run, outside mMutex: listeners take their own
+    // locks and may call pressure(); unregistering waits for a running trim
+    std::mutex mTrimMutex;
+    std::atomic<int> mLevel;
+    int mHintLevel;
+    int64_t mHintExpiresMs;
+};
+
+namespace NativeMemory {
+    /**
+     * Allocate and account bytes against the global budget
+     */
+    void* allocate(size_t bytes);
+
+    /**
+     * Free and un-account bytes
+     */
+    void deallocate(void* pointer, size_t bytes);
+}
+
+/**
+ * Standard allocator that routes through NativeMemory
+ */
+template <typename T>
+struct TrackedAllocator {
+    using value_type = T;
+
+    TrackedAllocator() noexcept = default;
+
+    template <typename U>
+    TrackedAllocator(const TrackedAllocator<U>&) noexcept {}
+
+    T* allocate(size_t count) {
+        void* pointer = NativeMemory::allocate(count * sizeof(T));
+        if (pointer == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(pointer);
+    }
+
+    void deallocate(T* pointer, size_t count) noexcept {
+        NativeMemory::deallocate(pointer, count * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const TrackedAllocator<T>&, const TrackedAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const TrackedAllocator<T>&, const TrackedAllocator<U>&) { return false; }
+
+// Frame-sized byte buffers accounted against the budget
+using TrackedBytes = std::vector<uint8_t, TrackedAllocator<uint8_t>>;
+
+/**
+ * Free a tracked buffer's storage (clear() alone keeps the capacity)
+ * @return Bytes released
+ */
+template <typename T>
+size_t releaseTracked(std::vector<T, TrackedAllocator<T>>& buffer) {
+    size_t bytes = buffer.capacity() * sizeof(T);
+    std::vector<T, TrackedAllocator<T>>().swap(buffer);
+    return bytes;
+}
+
+#endif // EDGEDETECTOR_NATIVE_MEMORY_H
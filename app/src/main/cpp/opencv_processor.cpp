@@ -1,4 +1,9 @@
 #include "opencv_processor.h"
+#include "content_hash.h"
+#include "mat_allocator.h"
+#include "simd_kernels.h"
+#include "subpixel_edges.h"
+#include "worker_pool.h"
 #include <cstring>
 #include <cmath>
 #include <chrono>
@@ -15,18 +20,39 @@ using namespace cv;
 OpenCVProcessor::OpenCVProcessor()
     : mInitialized(false)
     , mOpenCVAvailable(false)
+    , mImplementation(IMPL_AUTO)
+    , mKernels(&SimdKernels::vectorized())
     , mCannyLowThreshold(50.0)
     , mCannyHighThreshold(150.0)
     , mCannyApertureSize(3)
+    , mBlurSigma(1.5f)
     , mTotalFramesProcessed(0)
     , mTotalProcessingTimeMs(0)
     , mLastProcessingTimeMs(0)
+    , mFramesAbandoned(0)
+    , mFramesCached(0)
+    , mAbandonedByStage()
+    , mLastWidth(0)
+    , mLastHeight(0)
+    , mLastMode(MODE_RAW)
+    , mSubpixelEnabled(false)
+    , mEdgeHashEnabled(false)
+    , mEdgeHash()
+    , mEdgeHashFrame(0)
+    , mPendingEdgeHash()
+    , mEdgeHashPending(false)
+    , mDistanceMetric(DISTANCE_EUCLIDEAN)
+    , mDistanceNearest(false)
+    , mDeadline(nullptr)
+    , mAbandonedStage(-1)
 {
+    MemoryBudget::instance().registerListener(this);
     LOGI("OpenCVProcessor created");
 }
 
 // Destructor
 OpenCVProcessor::~OpenCVProcessor() {
+    MemoryBudget::instance().unregisterListener(this);
     release();
     LOGI("OpenCVProcessor destroyed");
 }
@@ -48,6 +74,8 @@ bool OpenCVProcessor::initialize() {
         } else {
             mOpenCVAvailable = true;
             LOGI("OpenCV initialized successfully (version %s)", CV_VERSION);
+            // Serve Canny/blur temporaries from per-thread free lists
+            PooledMatAllocator::install();
         }
     } catch (const std::exception& e) {
         LOGE("OpenCV initialization exception: %s", e.what());
@@ -73,17 +101,32 @@ ProcessingMetrics OpenCVProcessor::processFrame(
     int width,
     int height,
     ProcessingMode mode,
-    uint8_t* outputData
+    uint8_t* outputData,
+    int64_t deadlineMs
+) {
+    OutputTarget target = {outputData, width, height, OUTPUT_FORMAT_RGBA, 0, nullptr, 0};
+    return processFrame(inputData, width, height, mode, &target, 1, deadlineMs);
+}
+
+// Process frame once and write all output targets
+ProcessingMetrics OpenCVProcessor::processFrame(
+    const uint8_t* inputData,
+    int width,
+    int height,
+    ProcessingMode mode,
+    const OutputTarget* targets,
+    int targetCount,
+    int64_t deadlineMs
 ) {
-    ProcessingMetrics metrics = {0, width, height, mode, false};
+    ProcessingMetrics metrics = {0, width, height, mode, false, false, 0};
     
     if (!mInitialized) {
         LOGE("Processor not initialized");
         return metrics;
     }
     
-    if (inputData == nullptr || outputData == nullptr) {
-        LOGE("Invalid input or output data pointer");
+    if (inputData == nullptr || targets == nullptr || targetCount <= 0) {
+        LOGE("Invalid input data or output targets");
         return metrics;
     }
     
@@ -92,35 +135,387 @@ ProcessingMetrics OpenCVProcessor::processFrame(
         return metrics;
     }
     
+    // Pressure is read before locking so the budget lock is never taken
+    // under this one (onTrimMemory takes this lock from trimMemory)
+    const int pressure = MemoryBudget::instance().pressure();
+    std::lock_guard<std::mutex> lock(mMutex);
     int64_t startTime = getCurrentTimeMs();
     bool success = false;
+    FrameDeadline deadline(deadlineMs);
+    mDeadline = &deadline;
+    mAbandonedStage = -1;
+    if (abandonAt(STAGE_INPUT)) {
+        return finishMetrics(metrics, startTime, false);
+    }
+    
+    // Under memory pressure derive the plane from a half-resolution gray image
+    const bool half = (mode == MODE_EDGE || mode == MODE_GRAYSCALE || mode == MODE_DISTANCE) &&
+        pressure >= PRESSURE_LOWER_RESOLUTION &&
+        canProcessAtHalf(width, height, targets, targetCount);
+    const int planeWidth = half ? width / 2 : width;
+    const int planeHeight = half ? height / 2 : height;
+    const size_t planePixels = static_cast<size_t>(planeWidth) * planeHeight;
+    
+    // Produce the result plane once; RAW uses the input directly
+    const uint8_t* plane = inputData;
+    int channels = 4;
+    bool maskResult = false;
     
     switch (mode) {
         case MODE_RAW:
-            success = copyRawFrame(inputData, width, height, outputData);
+            success = true;
             break;
             
         case MODE_EDGE:
-            success = applyCannyEdge(inputData, width, height, outputData);
+        case MODE_DISTANCE:
+            mResultPlane.resize(planePixels);
+            if (half) {
+                mGrayPlane.resize(planePixels);
+                mKernels->rgbaToGrayHalf(inputData, width, height, mGrayPlane.data());
+                success = computeEdgesFromGray(mGrayPlane.data(), planeWidth, planeHeight, mResultPlane.data(),
+                                               mode == MODE_EDGE ? &maskResult : nullptr);
+            } else {
+                success = computeEdgePlane(inputData, width, height, mResultPlane.data(),
+                                           mode == MODE_EDGE ? &maskResult : nullptr);
+            }
+            if (success && mode == MODE_DISTANCE) {
+                success = computeDistancePlane(mResultPlane.data(), planeWidth, planeHeight, half ? 2.0f : 1.0f);
+            }
+            plane = mResultPlane.data();
+            channels = 1;
             break;
             
         case MODE_GRAYSCALE:
-            success = convertToGrayscale(inputData, width, height, outputData);
+            mResultPlane.resize(planePixels);
+            if (half) {
+                mKernels->rgbaToGrayHalf(inputData, width, height, mResultPlane.data());
+                success = true;
+            } else {
+                success = computeGrayPlane(inputData, width, height, mResultPlane.data());
+            }
+            if (success) {
+                hashGray(mResultPlane.data(), planeWidth, planeHeight);
+            }
+            plane = mResultPlane.data();
+            channels = 1;
             break;
             
         default:
             LOGE("Unknown processing mode: %d", mode);
-            success = copyRawFrame(inputData, width, height, outputData);
+            success = true;
             break;
     }
     
-    int64_t endTime = getCurrentTimeMs();
-    metrics.processingTimeMs = endTime - startTime;
-    metrics.success = success;
+    if (success && !abandonAt(STAGE_OUTPUT)) {
+        success = maskResult
+            ? mOutputWriter.write(mEdgeMask, targets, targetCount)
+            : mOutputWriter.write(plane, planeWidth, planeHeight, channels, targets, targetCount);
+    }
+    finishFrame(pressure, half);
     
-    updateStatistics(metrics.processingTimeMs);
+    return finishMetrics(metrics, startTime, success);
+}
+
+// Produce several modes from one frame through the derived-image cache
+ProcessingMetrics OpenCVProcessor::processFrameRequests(
+    const uint8_t* inputData,
+    int width,
+    int height,
+    const FrameRequest* requests,
+    int requestCount,
+    uint32_t extraImages,
+    int64_t deadlineMs
+) {
+    ProcessingMetrics metrics = {0, width, height, requestCount > 0 && requests != nullptr ? requests[0].mode : MODE_RAW, false, false, 0};
     
-    return metrics;
+    if (!mInitialized) {
+        LOGE("Processor not initialized");
+        return metrics;
+    }
+    
+    if (inputData == nullptr || requests == nullptr || requestCount <= 0) {
+        LOGE("Invalid input data or requests");
+        return metrics;
+    }
+    
+    if (width <= 0 || height <= 0) {
+        LOGE("Invalid dimensions: %dx%d", width, height);
+        return metrics;
+    }
+    
+    for (int i = 0; i < requestCount; i++) {
+        if (requests[i].targets == nullptr || requests[i].targetCount <= 0) {
+            LOGE("Request %d has no output targets", i);
+            return metrics;
+        }
+    }
+    
+    const int pressure = MemoryBudget::instance().pressure();
+    std::lock_guard<std::mutex> lock(mMutex);
+    int64_t startTime = getCurrentTimeMs();
+    FrameDeadline deadline(deadlineMs);
+    mDeadline = &deadline;
+    mAbandonedStage = -1;
+    if (abandonAt(STAGE_INPUT)) {
+        return finishMetrics(metrics, startTime, false);
+    }
+    
+    // Half resolution only when every derived output can be produced from a half plane
+    bool derives = extraImages != 0;
+    bool half = pressure >= PRESSURE_LOWER_RESOLUTION;
+    for (int i = 0; i < requestCount; i++) {
+        const FrameRequest& request = requests[i];
+        if (request.mode == MODE_EDGE || request.mode == MODE_GRAYSCALE || request.mode == MODE_DISTANCE) {
+            derives = true;
+            half = half && canProcessAtHalf(width, height, request.targets, request.targetCount);
+        }
+    }
+    half = half && derives && width >= 2 && height >= 2;
+    
+    mDerived.begin(half ? width / 2 : width, half ? height / 2 : height);
+    const FrameSource source = {inputData, width, height, half};
+    bool success = true;
+    
+    for (int i = 0; i < requestCount && success; i++) {
+        const FrameRequest& request = requests[i];
+        const uint8_t* plane = nullptr;
+        int planeWidth = mDerived.width();
+        int planeHeight = mDerived.height();
+        int channels = 1;
+        
+        switch (request.mode) {
+            case MODE_GRAYSCALE: {
+                const int level = pyramidLevelFor(request);
+                plane = derivePyramid(source, level);
+                planeWidth = mDerived.levelWidth(level);
+                planeHeight = mDerived.levelHeight(level);
+                break;
+            }
+                
+            case MODE_EDGE:
+                plane = deriveEdges(source);
+                break;
+                
+            case MODE_DISTANCE:
+                plane = deriveDistance(source);
+                break;
+                
+            default:
+                if (request.mode != MODE_RAW) {
+                    LOGE("Unknown processing mode: %d", request.mode);
+                }
+                plane = inputData;
+                planeWidth = width;
+                planeHeight = height;
+                channels = 4;
+                break;
+        }
+        
+        success = plane != nullptr && !abandonAt(STAGE_OUTPUT) &&
+            mOutputWriter.write(plane, planeWidth, planeHeight, channels, request.targets, request.targetCount);
+    }
+    
+    // Images the caller reads back through getDerivedImages()
+    if (success && (extraImages & DERIVED_IMAGE_BIT(DERIVED_LUMA))) {
+        success = deriveLuma(source) != nullptr;
+    }
+    if (success && (extraImages & DERIVED_IMAGE_BIT(DERIVED_BLURRED))) {
+        success = deriveSmoothed(source) != nullptr;
+    }
+    if (success && (extraImages & DERIVED_IMAGE_BIT(DERIVED_PYRAMID))) {
+        int levels = 0;
+        while (levels < DERIVED_PYRAMID_LEVELS && mDerived.levelWidth(levels + 1) > 0 &&
+               mDerived.levelHeight(levels + 1) > 0) {
+            levels++;
+        }
+        success = derivePyramid(source, levels) != nullptr;
+    }
+    if (success && (extraImages & DERIVED_IMAGE_BIT(DERIVED_GRADIENTS))) {
+        success = deriveGradients(source);
+    }
+    if (success && (extraImages & DERIVED_IMAGE_BIT(DERIVED_EDGES))) {
+        success = deriveEdges(source) != nullptr;
+    }
+    if (success && (extraImages & DERIVED_IMAGE_BIT(DERIVED_DISTANCE))) {
+        success = deriveDistance(source) != nullptr;
+    }
+    finishFrame(pressure, half);
+    
+    return finishMetrics(metrics, startTime, success);
+}
+
+// Derived images of the last processFrameRequests
+const DerivedImageCache& OpenCVProcessor::getDerivedImages() const {
+    return mDerived;
+}
+
+// Process camera YUV frame and write all output targets
+ProcessingMetrics OpenCVProcessor::processFrameYuv(
+    const YuvPlanes& planes,
+    int width,
+    int height,
+    ProcessingMode mode,
+    const OutputTarget* targets,
+    int targetCount,
+    int64_t deadlineMs
+) {
+    ProcessingMetrics metrics = {0, width, height, mode, false, false, 0};
+    
+    if (!mInitialized) {
+        LOGE("Processor not initialized");
+        return metrics;
+    }
+    
+    if (planes.y == nullptr || planes.u == nullptr || planes.v == nullptr ||
+        targets == nullptr || targetCount <= 0) {
+        LOGE("Invalid YUV planes or output targets");
+        return metrics;
+    }
+    
+    if (width <= 0 || height <= 0) {
+        LOGE("Invalid dimensions: %dx%d", width, height);
+        return metrics;
+    }
+    
+    const int pressure = MemoryBudget::instance().pressure();
+    std::lock_guard<std::mutex> lock(mMutex);
+    int64_t startTime = getCurrentTimeMs();
+    bool success = false;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    bool half = false;
+    FrameDeadline deadline(deadlineMs);
+    mDeadline = &deadline;
+    mAbandonedStage = -1;
+    if (abandonAt(STAGE_INPUT)) {
+        return finishMetrics(metrics, startTime, false);
+    }
+    
+    if (mode == MODE_EDGE || mode == MODE_GRAYSCALE || mode == MODE_DISTANCE) {
+        half = pressure >= PRESSURE_LOWER_RESOLUTION &&
+            canProcessAtHalf(width, height, targets, targetCount);
+        const int planeWidth = half ? width / 2 : width;
+        const int planeHeight = half ? height / 2 : height;
+        const size_t planePixels = static_cast<size_t>(planeWidth) * planeHeight;
+        
+        // Luma is already the gray image (undistorted in the same pass when calibrated)
+        mGrayPlane.resize(planePixels);
+        if (!mUndistort.isEnabled() ||
+            !mUndistort.lumaFromVideoRange(planes.y, width, height, planes.yRowStride,
+                                           planeWidth, planeHeight, mGrayPlane.data())) {
+            if (half) {
+                mKernels->lumaFromVideoRangeHalf(planes.y, width, height, planes.yRowStride, mGrayPlane.data());
+            } else {
+                mKernels->lumaFromVideoRange(planes.y, width, height, planes.yRowStride, mGrayPlane.data());
+            }
+        }
+        
+        const uint8_t* plane = mGrayPlane.data();
+        bool maskResult = false;
+        success = true;
+        if (mode == MODE_GRAYSCALE) {
+            hashGray(mGrayPlane.data(), planeWidth, planeHeight);
+        } else {
+            mResultPlane.resize(planePixels);
+            success = computeEdgesFromGray(mGrayPlane.data(), planeWidth, planeHeight, mResultPlane.data(),
+                                           mode == MODE_EDGE ? &maskResult : nullptr);
+            if (success && mode == MODE_DISTANCE) {
+                success = computeDistancePlane(mResultPlane.data(), planeWidth, planeHeight, half ? 2.0f : 1.0f);
+            }
+            plane = mResultPlane.data();
+        }
+        
+        if (success && !abandonAt(STAGE_OUTPUT)) {
+            success = maskResult
+                ? mOutputWriter.write(mEdgeMask, targets, targetCount)
+                : mOutputWriter.write(plane, planeWidth, planeHeight, 1, targets, targetCount);
+        }
+    } else {
+        // RAW: full-size NV12 targets keep the camera chroma, others need RGBA
+        std::vector<OutputTarget> rgbaTargets;
+        success = true;
+        for (int i = 0; i < targetCount && success; i++) {
+            const OutputTarget& target = targets[i];
+            if (target.format == OUTPUT_FORMAT_NV12 && target.width == width && target.height == height) {
+                success = MultiOutputWriter::writeNv12Passthrough(planes, width, height, target);
+            } else {
+                rgbaTargets.push_back(target);
+            }
+        }
+        
+        if (success && !rgbaTargets.empty() && !abandonAt(STAGE_OUTPUT)) {
+            mRgbaPlane.resize(pixels * 4);
+            mKernels->yuv420ToRgba(planes.y, planes.u, planes.v, width, height,
+                                   planes.yRowStride, planes.uvRowStride, planes.uvPixelStride,
+                                   mRgbaPlane.data());
+            success = mOutputWriter.write(mRgbaPlane.data(), width, height, 4,
+                                          rgbaTargets.data(), static_cast<int>(rgbaTargets.size()));
+        }
+    }
+    finishFrame(pressure, half);
+    
+    return finishMetrics(metrics, startTime, success);
+}
+
+// Process a gray frame and write all output targets
+ProcessingMetrics OpenCVProcessor::processGrayFrame(
+    const uint8_t* grayData,
+    int width,
+    int height,
+    ProcessingMode mode,
+    const OutputTarget* targets,
+    int targetCount,
+    int64_t deadlineMs
+) {
+    ProcessingMetrics metrics = {0, width, height, mode, false, false, 0};
+    
+    if (!mInitialized) {
+        LOGE("Processor not initialized");
+        return metrics;
+    }
+    
+    if (grayData == nullptr || targets == nullptr || targetCount <= 0) {
+        LOGE("Invalid gray input or output targets");
+        return metrics;
+    }
+    
+    if (width <= 0 || height <= 0) {
+        LOGE("Invalid dimensions: %dx%d", width, height);
+        return metrics;
+    }
+    
+    const int pressure = MemoryBudget::instance().pressure();
+    std::lock_guard<std::mutex> lock(mMutex);
+    int64_t startTime = getCurrentTimeMs();
+    bool success = true;
+    const uint8_t* plane = grayData;
+    bool maskResult = false;
+    FrameDeadline deadline(deadlineMs);
+    mDeadline = &deadline;
+    mAbandonedStage = -1;
+    if (abandonAt(STAGE_INPUT)) {
+        return finishMetrics(metrics, startTime, false);
+    }
+    
+    if (mode == MODE_EDGE || mode == MODE_DISTANCE) {
+        mResultPlane.resize(static_cast<size_t>(width) * height);
+        success = computeEdgesFromGray(grayData, width, height, mResultPlane.data(),
+                                       mode == MODE_EDGE ? &maskResult : nullptr);
+        if (success && mode == MODE_DISTANCE) {
+            success = computeDistancePlane(mResultPlane.data(), width, height, 1.0f);
+        }
+        plane = mResultPlane.data();
+    } else {
+        hashGray(grayData, width, height);
+    }
+    
+    if (success && !abandonAt(STAGE_OUTPUT)) {
+        success = maskResult
+            ? mOutputWriter.write(mEdgeMask, targets, targetCount)
+            : mOutputWriter.write(plane, width, height, 1, targets, targetCount);
+    }
+    finishFrame(pressure, false);
+    
+    return finishMetrics(metrics, startTime, success);
 }
 
 // Apply Canny edge detection
@@ -130,87 +525,254 @@ bool OpenCVProcessor::applyCannyEdge(
     int height,
     uint8_t* outputData
 ) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mResultPlane.resize(static_cast<size_t>(width) * height);
+    if (!computeEdgePlane(inputData, width, height, mResultPlane.data())) {
+        return false;
+    }
+    
+    // Not a counted frame, so there is no hash to publish
+    mEdgeHashPending = false;
+    
+    // White edges on black background
+    mKernels->expandGrayToRgba(mResultPlane.data(), width, height, outputData);
+    return true;
+}
+
+// Convert to grayscale
+bool OpenCVProcessor::convertToGrayscale(
+    const uint8_t* inputData,
+    int width,
+    int height,
+    uint8_t* outputData
+) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mResultPlane.resize(static_cast<size_t>(width) * height);
+    if (!computeGrayPlane(inputData, width, height, mResultPlane.data())) {
+        return false;
+    }
+    
+    // Grayscale in all channels
+    mKernels->expandGrayToRgba(mResultPlane.data(), width, height, outputData);
+    return true;
+}
+
+// Compute Canny edge plane
+bool OpenCVProcessor::computeEdgePlane(
+    const uint8_t* inputData,
+    int width,
+    int height,
+    uint8_t* edgeData,
+    bool* maskResult
+) {
+    mGrayPlane.resize(static_cast<size_t>(width) * height);
+    if (!computeGrayPlane(inputData, width, height, mGrayPlane.data())) {
+        return false;
+    }
+    return computeEdgesFromGray(mGrayPlane.data(), width, height, edgeData, maskResult);
+}
+
+// Compute Canny edges from a gray plane
+bool OpenCVProcessor::computeEdgesFromGray(
+    const uint8_t* grayData,
+    int width,
+    int height,
+    uint8_t* edgeData,
+    bool* maskResult
+) {
+    if (abandonAt(STAGE_BLUR)) {
+        return false;
+    }
+    hashGray(grayData, width, height);
+    bool success = false;
+    const uint8_t* smoothed = blurForEdges(grayData, width, height, mBlurPlane) ? mBlurPlane.data() : grayData;
+    if (abandonAt(STAGE_EDGES)) {
+        return false;
+    }
+    
 #ifdef HAVE_OPENCV
-    if (mOpenCVAvailable) {
+    if (useOpenCV()) {
         try {
-            // Create input Mat from RGBA data
-            Mat inputMat(height, width, CV_8UC4, (void*)inputData);
-            
-            // Convert to grayscale
-            Mat grayMat;
-            cvtColor(inputMat, grayMat, COLOR_RGBA2GRAY);
-            
-            // Apply Gaussian blur to reduce noise
-            Mat blurredMat;
-            GaussianBlur(grayMat, blurredMat, Size(5, 5), 1.5);
+            // Apply Canny edge detection straight into the caller's plane
+            if (mAdaptive.isEnabled() && mCannyApertureSize <= 5) {
+                // No other consumer here, so the derivatives are taken and
+                // rescaled row by row without full-frame Sobel planes
+                mAdaptive.normalize(smoothed, width, height, mCannyApertureSize);
+                adaptiveCanny(width, height, edgeData);
+            } else {
+                Mat smoothedMat(height, width, CV_8UC1, (void*)smoothed);
+                Mat edgesMat(height, width, CV_8UC1, edgeData);
+                Canny(smoothedMat, edgesMat, mCannyLowThreshold, mCannyHighThreshold, mCannyApertureSize);
+            }
             
-            // Apply Canny edge detection
-            Mat edgesMat;
-            Canny(blurredMat, edgesMat, mCannyLowThreshold, mCannyHighThreshold, mCannyApertureSize);
+            success = true;
+        } catch (const std::exception& e) {
+            LOGE("OpenCV Canny edge detection failed: %s", e.what());
+        }
+    }
+#endif
+    
+    // Use fallback if OpenCV is not available or failed
+    if (!success) {
+        if (mBlurSigma <= STACKED_BLUR_SIGMA_CUTOFF) {
+            smoothed = grayData;
+        }
+        success = computeEdgesFromGrayFallback(smoothed, width, height, edgeData);
+    }
+    if (!success || abandonAt(STAGE_POST)) {
+        return false;
+    }
+    
+    // Filtered edges stay packed when the caller writes them from mEdgeMask
+    const bool filtered = postProcessEdges(smoothed, edgeData, width, height);
+    if (maskResult != nullptr) {
+        *maskResult = filtered;
+    } else if (filtered) {
+        mEdgeMask.unpack(edgeData);
+    }
+    return success;
+}
+
+// Fragment filter and sub-pixel refinement on the packed mask
+bool OpenCVProcessor::postProcessEdges(
+    const uint8_t* smoothed,
+    uint8_t* edgeData,
+    int width,
+    int height,
+    const int16_t* dx,
+    const int16_t* dy
+) {
+    if (!mFragmentFilter.isEnabled() && !mSubpixelEnabled) {
+        return false;
+    }
+    mEdgeMask.pack(edgeData, width, height, 0, mKernels);
+    
+    // Drop fragments before sub-pixel refinement so their points are never computed
+    bool filtered = false;
+    if (mFragmentFilter.isEnabled()) {
+        mFragmentFilter.filter(mEdgeMask, mDeadline);
+        if (abandonAt(STAGE_POST)) {
+            return false;
+        }
+        filtered = mFragmentFilter.removedPixels() > 0;
+    }
+    
+    if (mSubpixelEnabled && !abandonAt(STAGE_POST)) {
+        if (dx != nullptr && dy != nullptr) {
+            SubpixelEdges::locate(dx, dy, mEdgeMask, mSubpixelPoints);
+        } else {
+            SubpixelEdges::locate(smoothed, mEdgeMask, mSubpixelPoints);
+        }
+    }
+    return filtered;
+}
+
+#ifdef HAVE_OPENCV
+// Canny on derivatives rescaled by the interpolated tile scales
+void OpenCVProcessor::adaptiveCanny(int width, int height, uint8_t* edgeData) {
+    Mat dxMat(height, width, CV_16SC1, mAdaptive.gradientX().data());
+    Mat dyMat(height, width, CV_16SC1, mAdaptive.gradientY().data());
+    Mat edgesMat(height, width, CV_8UC1, edgeData);
+    Canny(dxMat, dyMat, edgesMat, mCannyLowThreshold, mCannyHighThreshold);
+}
+#endif
+
+// Pre-Canny blur for the active path
+bool OpenCVProcessor::blurForEdges(
+    const uint8_t* grayData,
+    int width,
+    int height,
+    TrackedBytes& blurPlane
+) {
+    const size_t pixels = static_cast<size_t>(width) * height;
+    
+    // Large sigmas use the stacked box blur on either path
+    if (mBlurSigma > STACKED_BLUR_SIGMA_CUTOFF) {
+        blurPlane.resize(pixels);
+        if (!mStackedBlur.blur(grayData, blurPlane.data(), width, height, mBlurSigma, mDeadline)) {
+            abandonAt(STAGE_BLUR);
+        }
+        return true;
+    }
+    
+#ifdef HAVE_OPENCV
+    // Small sigmas blur with a Gaussian kernel (kept for sub-pixel refinement)
+    if (useOpenCV() && mBlurSigma > 0.0f) {
+        try {
+            const int radius = std::max(1, static_cast<int>(std::lround(1.5f * mBlurSigma)));
+            const Size kernel(2 * radius + 1, 2 * radius + 1);
+            Mat grayMat(height, width, CV_8UC1, (void*)grayData);
+            blurPlane.resize(pixels);
+            Mat blurredMat(height, width, CV_8UC1, blurPlane.data());
+            if (mDeadline == nullptr || !mDeadline->isSet()) {
+                GaussianBlur(grayMat, blurredMat, kernel, mBlurSigma);
+                return true;
+            }
             
-            // Convert edges back to RGBA (white edges on black background)
-            Mat outputMat(height, width, CV_8UC4);
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    uint8_t edgeValue = edgesMat.at<uint8_t>(y, x);
-                    outputMat.at<Vec4b>(y, x) = Vec4b(edgeValue, edgeValue, edgeValue, 255);
+            // Row bands of the full plane: the filter reads the rows around each
+            // band from the parent, so seams match a single full-frame call
+            for (int y0 = 0; y0 < height; y0 += DEADLINE_BAND_ROWS) {
+                if (abandonAt(STAGE_BLUR)) {
+                    break;
                 }
+                const int y1 = std::min(height, y0 + DEADLINE_BAND_ROWS);
+                Mat bandOut = blurredMat.rowRange(y0, y1);
+                GaussianBlur(grayMat.rowRange(y0, y1), bandOut, kernel, mBlurSigma);
             }
-            
-            // Copy to output buffer
-            std::memcpy(outputData, outputMat.data, width * height * 4);
-            
             return true;
         } catch (const std::exception& e) {
-            LOGE("OpenCV Canny edge detection failed: %s", e.what());
-            return applyCannyEdgeFallback(inputData, width, height, outputData);
+            LOGE("OpenCV Gaussian blur failed: %s", e.what());
         }
     }
 #endif
     
-    // Use fallback if OpenCV is not available
-    return applyCannyEdgeFallback(inputData, width, height, outputData);
+    // The built-in detector runs on the unblurred plane below the cutoff
+    return false;
 }
 
-// Convert to grayscale
-bool OpenCVProcessor::convertToGrayscale(
+// Replace an edge mask with u8 distances to the nearest edge
+bool OpenCVProcessor::computeDistancePlane(
+    uint8_t* plane,
+    int width,
+    int height,
+    float scale
+) {
+    if (abandonAt(STAGE_POST)) {
+        return false;
+    }
+    if (!mDistanceTransform.compute(plane, width, height, mDistanceMetric, mDistanceNearest, mDeadline)) {
+        abandonAt(STAGE_POST);
+        return false;
+    }
+    mDistanceTransform.toU8(plane, scale);
+    return true;
+}
+
+// Compute grayscale plane
+bool OpenCVProcessor::computeGrayPlane(
     const uint8_t* inputData,
     int width,
     int height,
-    uint8_t* outputData
+    uint8_t* grayData
 ) {
 #ifdef HAVE_OPENCV
-    if (mOpenCVAvailable) {
+    if (useOpenCV()) {
         try {
-            // Create input Mat from RGBA data
+            // Convert RGBA straight into the caller's plane
             Mat inputMat(height, width, CV_8UC4, (void*)inputData);
-            
-            // Convert to grayscale
-            Mat grayMat;
+            Mat grayMat(height, width, CV_8UC1, grayData);
             cvtColor(inputMat, grayMat, COLOR_RGBA2GRAY);
             
-            // Convert back to RGBA format (grayscale in all channels)
-            Mat outputMat(height, width, CV_8UC4);
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    uint8_t grayValue = grayMat.at<uint8_t>(y, x);
-                    outputMat.at<Vec4b>(y, x) = Vec4b(grayValue, grayValue, grayValue, 255);
-                }
-            }
-            
-            // Copy to output buffer
-            std::memcpy(outputData, outputMat.data, width * height * 4);
-            
             return true;
         } catch (const std::exception& e) {
             LOGE("OpenCV grayscale conversion failed: %s", e.what());
-            return convertToGrayscaleFallback(inputData, width, height, outputData);
+            return computeGrayPlaneFallback(inputData, width, height, grayData);
         }
     }
 #endif
     
     // Use fallback if OpenCV is not available
-    return convertToGrayscaleFallback(inputData, width, height, outputData);
+    return computeGrayPlaneFallback(inputData, width, height, grayData);
 }
 
 // Copy raw frame
@@ -232,23 +794,394 @@ void OpenCVProcessor::setCannyThresholds(double lowThreshold, double highThresho
     LOGI("Canny thresholds updated: low=%.1f, high=%.1f", lowThreshold, highThreshold);
 }
 
+// Set the Canny aperture
+bool OpenCVProcessor::setCannyApertureSize(int apertureSize) {
+    if (apertureSize != 3 && apertureSize != 5 && apertureSize != 7) {
+        LOGE("Invalid Canny aperture: %d", apertureSize);
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCannyApertureSize = apertureSize;
+    return true;
+}
+
+// Configure per-tile Canny thresholds
+void OpenCVProcessor::setAdaptiveThresholds(bool enabled, int tileSize) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mAdaptive.configure(enabled, tileSize);
+    if (!enabled) {
+        mAdaptive.release();
+    }
+    LOGI("Adaptive Canny thresholds %s (tile %dpx)", enabled ? "enabled" : "disabled", mAdaptive.tileSize());
+}
+
+// Get adaptive threshold state
+const AdaptiveThresholds& OpenCVProcessor::getAdaptiveThresholds() const {
+    return mAdaptive;
+}
+
+// Select processing implementation
+bool OpenCVProcessor::setImplementation(int implementation) {
+    if (implementation == IMPL_OPENCV && !mOpenCVAvailable) {
+        LOGW("OpenCV implementation requested but not available");
+        return false;
+    }
+    if (implementation < IMPL_AUTO || implementation > IMPL_SIMD) {
+        LOGE("Unknown implementation: %d", implementation);
+        return false;
+    }
+    if (implementation == IMPL_SIMD && !SimdKernels::isVectorized()) {
+        LOGW("SIMD kernels requested but not compiled in");
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    mImplementation = implementation;
+    mKernels = implementation == IMPL_FALLBACK ? &SimdKernels::reference() : &SimdKernels::vectorized();
+    mOutputWriter.setKernels(mKernels);
+    return true;
+}
+
+// Kernel set of the selected implementation
+const ImageKernels* OpenCVProcessor::kernels() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mKernels;
+}
+
+// Enable sub-pixel edge output
+void OpenCVProcessor::setSubpixelEdgesEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSubpixelEnabled = enabled;
+    if (!enabled) {
+        mSubpixelPoints.clear();
+    }
+    LOGI("Sub-pixel edges %s", enabled ? "enabled" : "disabled");
+}
+
+// Enable the perceptual edge hash side output
+void OpenCVProcessor::setEdgeHashEnabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEdgeHashEnabled = enabled;
+    LOGI("Edge hash %s", enabled ? "enabled" : "disabled");
+}
+
+// Get the edge hash of the last frame
+bool OpenCVProcessor::getEdgeHash(EdgeHash& hash) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mEdgeHashEnabled || mEdgeHashFrame == 0 || mEdgeHashFrame != mTotalFramesProcessed) {
+        return false;
+    }
+    hash = mEdgeHash;
+    return true;
+}
+
+// Set pre-Canny blur strength
+void OpenCVProcessor::setBlurSigma(float sigma) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBlurSigma = std::max(0.0f, std::min(sigma, 64.0f));
+    LOGI("Blur sigma set to %.2f (%s)", mBlurSigma,
+         mBlurSigma > STACKED_BLUR_SIGMA_CUTOFF ? "stacked box" : "Gaussian kernel");
+}
+
+// Set lens calibration for YUV ingest
+bool OpenCVProcessor::setLensCalibration(const LensCalibration* calibration) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (calibration == nullptr) {
+        mUndistort.clear();
+        return true;
+    }
+    return mUndistort.setCalibration(*calibration);
+}
+
+// Configure edge fragment removal
+void OpenCVProcessor::setFragmentFilter(int minPixels, int minExtent) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFragmentFilter.setThresholds(minPixels, minExtent);
+    LOGI("Fragment filter: min %d pixels, min extent %d", minPixels, minExtent);
+}
+
+// Get edge components of the last filtered frame
+const std::vector<EdgeComponent>& OpenCVProcessor::getEdgeComponents() const {
+    return mFragmentFilter.components();
+}
+
+// Configure DISTANCE mode
+void OpenCVProcessor::setDistanceOptions(int metric, bool trackNearest) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mDistanceMetric = metric == DISTANCE_CITY_BLOCK ? DISTANCE_CITY_BLOCK : DISTANCE_EUCLIDEAN;
+    mDistanceNearest = trackNearest;
+}
+
+// Get the distance field of the last DISTANCE frame
+const DistanceTransform& OpenCVProcessor::getDistanceField() const {
+    return mDistanceTransform;
+}
+
+// Copy sub-pixel edge points of the last EDGE frame
+void OpenCVProcessor::getSubpixelEdges(std::vector<float>& points) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    points = mSubpixelPoints;
+}
+
+namespace {
+
+const char kStateMagic[4] = {'E', 'P', 'S', '2'};
+const size_t kStateSize = 4 + 4 + 4 + 8 + 8 + 4 + 4 + 1 + 4 + 4 + 4 + 1 + 1 + 4 + 1 + 1 + 4 + 4 + 9 * 8 +
+                          4 + 4 + 4 + 4 + 5 * 8;
+
+// Largest plane a snapshot may ask for (8K RGBA)
+const uint64_t kMaxStatePlane = 7680ull * 4320ull * 4ull;
+
+// Most output targets a snapshot may reserve writer rows for
+const int kMaxStateTargets = 16;
+
+template <typename T>
+void putValue(uint8_t*& p, T value) {
+    std::memcpy(p, &value, sizeof(T));
+    p += sizeof(T);
+}
+
+template <typename T>
+T getValue(const uint8_t*& p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return value;
+}
+
+// Resize a plane and touch every page so the first frame does not fault
+void prefault(TrackedBytes& plane, uint64_t size) {
+    plane.resize(static_cast<size_t>(size));
+    volatile uint8_t* data = plane.data();
+    for (size_t i = 0; i < plane.size(); i += 4096) {
+        data[i] = 0;
+    }
+}
+
+} // namespace
+
+// Serialize configuration and buffer geometry
+void OpenCVProcessor::saveState(std::vector<uint8_t>& blob) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    blob.assign(kStateSize, 0);
+    uint8_t* p = blob.data();
+    std::memcpy(p, kStateMagic, 4);
+    p += 4;
+    putValue<uint32_t>(p, static_cast<uint32_t>(kStateSize));
+    putValue<int32_t>(p, mImplementation);
+    putValue<double>(p, mCannyLowThreshold);
+    putValue<double>(p, mCannyHighThreshold);
+    putValue<int32_t>(p, mCannyApertureSize);
+    putValue<float>(p, mBlurSigma);
+    putValue<uint8_t>(p, mSubpixelEnabled ? 1 : 0);
+    putValue<int32_t>(p, mFragmentFilter.minPixels());
+    putValue<int32_t>(p, mFragmentFilter.minExtent());
+    putValue<int32_t>(p, mDistanceMetric);
+    putValue<uint8_t>(p, mDistanceNearest ? 1 : 0);
+    putValue<uint8_t>(p, mAdaptive.isEnabled() ? 1 : 0);
+    putValue<int32_t>(p, mAdaptive.tileSize());
+    putValue<uint8_t>(p, mEdgeHashEnabled ? 1 : 0);
+    const LensCalibration& lens = mUndistort.calibration();
+    putValue<uint8_t>(p, mUndistort.isEnabled() ? 1 : 0);
+    putValue<int32_t>(p, lens.width);
+    putValue<int32_t>(p, lens.height);
+    for (double value : {lens.fx, lens.fy, lens.cx, lens.cy, lens.k1, lens.k2, lens.p1, lens.p2, lens.k3}) {
+        putValue<double>(p, value);
+    }
+    putValue<int32_t>(p, mLastWidth);
+    putValue<int32_t>(p, mLastHeight);
+    putValue<int32_t>(p, mLastMode);
+    putValue<int32_t>(p, mOutputWriter.targetCount());
+    putValue<uint64_t>(p, mResultPlane.size());
+    putValue<uint64_t>(p, mGrayPlane.size());
+    putValue<uint64_t>(p, mRgbaPlane.size());
+    putValue<uint64_t>(p, mBlurPlane.size());
+    putValue<uint64_t>(p, mStackedBlur.scratchPlane().size());
+}
+
+// Restore configuration and prefault scratch planes
+bool OpenCVProcessor::restoreState(const uint8_t* data, size_t size, bool prefaultPlanes) {
+    if (data == nullptr || size < kStateSize || std::memcmp(data, kStateMagic, 4) != 0) {
+        LOGE("Invalid processor state blob");
+        return false;
+    }
+    const uint8_t* p = data + 4;
+    if (getValue<uint32_t>(p) != kStateSize) {
+        LOGE("Unsupported processor state size");
+        return false;
+    }
+    
+    const int implementation = getValue<int32_t>(p);
+    const double cannyLow = getValue<double>(p);
+    const double cannyHigh = getValue<double>(p);
+    const int aperture = getValue<int32_t>(p);
+    const float blurSigma = getValue<float>(p);
+    const bool subpixel = getValue<uint8_t>(p) != 0;
+    const int fragmentPixels = getValue<int32_t>(p);
+    const int fragmentExtent = getValue<int32_t>(p);
+    const int distanceMetric = getValue<int32_t>(p);
+    const bool distanceNearest = getValue<uint8_t>(p) != 0;
+    const bool adaptive = getValue<uint8_t>(p) != 0;
+    const int adaptiveTile = getValue<int32_t>(p);
+    const bool edgeHash = getValue<uint8_t>(p) != 0;
+    const bool lensEnabled = getValue<uint8_t>(p) != 0;
+    LensCalibration lens;
+    lens.width = getValue<int32_t>(p);
+    lens.height = getValue<int32_t>(p);
+    for (double* value : {&lens.fx, &lens.fy, &lens.cx, &lens.cy, &lens.k1, &lens.k2, &lens.p1, &lens.p2, &lens.k3}) {
+        *value = getValue<double>(p);
+    }
+    const int lastWidth = getValue<int32_t>(p);
+    const int lastHeight = getValue<int32_t>(p);
+    const int lastMode = getValue<int32_t>(p);
+    const int writerTargets = getValue<int32_t>(p);
+    uint64_t planeSizes[5];
+    for (uint64_t& planeSize : planeSizes) {
+        planeSize = getValue<uint64_t>(p);
+        if (planeSize > kMaxStatePlane) {
+            LOGE("Processor state plane too large: %llu", static_cast<unsigned long long>(planeSize));
+            return false;
+        }
+    }
+    if (aperture != 3 && aperture != 5 && aperture != 7) {
+        LOGE("Invalid aperture in processor state: %d", aperture);
+        return false;
+    }
+    if (lastWidth < 0 || lastHeight < 0 ||
+        static_cast<uint64_t>(lastWidth) * static_cast<uint64_t>(lastHeight) * 4 > kMaxStatePlane ||
+        writerTargets < 0 || writerTargets > kMaxStateTargets) {
+        LOGE("Invalid frame geometry in processor state: %dx%d, %d targets", lastWidth, lastHeight, writerTargets);
+        return false;
+    }
+    
+    if (!mInitialized) {
+        initialize();
+    }
+    if (!setImplementation(implementation)) {
+        LOGW("Saved implementation %d unavailable, using auto", implementation);
+        setImplementation(IMPL_AUTO);
+    }
+    setCannyThresholds(cannyLow, cannyHigh);
+    setCannyApertureSize(aperture);
+    setBlurSigma(blurSigma);
+    setSubpixelEdgesEnabled(subpixel);
+    setFragmentFilter(fragmentPixels, fragmentExtent);
+    setDistanceOptions(distanceMetric, distanceNearest);
+    setAdaptiveThresholds(adaptive, adaptiveTile);
+    setEdgeHashEnabled(edgeHash);
+    if (!setLensCalibration(lensEnabled ? &lens : nullptr)) {
+        LOGW("Saved lens calibration rejected, undistortion disabled");
+    }
+    
+    const int pressure = MemoryBudget::instance().pressure();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLastWidth = lastWidth;
+        mLastHeight = lastHeight;
+        mLastMode = lastMode;
+        
+        // Skip prefaulting when memory is already tight; planes grow on demand
+        if (prefaultPlanes && pressure < PRESSURE_LOWER_RESOLUTION) {
+            prefault(mResultPlane, planeSizes[0]);
+            prefault(mGrayPlane, planeSizes[1]);
+            prefault(mRgbaPlane, planeSizes[2]);
+            prefault(mBlurPlane, planeSizes[3]);
+            prefault(mStackedBlur.scratchPlane(), planeSizes[4]);
+            
+            // Edge post-processing and writer rows at the last frame size
+            const size_t pixels = static_cast<size_t>(lastWidth) * lastHeight;
+            const bool edges = lastMode == MODE_EDGE || lastMode == MODE_DISTANCE;
+            if (edges && pixels > 0 && (mFragmentFilter.isEnabled() || mSubpixelEnabled)) {
+                mEdgeMask.resize(lastWidth, lastHeight);
+            }
+            if (edges && pixels > 0 && mFragmentFilter.isEnabled()) {
+                mFragmentFilter.reserve(pixels);
+            }
+            mOutputWriter.reserveBuffers(lastWidth, writerTargets);
+        }
+    }
+    
+    // Start the shared pool threads now rather than on the first frame
+    WorkerPool::shared();
+    
+    LOGI("Processor state restored (%dx%d, mode %d)", lastWidth, lastHeight, lastMode);
+    return true;
+}
+
+// Hash of the settings that shape results
+uint64_t OpenCVProcessor::configurationHash() const {
+    uint64_t hash = ContentHash::xxh64(kStateMagic, 4);
+    hash = ContentHash::combine(hash, useOpenCV() ? 1 : 0);
+    hash = ContentHash::combine(hash, static_cast<uint64_t>(mCannyApertureSize));
+    uint64_t bits;
+    std::memcpy(&bits, &mCannyLowThreshold, sizeof(bits));
+    hash = ContentHash::combine(hash, bits);
+    std::memcpy(&bits, &mCannyHighThreshold, sizeof(bits));
+    hash = ContentHash::combine(hash, bits);
+    uint32_t sigmaBits;
+    std::memcpy(&sigmaBits, &mBlurSigma, sizeof(sigmaBits));
+    hash = ContentHash::combine(hash, sigmaBits);
+    hash = ContentHash::combine(hash, static_cast<uint64_t>(mFragmentFilter.minPixels()));
+    hash = ContentHash::combine(hash, static_cast<uint64_t>(mFragmentFilter.minExtent()));
+    hash = ContentHash::combine(hash, static_cast<uint64_t>(mDistanceMetric));
+    hash = ContentHash::combine(hash, mDistanceNearest ? 1 : 0);
+    hash = ContentHash::combine(hash, mAdaptive.isEnabled() ? static_cast<uint64_t>(mAdaptive.tileSize()) : 0);
+    hash = ContentHash::combine(hash,
+        MemoryBudget::instance().pressure() >= PRESSURE_LOWER_RESOLUTION ? 1 : 0);
+    return hash;
+}
+
+// Per-frame outputs a cached result would leave stale
+bool OpenCVProcessor::hasFrameSideOutputs(ProcessingMode mode) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mEdgeHashEnabled && mode != MODE_RAW) {
+        return true;
+    }
+    // DISTANCE runs the same edge post-processing before the transform
+    if ((mode == MODE_EDGE || mode == MODE_DISTANCE) && (mSubpixelEnabled || mFragmentFilter.isEnabled())) {
+        return true;
+    }
+    return mode == MODE_DISTANCE && mDistanceNearest;
+}
+
+// Count a result cache hit as a frame
+void OpenCVProcessor::recordCachedFrame(const ProcessingMetrics& metrics) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFramesCached++;
+    updateStatistics(metrics);
+}
+
 // Get statistics
 std::string OpenCVProcessor::getStatistics() const {
-    char buffer[256];
+    char buffer[384];
     double avgTime = mTotalFramesProcessed > 0 
         ? static_cast<double>(mTotalProcessingTimeMs) / mTotalFramesProcessed 
         : 0.0;
     
     snprintf(buffer, sizeof(buffer),
-        "Frames: %llu, Avg Time: %.2fms, Last Time: %lldms, OpenCV: %s",
+        "Frames: %llu (cached %llu), Avg Time: %.2fms, Last Time: %lldms, OpenCV: %s, Kernels: %s, "
+        "Abandoned: %llu (input %llu, blur %llu, edges %llu, post %llu, output %llu)",
         static_cast<unsigned long long>(mTotalFramesProcessed),
+        static_cast<unsigned long long>(mFramesCached),
         avgTime,
         static_cast<long long>(mLastProcessingTimeMs),
-        mOpenCVAvailable ? "Yes" : "No");
+        mOpenCVAvailable ? "Yes" : "No",
+        mKernels == &SimdKernels::reference() ? "scalar" : SimdKernels::backend(),
+        static_cast<unsigned long long>(mFramesAbandoned),
+        static_cast<unsigned long long>(mAbandonedByStage[STAGE_INPUT]),
+        static_cast<unsigned long long>(mAbandonedByStage[STAGE_BLUR]),
+        static_cast<unsigned long long>(mAbandonedByStage[STAGE_EDGES]),
+        static_cast<unsigned long long>(mAbandonedByStage[STAGE_POST]),
+        static_cast<unsigned long long>(mAbandonedByStage[STAGE_OUTPUT]));
     
     return std::string(buffer);
 }
 
+// Release scratch planes on trimMemory
+size_t OpenCVProcessor::onTrimMemory(int /* level */) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return releaseScratch();
+}
+
 // Release resources
 void OpenCVProcessor::release() {
     if (mInitialized) {
@@ -258,6 +1191,64 @@ void OpenCVProcessor::release() {
     }
 }
 
+// Whether the OpenCV path should be used for this frame
+bool OpenCVProcessor::useOpenCV() const {
+    return mOpenCVAvailable && mImplementation != IMPL_FALLBACK && mImplementation != IMPL_SIMD;
+}
+
+// Whether every target can be produced from a half-resolution plane
+bool OpenCVProcessor::canProcessAtHalf(
+    int width,
+    int height,
+    const OutputTarget* targets,
+    int targetCount
+) {
+    if (width < 2 || height < 2) {
+        return false;
+    }
+    for (int i = 0; i < targetCount; i++) {
+        if (!MultiOutputWriter::validateTarget(targets[i], width / 2, height / 2)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Per-frame memory pressure follow-up
+void OpenCVProcessor::finishFrame(int pressure, bool halfResolution) {
+    // Sub-pixel points are reported in full-resolution coordinates
+    if (halfResolution && mSubpixelEnabled) {
+        for (float& coordinate : mSubpixelPoints) {
+            coordinate = coordinate * 2.0f + 0.5f;
+        }
+    }
+    if (halfResolution && mFragmentFilter.isEnabled()) {
+        mFragmentFilter.scaleComponents(2);
+    }
+    
+    if (pressure >= PRESSURE_DROP_CACHES) {
+        releaseScratch();
+    }
+}
+
+// Free all scratch planes and writer rows
+size_t OpenCVProcessor::releaseScratch() {
+    size_t released = releaseTracked(mResultPlane);
+    released += releaseTracked(mGrayPlane);
+    released += releaseTracked(mRgbaPlane);
+    released += releaseTracked(mBlurPlane);
+    released += mStackedBlur.release();
+    released += mDerived.release();
+    released += mUndistort.release();
+    released += releaseTracked(mBandScratch);
+    released += mOutputWriter.releaseBuffers();
+    released += mFragmentFilter.release();
+    released += mEdgeMask.release();
+    released += mAdaptive.release();
+    released += mDistanceTransform.release();
+    return released;
+}
+
 // Get current time in milliseconds
 int64_t OpenCVProcessor::getCurrentTimeMs() const {
     auto now = std::chrono::steady_clock::now();
@@ -266,10 +1257,17 @@ int64_t OpenCVProcessor::getCurrentTimeMs() const {
 }
 
 // Update statistics
-void OpenCVProcessor::updateStatistics(int64_t processingTimeMs) {
+void OpenCVProcessor::updateStatistics(const ProcessingMetrics& metrics) {
     mTotalFramesProcessed++;
-    mTotalProcessingTimeMs += processingTimeMs;
-    mLastProcessingTimeMs = processingTimeMs;
+    mTotalProcessingTimeMs += metrics.processingTimeMs;
+    mLastProcessingTimeMs = metrics.processingTimeMs;
+    mLastWidth = metrics.width;
+    mLastHeight = metrics.height;
+    mLastMode = metrics.mode;
+    if (metrics.abandoned) {
+        mFramesAbandoned++;
+        mAbandonedByStage[metrics.abandonedStage]++;
+    }
     
     // Log every 100 frames
     if (mTotalFramesProcessed % 100 == 0) {
@@ -277,70 +1275,343 @@ void OpenCVProcessor::updateStatistics(int64_t processingTimeMs) {
     }
 }
 
+// Record the first stage that found the frame late
+bool OpenCVProcessor::abandonAt(int stage) {
+    if (mAbandonedStage >= 0) {
+        return true;
+    }
+    if (mDeadline == nullptr || !mDeadline->expired()) {
+        return false;
+    }
+    mAbandonedStage = stage;
+    return true;
+}
+
+// Fill timing and abandonment, update statistics and detach the frame deadline
+ProcessingMetrics OpenCVProcessor::finishMetrics(ProcessingMetrics metrics, int64_t startTime, bool success) {
+    metrics.processingTimeMs = getCurrentTimeMs() - startTime;
+    metrics.abandoned = mAbandonedStage >= 0;
+    metrics.abandonedStage = metrics.abandoned ? mAbandonedStage : 0;
+    metrics.success = success && !metrics.abandoned;
+    mDeadline = nullptr;
+    mAbandonedStage = -1;
+    
+    updateStatistics(metrics);
+    
+    // Publish the frame's edge hash only once its outputs were written
+    if (mEdgeHashPending && metrics.success) {
+        mEdgeHash = mPendingEdgeHash;
+        mEdgeHashFrame = mTotalFramesProcessed;
+    }
+    mEdgeHashPending = false;
+    
+    return metrics;
+}
+
 // Fallback Canny edge detection
-bool OpenCVProcessor::applyCannyEdgeFallback(
-    const uint8_t* inputData,
+bool OpenCVProcessor::computeEdgesFromGrayFallback(
+    const uint8_t* grayData,
     int width,
     int height,
-    uint8_t* outputData
+    uint8_t* edgeData
 ) {
-    // Allocate temporary grayscale buffer
-    uint8_t* grayData = new uint8_t[width * height];
+    // Apply simple edge detection
+    if (mDeadline == nullptr || !mDeadline->isSet()) {
+        mKernels->simpleEdgeDetection(grayData, width, height, edgeData);
+        return true;
+    }
     
-    // Convert to grayscale
-    for (int i = 0; i < width * height; i++) {
-        int idx = i * 4;
-        grayData[i] = ImageUtils::rgbaToGray(
-            inputData[idx],
-            inputData[idx + 1],
-            inputData[idx + 2]
-        );
+    // Bands with a one-row halo on each side, so seams match the full-frame result
+    mBandScratch.resize(static_cast<size_t>(DEADLINE_BAND_ROWS + 2) * width);
+    for (int y0 = 0; y0 < height; y0 += DEADLINE_BAND_ROWS) {
+        if (abandonAt(STAGE_EDGES)) {
+            return false;
+        }
+        const int y1 = std::min(height, y0 + DEADLINE_BAND_ROWS);
+        const int top = std::max(0, y0 - 1);
+        const int bottom = std::min(height, y1 + 1);
+        mKernels->simpleEdgeDetection(grayData + static_cast<size_t>(top) * width, width, bottom - top,
+                                      mBandScratch.data());
+        memcpy(edgeData + static_cast<size_t>(y0) * width,
+               mBandScratch.data() + static_cast<size_t>(y0 - top) * width,
+               static_cast<size_t>(y1 - y0) * width);
+    }
+    return true;
+}
+
+// Fallback grayscale conversion
+bool OpenCVProcessor::computeGrayPlaneFallback(
+    const uint8_t* inputData,
+    int width,
+    int height,
+    uint8_t* grayData
+) {
+    mKernels->rgbaToGray(inputData, width, height, grayData);
+    return true;
+}
+
+// Hash the gray plane; stamped with the count the frame will have once finished
+void OpenCVProcessor::hashGray(const uint8_t* grayData, int width, int height) {
+    mEdgeHashPending = mEdgeHashEnabled &&
+        PerceptualHash::compute(grayData, width, height, 0, mPendingEdgeHash);
+}
+
+// Luma of the frame (half size under memory pressure)
+const uint8_t* OpenCVProcessor::deriveLuma(const FrameSource& source) {
+    TrackedBytes& luma = mDerived.plane(DERIVED_LUMA);
+    if (mDerived.reuse(DERIVED_LUMA)) {
+        return luma.data();
     }
     
-    // Apply simple edge detection
-    uint8_t* edgeData = new uint8_t[width * height];
-    ImageUtils::simpleEdgeDetection(grayData, width, height, edgeData);
+    luma.resize(static_cast<size_t>(mDerived.width()) * mDerived.height());
+    if (source.half) {
+        mKernels->rgbaToGrayHalf(source.rgba, source.width, source.height, luma.data());
+    } else if (!computeGrayPlane(source.rgba, source.width, source.height, luma.data())) {
+        return nullptr;
+    }
+    hashGray(luma.data(), mDerived.width(), mDerived.height());
+    mDerived.markComputed(DERIVED_LUMA);
+    return luma.data();
+}
+
+// Plane edges are detected on: blurred luma, or the luma when no blur applies
+const uint8_t* OpenCVProcessor::deriveSmoothed(const FrameSource& source) {
+    TrackedBytes& blurred = mDerived.plane(DERIVED_BLURRED);
+    if (mDerived.reuse(DERIVED_BLURRED)) {
+        return blurred.data();
+    }
     
-    // Convert back to RGBA
-    for (int i = 0; i < width * height; i++) {
-        int idx = i * 4;
-        uint8_t edgeValue = edgeData[i];
-        outputData[idx] = edgeValue;
-        outputData[idx + 1] = edgeValue;
-        outputData[idx + 2] = edgeValue;
-        outputData[idx + 3] = 255;
+    const uint8_t* luma = deriveLuma(source);
+    if (luma == nullptr) {
+        return nullptr;
+    }
+    if (!blurForEdges(luma, mDerived.width(), mDerived.height(), blurred)) {
+        return luma;
+    }
+    if (abandonAt(STAGE_BLUR)) {
+        return nullptr;
+    }
+    mDerived.markComputed(DERIVED_BLURRED);
+    return blurred.data();
+}
+
+// Pyramid level (0 = luma), built from the level above it
+const uint8_t* OpenCVProcessor::derivePyramid(const FrameSource& source, int level) {
+    if (level <= 0) {
+        return deriveLuma(source);
+    }
+    TrackedBytes& plane = mDerived.pyramidLevel(level);
+    if (mDerived.reuse(DERIVED_PYRAMID, level)) {
+        return plane.data();
     }
     
-    delete[] grayData;
-    delete[] edgeData;
+    const uint8_t* above = derivePyramid(source, level - 1);
+    if (above == nullptr) {
+        return nullptr;
+    }
+    plane.resize(static_cast<size_t>(mDerived.levelWidth(level)) * mDerived.levelHeight(level));
+    DerivedImageCache::halveGray(above, mDerived.levelWidth(level - 1), mDerived.levelHeight(level - 1), plane.data());
+    mDerived.markComputed(DERIVED_PYRAMID, level);
+    return plane.data();
+}
+
+// Sobel derivatives of the smoothed plane, shared by the frame's consumers
+bool OpenCVProcessor::deriveGradients(const FrameSource& source) {
+    if (mDerived.reuse(DERIVED_GRADIENTS)) {
+        return true;
+    }
     
+    const uint8_t* smoothed = deriveSmoothed(source);
+    if (smoothed == nullptr) {
+        return false;
+    }
+    const int width = mDerived.width();
+    const int height = mDerived.height();
+    const size_t pixels = static_cast<size_t>(width) * height;
+    DerivedImageCache::ShortBuffer& dx = mDerived.gradientX();
+    DerivedImageCache::ShortBuffer& dy = mDerived.gradientY();
+    dx.resize(pixels);
+    dy.resize(pixels);
+    sobelDerivatives(smoothed, width, height, dx.data(), dy.data());
+    mDerived.markComputed(DERIVED_GRADIENTS);
     return true;
 }
 
-// Fallback grayscale conversion
-bool OpenCVProcessor::convertToGrayscaleFallback(
-    const uint8_t* inputData,
+// Sobel derivatives (Canny's aperture on the OpenCV path, 3x3 otherwise)
+void OpenCVProcessor::sobelDerivatives(
+    const uint8_t* smoothed,
     int width,
     int height,
-    uint8_t* outputData
+    int16_t* dx,
+    int16_t* dy
 ) {
-    for (int i = 0; i < width * height; i++) {
-        int idx = i * 4;
-        uint8_t gray = ImageUtils::rgbaToGray(
-            inputData[idx],
-            inputData[idx + 1],
-            inputData[idx + 2]
-        );
-        outputData[idx] = gray;
-        outputData[idx + 1] = gray;
-        outputData[idx + 2] = gray;
-        outputData[idx + 3] = 255;
+#ifdef HAVE_OPENCV
+    if (useOpenCV()) {
+        try {
+            // Same derivatives Canny computes internally
+            Mat smoothedMat(height, width, CV_8UC1, (void*)smoothed);
+            Mat dxMat(height, width, CV_16SC1, dx);
+            Mat dyMat(height, width, CV_16SC1, dy);
+            Sobel(smoothedMat, dxMat, CV_16S, 1, 0, mCannyApertureSize, 1, 0, BORDER_REPLICATE);
+            Sobel(smoothedMat, dyMat, CV_16S, 0, 1, mCannyApertureSize, 1, 0, BORDER_REPLICATE);
+            return;
+        } catch (const std::exception& e) {
+            LOGE("OpenCV Sobel failed: %s", e.what());
+        }
     }
-    return true;
+#endif
+    
+    DerivedImageCache::sobelGradients(smoothed, width, height, dx, dy);
+}
+
+// Canny mask, fragment-filtered and sub-pixel refined as in computeEdgesFromGray
+const uint8_t* OpenCVProcessor::deriveEdges(const FrameSource& source) {
+    TrackedBytes& edges = mDerived.plane(DERIVED_EDGES);
+    if (mDerived.reuse(DERIVED_EDGES)) {
+        return edges.data();
+    }
+    
+    const uint8_t* smoothed = deriveSmoothed(source);
+    if (smoothed == nullptr || abandonAt(STAGE_EDGES)) {
+        return nullptr;
+    }
+    const int width = mDerived.width();
+    const int height = mDerived.height();
+    edges.resize(static_cast<size_t>(width) * height);
+    bool success = false;
+    // 3x3 derivatives of smoothed, when available, for sub-pixel refinement
+    const int16_t* refineX = nullptr;
+    const int16_t* refineY = nullptr;
+    
+#ifdef HAVE_OPENCV
+    if (useOpenCV()) {
+        try {
+            Mat edgesMat(height, width, CV_8UC1, edges.data());
+            // Canny rescales its thresholds for the 7x7 aperture, so only
+            // the 3x3 and 5x5 apertures run from the shared gradients
+            if (mCannyApertureSize <= 5 && deriveGradients(source)) {
+                if (mCannyApertureSize == 3) {
+                    refineX = mDerived.gradientX().data();
+                    refineY = mDerived.gradientY().data();
+                }
+                if (mAdaptive.isEnabled()) {
+                    // Rescaled into the adaptive buffers; the shared gradients stay as derived
+                    mAdaptive.normalize(mDerived.gradientX().data(), mDerived.gradientY().data(),
+                                        width, height, mCannyApertureSize);
+                    adaptiveCanny(width, height, edges.data());
+                } else {
+                    Mat dxMat(height, width, CV_16SC1, mDerived.gradientX().data());
+                    Mat dyMat(height, width, CV_16SC1, mDerived.gradientY().data());
+                    Canny(dxMat, dyMat, edgesMat, mCannyLowThreshold, mCannyHighThreshold);
+                }
+            } else {
+                Mat smoothedMat(height, width, CV_8UC1, (void*)smoothed);
+                Canny(smoothedMat, edgesMat, mCannyLowThreshold, mCannyHighThreshold, mCannyApertureSize);
+            }
+            success = true;
+        } catch (const std::exception& e) {
+            LOGE("OpenCV Canny edge detection failed: %s", e.what());
+        }
+    }
+#endif
+    
+    if (!success) {
+        if (mBlurSigma <= STACKED_BLUR_SIGMA_CUTOFF) {
+            smoothed = deriveLuma(source);
+        }
+        refineX = nullptr;
+        refineY = nullptr;
+        success = computeEdgesFromGrayFallback(smoothed, width, height, edges.data());
+    }
+    if (!success || abandonAt(STAGE_POST)) {
+        return nullptr;
+    }
+    
+    if (postProcessEdges(smoothed, edges.data(), width, height, refineX, refineY)) {
+        mEdgeMask.unpack(edges.data());
+    }
+    if (abandonAt(STAGE_POST)) {
+        return nullptr;
+    }
+    mDerived.markComputed(DERIVED_EDGES);
+    return edges.data();
+}
+
+// Distance plane from the Canny mask
+const uint8_t* OpenCVProcessor::deriveDistance(const FrameSource& source) {
+    TrackedBytes& distance = mDerived.plane(DERIVED_DISTANCE);
+    if (mDerived.reuse(DERIVED_DISTANCE)) {
+        return distance.data();
+    }
+    
+    const uint8_t* edges = deriveEdges(source);
+    if (edges == nullptr) {
+        return nullptr;
+    }
+    const size_t pixels = static_cast<size_t>(mDerived.width()) * mDerived.height();
+    distance.assign(edges, edges + pixels);
+    if (!computeDistancePlane(distance.data(), mDerived.width(), mDerived.height(), source.half ? 2.0f : 1.0f)) {
+        return nullptr;
+    }
+    mDerived.markComputed(DERIVED_DISTANCE);
+    return distance.data();
+}
+
+// Deepest pyramid level that still covers every target of a request
+int OpenCVProcessor::pyramidLevelFor(const FrameRequest& request) const {
+    int level = 0;
+    while (level < DERIVED_PYRAMID_LEVELS) {
+        const int nextWidth = mDerived.levelWidth(level + 1);
+        const int nextHeight = mDerived.levelHeight(level + 1);
+        for (int i = 0; i < request.targetCount; i++) {
+            if (request.targets[i].width > nextWidth || request.targets[i].height > nextHeight) {
+                return level;
+            }
+        }
+        level++;
+    }
+    return level;
 }
 
 // ImageUtils namespace implementation
 namespace ImageUtils {
+    void rgbaToGrayPlane(
+        const uint8_t* rgba,
+        int width,
+        int height,
+        uint8_t* gray
+    ) {
+        const size_t pixels = static_cast<size_t>(width) * height;
+        for (size_t i = 0; i < pixels; i++) {
+            const uint8_t* px = rgba + i * 4;
+            gray[i] = rgbaToGray(px[0], px[1], px[2]);
+        }
+    }
+    
+    void rgbaToGrayHalf(
+        const uint8_t* rgba,
+        int width,
+        int height,
+        uint8_t* gray
+    ) {
+        const int halfWidth = width / 2;
+        const int halfHeight = height / 2;
+        const size_t stride = static_cast<size_t>(width) * 4;
+        
+        for (int y = 0; y < halfHeight; y++) {
+            const uint8_t* top = rgba + static_cast<size_t>(2 * y) * stride;
+            const uint8_t* bottom = top + stride;
+            uint8_t* out = gray + static_cast<size_t>(y) * halfWidth;
+            for (int x = 0; x < halfWidth; x++) {
+                const uint8_t* a = top + x * 8;
+                const uint8_t* b = bottom + x * 8;
+                int sum = rgbaToGray(a[0], a[1], a[2]) + rgbaToGray(a[4], a[5], a[6]) +
+                          rgbaToGray(b[0], b[1], b[2]) + rgbaToGray(b[4], b[5], b[6]);
+                out[x] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+    
     void simpleEdgeDetection(
         const uint8_t* grayscale,
         int width,
@@ -393,6 +1664,111 @@ namespace ImageUtils {
         }
     }
     
+    void yuv420ToRgba(
+        const uint8_t* yData,
+        const uint8_t* uData,
+        const uint8_t* vData,
+        int width,
+        int height,
+        int yRowStride,
+        int uvRowStride,
+        int uvPixelStride,
+        uint8_t* rgba
+    ) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                int yIndex = y * yRowStride + x;
+                int uvIndex = (y / 2) * uvRowStride + (x / 2) * uvPixelStride;
+                
+                int Y = yData[yIndex];
+                int U = uData[uvIndex];
+                int V = vData[uvIndex];
+                
+                // YUV to RGB conversion
+                int C = Y - 16;
+                int D = U - 128;
+                int E = V - 128;
+                
+                int R = (298 * C + 409 * E + 128) >> 8;
+                int G = (298 * C - 100 * D - 208 * E + 128) >> 8;
+                int B = (298 * C + 516 * D + 128) >> 8;
+                
+                // Clamp values
+                R = R < 0 ? 0 : (R > 255 ? 255 : R);
+                G = G < 0 ? 0 : (G > 255 ? 255 : G);
+                B = B < 0 ? 0 : (B > 255 ? 255 : B);
+                
+                // Write RGBA
+                int outIndex = (y * width + x) * 4;
+                rgba[outIndex] = static_cast<uint8_t>(R);
+                rgba[outIndex + 1] = static_cast<uint8_t>(G);
+                rgba[outIndex + 2] = static_cast<uint8_t>(B);
+                rgba[outIndex + 3] = 255;
+            }
+        }
+    }
+    
+    void lumaFromVideoRange(
+        const uint8_t* yData,
+        int width,
+        int height,
+        int yRowStride,
+        uint8_t* gray
+    ) {
+        // Same 298/256 scale as the RGB conversion, so results match the RGBA route
+        uint8_t table[256];
+        for (int i = 0; i < 256; i++) {
+            int value = (298 * (i - 16) + 128) >> 8;
+            table[i] = static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+        
+        for (int y = 0; y < height; y++) {
+            const uint8_t* row = yData + static_cast<size_t>(y) * yRowStride;
+            uint8_t* out = gray + static_cast<size_t>(y) * width;
+            for (int x = 0; x < width; x++) {
+                out[x] = table[row[x]];
+            }
+        }
+    }
+    
+    void lumaFromVideoRangeHalf(
+        const uint8_t* yData,
+        int width,
+        int height,
+        int yRowStride,
+        uint8_t* gray
+    ) {
+        const int halfWidth = width / 2;
+        const int halfHeight = height / 2;
+        
+        for (int y = 0; y < halfHeight; y++) {
+            const uint8_t* top = yData + static_cast<size_t>(2 * y) * yRowStride;
+            const uint8_t* bottom = top + yRowStride;
+            uint8_t* out = gray + static_cast<size_t>(y) * halfWidth;
+            for (int x = 0; x < halfWidth; x++) {
+                int luma = (top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1] + 2) >> 2;
+                int value = (298 * (luma - 16) + 128) >> 8;
+                out[x] = static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+            }
+        }
+    }
+    
+    void expandGrayToRgba(
+        const uint8_t* gray,
+        int width,
+        int height,
+        uint8_t* rgba
+    ) {
+        for (int i = 0; i < width * height; i++) {
+            uint8_t value = gray[i];
+            uint8_t* px = rgba + i * 4;
+            px[0] = value;
+            px[1] = value;
+            px[2] = value;
+            px[3] = 255;
+        }
+    }
+    
     void applyThreshold(
         const uint8_t* input,
         int width,
@@ -404,4 +1780,17 @@ namespace ImageUtils {
             output[i] = input[i] > threshold ? 255 : 0;
         }
     }
+    
+    void packMask(
+        const uint8_t* mask,
+        size_t count,
+        uint8_t* bits
+    ) {
+        std::memset(bits, 0, (count + 7) / 8);
+        for (size_t i = 0; i < count; i++) {
+            if (mask[i] != 0) {
+                bits[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+            }
+        }
+    }
 }
\ No newline at end of file
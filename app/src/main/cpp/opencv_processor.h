@@ -1,23 +1,55 @@
 #ifndef EDGEDETECTOR_OPENCV_PROCESSOR_H
 #define EDGEDETECTOR_OPENCV_PROCESSOR_H
 
-#include <jni.h>
-#include <android/log.h>
 #include <cstdint>
+#include <mutex>
 #include <string>
+#include <vector>
+#include "adaptive_thresholds.h"
+#include "bit_mask.h"
+#include "derived_images.h"
+#include "distance_transform.h"
+#include "edge_components.h"
+#include "frame_deadline.h"
+#include "frame_output.h"
+#include "lens_undistort.h"
+#include "native_memory.h"
+#include "perceptual_hash.h"
+#include "simd_kernels.h"
+#include "stacked_blur.h"
 
-// Logging macro
+// Logging macro (stderr on host builds so the pipeline can run off-device)
 #define LOG_TAG "OpenCVProcessor"
+#ifdef __ANDROID__
+#include <android/log.h>
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+#define HOST_LOG(level, ...) (std::fprintf(stderr, "%s " LOG_TAG ": ", level), \
+                              std::fprintf(stderr, __VA_ARGS__), std::fputc('\n', stderr))
+#define LOGI(...) HOST_LOG("I", __VA_ARGS__)
+#define LOGD(...) ((void)0)
+#define LOGE(...) HOST_LOG("E", __VA_ARGS__)
+#define LOGW(...) HOST_LOG("W", __VA_ARGS__)
+#endif
 
 // Processing modes
 enum ProcessingMode {
     MODE_RAW = 0,       // No processing
     MODE_EDGE = 1,      // Canny edge detection
-    MODE_GRAYSCALE = 2  // Grayscale conversion
+    MODE_GRAYSCALE = 2, // Grayscale conversion
+    MODE_DISTANCE = 3   // Distance to the nearest Canny edge (u8 pixels, clamped)
+};
+
+// Processing implementations (selectable for conformance checks)
+enum ProcessingImplementation {
+    IMPL_AUTO = 0,      // OpenCV when available, fallback otherwise
+    IMPL_OPENCV = 1,    // OpenCV only
+    IMPL_FALLBACK = 2,  // Built-in fallback on the scalar reference kernels
+    IMPL_SIMD = 3       // Built-in fallback on the vectorized kernels (bit-exact with IMPL_FALLBACK)
 };
 
 // Performance metrics structure
@@ -27,12 +59,21 @@ struct ProcessingMetrics {
     int height;
     int mode;
     bool success;
+    bool abandoned;         // Deadline passed: targets left untouched (previous output)
+    int abandonedStage;     // PipelineStage the frame was dropped at (when abandoned)
 };
 
-class OpenCVProcessor {
+// One processing mode and the targets written from it (processFrameRequests)
+struct FrameRequest {
+    int mode;                       // ProcessingMode
+    const OutputTarget* targets;
+    int targetCount;
+};
+
+class OpenCVProcessor : public MemoryTrimListener {
 public:
     OpenCVProcessor();
-    ~OpenCVProcessor();
+    ~OpenCVProcessor() override;
 
     /**
      * Initialize OpenCV processor
@@ -53,6 +94,7 @@ public:
      * @param height Frame height
      * @param mode Processing mode
      * @param outputData Output processed frame data (must be pre-allocated)
+     * @param deadlineMs Steady-clock deadline (FrameDeadline::nowMs()), 0 = none
      * @return Processing metrics
      */
     ProcessingMetrics processFrame(
@@ -60,7 +102,120 @@ public:
         int width,
         int height,
         ProcessingMode mode,
-        uint8_t* outputData
+        uint8_t* outputData,
+        int64_t deadlineMs = 0
+    );
+
+    /**
+     * Process frame once and write the result to several output targets
+     * Downscaled targets are produced from the same row traversal as the
+     * full-size ones, so each extra output costs roughly one pass over
+     * rows that are already in cache.
+     * Under memory pressure (PRESSURE_LOWER_RESOLUTION) EDGE and GRAYSCALE
+     * are computed at half resolution and scaled back up to the targets.
+     * With a deadline, the blurs and the built-in detector run in bands of
+     * DEADLINE_BAND_ROWS, the fragment filter and distance transform check
+     * it between their passes, and every stage checks it before it starts;
+     * a late frame is abandoned without touching the targets
+     * (metrics.abandoned, success false).
+     * @param inputData Input RGBA frame data
+     * @param width Frame width
+     * @param height Frame height
+     * @param mode Processing mode
+     * @param targets Output targets (sizes must not exceed the frame size)
+     * @param targetCount Number of output targets
+     * @param deadlineMs Steady-clock deadline (FrameDeadline::nowMs()), 0 = none
+     * @return Processing metrics
+     */
+    ProcessingMetrics processFrame(
+        const uint8_t* inputData,
+        int width,
+        int height,
+        ProcessingMode mode,
+        const OutputTarget* targets,
+        int targetCount,
+        int64_t deadlineMs = 0
+    );
+
+    /**
+     * Produce several modes from one RGBA frame. Luma, blurred luma,
+     * pyramid levels, gradients, the Canny mask and the distance plane are
+     * derived lazily and each at most once, however many requests need
+     * them (e.g. RAW for display, EDGE for streaming and a gray thumbnail
+     * together cost one luma conversion and one blur). GRAYSCALE requests
+     * whose targets all fit in a pyramid level are written from the
+     * deepest such level. Under memory pressure every derived image is
+     * half size, as in processFrame.
+     * @param inputData Input RGBA frame data
+     * @param width Frame width
+     * @param height Frame height
+     * @param requests Modes with their output targets
+     * @param requestCount Number of requests
+     * @param extraImages DERIVED_IMAGE_BIT mask of images to derive even if
+     *                    no request needs them (read via getDerivedImages)
+     * @param deadlineMs Steady-clock deadline (FrameDeadline::nowMs()), 0 = none;
+     *        a late frame is abandoned as in processFrame and the targets
+     *        not yet written keep their previous contents
+     * @return Processing metrics (mode of the first request)
+     */
+    ProcessingMetrics processFrameRequests(
+        const uint8_t* inputData,
+        int width,
+        int height,
+        const FrameRequest* requests,
+        int requestCount,
+        uint32_t extraImages = 0,
+        int64_t deadlineMs = 0
+    );
+
+    /**
+     * Derived images and computed/reused report of the last processFrameRequests
+     */
+    const DerivedImageCache& getDerivedImages() const;
+
+    /**
+     * Process camera YUV_420_888 frame and write all output targets
+     * EDGE and GRAYSCALE start from the Y plane without an RGBA round trip.
+     * RAW frames written to full-size NV12 targets keep the camera chroma.
+     * @param planes Input Y, U and V planes with their strides
+     * @param width Frame width
+     * @param height Frame height
+     * @param mode Processing mode
+     * @param targets Output targets (sizes must not exceed the frame size)
+     * @param targetCount Number of output targets
+     * @param deadlineMs Steady-clock deadline (FrameDeadline::nowMs()), 0 = none
+     * @return Processing metrics
+     */
+    ProcessingMetrics processFrameYuv(
+        const YuvPlanes& planes,
+        int width,
+        int height,
+        ProcessingMode mode,
+        const OutputTarget* targets,
+        int targetCount,
+        int64_t deadlineMs = 0
+    );
+
+    /**
+     * Process an already-gray frame (e.g. a grayscale image decode) and
+     * write all output targets. RAW and GRAYSCALE both write the gray plane.
+     * @param grayData Input single-channel frame data
+     * @param width Frame width
+     * @param height Frame height
+     * @param mode Processing mode
+     * @param targets Output targets (sizes must not exceed the frame size)
+     * @param targetCount Number of output targets
+     * @param deadlineMs Steady-clock deadline (FrameDeadline::nowMs()), 0 = none
+     * @return Processing metrics
+     */
+    ProcessingMetrics processGrayFrame(
+        const uint8_t* grayData,
+        int width,
+        int height,
+        ProcessingMode mode,
+        const OutputTarget* targets,
+        int targetCount,
+        int64_t deadlineMs = 0
     );
 
     /**
@@ -113,11 +268,171 @@ public:
      */
     void setCannyThresholds(double lowThreshold, double highThreshold);
 
+    /**
+     * Set the Canny/Sobel aperture (3, 5 or 7; the fallback path always uses 3)
+     * @return false for other sizes (aperture unchanged)
+     */
+    bool setCannyApertureSize(int apertureSize);
+
+    /**
+     * Vary the Canny thresholds per tile from local gradient statistics
+     * (OpenCV path, 3x3 and 5x5 apertures). The configured thresholds stay
+     * the frame-wide reference; each tile scales them by its contrast
+     * relative to the frame, interpolated between tile centres.
+     * @param enabled Adaptive thresholds on or off
+     * @param tileSize Tile side in processing-plane pixels
+     */
+    void setAdaptiveThresholds(bool enabled, int tileSize);
+
+    /**
+     * Adaptive threshold state and tile scales of the last frame
+     */
+    const AdaptiveThresholds& getAdaptiveThresholds() const;
+
+    /**
+     * Select processing implementation
+     * @param implementation ProcessingImplementation
+     * @return false if the implementation is not available in this build
+     */
+    bool setImplementation(int implementation);
+
+    /**
+     * Conversion kernels of the selected implementation, for writing
+     * results produced outside processFrame (cached images)
+     */
+    const ImageKernels* kernels() const;
+
+    /**
+     * Enable sub-pixel localization of Canny edge pixels (EDGE mode)
+     */
+    void setSubpixelEdgesEnabled(bool enabled);
+
+    /**
+     * Copy the sub-pixel edge points of the last EDGE frame as packed (x, y)
+     * pairs (taken under the frame lock, so safe while frames run)
+     */
+    void getSubpixelEdges(std::vector<float>& points) const;
+
+    /**
+     * Compute a perceptual edge hash of every frame's gray plane as a side
+     * output (EDGE, GRAYSCALE and DISTANCE; processFrameRequests when luma
+     * is derived). Costs one vectorized read of the plane.
+     */
+    void setEdgeHashEnabled(bool enabled);
+
+    /**
+     * Edge hash of the last processed frame
+     * @return false if hashing is disabled, the last frame had no gray plane,
+     *         or it failed or was abandoned
+     */
+    bool getEdgeHash(EdgeHash& hash) const;
+
+    /**
+     * Set the pre-Canny blur strength (EDGE and DISTANCE modes)
+     * Up to STACKED_BLUR_SIGMA_CUTOFF a Gaussian kernel of radius 1.5 sigma
+     * is used; above it the stacked box blur, whose cost does not grow with
+     * sigma. The built-in fallback detector only blurs above the cutoff.
+     * @param sigma Gaussian sigma (0 disables the blur, default 1.5)
+     */
+    void setBlurSigma(float sigma);
+
+    /**
+     * Undistort camera frames during YUV ingest (processFrameYuv EDGE,
+     * GRAYSCALE and DISTANCE; RAW output is left as captured). The fixed-point
+     * remap table is built once per frame size and applied while the luma
+     * is converted, so it costs no extra pass.
+     * @param calibration Intrinsics and distortion, or nullptr to disable
+     * @return false for invalid calibration (undistortion disabled)
+     */
+    bool setLensCalibration(const LensCalibration* calibration);
+
+    /**
+     * Remove short edge fragments after Canny (EDGE mode, 0 disables a threshold)
+     * Thresholds apply to the processed plane, which is half size under memory pressure
+     * @param minPixels Minimum component size in pixels
+     * @param minExtent Minimum bounding-box side in pixels
+     */
+    void setFragmentFilter(int minPixels, int minExtent);
+
+    /**
+     * Components of the last filtered EDGE frame (kept and removed)
+     */
+    const std::vector<EdgeComponent>& getEdgeComponents() const;
+
+    /**
+     * Configure DISTANCE mode
+     * @param metric DistanceMetric
+     * @param trackNearest Record the nearest edge pixel for every pixel
+     */
+    void setDistanceOptions(int metric, bool trackNearest);
+
+    /**
+     * Distance field of the last DISTANCE frame (processing-plane resolution)
+     */
+    const DistanceTransform& getDistanceField() const;
+
+    /**
+     * Serialize configuration and buffer geometry to a small blob so a
+     * processor recreated after backgrounding can skip setup and warm-up
+     * Layout (little-endian): "EPS2" | u32 size | i32 implementation
+     * | f64 canny low | f64 canny high | i32 aperture | f32 blur sigma
+     * | u8 sub-pixel | i32 fragment pixels | i32 fragment extent
+     * | i32 distance metric | u8 nearest | u8 adaptive | i32 adaptive tile
+     * | u8 edge hash | u8 lens | i32 lens width | i32 lens height
+     * | f64 fx fy cx cy k1 k2 p1 p2 k3 | i32 width | i32 height | i32 mode
+     * | i32 output targets
+     * | u64 plane sizes x 5 (result, gray, RGBA, blur, blur scratch)
+     * Blobs from other versions are rejected.
+     * @param blob Output blob (replaced)
+     */
+    void saveState(std::vector<uint8_t>& blob);
+
+    /**
+     * Restore a saveState() blob: applies the configuration and allocates
+     * and prefaults the scratch planes at the saved sizes. Initializes the
+     * processor if needed.
+     * @param prefaultPlanes false to apply only the configuration (planes
+     *        grow on demand), e.g. when copying settings to another processor
+     * @return false for malformed blobs (state left unchanged)
+     */
+    bool restoreState(const uint8_t* data, size_t size, bool prefaultPlanes = true);
+
+    /**
+     * Hash of every setting that shapes RGBA/encoded-input results
+     * (implementation path, Canny, blur, fragment filter, distance options,
+     * adaptive thresholds, reduced resolution under memory pressure), for
+     * keying cached results. Lens calibration only affects YUV ingest and
+     * is not included.
+     */
+    uint64_t configurationHash() const;
+
+    /**
+     * Whether frames in a mode produce side outputs beyond the result image
+     * (sub-pixel points and edge components in EDGE and DISTANCE,
+     * nearest-edge indices in DISTANCE, the edge hash). A cached result
+     * cannot restore them, so result caches are bypassed while any is
+     * enabled.
+     */
+    bool hasFrameSideOutputs(ProcessingMode mode) const;
+
+    /**
+     * Count a frame served from a result cache like a processed one, so
+     * frame statistics and last-frame outputs (the edge hash) describe it
+     */
+    void recordCachedFrame(const ProcessingMetrics& metrics);
+
     /**
      * Get current processing statistics
      */
     std::string getStatistics() const;
 
+    /**
+     * Release scratch planes (MemoryBudget trim callback)
+     * @param level Android trim level
+     * @return Bytes released
+     */
+    size_t onTrimMemory(int level) override;
+
     /**
      * Release resources
      */
@@ -126,34 +441,194 @@ public:
 private:
     bool mInitialized;
     bool mOpenCVAvailable;
+    int mImplementation;
+    const ImageKernels* mKernels;   // Scalar reference for IMPL_FALLBACK, vectorized otherwise
     
     // Canny edge detection parameters
     double mCannyLowThreshold;
     double mCannyHighThreshold;
     int mCannyApertureSize;
+    float mBlurSigma;
     
     // Statistics
     uint64_t mTotalFramesProcessed;
     uint64_t mTotalProcessingTimeMs;
     int64_t mLastProcessingTimeMs;
+    uint64_t mFramesAbandoned;
+    uint64_t mFramesCached;
+    uint64_t mAbandonedByStage[STAGE_COUNT];
+    
+    // Geometry of the last processed frame (kept in state snapshots)
+    int mLastWidth;
+    int mLastHeight;
+    int mLastMode;
+    
+    // Single-channel result plane (gray or edges) and multi-target writer
+    TrackedBytes mResultPlane;
+    TrackedBytes mGrayPlane;
+    TrackedBytes mRgbaPlane;
+    TrackedBytes mBlurPlane;
+    StackedBlur mStackedBlur;
+    
+    // Guards scratch planes against trimMemory from another thread
+    mutable std::mutex mMutex;
+    
+    // Sub-pixel edge output
+    bool mSubpixelEnabled;
+    std::vector<float> mSubpixelPoints;
+    
+    // Per-tile Canny thresholds
+    AdaptiveThresholds mAdaptive;
+    
+    // Fragment removal on the edge mask
+    EdgeComponentFilter mFragmentFilter;
+    BitMask mEdgeMask;
+    
+    // Perceptual hash side output; valid while mEdgeHashFrame matches the frame
+    // count. hashGray fills mPendingEdgeHash and finishMetrics publishes it
+    // only for frames that succeed.
+    bool mEdgeHashEnabled;
+    EdgeHash mEdgeHash;
+    uint64_t mEdgeHashFrame;
+    EdgeHash mPendingEdgeHash;
+    bool mEdgeHashPending;
+    
+    // DISTANCE mode
+    DistanceTransform mDistanceTransform;
+    int mDistanceMetric;
+    bool mDistanceNearest;
+    MultiOutputWriter mOutputWriter;
+    
+    // Deadline of the frame in progress (nullptr outside processing calls)
+    const FrameDeadline* mDeadline;
+    int mAbandonedStage;
+    TrackedBytes mBandScratch;
+    
+    // Lens undistortion fused into YUV ingest
+    LensUndistort mUndistort;
+    
+    // Per-frame derived images for processFrameRequests
+    DerivedImageCache mDerived;
     
     // Helper methods
+    bool useOpenCV() const;
     int64_t getCurrentTimeMs() const;
-    void updateStatistics(int64_t processingTimeMs);
+    void updateStatistics(const ProcessingMetrics& metrics);
     
-    // Fallback processing methods (when OpenCV is not available)
-    bool applyCannyEdgeFallback(
+    // Deadline handling: abandonAt() records the first stage found late
+    bool abandonAt(int stage);
+    ProcessingMetrics finishMetrics(ProcessingMetrics metrics, int64_t startTime, bool success);
+    
+    // Memory pressure handling
+    static bool canProcessAtHalf(
+        int width,
+        int height,
+        const OutputTarget* targets,
+        int targetCount
+    );
+    void finishFrame(int pressure, bool halfResolution);
+    size_t releaseScratch();
+    
+    // Edge hash side output of the frame in progress (no-op when disabled)
+    void hashGray(const uint8_t* grayData, int width, int height);
+    
+    // Lazily derived images of the frame in processFrameRequests
+    struct FrameSource {
+        const uint8_t* rgba;
+        int width;
+        int height;
+        bool half;
+    };
+    const uint8_t* deriveLuma(const FrameSource& source);
+    const uint8_t* deriveSmoothed(const FrameSource& source);
+    const uint8_t* derivePyramid(const FrameSource& source, int level);
+    bool deriveGradients(const FrameSource& source);
+    const uint8_t* deriveEdges(const FrameSource& source);
+    const uint8_t* deriveDistance(const FrameSource& source);
+    int pyramidLevelFor(const FrameRequest& request) const;
+    
+    // Compute single-channel result planes (OpenCV with fallback). With
+    // maskResult, fragment-filtered edges are left in mEdgeMask rather than
+    // unpacked into edgeData, and *maskResult says which of the two holds them.
+    bool computeEdgePlane(
         const uint8_t* inputData,
         int width,
         int height,
-        uint8_t* outputData
+        uint8_t* edgeData,
+        bool* maskResult = nullptr
+    );
+    
+    bool computeEdgesFromGray(
+        const uint8_t* grayData,
+        int width,
+        int height,
+        uint8_t* edgeData,
+        bool* maskResult = nullptr
+    );
+    
+    // Sobel derivatives with Canny's aperture on the OpenCV path, 3x3 otherwise
+    void sobelDerivatives(
+        const uint8_t* smoothed,
+        int width,
+        int height,
+        int16_t* dx,
+        int16_t* dy
     );
     
-    bool convertToGrayscaleFallback(
+#ifdef HAVE_OPENCV
+    // OpenCV Canny on the derivatives mAdaptive last normalized
+    void adaptiveCanny(int width, int height, uint8_t* edgeData);
+#endif
+    
+    // Fragment filter and sub-pixel refinement on the packed mask. Returns
+    // true when fragments were removed: mEdgeMask then holds the result and
+    // edgeData is left as Canny produced it. dx/dy, when given, are 3x3
+    // Sobel derivatives of smoothed that refinement reads instead of
+    // recomputing them per pixel.
+    bool postProcessEdges(
+        const uint8_t* smoothed,
+        uint8_t* edgeData,
+        int width,
+        int height,
+        const int16_t* dx = nullptr,
+        const int16_t* dy = nullptr
+    );
+    
+    // Pre-Canny blur for the active path (false when edges use the plane unblurred)
+    bool blurForEdges(
+        const uint8_t* grayData,
+        int width,
+        int height,
+        TrackedBytes& blurPlane
+    );
+    
+    bool computeDistancePlane(
+        uint8_t* plane,
+        int width,
+        int height,
+        float scale
+    );
+    
+    bool computeGrayPlane(
         const uint8_t* inputData,
         int width,
         int height,
-        uint8_t* outputData
+        uint8_t* grayData
+    );
+    
+    // Fallback processing methods (when OpenCV is not available)
+    bool computeEdgesFromGrayFallback(
+        const uint8_t* grayData,
+        int width,
+        int height,
+        uint8_t* edgeData
+    );
+    
+    bool computeGrayPlaneFallback(
+        const uint8_t* inputData,
+        int width,
+        int height,
+        uint8_t* grayData
     );
 };
 
@@ -163,9 +638,37 @@ namespace ImageUtils {
      * Convert RGBA to grayscale using standard luminance formula
      */
     inline uint8_t rgbaToGray(uint8_t r, uint8_t g, uint8_t b) {
-        return static_cast<uint8_t>(0.299f * r + 0.587f * g + 0.114f * b);
+        // Separate statements keep the compiler from fusing into FMAs, so the
+        // vectorized kernels (explicit multiply then add) match bit for bit
+        float red = 0.299f * r;
+        float green = 0.587f * g;
+        float blue = 0.114f * b;
+        float sum = red + green;
+        sum = sum + blue;
+        return static_cast<uint8_t>(sum);
     }
     
+    /**
+     * Convert an RGBA plane to grayscale
+     */
+    void rgbaToGrayPlane(
+        const uint8_t* rgba,
+        int width,
+        int height,
+        uint8_t* gray
+    );
+    
+    /**
+     * Convert RGBA to grayscale at half resolution (2x2 average)
+     * @param gray Output plane of (width / 2) x (height / 2)
+     */
+    void rgbaToGrayHalf(
+        const uint8_t* rgba,
+        int width,
+        int height,
+        uint8_t* gray
+    );
+    
     /**
      * Simple edge detection using Sobel-like operator (fallback)
      */
@@ -176,6 +679,54 @@ namespace ImageUtils {
         uint8_t* output
     );
     
+    /**
+     * Convert YUV_420_888 planes to RGBA (BT.601 limited range)
+     */
+    void yuv420ToRgba(
+        const uint8_t* yData,
+        const uint8_t* uData,
+        const uint8_t* vData,
+        int width,
+        int height,
+        int yRowStride,
+        int uvRowStride,
+        int uvPixelStride,
+        uint8_t* rgba
+    );
+    
+    /**
+     * Expand video-range luma (16-235) to full-range gray (0-255)
+     */
+    void lumaFromVideoRange(
+        const uint8_t* yData,
+        int width,
+        int height,
+        int yRowStride,
+        uint8_t* gray
+    );
+    
+    /**
+     * Expand video-range luma at half resolution (2x2 average)
+     * @param gray Output plane of (width / 2) x (height / 2)
+     */
+    void lumaFromVideoRangeHalf(
+        const uint8_t* yData,
+        int width,
+        int height,
+        int yRowStride,
+        uint8_t* gray
+    );
+    
+    /**
+     * Expand single-channel plane to RGBA (value in RGB, alpha 255)
+     */
+    void expandGrayToRgba(
+        const uint8_t* gray,
+        int width,
+        int height,
+        uint8_t* rgba
+    );
+    
     /**
      * Apply threshold to grayscale image
      */
@@ -186,6 +737,16 @@ namespace ImageUtils {
         uint8_t threshold,
         uint8_t* output
     );
+    
+    /**
+     * Pack non-zero flags into bits, LSB first
+     * @param bits Output of (count + 7) / 8 bytes
+     */
+    void packMask(
+        const uint8_t* mask,
+        size_t count,
+        uint8_t* bits
+    );
 }
 
 #endif // EDGEDETECTOR_OPENCV_PROCESSOR_H
\ No newline at end of file
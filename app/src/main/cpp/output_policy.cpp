@@ -0,0 +1,218 @@
+#include "output_policy.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Constructor
+OutputSubscriptions::OutputSubscriptions()
+    : mNextId(1)
+    , mLastTimestampUs(0)
+    , mFrameIntervalUs(0.0)
+{
+}
+
+bool OutputSubscriptions::validPolicy(const ConsumerPolicy& policy) {
+    if (MultiOutputWriter::bytesPerPixel(policy.format) == 0 || policy.targetFps < 0.0 ||
+        policy.maxWidth < 0 || policy.maxHeight < 0) {
+        LOGE("Invalid consumer policy: %.1f fps, max %dx%d, format %d",
+             policy.targetFps, policy.maxWidth, policy.maxHeight, policy.format);
+        return false;
+    }
+    return true;
+}
+
+// Register a consumer
+int OutputSubscriptions::addConsumer(const ConsumerPolicy& policy) {
+    if (!validPolicy(policy)) {
+        return -1;
+    }
+
+    std::shared_ptr<Consumer> consumer = std::make_shared<Consumer>();
+    consumer->policy = policy;
+    consumer->nextDueUs = 0;
+    consumer->preparedDueUs = 0;
+    consumer->started = false;
+    consumer->framesOffered = 0;
+    consumer->framesTaken = 0;
+    consumer->backInfo = {};
+    consumer->frontInfo = {};
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    consumer->id = mNextId++;
+    mConsumers.push_back(consumer);
+    LOGI("Consumer %d added: %.1f fps, max %dx%d, format %d",
+         consumer->id, policy.targetFps, policy.maxWidth, policy.maxHeight, policy.format);
+    return consumer->id;
+}
+
+// Replace a consumer's policy
+bool OutputSubscriptions::updateConsumer(int id, const ConsumerPolicy& policy) {
+    if (!validPolicy(policy)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& consumer : mConsumers) {
+        if (consumer->id == id) {
+            consumer->policy = policy;
+            consumer->started = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Unregister a consumer (a frame in flight keeps its buffers alive)
+bool OutputSubscriptions::removeConsumer(int id) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = std::find_if(mConsumers.begin(), mConsumers.end(),
+                           [id](const std::shared_ptr<Consumer>& consumer) { return consumer->id == id; });
+    if (it == mConsumers.end()) {
+        return false;
+    }
+    mConsumers.erase(it);
+    return true;
+}
+
+// Fit policy bounds, keeping aspect ratio
+void OutputSubscriptions::fitSize(const ConsumerPolicy& policy, int srcWidth, int srcHeight, int& width, int& height) {
+    const int maxWidth = policy.maxWidth > 0 ? std::min(policy.maxWidth, srcWidth) : srcWidth;
+    const int maxHeight = policy.maxHeight > 0 ? std::min(policy.maxHeight, srcHeight) : srcHeight;
+
+    width = srcWidth;
+    height = srcHeight;
+    if (width > maxWidth) {
+        height = static_cast<int>(static_cast<int64_t>(height) * maxWidth / width);
+        width = maxWidth;
+    }
+    if (height > maxHeight) {
+        width = static_cast<int>(static_cast<int64_t>(width) * maxHeight / height);
+        height = maxHeight;
+    }
+
+    if (policy.format == OUTPUT_FORMAT_NV12) {
+        width &= ~1;
+        height &= ~1;
+    }
+    width = std::max(policy.format == OUTPUT_FORMAT_NV12 ? 2 : 1, width);
+    height = std::max(policy.format == OUTPUT_FORMAT_NV12 ? 2 : 1, height);
+}
+
+// Even decimation against a deadline that advances by the consumer period
+bool OutputSubscriptions::isDue(const Consumer& consumer, int64_t timestampUs, int64_t& nextDueUs) const {
+    if (consumer.policy.targetFps <= 0.0) {
+        nextDueUs = timestampUs;
+        return true;
+    }
+
+    const double periodUs = 1e6 / consumer.policy.targetFps;
+    if (!consumer.started || timestampUs < consumer.nextDueUs - periodUs) {
+        // First frame, or the clock went backwards
+        nextDueUs = timestampUs + static_cast<int64_t>(periodUs);
+        return true;
+    }
+
+    // Half a source interval of slack absorbs timestamp jitter
+    const int64_t slackUs = static_cast<int64_t>(mFrameIntervalUs * 0.5);
+    if (timestampUs + slackUs < consumer.nextDueUs) {
+        return false;
+    }
+
+    nextDueUs = consumer.nextDueUs + static_cast<int64_t>(periodUs);
+    if (nextDueUs <= timestampUs) {
+        // Source slower than the target rate; do not bank the missed deadlines
+        nextDueUs = timestampUs + static_cast<int64_t>(periodUs);
+    }
+    return true;
+}
+
+// Select due consumers and describe their targets
+int OutputSubscriptions::prepare(int64_t timestampUs, int srcWidth, int srcHeight, std::vector<OutputTarget>& targets) {
+    targets.clear();
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPrepared.clear();
+
+    if (mLastTimestampUs > 0 && timestampUs > mLastTimestampUs) {
+        double interval = static_cast<double>(timestampUs - mLastTimestampUs);
+        mFrameIntervalUs = mFrameIntervalUs > 0.0 ? 0.9 * mFrameIntervalUs + 0.1 * interval : interval;
+    }
+    mLastTimestampUs = timestampUs;
+
+    for (auto& consumer : mConsumers) {
+        consumer->framesOffered++;
+        if (!isDue(*consumer, timestampUs, consumer->preparedDueUs)) {
+            continue;
+        }
+
+        int width = 0;
+        int height = 0;
+        fitSize(consumer->policy, srcWidth, srcHeight, width, height);
+        const int format = consumer->policy.format;
+        const size_t planeSize = static_cast<size_t>(width) * height * MultiOutputWriter::bytesPerPixel(format);
+        const size_t size = format == OUTPUT_FORMAT_NV12 ? planeSize + planeSize / 2 : planeSize;
+
+        consumer->back.resize(size);
+        consumer->backInfo = {0, timestampUs, width, height, format, size};
+        uint8_t* data = consumer->back.data();
+        targets.push_back({data, width, height, format, 0,
+                           format == OUTPUT_FORMAT_NV12 ? data + planeSize : nullptr, 0});
+        mPrepared.push_back(consumer);
+    }
+    return static_cast<int>(targets.size());
+}
+
+// Publish prepared outputs and advance their consumers' deadlines
+void OutputSubscriptions::commit(bool success) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (success) {
+        for (auto& consumer : mPrepared) {
+            consumer->nextDueUs = consumer->preparedDueUs;
+            consumer->started = true;
+            consumer->front.swap(consumer->back);
+            consumer->framesTaken++;
+            consumer->frontInfo = consumer->backInfo;
+            consumer->frontInfo.sequence = consumer->framesTaken;
+        }
+    }
+    mPrepared.clear();
+}
+
+// Copy a consumer's latest frame
+bool OutputSubscriptions::readLatest(int id, uint8_t* output, size_t capacity, ConsumerFrameInfo& info) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& consumer : mConsumers) {
+        if (consumer->id != id) {
+            continue;
+        }
+        info = consumer->frontInfo;
+        if (output == nullptr || info.sequence == 0) {
+            return true;
+        }
+        if (capacity < info.size) {
+            LOGE("Consumer %d frame needs %zu bytes, got %zu", id, info.size, capacity);
+            return false;
+        }
+        std::memcpy(output, consumer->front.data(), info.size);
+        return true;
+    }
+    return false;
+}
+
+// Per-consumer summary
+std::string OutputSubscriptions::getStatistics() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::string text;
+    char line[192];
+    snprintf(line, sizeof(line), "Consumers: %zu, source interval %.1f ms",
+             mConsumers.size(), mFrameIntervalUs / 1000.0);
+    text += line;
+    for (const auto& consumer : mConsumers) {
+        snprintf(line, sizeof(line), "\n  #%d: %.1f fps, %dx%d format %d, taken %llu/%llu",
+                 consumer->id, consumer->policy.targetFps,
+                 consumer->frontInfo.width, consumer->frontInfo.height, consumer->policy.format,
+                 static_cast<unsigned long long>(consumer->framesTaken),
+                 static_cast<unsigned long long>(consumer->framesOffered));
+        text += line;
+    }
+    return text;
+}
@@ -0,0 +1,116 @@
+#ifndef EDGEDETECTOR_OUTPUT_POLICY_H
+#define EDGEDETECTOR_OUTPUT_POLICY_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "frame_output.h"
+
+// What a consumer wants from the output stage
+struct ConsumerPolicy {
+    double targetFps;   // Frames per second to deliver (0 = every frame)
+    int maxWidth;       // Largest output width (0 = source width)
+    int maxHeight;      // Largest output height (0 = source height)
+    int format;         // OutputFormat
+};
+
+// Latest frame delivered to a consumer
+struct ConsumerFrameInfo {
+    uint64_t sequence;      // Frames delivered so far (0 = none yet)
+    int64_t timestampUs;    // Source timestamp of the delivered frame
+    int width;
+    int height;
+    int format;
+    size_t size;            // Bytes in the frame (NV12: Y plane then UV plane)
+};
+
+/**
+ * Per-consumer subscriptions for the output stage. Before a frame is
+ * processed, prepare() decides which consumers are due (evenly decimating
+ * the source rate down to each consumer's target fps) and describes only
+ * their outputs as targets, sized to fit the consumer's bounds with the
+ * source aspect ratio. A frame that no consumer takes is never processed,
+ * and a consumer that skips a frame costs no resize or conversion work.
+ * A consumer's deadline only advances when its frame is committed, so a
+ * failed or abandoned frame leaves it due for the next one.
+ *
+ * prepare() and commit() must be called from a single producer thread;
+ * consumers can be added, removed and read from any thread.
+ */
+class OutputSubscriptions {
+public:
+    OutputSubscriptions();
+
+    /**
+     * Register a consumer
+     * @return Consumer id, or -1 if the policy is invalid
+     */
+    int addConsumer(const ConsumerPolicy& policy);
+
+    /**
+     * Replace a consumer's policy (takes effect from the next frame)
+     */
+    bool updateConsumer(int id, const ConsumerPolicy& policy);
+
+    bool removeConsumer(int id);
+
+    /**
+     * Select the consumers due for a source frame and describe their targets
+     * @param timestampUs Source frame timestamp
+     * @param srcWidth Source frame width
+     * @param srcHeight Source frame height
+     * @param targets Output targets for the due consumers (replaced)
+     * @return Number of targets (0 = skip processing this frame)
+     */
+    int prepare(int64_t timestampUs, int srcWidth, int srcHeight, std::vector<OutputTarget>& targets);
+
+    /**
+     * Publish the prepared outputs once the frame has been processed
+     * @param success false discards the prepared outputs
+     */
+    void commit(bool success);
+
+    /**
+     * Copy a consumer's latest frame
+     * @param output Destination, or nullptr to query the info only
+     * @param capacity Destination size in bytes
+     * @return false for an unknown consumer or a too-small destination
+     */
+    bool readLatest(int id, uint8_t* output, size_t capacity, ConsumerFrameInfo& info) const;
+
+    std::string getStatistics() const;
+
+    /**
+     * Largest size within the policy bounds that keeps the source aspect ratio
+     */
+    static void fitSize(const ConsumerPolicy& policy, int srcWidth, int srcHeight, int& width, int& height);
+
+private:
+    struct Consumer {
+        int id;
+        ConsumerPolicy policy;
+        int64_t nextDueUs;
+        int64_t preparedDueUs;      // Deadline to adopt if the prepared frame is committed
+        bool started;
+        uint64_t framesOffered;
+        uint64_t framesTaken;
+        TrackedBytes back;          // Written by the producer while a frame is processed
+        TrackedBytes front;         // Latest delivered frame
+        ConsumerFrameInfo backInfo;
+        ConsumerFrameInfo frontInfo;
+    };
+
+    mutable std::mutex mMutex;
+    std::vector<std::shared_ptr<Consumer>> mConsumers;
+    std::vector<std::shared_ptr<Consumer>> mPrepared;
+    int mNextId;
+    int64_t mLastTimestampUs;
+    double mFrameIntervalUs;        // Smoothed source frame interval
+
+    static bool validPolicy(const ConsumerPolicy& policy);
+    bool isDue(const Consumer& consumer, int64_t timestampUs, int64_t& nextDueUs) const;
+};
+
+#endif // EDGEDETECTOR_OUTPUT_POLICY_H
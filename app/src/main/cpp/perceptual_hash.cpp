@@ -0,0 +1,138 @@
+#include "perceptual_hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef HAVE_OPENCV
+#include <opencv2/core/hal/intrin.hpp>
+#endif
+
+// Same fixed-width universal intrinsics condition as the image kernels
+#if defined(HAVE_OPENCV) && CV_SIMD && !CV_SIMD_SCALABLE
+#define PERCEPTUAL_HASH_VECTORIZED 1
+#else
+#define PERCEPTUAL_HASH_VECTORIZED 0
+#endif
+
+namespace {
+    const int kCells = EDGE_HASH_GRID + 1;
+
+    // Sum of a byte run
+    uint32_t sumBytes(const uint8_t* data, int count) {
+        uint32_t total = 0;
+        int i = 0;
+#if PERCEPTUAL_HASH_VECTORIZED
+        using namespace cv;
+        const int lanes = VTraits<v_uint8>::vlanes();
+        while (i + lanes <= count) {
+            // Each 16-bit lane gains at most 510 per step; 128 steps stay below 65536
+            v_uint16 accumulator = vx_setzero_u16();
+            for (int step = 0; step < 128 && i + lanes <= count; step++, i += lanes) {
+                v_uint16 low, high;
+                v_expand(vx_load(data + i), low, high);
+                accumulator = v_add(accumulator, v_add(low, high));
+            }
+            total += v_reduce_sum(accumulator);
+        }
+#endif
+        for (; i < count; i++) {
+            total += data[i];
+        }
+        return total;
+    }
+
+    int findRoot(std::vector<int>& parents, int index) {
+        while (parents[index] != index) {
+            parents[index] = parents[parents[index]];
+            index = parents[index];
+        }
+        return index;
+    }
+}
+
+namespace PerceptualHash {
+    bool compute(const uint8_t* gray, int width, int height, int stride, EdgeHash& hash) {
+        std::memset(hash.words, 0, sizeof(hash.words));
+        if (gray == nullptr || width < kCells || height < kCells) {
+            return false;
+        }
+        if (stride <= 0) {
+            stride = width;
+        }
+
+        // Area sums per cell (same span rounding as MultiOutputWriter)
+        int columnStart[kCells + 1];
+        int rowStart[kCells + 1];
+        for (int i = 0; i <= kCells; i++) {
+            columnStart[i] = static_cast<int>(static_cast<int64_t>(i) * width / kCells);
+            rowStart[i] = static_cast<int>(static_cast<int64_t>(i) * height / kCells);
+        }
+        uint64_t sums[kCells][kCells] = {};
+        for (int cy = 0; cy < kCells; cy++) {
+            for (int y = rowStart[cy]; y < rowStart[cy + 1]; y++) {
+                const uint8_t* row = gray + static_cast<size_t>(y) * stride;
+                for (int cx = 0; cx < kCells; cx++) {
+                    sums[cy][cx] += sumBytes(row + columnStart[cx], columnStart[cx + 1] - columnStart[cx]);
+                }
+            }
+        }
+
+        // Compare means without dividing: sumA * areaB against sumB * areaA
+        uint64_t areas[kCells][kCells];
+        for (int cy = 0; cy < kCells; cy++) {
+            for (int cx = 0; cx < kCells; cx++) {
+                areas[cy][cx] = static_cast<uint64_t>(columnStart[cx + 1] - columnStart[cx]) *
+                    (rowStart[cy + 1] - rowStart[cy]);
+            }
+        }
+        int bit = 0;
+        for (int y = 0; y < EDGE_HASH_GRID; y++) {
+            for (int x = 0; x < EDGE_HASH_GRID; x++, bit++) {
+                if (sums[y][x + 1] * areas[y][x] > sums[y][x] * areas[y][x + 1]) {
+                    hash.words[0] |= uint64_t(1) << bit;
+                }
+                if (sums[y + 1][x] * areas[y][x] > sums[y][x] * areas[y + 1][x]) {
+                    hash.words[1] |= uint64_t(1) << bit;
+                }
+            }
+        }
+        return true;
+    }
+
+    int cluster(const std::vector<EdgeHash>& hashes, int maxDistance, std::vector<int>& clusterOf) {
+        const int count = static_cast<int>(hashes.size());
+        clusterOf.resize(count);
+        for (int i = 0; i < count; i++) {
+            clusterOf[i] = i;
+        }
+
+        // Union-find keeping the smaller index as root, so roots are first members
+        for (int i = 0; i < count; i++) {
+            for (int j = i + 1; j < count; j++) {
+                if (distance(hashes[i], hashes[j]) > maxDistance) {
+                    continue;
+                }
+                const int a = findRoot(clusterOf, i);
+                const int b = findRoot(clusterOf, j);
+                if (a != b) {
+                    clusterOf[std::max(a, b)] = std::min(a, b);
+                }
+            }
+        }
+
+        int clusters = 0;
+        for (int i = 0; i < count; i++) {
+            clusterOf[i] = findRoot(clusterOf, i);
+            clusters += clusterOf[i] == i ? 1 : 0;
+        }
+        return clusters;
+    }
+
+    std::string toHex(const EdgeHash& hash) {
+        char buffer[EDGE_HASH_WORDS * 16 + 1];
+        for (int i = 0; i < EDGE_HASH_WORDS; i++) {
+            snprintf(buffer + i * 16, 17, "%016llx", static_cast<unsigned long long>(hash.words[i]));
+        }
+        return std::string(buffer);
+    }
+}
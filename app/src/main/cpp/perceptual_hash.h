@@ -0,0 +1,75 @@
+#ifndef EDGEDETECTOR_PERCEPTUAL_HASH_H
+#define EDGEDETECTOR_PERCEPTUAL_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Gradient signs are taken on a (GRID + 1) x (GRID + 1) grid of cell means
+#define EDGE_HASH_GRID 8
+#define EDGE_HASH_BITS (2 * EDGE_HASH_GRID * EDGE_HASH_GRID)
+#define EDGE_HASH_WORDS (EDGE_HASH_BITS / 64)
+
+// Default Hamming distance under which two hashes count as the same shot
+#define EDGE_HASH_DUPLICATE_DISTANCE 12
+
+/**
+ * 128-bit perceptual edge hash: word 0 holds the horizontal gradient signs
+ * (dHash), word 1 the vertical ones, row-major over the grid. A bit is set
+ * where the next cell is brighter. Cell means are area averages, so the
+ * hash barely depends on resolution, compression or small exposure changes,
+ * while edits that move edges flip many bits.
+ */
+struct EdgeHash {
+    uint64_t words[EDGE_HASH_WORDS];
+
+    bool operator==(const EdgeHash& other) const {
+        for (int i = 0; i < EDGE_HASH_WORDS; i++) {
+            if (words[i] != other.words[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+namespace PerceptualHash {
+    /**
+     * Hash a gray plane. Cell sums use vectorized row reductions, so a full
+     * camera frame costs one read of the plane.
+     * @param gray Gray plane
+     * @param stride Row stride in bytes (0 = width)
+     * @return false if the plane is smaller than the grid (hash cleared)
+     */
+    bool compute(const uint8_t* gray, int width, int height, int stride, EdgeHash& hash);
+
+    /**
+     * Number of differing bits (0 to EDGE_HASH_BITS)
+     */
+    inline int distance(const EdgeHash& a, const EdgeHash& b) {
+        int bits = 0;
+        for (int i = 0; i < EDGE_HASH_WORDS; i++) {
+            bits += __builtin_popcountll(a.words[i] ^ b.words[i]);
+        }
+        return bits;
+    }
+
+    /**
+     * Group hashes whose Hamming distance is at most maxDistance (single
+     * linkage: a chain of close pairs forms one cluster). Every pair is
+     * compared with two popcounts, so this suits gallery batches of a few
+     * thousand images rather than whole libraries.
+     * @param clusterOf Output: per hash, the index of the first hash of its
+     *        cluster (so clusterOf[i] == i marks the image to keep)
+     * @return Number of clusters
+     */
+    int cluster(const std::vector<EdgeHash>& hashes, int maxDistance, std::vector<int>& clusterOf);
+
+    /**
+     * Hex form, word 0 first (32 characters)
+     */
+    std::string toHex(const EdgeHash& hash);
+}
+
+#endif // EDGEDETECTOR_PERCEPTUAL_HASH_H
@@ -0,0 +1,209 @@
+#include "perf_baseline.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    // Continued fraction for the regularized incomplete beta function
+    double betaContinuedFraction(double a, double b, double x) {
+        const int maxIterations = 200;
+        const double epsilon = 3e-14;
+        const double tiny = 1e-300;
+
+        double qab = a + b;
+        double qap = a + 1.0;
+        double qam = a - 1.0;
+        double c = 1.0;
+        double d = 1.0 - qab * x / qap;
+        if (std::fabs(d) < tiny) d = tiny;
+        d = 1.0 / d;
+        double h = d;
+
+        for (int m = 1; m <= maxIterations; m++) {
+            int m2 = 2 * m;
+            double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+            d = 1.0 + aa * d;
+            if (std::fabs(d) < tiny) d = tiny;
+            c = 1.0 + aa / c;
+            if (std::fabs(c) < tiny) c = tiny;
+            d = 1.0 / d;
+            h *= d * c;
+
+            aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+            d = 1.0 + aa * d;
+            if (std::fabs(d) < tiny) d = tiny;
+            c = 1.0 + aa / c;
+            if (std::fabs(c) < tiny) c = tiny;
+            d = 1.0 / d;
+            double delta = d * c;
+            h *= delta;
+            if (std::fabs(delta - 1.0) < epsilon) {
+                break;
+            }
+        }
+        return h;
+    }
+
+    // Regularized incomplete beta I_x(a, b)
+    double incompleteBeta(double a, double b, double x) {
+        if (x <= 0.0) return 0.0;
+        if (x >= 1.0) return 1.0;
+
+        double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                                a * std::log(x) + b * std::log(1.0 - x));
+        if (x < (a + 1.0) / (a + b + 2.0)) {
+            return front * betaContinuedFraction(a, b, x) / a;
+        }
+        return 1.0 - front * betaContinuedFraction(b, a, 1.0 - x) / b;
+    }
+}
+
+// Summarize samples into a baseline entry
+void PerfBaseline::add(const std::string& name, const std::vector<double>& samplesUs) {
+    BaselineEntry entry = {name, 0, 0.0, 0.0, 0.0};
+    entry.count = static_cast<uint32_t>(samplesUs.size());
+
+    if (!samplesUs.empty()) {
+        double sum = 0.0;
+        for (double sample : samplesUs) {
+            sum += sample;
+        }
+        entry.meanUs = sum / samplesUs.size();
+
+        double squares = 0.0;
+        for (double sample : samplesUs) {
+            squares += (sample - entry.meanUs) * (sample - entry.meanUs);
+        }
+        entry.stddevUs = samplesUs.size() > 1 ? std::sqrt(squares / (samplesUs.size() - 1)) : 0.0;
+
+        std::vector<double> sorted(samplesUs);
+        std::sort(sorted.begin(), sorted.end());
+        entry.medianUs = sorted[sorted.size() / 2];
+    }
+
+    mEntries.push_back(entry);
+}
+
+// Write baseline file
+bool PerfBaseline::save(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        LOGE("Cannot write baseline file: %s", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "# name\tcount\tmean_us\tstddev_us\tmedian_us\n");
+    for (const BaselineEntry& entry : mEntries) {
+        fprintf(file, "%s\t%u\t%.3f\t%.3f\t%.3f\n",
+                entry.name.c_str(), entry.count, entry.meanUs, entry.stddevUs, entry.medianUs);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Read baseline file
+bool PerfBaseline::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        LOGE("Cannot read baseline file: %s", path.c_str());
+        return false;
+    }
+
+    mEntries.clear();
+    char line[512];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        char name[256];
+        BaselineEntry entry = {"", 0, 0.0, 0.0, 0.0};
+        if (sscanf(line, "%255[^\t]\t%u\t%lf\t%lf\t%lf",
+                   name, &entry.count, &entry.meanUs, &entry.stddevUs, &entry.medianUs) == 5) {
+            entry.name = name;
+            mEntries.push_back(entry);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+// One-sided Welch t-test p-value for current > baseline
+double PerfBaseline::welchPValue(const BaselineEntry& baseline, const BaselineEntry& current) {
+    if (baseline.count < 2 || current.count < 2) {
+        return 1.0;
+    }
+
+    double va = baseline.stddevUs * baseline.stddevUs / baseline.count;
+    double vb = current.stddevUs * current.stddevUs / current.count;
+    double se = std::sqrt(va + vb);
+    double diff = current.meanUs - baseline.meanUs;
+
+    if (se <= 0.0) {
+        return diff > 0.0 ? 0.0 : 1.0;
+    }
+
+    double t = diff / se;
+    double df = (va + vb) * (va + vb) /
+                (va * va / (baseline.count - 1) + vb * vb / (current.count - 1));
+
+    // Two-sided tail from the Student t CDF, halved for one side
+    double tail = 0.5 * incompleteBeta(0.5 * df, 0.5, df / (df + t * t));
+    return t > 0.0 ? tail : 1.0 - tail;
+}
+
+// Find significant slowdowns
+std::vector<Regression> PerfBaseline::compare(
+    const PerfBaseline& baseline,
+    const PerfBaseline& current,
+    double alpha,
+    double minRelativeChange
+) {
+    std::vector<Regression> regressions;
+
+    for (const BaselineEntry& now : current.mEntries) {
+        auto it = std::find_if(baseline.mEntries.begin(), baseline.mEntries.end(),
+            [&now](const BaselineEntry& entry) { return entry.name == now.name; });
+        if (it == baseline.mEntries.end() || it->meanUs <= 0.0) {
+            continue;
+        }
+
+        double change = (now.meanUs - it->meanUs) / it->meanUs;
+        if (change <= minRelativeChange) {
+            continue;
+        }
+
+        double pValue = welchPValue(*it, now);
+        if (pValue < alpha) {
+            regressions.push_back({now.name, it->meanUs, now.meanUs, change, pValue});
+        }
+    }
+
+    return regressions;
+}
+
+// Format comparison result
+std::string PerfBaseline::formatRegressions(const std::vector<Regression>& regressions) {
+    if (regressions.empty()) {
+        return "No significant regressions";
+    }
+
+    std::string text;
+    char line[384];
+    snprintf(line, sizeof(line), "%zu significant regression(s):\n", regressions.size());
+    text += line;
+    for (const Regression& regression : regressions) {
+        snprintf(line, sizeof(line), "  %s: %.1fus -> %.1fus (+%.1f%%, p=%.4f)\n",
+                 regression.name.c_str(),
+                 regression.baselineMeanUs,
+                 regression.currentMeanUs,
+                 regression.relativeChange * 100.0,
+                 regression.pValue);
+        text += line;
+    }
+    return text;
+}
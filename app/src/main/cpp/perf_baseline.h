@@ -0,0 +1,67 @@
+#ifndef EDGEDETECTOR_PERF_BASELINE_H
+#define EDGEDETECTOR_PERF_BASELINE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Timing summary for one benchmark case
+struct BaselineEntry {
+    std::string name;
+    uint32_t count;     // Samples after warm-up
+    double meanUs;
+    double stddevUs;
+    double medianUs;
+};
+
+// Case that got slower than the baseline
+struct Regression {
+    std::string name;
+    double baselineMeanUs;
+    double currentMeanUs;
+    double relativeChange;  // (current - baseline) / baseline
+    double pValue;          // One-sided Welch t-test
+};
+
+/**
+ * Timing baselines stored as a tab-separated file, one case per line:
+ * name, count, mean, stddev, median (microseconds).
+ */
+class PerfBaseline {
+public:
+    /**
+     * Summarize raw timing samples and add them as a case
+     */
+    void add(const std::string& name, const std::vector<double>& samplesUs);
+
+    const std::vector<BaselineEntry>& entries() const { return mEntries; }
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    /**
+     * Flag cases that are slower by more than minRelativeChange with
+     * one-sided significance below alpha (Welch's t-test)
+     */
+    static std::vector<Regression> compare(
+        const PerfBaseline& baseline,
+        const PerfBaseline& current,
+        double alpha,
+        double minRelativeChange
+    );
+
+    /**
+     * Human-readable comparison summary
+     */
+    static std::string formatRegressions(const std::vector<Regression>& regressions);
+
+    /**
+     * One-sided p-value that `current` is slower than `baseline`
+     */
+    static double welchPValue(const BaselineEntry& baseline, const BaselineEntry& current);
+
+private:
+    std::vector<BaselineEntry> mEntries;
+};
+
+#endif // EDGEDETECTOR_PERF_BASELINE_H
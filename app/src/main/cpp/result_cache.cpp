@@ -0,0 +1,661 @@
+#include "result_cache.h"
+#include "content_hash.h"
+#include "gray_codec.h"
+#include "opencv_processor.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    const char kRecordMagic[4] = {'E', 'R', 'C', '1'};
+    const char kIndexMagic[4] = {'E', 'R', 'I', '1'};
+    const size_t kRecordHeaderSize = 48;
+    const size_t kIndexHeaderSize = 24;
+    const size_t kIndexEntrySize = 40;
+
+    template <typename T>
+    void putValue(uint8_t*& p, T value) {
+        std::memcpy(p, &value, sizeof(T));
+        p += sizeof(T);
+    }
+
+    template <typename T>
+    T getValue(const uint8_t*& p) {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+
+    // Parsed record header
+    struct RecordHeader {
+        uint32_t payloadSize;
+        ResultCacheKey key;
+        uint32_t width;
+        uint32_t height;
+        uint8_t channels;
+        uint64_t payloadHash;
+    };
+
+    bool parseHeader(const uint8_t* p, RecordHeader& header) {
+        if (std::memcmp(p, kRecordMagic, 4) != 0) {
+            return false;
+        }
+        p += 4;
+        header.payloadSize = getValue<uint32_t>(p);
+        header.key.content = getValue<uint64_t>(p);
+        header.key.parameters = getValue<uint64_t>(p);
+        header.width = getValue<uint32_t>(p);
+        header.height = getValue<uint32_t>(p);
+        header.channels = *p;
+        p += 8;
+        header.payloadHash = getValue<uint64_t>(p);
+        return header.width > 0 && header.height > 0 &&
+               (header.channels == 1 || header.channels == 4);
+    }
+
+    // Whole-buffer write at an offset (retries short writes)
+    bool writeAll(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+        return true;
+    }
+
+    // Opaque pixels with equal colour channels
+    bool isGray(const uint8_t* rgba, size_t pixels) {
+        for (size_t i = 0; i < pixels; i++) {
+            const uint8_t* p = rgba + i * 4;
+            if (p[0] != p[1] || p[0] != p[2] || p[3] != 255) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// Constructor
+ResultCache::ResultCache()
+    : mFd(-1)
+    , mMap(nullptr)
+    , mMapSize(0)
+    , mPackSize(0)
+    , mCapacity(0)
+    , mLiveBytes(0)
+    , mUseCounter(0)
+    , mGeneration(0)
+    , mCompacting(false)
+    , mStats()
+{
+}
+
+// Destructor
+ResultCache::~ResultCache() {
+    close();
+}
+
+std::string ResultCache::packPath() const {
+    return mDirectory + "/results.pack";
+}
+
+std::string ResultCache::indexPath() const {
+    return mDirectory + "/results.idx";
+}
+
+// Open the pack and restore the index
+bool ResultCache::open(const std::string& directory, uint64_t capacityBytes) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    closeLocked();
+    if (directory.empty() || capacityBytes == 0) {
+        LOGE("Invalid result cache directory or capacity");
+        return false;
+    }
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        LOGE("Cannot create result cache directory %s: %s", directory.c_str(), strerror(errno));
+        return false;
+    }
+
+    mDirectory = directory;
+    mCapacity = capacityBytes;
+    mFd = ::open(packPath().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (mFd < 0) {
+        LOGE("Cannot open result cache pack: %s", strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(mFd, &info) != 0) {
+        closeLocked();
+        return false;
+    }
+    mPackSize = static_cast<uint64_t>(info.st_size);
+    mStats = ResultCacheStats();
+
+    if (!loadIndex()) {
+        scanPack();
+    }
+    mLiveBytes = 0;
+    for (const auto& entry : mEntries) {
+        mLiveBytes += entry.second.size;
+    }
+    LOGI("Result cache opened: %zu entries, %llu bytes", mEntries.size(),
+         static_cast<unsigned long long>(mPackSize));
+    if (mPackSize > mCapacity && startCompaction()) {
+        lock.unlock();
+        compact();
+    }
+    return true;
+}
+
+void ResultCache::close() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    closeLocked();
+}
+
+void ResultCache::closeLocked() {
+    mGeneration++;
+    if (mFd >= 0) {
+        writeIndex();
+        unmapPack();
+        ::close(mFd);
+        mFd = -1;
+    }
+    mEntries.clear();
+    mPackSize = 0;
+    mLiveBytes = 0;
+}
+
+bool ResultCache::isOpen() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFd >= 0;
+}
+
+// Map the pack so that at least `needed` bytes are readable
+bool ResultCache::mapPack(uint64_t needed) {
+    if (needed <= mMapSize) {
+        return true;
+    }
+    unmapPack();
+    if (mPackSize == 0) {
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(mPackSize), PROT_READ, MAP_SHARED, mFd, 0);
+    if (mapped == MAP_FAILED) {
+        LOGE("Cannot map result cache pack: %s", strerror(errno));
+        return false;
+    }
+    mMap = static_cast<const uint8_t*>(mapped);
+    mMapSize = static_cast<size_t>(mPackSize);
+    return needed <= mMapSize;
+}
+
+void ResultCache::unmapPack() {
+    if (mMap != nullptr) {
+        munmap(const_cast<uint8_t*>(mMap), mMapSize);
+        mMap = nullptr;
+        mMapSize = 0;
+    }
+}
+
+// Restore entries from the index file if it describes the current pack
+bool ResultCache::loadIndex() {
+    mEntries.clear();
+    int fd = ::open(indexPath().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= kIndexHeaderSize) {
+        data.resize(static_cast<size_t>(info.st_size));
+        if (pread(fd, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) {
+            data.clear();
+        }
+    }
+    ::close(fd);
+    if (data.size() < kIndexHeaderSize || std::memcmp(data.data(), kIndexMagic, 4) != 0) {
+        return false;
+    }
+
+    const uint8_t* p = data.data() + 4;
+    const uint32_t count = getValue<uint32_t>(p);
+    const uint64_t packSize = getValue<uint64_t>(p);
+    const uint64_t useCounter = getValue<uint64_t>(p);
+    if (packSize != mPackSize || data.size() != kIndexHeaderSize + static_cast<size_t>(count) * kIndexEntrySize) {
+        LOGW("Result cache index is stale, rescanning the pack");
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        ResultCacheKey key;
+        Entry entry;
+        key.content = getValue<uint64_t>(p);
+        key.parameters = getValue<uint64_t>(p);
+        entry.offset = getValue<uint64_t>(p);
+        entry.size = getValue<uint32_t>(p);
+        p += 4;
+        entry.lastUse = getValue<uint64_t>(p);
+        if (entry.size < kRecordHeaderSize || entry.offset + entry.size > mPackSize) {
+            mEntries.clear();
+            return false;
+        }
+        mEntries[key] = entry;
+    }
+    mUseCounter = useCounter;
+    return true;
+}
+
+// Rebuild entries by walking the records (later records replace earlier ones)
+void ResultCache::scanPack() {
+    mEntries.clear();
+    mUseCounter = 0;
+    uint64_t offset = 0;
+    if (mapPack(mPackSize)) {
+        while (offset + kRecordHeaderSize <= mPackSize) {
+            RecordHeader header;
+            if (!parseHeader(mMap + offset, header) ||
+                offset + kRecordHeaderSize + header.payloadSize > mPackSize) {
+                break;
+            }
+            const uint32_t size = static_cast<uint32_t>(kRecordHeaderSize + header.payloadSize);
+            mEntries[header.key] = {offset, size, ++mUseCounter};
+            offset += size;
+        }
+    }
+    if (offset < mPackSize) {
+        LOGW("Result cache pack has a torn tail at %llu, truncating", static_cast<unsigned long long>(offset));
+        unmapPack();
+        if (ftruncate(mFd, static_cast<off_t>(offset)) == 0) {
+            mPackSize = offset;
+        }
+    }
+}
+
+// Save entries and LRU order next to the pack
+bool ResultCache::writeIndex() {
+    if (mFd < 0) {
+        return false;
+    }
+    std::vector<uint8_t> data(kIndexHeaderSize + mEntries.size() * kIndexEntrySize);
+    uint8_t* p = data.data();
+    std::memcpy(p, kIndexMagic, 4);
+    p += 4;
+    putValue<uint32_t>(p, static_cast<uint32_t>(mEntries.size()));
+    putValue<uint64_t>(p, mPackSize);
+    putValue<uint64_t>(p, mUseCounter);
+    for (const auto& item : mEntries) {
+        putValue<uint64_t>(p, item.first.content);
+        putValue<uint64_t>(p, item.first.parameters);
+        putValue<uint64_t>(p, item.second.offset);
+        putValue<uint32_t>(p, item.second.size);
+        putValue<uint32_t>(p, 0);
+        putValue<uint64_t>(p, item.second.lastUse);
+    }
+
+    // Written aside and renamed, so a crash leaves the old index or the new one
+    const std::string temporary = indexPath() + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    bool success = writeAll(fd, data.data(), data.size(), 0);
+    ::close(fd);
+    if (!success || rename(temporary.c_str(), indexPath().c_str()) != 0) {
+        LOGE("Cannot write result cache index");
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Drop least recently used entries down to the low-water mark
+void ResultCache::evict() {
+    const uint64_t target = static_cast<uint64_t>(mCapacity * RESULT_CACHE_LOW_WATER);
+    if (mLiveBytes <= target) {
+        return;
+    }
+    std::vector<std::pair<uint64_t, ResultCacheKey>> order;
+    order.reserve(mEntries.size());
+    for (const auto& item : mEntries) {
+        order.emplace_back(item.second.lastUse, item.first);
+    }
+    std::sort(order.begin(), order.end(),
+        [](const std::pair<uint64_t, ResultCacheKey>& a, const std::pair<uint64_t, ResultCacheKey>& b) {
+            return a.first < b.first;
+        });
+    for (const auto& item : order) {
+        if (mLiveBytes <= target) {
+            break;
+        }
+        auto it = mEntries.find(item.second);
+        mLiveBytes -= it->second.size;
+        mEntries.erase(it);
+        mStats.evictions++;
+    }
+}
+
+// Evict down to the low-water mark and claim the compaction (caller holds the lock)
+bool ResultCache::startCompaction() {
+    evict();
+    if (mCompacting) {
+        return false;
+    }
+    mCompacting = true;
+    return true;
+}
+
+// Copy live records into a fresh pack and swap it in (caller must not hold
+// the lock and must have claimed the compaction)
+bool ResultCache::compact() {
+    struct Move {
+        ResultCacheKey key;
+        uint64_t from;
+        uint32_t size;
+    };
+    std::vector<Move> moves;
+    std::string path;
+    std::string temporary;
+    uint64_t copied = 0;
+    uint64_t generation;
+    int source;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        source = mFd >= 0 ? fcntl(mFd, F_DUPFD_CLOEXEC, 0) : -1;
+        if (source < 0) {
+            mCompacting = false;
+            return false;
+        }
+        moves.reserve(mEntries.size());
+        for (const auto& item : mEntries) {
+            moves.push_back({item.first, item.second.offset, item.second.size});
+        }
+        copied = mPackSize;
+        generation = mGeneration;
+        path = packPath();
+        temporary = path + ".tmp";
+    }
+    std::sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) { return a.from < b.from; });
+
+    // Survivors copied from the snapshot without the lock; pread rather than
+    // a mapping, so a concurrent clear() shortens the copy instead of faulting
+    int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool success = fd >= 0;
+    uint64_t offset = 0;
+    std::vector<uint8_t> buffer;
+    for (size_t i = 0; success && i < moves.size(); i++) {
+        buffer.resize(moves[i].size);
+        success = pread(source, buffer.data(), buffer.size(), static_cast<off_t>(moves[i].from)) ==
+                      static_cast<ssize_t>(buffer.size()) &&
+                  writeAll(fd, buffer.data(), buffer.size(), offset);
+        offset += moves[i].size;
+    }
+    success = success && fdatasync(fd) == 0;
+    ::close(source);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCompacting = false;
+    if (!success || generation != mGeneration || mFd < 0) {
+        if (!success) {
+            LOGE("Result cache compaction failed");
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    // Records appended while copying follow the survivors (unsynced, like any
+    // append; a torn tail is cut off by the next scan)
+    std::vector<std::pair<uint64_t, ResultCacheKey>> appended;
+    for (const auto& item : mEntries) {
+        if (item.second.offset >= copied) {
+            appended.emplace_back(item.second.offset, item.first);
+        }
+    }
+    std::sort(appended.begin(), appended.end(),
+        [](const std::pair<uint64_t, ResultCacheKey>& a, const std::pair<uint64_t, ResultCacheKey>& b) {
+            return a.first < b.first;
+        });
+    uint64_t end = offset;
+    if (!appended.empty() && !mapPack(mPackSize)) {
+        success = false;
+    }
+    for (size_t i = 0; success && i < appended.size(); i++) {
+        const Entry& entry = mEntries[appended[i].second];
+        success = writeAll(fd, mMap + entry.offset, entry.size, end);
+        end += entry.size;
+    }
+    if (!success || rename(temporary.c_str(), path.c_str()) != 0) {
+        LOGE("Result cache compaction failed");
+        ::close(fd);
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    // Offsets change only once the new pack is in place; entries dropped
+    // during the copy leave dead bytes that the next compaction reclaims
+    offset = 0;
+    for (const Move& move : moves) {
+        auto it = mEntries.find(move.key);
+        if (it != mEntries.end() && it->second.offset == move.from) {
+            it->second.offset = offset;
+        }
+        offset += move.size;
+    }
+    for (const auto& item : appended) {
+        Entry& entry = mEntries[item.second];
+        entry.offset = offset;
+        offset += entry.size;
+    }
+    unmapPack();
+    ::close(mFd);
+    mFd = fd;
+    mPackSize = end;
+    mStats.compactions++;
+    writeIndex();
+    return true;
+}
+
+// Fetch and decode a cached result
+bool ResultCache::lookup(const ResultCacheKey& key, int& width, int& height, TrackedBytes& rgba,
+                         const ImageKernels* kernels) {
+    std::vector<uint8_t> record;
+    uint64_t offset;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mFd >= 0 ? mEntries.find(key) : mEntries.end();
+        if (it == mEntries.end() || !mapPack(it->second.offset + it->second.size)) {
+            mStats.misses++;
+            return false;
+        }
+        // Copied under the lock; a compaction may remap the pack afterwards
+        offset = it->second.offset;
+        record.assign(mMap + offset, mMap + offset + it->second.size);
+        it->second.lastUse = ++mUseCounter;
+    }
+
+    RecordHeader header = {};
+    const uint8_t* payload = record.data() + kRecordHeaderSize;
+    bool valid = parseHeader(record.data(), header) && header.key == key &&
+                 kRecordHeaderSize + header.payloadSize == record.size() &&
+                 ContentHash::xxh64(payload, header.payloadSize) == header.payloadHash;
+
+    const int planeHeight = static_cast<int>(header.height) * (valid ? header.channels : 1);
+    const size_t pixels = static_cast<size_t>(header.width) * header.height;
+    TrackedBytes planes;
+    if (valid) {
+        planes.resize(pixels * header.channels);
+        valid = GrayCodec::decode(payload, header.payloadSize, planes.data(),
+                                  static_cast<int>(header.width), planeHeight);
+    }
+    if (!valid) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(key);
+        if (it != mEntries.end() && it->second.offset == offset) {
+            mLiveBytes -= it->second.size;
+            mEntries.erase(it);
+        }
+        mStats.corrupt++;
+        mStats.misses++;
+        LOGW("Dropped damaged result cache record at %llu", static_cast<unsigned long long>(offset));
+        return false;
+    }
+
+    width = static_cast<int>(header.width);
+    height = static_cast<int>(header.height);
+    rgba.resize(pixels * 4);
+    if (header.channels == 1) {
+        const ImageKernels& expander = kernels != nullptr ? *kernels : SimdKernels::vectorized();
+        expander.expandGrayToRgba(planes.data(), width, height, rgba.data());
+    } else {
+        for (int c = 0; c < 4; c++) {
+            const uint8_t* plane = planes.data() + pixels * c;
+            for (size_t i = 0; i < pixels; i++) {
+                rgba[i * 4 + c] = plane[i];
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.hits++;
+    return true;
+}
+
+// Encode and append a result
+bool ResultCache::store(const ResultCacheKey& key, const uint8_t* rgba, int width, int height) {
+    if (rgba == nullptr || width <= 0 || height <= 0) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mFd < 0) {
+            return false;
+        }
+        if (mEntries.count(key) != 0) {
+            return true;
+        }
+    }
+
+    // Gray results keep one plane; colour ones are split into stacked planes
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const int channels = isGray(rgba, pixels) ? 1 : 4;
+    TrackedBytes planes(pixels * channels);
+    for (int c = 0; c < channels; c++) {
+        uint8_t* plane = planes.data() + pixels * c;
+        for (size_t i = 0; i < pixels; i++) {
+            plane[i] = rgba[i * 4 + c];
+        }
+    }
+    TrackedBytes payload;
+    GrayCodec codec;
+    if (!codec.encode(planes.data(), width, height * channels, 0, payload)) {
+        return false;
+    }
+    releaseTracked(planes);
+
+    std::vector<uint8_t> record(kRecordHeaderSize + payload.size());
+    uint8_t* p = record.data();
+    std::memcpy(p, kRecordMagic, 4);
+    p += 4;
+    putValue<uint32_t>(p, static_cast<uint32_t>(payload.size()));
+    putValue<uint64_t>(p, key.content);
+    putValue<uint64_t>(p, key.parameters);
+    putValue<uint32_t>(p, static_cast<uint32_t>(width));
+    putValue<uint32_t>(p, static_cast<uint32_t>(height));
+    putValue<uint8_t>(p, static_cast<uint8_t>(channels));
+    p += 7;
+    putValue<uint64_t>(p, ContentHash::xxh64(payload.data(), payload.size()));
+    std::memcpy(p, payload.data(), payload.size());
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mFd < 0 || record.size() > mCapacity) {
+        return false;
+    }
+    if (mEntries.count(key) != 0) {
+        return true;
+    }
+    if (!writeAll(mFd, record.data(), record.size(), mPackSize)) {
+        LOGE("Result cache append failed: %s", strerror(errno));
+        if (ftruncate(mFd, static_cast<off_t>(mPackSize)) != 0) {
+            LOGE("Cannot truncate result cache pack");
+        }
+        return false;
+    }
+    mEntries[key] = {mPackSize, static_cast<uint32_t>(record.size()), ++mUseCounter};
+    mPackSize += record.size();
+    mLiveBytes += record.size();
+    mStats.stores++;
+
+    if (mPackSize > mCapacity && startCompaction()) {
+        lock.unlock();
+        compact();
+    }
+    return true;
+}
+
+// Drop everything
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFd < 0) {
+        return;
+    }
+    mEntries.clear();
+    mGeneration++;
+    unmapPack();
+    if (ftruncate(mFd, 0) != 0) {
+        LOGE("Cannot truncate result cache pack");
+    }
+    mPackSize = 0;
+    mLiveBytes = 0;
+    writeIndex();
+}
+
+bool ResultCache::flush() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return writeIndex();
+}
+
+ResultCacheStats ResultCache::stats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    ResultCacheStats stats = mStats;
+    stats.entries = mEntries.size();
+    stats.liveBytes = mLiveBytes;
+    stats.packBytes = mPackSize;
+    stats.capacityBytes = mCapacity;
+    return stats;
+}
+
+// Counter summary
+std::string ResultCache::getStatistics() const {
+    ResultCacheStats s = stats();
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+        "Result cache: %zu entries, %.1f MB live, %.1f MB pack (cap %.1f MB), "
+        "%llu hits, %llu misses, %llu stores, %llu evicted, %llu compactions, %llu damaged",
+        s.entries,
+        s.liveBytes / (1024.0 * 1024.0),
+        s.packBytes / (1024.0 * 1024.0),
+        s.capacityBytes / (1024.0 * 1024.0),
+        static_cast<unsigned long long>(s.hits),
+        static_cast<unsigned long long>(s.misses),
+        static_cast<unsigned long long>(s.stores),
+        static_cast<unsigned long long>(s.evictions),
+        static_cast<unsigned long long>(s.compactions),
+        static_cast<unsigned long long>(s.corrupt));
+    return std::string(buffer);
+}
@@ -0,0 +1,161 @@
+#ifndef EDGEDETECTOR_RESULT_CACHE_H
+#define EDGEDETECTOR_RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "native_memory.h"
+
+struct ImageKernels;
+
+// Fraction of the capacity left live after eviction, so stores do not evict one at a time
+#define RESULT_CACHE_LOW_WATER 0.75
+
+// Content hash of the input bytes plus a hash of everything that shapes the output
+struct ResultCacheKey {
+    uint64_t content;
+    uint64_t parameters;
+
+    bool operator==(const ResultCacheKey& other) const {
+        return content == other.content && parameters == other.parameters;
+    }
+};
+
+// Cache counters
+struct ResultCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    uint64_t compactions;
+    uint64_t corrupt;           // Records dropped for a payload hash mismatch
+    size_t entries;
+    uint64_t liveBytes;
+    uint64_t packBytes;
+    uint64_t capacityBytes;
+};
+
+/**
+ * Content-addressed on-disk cache of processed RGBA results. Records are
+ * appended to one pack file and read through a shared memory mapping; an
+ * in-memory index maps keys to records and orders them for LRU eviction.
+ * Gray results (R = G = B, opaque) are stored as one plane, others as four
+ * planes stacked vertically, both through the lossless GrayCodec, with an
+ * XXH64 of the payload checked on every read.
+ *
+ * When a store pushes the pack past the capacity, least recently used
+ * entries are dropped until the live bytes fall to RESULT_CACHE_LOW_WATER
+ * of it and the survivors are copied into a fresh pack that replaces the
+ * old one. The copy and its fdatasync run outside the lock on the storing
+ * thread, reading the old pack through its own descriptor, so lookups and
+ * stores continue meanwhile; records appended during the copy are moved
+ * over when the new pack is swapped in under the lock. The index (with
+ * LRU order) is saved on flush, close and compaction; when it is missing
+ * or does not match the pack, the pack is scanned instead and a torn tail
+ * from an interrupted append is cut off.
+ *
+ * Pack record (little-endian): "ERC1" | u32 payload size | u64 content
+ * | u64 parameters | u32 width | u32 height | u8 channels | u8 x 7 zero
+ * | u64 payload XXH64 | payload
+ * Index: "ERI1" | u32 entries | u64 pack size | u64 use counter
+ * | entries x (u64 content | u64 parameters | u64 offset | u32 size
+ * | u32 zero | u64 last use)
+ *
+ * All methods are thread-safe; encoding, decoding and the compaction copy
+ * run outside the lock.
+ */
+class ResultCache {
+public:
+    ResultCache();
+    ~ResultCache();
+
+    /**
+     * Open or create the cache in a directory
+     * @param directory Cache directory (created if missing)
+     * @param capacityBytes Pack size limit
+     * @return false if the pack cannot be opened (cache stays closed)
+     */
+    bool open(const std::string& directory, uint64_t capacityBytes);
+
+    /**
+     * Save the index and close the pack
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * Fetch a result
+     * @param key Content and parameter hash
+     * @param width Result width
+     * @param height Result height
+     * @param rgba Result pixels (replaced)
+     * @param kernels Kernel set expanding gray records (nullptr = vectorized)
+     * @return false on a miss, a closed cache or a damaged record
+     */
+    bool lookup(const ResultCacheKey& key, int& width, int& height, TrackedBytes& rgba,
+                const ImageKernels* kernels = nullptr);
+
+    /**
+     * Append a result (no-op if the key is already cached)
+     * @return false if the cache is closed, the record exceeds the capacity
+     *         or the write failed
+     */
+    bool store(const ResultCacheKey& key, const uint8_t* rgba, int width, int height);
+
+    /**
+     * Drop every entry and truncate the pack
+     */
+    void clear();
+
+    /**
+     * Save the index so the next open skips the pack scan
+     */
+    bool flush();
+
+    ResultCacheStats stats() const;
+    std::string getStatistics() const;
+
+private:
+    struct Entry {
+        uint64_t offset;
+        uint32_t size;          // Header plus payload
+        uint64_t lastUse;
+    };
+
+    struct KeyHash {
+        size_t operator()(const ResultCacheKey& key) const {
+            return static_cast<size_t>(key.content ^ (key.parameters * 0x9E3779B97F4A7C15ULL));
+        }
+    };
+
+    mutable std::mutex mMutex;
+    std::string mDirectory;
+    int mFd;
+    const uint8_t* mMap;
+    size_t mMapSize;
+    uint64_t mPackSize;
+    uint64_t mCapacity;
+    uint64_t mLiveBytes;
+    uint64_t mUseCounter;
+    uint64_t mGeneration;       // Bumped when the pack is closed or cleared
+    bool mCompacting;           // A compaction copy is in flight
+    std::unordered_map<ResultCacheKey, Entry, KeyHash> mEntries;
+    ResultCacheStats mStats;
+
+    std::string packPath() const;
+    std::string indexPath() const;
+    bool mapPack(uint64_t needed);
+    void unmapPack();
+    bool loadIndex();
+    void scanPack();
+    bool writeIndex();
+    void evict();
+    bool startCompaction();
+    bool compact();
+    void closeLocked();
+};
+
+#endif // EDGEDETECTOR_RESULT_CACHE_H
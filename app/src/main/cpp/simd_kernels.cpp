@@ -0,0 +1,573 @@
+#include "simd_kernels.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#ifdef HAVE_OPENCV
+#include <opencv2/core/hal/intrin.hpp>
+#endif
+
+// Fixed-width universal intrinsics only (the RVV scalable backend has no
+// compile-time lane count for the stack chunks below)
+#if defined(HAVE_OPENCV) && CV_SIMD && !CV_SIMD_SCALABLE
+#define SIMD_KERNELS_VECTORIZED 1
+#else
+#define SIMD_KERNELS_VECTORIZED 0
+#endif
+
+namespace {
+
+// Fallback detector threshold: (int)sqrt(m) > 50 <=> m >= 51 * 51
+const int kEdgeMagnitudeSq = 51 * 51 - 1;
+
+// Scalar helpers shared by the vector tails
+inline uint8_t videoToFull(int luma) {
+    int value = (298 * (luma - 16) + 128) >> 8;
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+inline uint8_t sobelAt(const uint8_t* p0, const uint8_t* p1, const uint8_t* p2, int x) {
+    int gx = (p0[x + 1] - p0[x - 1]) + 2 * (p1[x + 1] - p1[x - 1]) + (p2[x + 1] - p2[x - 1]);
+    int gy = (p2[x - 1] + 2 * p2[x] + p2[x + 1]) - (p0[x - 1] + 2 * p0[x] + p0[x + 1]);
+    return gx * gx + gy * gy > kEdgeMagnitudeSq ? 255 : 0;
+}
+
+inline void yuvPixel(int Y, int U, int V, uint8_t* px) {
+    int C = Y - 16;
+    int D = U - 128;
+    int E = V - 128;
+    int R = (298 * C + 409 * E + 128) >> 8;
+    int G = (298 * C - 100 * D - 208 * E + 128) >> 8;
+    int B = (298 * C + 516 * D + 128) >> 8;
+    px[0] = static_cast<uint8_t>(R < 0 ? 0 : (R > 255 ? 255 : R));
+    px[1] = static_cast<uint8_t>(G < 0 ? 0 : (G > 255 ? 255 : G));
+    px[2] = static_cast<uint8_t>(B < 0 ? 0 : (B > 255 ? 255 : B));
+    px[3] = 255;
+}
+
+#if SIMD_KERNELS_VECTORIZED
+using namespace cv;
+
+// Pixels per stack chunk in the half-resolution kernels
+const int kChunk = 256;
+
+// Luma of 1/4 vector of pixels, same operation order as ImageUtils::rgbaToGray
+inline v_uint32 lumaQuarter(const v_uint32& r, const v_uint32& g, const v_uint32& b) {
+    const v_float32 kr = vx_setall_f32(0.299f);
+    const v_float32 kg = vx_setall_f32(0.587f);
+    const v_float32 kb = vx_setall_f32(0.114f);
+    v_float32 sum = v_add(v_mul(kr, v_cvt_f32(v_reinterpret_as_s32(r))),
+                          v_mul(kg, v_cvt_f32(v_reinterpret_as_s32(g))));
+    sum = v_add(sum, v_mul(kb, v_cvt_f32(v_reinterpret_as_s32(b))));
+    return v_reinterpret_as_u32(v_trunc(sum));
+}
+
+inline v_uint16 lumaHalf(const v_uint16& r, const v_uint16& g, const v_uint16& b) {
+    v_uint32 r0, r1, g0, g1, b0, b1;
+    v_expand(r, r0, r1);
+    v_expand(g, g0, g1);
+    v_expand(b, b0, b1);
+    return v_pack(lumaQuarter(r0, g0, b0), lumaQuarter(r1, g1, b1));
+}
+
+// Luma of one vector of RGBA pixels
+inline v_uint8 lumaVector(const uint8_t* rgba) {
+    v_uint8 r, g, b, a;
+    v_load_deinterleave(rgba, r, g, b, a);
+    v_uint16 r0, r1, g0, g1, b0, b1;
+    v_expand(r, r0, r1);
+    v_expand(g, g0, g1);
+    v_expand(b, b0, b1);
+    return v_pack(lumaHalf(r0, g0, b0), lumaHalf(r1, g1, b1));
+}
+
+void lumaRow(const uint8_t* rgba, int count, uint8_t* gray) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    int x = 0;
+    for (; x + lanes <= count; x += lanes) {
+        v_store(gray + x, lumaVector(rgba + 4 * x));
+    }
+    for (; x < count; x++) {
+        const uint8_t* px = rgba + 4 * x;
+        gray[x] = ImageUtils::rgbaToGray(px[0], px[1], px[2]);
+    }
+}
+
+// (a + b + c + d + 2) >> 2 over 2x2 blocks: 2 vectors of input per row -> 1 vector
+inline v_uint8 average2x2(const uint8_t* top, const uint8_t* bottom) {
+    v_uint8 te, to, be, bo;
+    v_load_deinterleave(top, te, to);
+    v_load_deinterleave(bottom, be, bo);
+    v_uint16 te0, te1, to0, to1, be0, be1, bo0, bo1;
+    v_expand(te, te0, te1);
+    v_expand(to, to0, to1);
+    v_expand(be, be0, be1);
+    v_expand(bo, bo0, bo1);
+    const v_uint16 two = vx_setall_u16(2);
+    v_uint16 s0 = v_shr<2>(v_add(v_add(v_add(te0, to0), v_add(be0, bo0)), two));
+    v_uint16 s1 = v_shr<2>(v_add(v_add(v_add(te1, to1), v_add(be1, bo1)), two));
+    return v_pack(s0, s1);
+}
+
+// (298 * (y - 16) + 128) >> 8, clamped; 298 y' = 256 y' + 42 y' keeps it in 16 bits
+inline v_uint8 videoToFullVector(const v_uint8& luma) {
+    v_uint8 c = v_sub(luma, vx_setall_u8(16));
+    v_uint16 c0, c1;
+    v_expand(c, c0, c1);
+    const v_uint16 k42 = vx_setall_u16(42);
+    const v_uint16 k128 = vx_setall_u16(128);
+    c0 = v_add(c0, v_shr<8>(v_add(v_mul_wrap(c0, k42), k128)));
+    c1 = v_add(c1, v_shr<8>(v_add(v_mul_wrap(c1, k42), k128)));
+    return v_pack(c0, c1);
+}
+
+void rgbaToGrayVector(const uint8_t* rgba, int width, int height, uint8_t* gray) {
+    lumaRow(rgba, width * height, gray);
+}
+
+void rgbaToGrayHalfVector(const uint8_t* rgba, int width, int height, uint8_t* gray) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    const int halfWidth = width / 2;
+    const int halfHeight = height / 2;
+    const size_t stride = static_cast<size_t>(width) * 4;
+    uint8_t top[2 * kChunk];
+    uint8_t bottom[2 * kChunk];
+
+    for (int y = 0; y < halfHeight; y++) {
+        const uint8_t* topRow = rgba + static_cast<size_t>(2 * y) * stride;
+        const uint8_t* bottomRow = topRow + stride;
+        uint8_t* out = gray + static_cast<size_t>(y) * halfWidth;
+
+        for (int x0 = 0; x0 < halfWidth; x0 += kChunk) {
+            const int count = std::min(kChunk, halfWidth - x0);
+            lumaRow(topRow + static_cast<size_t>(x0) * 8, 2 * count, top);
+            lumaRow(bottomRow + static_cast<size_t>(x0) * 8, 2 * count, bottom);
+            int x = 0;
+            for (; x + lanes <= count; x += lanes) {
+                v_store(out + x0 + x, average2x2(top + 2 * x, bottom + 2 * x));
+            }
+            for (; x < count; x++) {
+                int sum = top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1];
+                out[x0 + x] = static_cast<uint8_t>((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+void expandGrayToRgbaVector(const uint8_t* gray, int width, int height, uint8_t* rgba) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    const int count = width * height;
+    const v_uint8 alpha = vx_setall_u8(255);
+    int i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        v_uint8 value = vx_load(gray + i);
+        v_store_interleave(rgba + 4 * static_cast<size_t>(i), value, value, value, alpha);
+    }
+    for (; i < count; i++) {
+        uint8_t* px = rgba + 4 * static_cast<size_t>(i);
+        px[0] = px[1] = px[2] = gray[i];
+        px[3] = 255;
+    }
+}
+
+// R, G, B for 1/4 vector of pixels (offset luma and centred chroma in 32 bits)
+inline void yuvQuarter(const v_int32& c, const v_int32& d, const v_int32& e,
+                       v_int32& r, v_int32& g, v_int32& b) {
+    const v_int32 base = v_add(v_mul(c, vx_setall_s32(298)), vx_setall_s32(128));
+    r = v_shr<8>(v_add(base, v_mul(e, vx_setall_s32(409))));
+    g = v_shr<8>(v_sub(v_sub(base, v_mul(d, vx_setall_s32(100))), v_mul(e, vx_setall_s32(208))));
+    b = v_shr<8>(v_add(base, v_mul(d, vx_setall_s32(516))));
+}
+
+inline void expandQuarters(const v_uint8& value, int offset, v_int32 quarters[4]) {
+    v_uint16 h0, h1;
+    v_expand(value, h0, h1);
+    v_uint32 q0, q1, q2, q3;
+    v_expand(h0, q0, q1);
+    v_expand(h1, q2, q3);
+    const v_int32 bias = vx_setall_s32(offset);
+    quarters[0] = v_sub(v_reinterpret_as_s32(q0), bias);
+    quarters[1] = v_sub(v_reinterpret_as_s32(q1), bias);
+    quarters[2] = v_sub(v_reinterpret_as_s32(q2), bias);
+    quarters[3] = v_sub(v_reinterpret_as_s32(q3), bias);
+}
+
+void yuv420ToRgbaVector(
+    const uint8_t* yData,
+    const uint8_t* uData,
+    const uint8_t* vData,
+    int width,
+    int height,
+    int yRowStride,
+    int uvRowStride,
+    int uvPixelStride,
+    uint8_t* rgba
+) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    const int chromaWidth = (width + 1) / 2;
+    std::vector<uint8_t> uRow(chromaWidth + lanes);
+    std::vector<uint8_t> vRow(chromaWidth + lanes);
+    const v_uint8 alpha = vx_setall_u8(255);
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* yLine = yData + static_cast<size_t>(y) * yRowStride;
+        const uint8_t* uLine = uData + static_cast<size_t>(y / 2) * uvRowStride;
+        const uint8_t* vLine = vData + static_cast<size_t>(y / 2) * uvRowStride;
+        uint8_t* out = rgba + static_cast<size_t>(y) * width * 4;
+
+        // Gather the row's chroma once (planar or interleaved)
+        if (uvPixelStride == 1) {
+            std::memcpy(uRow.data(), uLine, chromaWidth);
+            std::memcpy(vRow.data(), vLine, chromaWidth);
+        } else {
+            for (int x = 0; x < chromaWidth; x++) {
+                uRow[x] = uLine[x * uvPixelStride];
+                vRow[x] = vLine[x * uvPixelStride];
+            }
+        }
+
+        int x = 0;
+        for (; x + lanes <= width; x += lanes) {
+            v_uint8 uHalf = vx_load_low(uRow.data() + x / 2);
+            v_uint8 vHalf = vx_load_low(vRow.data() + x / 2);
+            v_uint8 u, v, unused;
+            v_zip(uHalf, uHalf, u, unused);
+            v_zip(vHalf, vHalf, v, unused);
+
+            v_int32 c[4], d[4], e[4], r[4], g[4], b[4];
+            expandQuarters(vx_load(yLine + x), 16, c);
+            expandQuarters(u, 128, d);
+            expandQuarters(v, 128, e);
+            for (int q = 0; q < 4; q++) {
+                yuvQuarter(c[q], d[q], e[q], r[q], g[q], b[q]);
+            }
+
+            v_uint8 red = v_pack_u(v_pack(r[0], r[1]), v_pack(r[2], r[3]));
+            v_uint8 green = v_pack_u(v_pack(g[0], g[1]), v_pack(g[2], g[3]));
+            v_uint8 blue = v_pack_u(v_pack(b[0], b[1]), v_pack(b[2], b[3]));
+            v_store_interleave(out + 4 * x, red, green, blue, alpha);
+        }
+        for (; x < width; x++) {
+            yuvPixel(yLine[x], uRow[x / 2], vRow[x / 2], out + 4 * x);
+        }
+    }
+}
+
+void lumaFromVideoRangeVector(const uint8_t* yData, int width, int height, int yRowStride, uint8_t* gray) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = yData + static_cast<size_t>(y) * yRowStride;
+        uint8_t* out = gray + static_cast<size_t>(y) * width;
+        int x = 0;
+        for (; x + lanes <= width; x += lanes) {
+            v_store(out + x, videoToFullVector(vx_load(row + x)));
+        }
+        for (; x < width; x++) {
+            out[x] = videoToFull(row[x]);
+        }
+    }
+}
+
+void lumaFromVideoRangeHalfVector(const uint8_t* yData, int width, int height, int yRowStride, uint8_t* gray) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    const int halfWidth = width / 2;
+    const int halfHeight = height / 2;
+    for (int y = 0; y < halfHeight; y++) {
+        const uint8_t* top = yData + static_cast<size_t>(2 * y) * yRowStride;
+        const uint8_t* bottom = top + yRowStride;
+        uint8_t* out = gray + static_cast<size_t>(y) * halfWidth;
+        int x = 0;
+        for (; x + lanes <= halfWidth; x += lanes) {
+            v_store(out + x, videoToFullVector(average2x2(top + 2 * x, bottom + 2 * x)));
+        }
+        for (; x < halfWidth; x++) {
+            out[x] = videoToFull((top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1] + 2) >> 2);
+        }
+    }
+}
+
+// Squared magnitude > threshold for half a vector of Sobel responses -> 0/255 in 16 bits
+inline v_int16 sobelMask(const v_int16& gx, const v_int16& gy) {
+    v_int16 z0, z1;
+    v_zip(gx, gy, z0, z1);
+    const v_int32 limit = vx_setall_s32(kEdgeMagnitudeSq);
+    const v_int32 full = vx_setall_s32(255);
+    v_int32 m0 = v_and(v_gt(v_dotprod(z0, z0), limit), full);
+    v_int32 m1 = v_and(v_gt(v_dotprod(z1, z1), limit), full);
+    return v_pack(m0, m1);
+}
+
+inline void loadSigned(const uint8_t* p, v_int16& lo, v_int16& hi) {
+    v_uint16 a, b;
+    v_expand(vx_load(p), a, b);
+    lo = v_reinterpret_as_s16(a);
+    hi = v_reinterpret_as_s16(b);
+}
+
+inline v_int16 sobelHalf(const v_int16 n[9], v_int16& gy) {
+    // n: rows 0..2, columns x-1, x, x+1
+    v_int16 gx = v_add(v_add(v_sub(n[2], n[0]), v_sub(n[8], n[6])),
+                       v_shl<1>(v_sub(n[5], n[3])));
+    gy = v_sub(v_add(v_add(n[6], n[8]), v_shl<1>(n[7])),
+               v_add(v_add(n[0], n[2]), v_shl<1>(n[1])));
+    return gx;
+}
+
+void simpleEdgeDetectionVector(const uint8_t* gray, int width, int height, uint8_t* edges) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    std::memset(edges, 0, static_cast<size_t>(width) * height);
+
+    for (int y = 1; y < height - 1; y++) {
+        const uint8_t* p0 = gray + static_cast<size_t>(y - 1) * width;
+        const uint8_t* p1 = p0 + width;
+        const uint8_t* p2 = p1 + width;
+        uint8_t* out = edges + static_cast<size_t>(y) * width;
+
+        int x = 1;
+        for (; x + lanes <= width - 1; x += lanes) {
+            v_int16 lo[9], hi[9];
+            const uint8_t* rows[3] = {p0, p1, p2};
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 3; c++) {
+                    loadSigned(rows[r] + x + c - 1, lo[3 * r + c], hi[3 * r + c]);
+                }
+            }
+            v_int16 gyLo, gyHi;
+            v_int16 gxLo = sobelHalf(lo, gyLo);
+            v_int16 gxHi = sobelHalf(hi, gyHi);
+            v_store(out + x, v_pack_u(sobelMask(gxLo, gyLo), sobelMask(gxHi, gyHi)));
+        }
+        for (; x < width - 1; x++) {
+            out[x] = sobelAt(p0, p1, p2, x);
+        }
+    }
+}
+
+void applyThresholdVector(const uint8_t* input, int width, int height, uint8_t threshold, uint8_t* output) {
+    const int lanes = VTraits<v_uint8>::vlanes();
+    const int count = width * height;
+    const v_uint8 limit = vx_setall_u8(threshold);
+    int i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        v_store(output + i, v_gt(vx_load(input + i), limit));
+    }
+    for (; i < count; i++) {
+        output[i] = input[i] > threshold ? 255 : 0;
+    }
+}
+
+void packMaskVector(const uint8_t* mask, size_t count, uint8_t* bits) {
+    size_t i = 0;
+#if CV_SIMD128
+    // 128-bit sign masks are available on every backend
+    const v_uint8x16 zero = v_setzero_u8();
+    for (; i + 16 <= count; i += 16) {
+        int flags = v_signmask(v_ne(v_load(mask + i), zero));
+        bits[i / 8] = static_cast<uint8_t>(flags);
+        bits[i / 8 + 1] = static_cast<uint8_t>(flags >> 8);
+    }
+#endif
+    ImageUtils::packMask(mask + i, count - i, bits + i / 8);
+}
+#endif // SIMD_KERNELS_VECTORIZED
+
+const ImageKernels kReference = {
+    "scalar",
+    ImageUtils::rgbaToGrayPlane,
+    ImageUtils::rgbaToGrayHalf,
+    ImageUtils::expandGrayToRgba,
+    ImageUtils::yuv420ToRgba,
+    ImageUtils::lumaFromVideoRange,
+    ImageUtils::lumaFromVideoRangeHalf,
+    ImageUtils::simpleEdgeDetection,
+    ImageUtils::applyThreshold,
+    ImageUtils::packMask
+};
+
+#if SIMD_KERNELS_VECTORIZED
+const ImageKernels kVectorized = {
+    "vector",
+    rgbaToGrayVector,
+    rgbaToGrayHalfVector,
+    expandGrayToRgbaVector,
+    yuv420ToRgbaVector,
+    lumaFromVideoRangeVector,
+    lumaFromVideoRangeHalfVector,
+    simpleEdgeDetectionVector,
+    applyThresholdVector,
+    packMaskVector
+};
+#endif
+
+// Count differing bytes between two runs of a kernel
+int compareBuffers(const char* kernel, const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual) {
+    size_t mismatches = 0;
+    size_t first = expected.size();
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (expected[i] != actual[i]) {
+            if (mismatches == 0) {
+                first = i;
+            }
+            mismatches++;
+        }
+    }
+    if (mismatches > 0) {
+        LOGE("SIMD kernel %s: %zu byte(s) differ, first at %zu (%d vs %d)",
+             kernel, mismatches, first, expected[first], actual[first]);
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+namespace SimdKernels {
+
+const ImageKernels& reference() {
+    return kReference;
+}
+
+const ImageKernels& vectorized() {
+#if SIMD_KERNELS_VECTORIZED
+    return kVectorized;
+#else
+    return kReference;
+#endif
+}
+
+bool isVectorized() {
+    return SIMD_KERNELS_VECTORIZED != 0;
+}
+
+const char* backend() {
+#if SIMD_KERNELS_VECTORIZED
+#if CV_AVX512_SKX
+    return "AVX512";
+#elif CV_AVX2
+    return "AVX2";
+#elif CV_NEON
+    return "NEON";
+#elif CV_SSE4_1
+    return "SSE4.1";
+#elif CV_SSE2
+    return "SSE2";
+#else
+    return "SIMD";
+#endif
+#else
+    return "scalar";
+#endif
+}
+
+int lanes() {
+#if SIMD_KERNELS_VECTORIZED
+    return cv::VTraits<cv::v_uint8>::vlanes();
+#else
+    return 1;
+#endif
+}
+
+// Compare every vectorized kernel with the reference
+int selfTest(int width, int height, uint32_t seed) {
+    if (width < 2 || height < 2) {
+        return 0;
+    }
+    const ImageKernels& ref = reference();
+    const ImageKernels& vec = vectorized();
+    const size_t pixels = static_cast<size_t>(width) * height;
+    std::mt19937 rng(seed);
+
+    // Random bytes with runs of extremes so clamping and exact-integer luma are hit
+    std::vector<uint8_t> rgba(pixels * 4);
+    for (size_t i = 0; i < rgba.size(); i++) {
+        uint32_t r = rng();
+        rgba[i] = (r & 0x700) == 0 ? ((r & 1) ? 255 : 0) : static_cast<uint8_t>(r);
+    }
+    std::vector<uint8_t> gray(pixels);
+    for (size_t i = 0; i < pixels; i++) {
+        gray[i] = rgba[i * 4];
+    }
+
+    // YUV_420_888 as semi-planar (pixel stride 2) with padded rows
+    const int yStride = width + 16;
+    const int chromaWidth = (width + 1) / 2;
+    const int uvStride = chromaWidth * 2 + 8;
+    std::vector<uint8_t> yPlane(static_cast<size_t>(yStride) * height);
+    std::vector<uint8_t> uvPlane(static_cast<size_t>(uvStride) * ((height + 1) / 2) + 1);
+    for (uint8_t& value : yPlane) {
+        value = static_cast<uint8_t>(rng());
+    }
+    for (uint8_t& value : uvPlane) {
+        value = static_cast<uint8_t>(rng());
+    }
+
+    const size_t halfPixels = static_cast<size_t>(width / 2) * (height / 2);
+    int failures = 0;
+    std::vector<uint8_t> expected, actual;
+
+    expected.assign(pixels, 0);
+    actual.assign(pixels, 0);
+    ref.rgbaToGray(rgba.data(), width, height, expected.data());
+    vec.rgbaToGray(rgba.data(), width, height, actual.data());
+    failures += compareBuffers("rgbaToGray", expected, actual);
+
+    expected.assign(halfPixels, 0);
+    actual.assign(halfPixels, 0);
+    ref.rgbaToGrayHalf(rgba.data(), width, height, expected.data());
+    vec.rgbaToGrayHalf(rgba.data(), width, height, actual.data());
+    failures += compareBuffers("rgbaToGrayHalf", expected, actual);
+
+    expected.assign(pixels * 4, 0);
+    actual.assign(pixels * 4, 0);
+    ref.expandGrayToRgba(gray.data(), width, height, expected.data());
+    vec.expandGrayToRgba(gray.data(), width, height, actual.data());
+    failures += compareBuffers("expandGrayToRgba", expected, actual);
+
+    for (int pixelStride = 1; pixelStride <= 2; pixelStride++) {
+        expected.assign(pixels * 4, 0);
+        actual.assign(pixels * 4, 0);
+        ref.yuv420ToRgba(yPlane.data(), uvPlane.data(), uvPlane.data() + 1, width, height,
+                         yStride, uvStride, pixelStride, expected.data());
+        vec.yuv420ToRgba(yPlane.data(), uvPlane.data(), uvPlane.data() + 1, width, height,
+                         yStride, uvStride, pixelStride, actual.data());
+        failures += compareBuffers("yuv420ToRgba", expected, actual);
+    }
+
+    expected.assign(pixels, 0);
+    actual.assign(pixels, 0);
+    ref.lumaFromVideoRange(yPlane.data(), width, height, yStride, expected.data());
+    vec.lumaFromVideoRange(yPlane.data(), width, height, yStride, actual.data());
+    failures += compareBuffers("lumaFromVideoRange", expected, actual);
+
+    expected.assign(halfPixels, 0);
+    actual.assign(halfPixels, 0);
+    ref.lumaFromVideoRangeHalf(yPlane.data(), width, height, yStride, expected.data());
+    vec.lumaFromVideoRangeHalf(yPlane.data(), width, height, yStride, actual.data());
+    failures += compareBuffers("lumaFromVideoRangeHalf", expected, actual);
+
+    expected.assign(pixels, 0);
+    actual.assign(pixels, 0);
+    ref.simpleEdgeDetection(gray.data(), width, height, expected.data());
+    vec.simpleEdgeDetection(gray.data(), width, height, actual.data());
+    failures += compareBuffers("simpleEdgeDetection", expected, actual);
+
+    expected.assign(pixels, 0);
+    actual.assign(pixels, 0);
+    ref.applyThreshold(gray.data(), width, height, 127, expected.data());
+    vec.applyThreshold(gray.data(), width, height, 127, actual.data());
+    failures += compareBuffers("applyThreshold", expected, actual);
+
+    expected.assign((pixels + 7) / 8, 0);
+    actual.assign((pixels + 7) / 8, 0);
+    ref.packMask(gray.data(), pixels, expected.data());
+    vec.packMask(gray.data(), pixels, actual.data());
+    failures += compareBuffers("packMask", expected, actual);
+
+    LOGI("SIMD kernel self-test %dx%d (%s, %d lanes): %d failure(s)",
+         width, height, backend(), lanes(), failures);
+    return failures;
+}
+
+} // namespace SimdKernels
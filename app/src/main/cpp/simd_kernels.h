@@ -0,0 +1,85 @@
+#ifndef EDGEDETECTOR_SIMD_KERNELS_H
+#define EDGEDETECTOR_SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Per-pixel conversion kernels. The scalar set is the ImageUtils reference;
+ * the vectorized set is written once against OpenCV universal intrinsics
+ * (NEON on the phone ABIs, SSE/AVX on x86) and produces bit-identical
+ * output, so callers may switch between them freely.
+ */
+struct ImageKernels {
+    const char* name;
+
+    // RGBA to luma (0.299 R + 0.587 G + 0.114 B, truncated)
+    void (*rgbaToGray)(const uint8_t* rgba, int width, int height, uint8_t* gray);
+
+    // RGBA to luma at half resolution (2x2 average of full-resolution luma)
+    void (*rgbaToGrayHalf)(const uint8_t* rgba, int width, int height, uint8_t* gray);
+
+    // Single-channel plane to RGBA (value in RGB, alpha 255)
+    void (*expandGrayToRgba)(const uint8_t* gray, int width, int height, uint8_t* rgba);
+
+    // YUV_420_888 planes to RGBA (BT.601 limited range)
+    void (*yuv420ToRgba)(
+        const uint8_t* yData,
+        const uint8_t* uData,
+        const uint8_t* vData,
+        int width,
+        int height,
+        int yRowStride,
+        int uvRowStride,
+        int uvPixelStride,
+        uint8_t* rgba
+    );
+
+    // Video-range luma to full-range gray, full and half resolution
+    void (*lumaFromVideoRange)(const uint8_t* yData, int width, int height, int yRowStride, uint8_t* gray);
+    void (*lumaFromVideoRangeHalf)(const uint8_t* yData, int width, int height, int yRowStride, uint8_t* gray);
+
+    // Thresholded 3x3 Sobel magnitude (fallback edge detector)
+    void (*simpleEdgeDetection)(const uint8_t* gray, int width, int height, uint8_t* edges);
+
+    // Binary threshold (value > threshold -> 255)
+    void (*applyThreshold)(const uint8_t* input, int width, int height, uint8_t threshold, uint8_t* output);
+
+    // Non-zero flags to bits, LSB first, (count + 7) / 8 bytes
+    void (*packMask)(const uint8_t* mask, size_t count, uint8_t* bits);
+};
+
+namespace SimdKernels {
+    /**
+     * Scalar reference kernels (ImageUtils)
+     */
+    const ImageKernels& reference();
+
+    /**
+     * Vectorized kernels, or the reference when this build has no SIMD backend
+     */
+    const ImageKernels& vectorized();
+
+    /**
+     * Whether vectorized() is backed by SIMD code in this build
+     */
+    bool isVectorized();
+
+    /**
+     * Backend name ("NEON", "SSE2", "AVX2", ... or "scalar") and 8-bit lane count
+     */
+    const char* backend();
+    int lanes();
+
+    /**
+     * Run every kernel over random and edge-case inputs and compare the
+     * vectorized set with the reference
+     * @param width Test plane width (odd sizes exercise the scalar tails)
+     * @param height Test plane height
+     * @param seed Random seed
+     * @return Number of mismatching kernels (0 = bit-exact)
+     */
+    int selfTest(int width, int height, uint32_t seed);
+}
+
+#endif // EDGEDETECTOR_SIMD_KERNELS_H
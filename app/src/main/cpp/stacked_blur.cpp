@@ -0,0 +1,178 @@
+#include "stacked_blur.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    // Fixed-point reciprocal of the box width; 255 * 2^22 still fits in 32 bits
+    const int kScaleBits = 22;
+
+    inline uint32_t reciprocal(int boxWidth) {
+        return static_cast<uint32_t>(((1u << kScaleBits) + boxWidth / 2) / boxWidth);
+    }
+
+    inline uint8_t scaled(uint32_t sum, uint32_t multiplier) {
+        return static_cast<uint8_t>((sum * multiplier + (1u << (kScaleBits - 1))) >> kScaleBits);
+    }
+
+    // One horizontal box pass over a row with replicated borders
+    void boxRow(const uint8_t* in, uint8_t* out, int width, int radius) {
+        const uint32_t multiplier = reciprocal(2 * radius + 1);
+        const int last = width - 1;
+
+        uint32_t sum = in[0] * static_cast<uint32_t>(radius + 1);
+        for (int i = 1; i <= radius; i++) {
+            sum += in[std::min(i, last)];
+        }
+
+        // Clamped indices only near the borders
+        int x = 0;
+        for (; x <= radius && x < width; x++) {
+            out[x] = scaled(sum, multiplier);
+            sum += in[std::min(x + radius + 1, last)];
+            sum -= in[std::max(x - radius, 0)];
+        }
+        for (; x + radius + 1 <= last; x++) {
+            out[x] = scaled(sum, multiplier);
+            sum += in[x + radius + 1];
+            sum -= in[x - radius];
+        }
+        for (; x < width; x++) {
+            out[x] = scaled(sum, multiplier);
+            sum += in[last];
+            sum -= in[std::max(x - radius, 0)];
+        }
+    }
+
+    // Deadline check at the start of every band of DEADLINE_BAND_ROWS rows
+    inline bool lateAtRow(const FrameDeadline* deadline, int y) {
+        return deadline != nullptr && y % DEADLINE_BAND_ROWS == 0 && deadline->expired();
+    }
+
+    // One vertical box pass over columns [x0, x1), a row at a time
+    void boxColumns(const uint8_t* in, uint8_t* out, int width, int height, int radius,
+                    int x0, int x1, std::vector<uint32_t, TrackedAllocator<uint32_t>>& sums,
+                    const FrameDeadline* deadline) {
+        const uint32_t multiplier = reciprocal(2 * radius + 1);
+        const int last = height - 1;
+        const int span = x1 - x0;
+        sums.resize(span);
+        uint32_t* acc = sums.data();
+
+        const uint8_t* first = in + x0;
+        for (int x = 0; x < span; x++) {
+            acc[x] = first[x] * static_cast<uint32_t>(radius + 1);
+        }
+        for (int i = 1; i <= radius; i++) {
+            const uint8_t* row = in + static_cast<size_t>(std::min(i, last)) * width + x0;
+            for (int x = 0; x < span; x++) {
+                acc[x] += row[x];
+            }
+        }
+
+        for (int y = 0; y < height; y++) {
+            if (lateAtRow(deadline, y)) {
+                return;
+            }
+            uint8_t* target = out + static_cast<size_t>(y) * width + x0;
+            const uint8_t* entering = in + static_cast<size_t>(std::min(y + radius + 1, last)) * width + x0;
+            const uint8_t* leaving = in + static_cast<size_t>(std::max(y - radius, 0)) * width + x0;
+            for (int x = 0; x < span; x++) {
+                target[x] = scaled(acc[x], multiplier);
+                acc[x] += entering[x];
+                acc[x] -= leaving[x];
+            }
+        }
+    }
+}
+
+// Box widths for a sigma
+void StackedBlur::boxWidths(float sigma, int* widths) {
+    const int passes = STACKED_BLUR_PASSES;
+    const double variance = 12.0 * sigma * sigma;
+    int lower = static_cast<int>(std::floor(std::sqrt(variance / passes + 1.0)));
+    if (lower % 2 == 0) {
+        lower--;
+    }
+    lower = std::max(1, lower);
+    const int upper = lower + 2;
+
+    // Number of passes at the lower width that best matches the variance
+    const double ideal = (variance - passes * lower * lower - 4.0 * passes * lower - 3.0 * passes) /
+                         (-4.0 * lower - 4.0);
+    const int lowerCount = std::max(0, std::min(passes, static_cast<int>(std::lround(ideal))));
+    for (int i = 0; i < passes; i++) {
+        widths[i] = i < lowerCount ? lower : upper;
+    }
+}
+
+// Three horizontal then three vertical box passes
+bool StackedBlur::blur(
+    const uint8_t* source,
+    uint8_t* output,
+    int width,
+    int height,
+    float sigma,
+    const FrameDeadline* deadline
+) {
+    int widths[STACKED_BLUR_PASSES];
+    boxWidths(sigma, widths);
+
+    const size_t pixels = static_cast<size_t>(width) * height;
+    mScratch.resize(pixels);
+    uint8_t* scratch = mScratch.data();
+    WorkerPool& pool = WorkerPool::shared();
+    const int tasks = pool.threadCount();
+    mBands.resize(tasks);
+
+    // Horizontal passes stay within a row buffer: source -> scratch
+    pool.parallelFor(tasks, [&](int task) {
+        const int y0 = static_cast<int>(static_cast<int64_t>(height) * task / tasks);
+        const int y1 = static_cast<int>(static_cast<int64_t>(height) * (task + 1) / tasks);
+        BandScratch& band = mBands[task];
+        band.first.resize(width);
+        band.second.resize(width);
+        for (int y = y0; y < y1; y++) {
+            if (lateAtRow(deadline, y - y0)) {
+                return;
+            }
+            const size_t offset = static_cast<size_t>(y) * width;
+            boxRow(source + offset, band.first.data(), width, widths[0] / 2);
+            boxRow(band.first.data(), band.second.data(), width, widths[1] / 2);
+            boxRow(band.second.data(), scratch + offset, width, widths[2] / 2);
+        }
+    });
+
+    // Vertical passes ping-pong scratch -> output -> scratch -> output
+    const uint8_t* inputs[STACKED_BLUR_PASSES] = {scratch, output, scratch};
+    uint8_t* outputs[STACKED_BLUR_PASSES] = {output, scratch, output};
+    for (int pass = 0; pass < STACKED_BLUR_PASSES; pass++) {
+        if (deadline != nullptr && deadline->expired()) {
+            return false;
+        }
+        pool.parallelFor(tasks, [&](int task) {
+            // Strip bounds on 64-byte multiples so workers never share a cache line
+            const int x0 = std::min(width, (width * task / tasks + 63) & ~63);
+            const int x1 = task + 1 == tasks ? width : std::min(width, (width * (task + 1) / tasks + 63) & ~63);
+            if (x1 > x0) {
+                boxColumns(inputs[pass], outputs[pass], width, height, widths[pass] / 2, x0, x1,
+                           mBands[task].sums, deadline);
+            }
+        });
+    }
+    return deadline == nullptr || !deadline->expired();
+}
+
+// Release scratch
+size_t StackedBlur::release() {
+    size_t released = releaseTracked(mScratch);
+    for (BandScratch& band : mBands) {
+        released += releaseTracked(band.first);
+        released += releaseTracked(band.second);
+        released += releaseTracked(band.sums);
+    }
+    mBands.clear();
+    mBands.shrink_to_fit();
+    return released;
+}
@@ -0,0 +1,84 @@
+#ifndef EDGEDETECTOR_STACKED_BLUR_H
+#define EDGEDETECTOR_STACKED_BLUR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frame_deadline.h"
+#include "native_memory.h"
+
+// Sigma above which the stacked box blur replaces a true Gaussian kernel
+#define STACKED_BLUR_SIGMA_CUTOFF 2.5f
+
+// Box passes approximating one Gaussian
+#define STACKED_BLUR_PASSES 3
+
+class StackedBlur {
+public:
+    /**
+     * Box widths (odd) whose stacked variance matches sigma as closely as
+     * odd widths allow (Kutskir's split between two adjacent odd widths)
+     * @param sigma Gaussian standard deviation
+     * @param widths Output, STACKED_BLUR_PASSES entries
+     */
+    static void boxWidths(float sigma, int* widths);
+
+    /**
+     * Gaussian approximation by three box filters per axis
+     * Every pass is a running sum, so the cost per pixel does not depend on
+     * sigma. Horizontal passes run per row on the worker pool; vertical
+     * passes keep one accumulator per column and advance a whole row at a
+     * time, which vectorizes across columns. Borders replicate the edge
+     * pixel (OpenCV's GaussianBlur reflects instead).
+     *
+     * Accuracy against a true Gaussian with the same sigma and replicated
+     * border (1280x720 synthetic scenes, sigma 3-12): mean absolute error
+     * 0.4-0.8 gray levels and at most 4 levels away from the border. Within
+     * about 3 sigma of the border the error grows (up to ~35 levels at a
+     * corner pixel that differs strongly from its neighbours), because each
+     * box pass replicates its own already-blurred border.
+     *
+     * @param source Input plane (must not alias output)
+     * @param output Blurred plane
+     * @param width Plane width
+     * @param height Plane height
+     * @param sigma Gaussian standard deviation
+     * @param deadline Checked before each pass and every DEADLINE_BAND_ROWS
+     *        rows within one (nullptr = none)
+     * @return false if the deadline passed (output incomplete)
+     */
+    bool blur(
+        const uint8_t* source,
+        uint8_t* output,
+        int width,
+        int height,
+        float sigma,
+        const FrameDeadline* deadline = nullptr
+    );
+
+    /**
+     * Intermediate plane, kept between frames (exposed for state prefaulting)
+     */
+    TrackedBytes& scratchPlane() { return mScratch; }
+
+    /**
+     * Release the intermediate plane and band buffers
+     * @return Bytes released
+     */
+    size_t release();
+
+private:
+    using SumBuffer = std::vector<uint32_t, TrackedAllocator<uint32_t>>;
+
+    // Per-band row buffers and column accumulators, kept between frames
+    struct BandScratch {
+        TrackedBytes first;
+        TrackedBytes second;
+        SumBuffer sums;
+    };
+
+    TrackedBytes mScratch;
+    std::vector<BandScratch> mBands;
+};
+
+#endif // EDGEDETECTOR_STACKED_BLUR_H
@@ -0,0 +1,273 @@
+#include "stream_loopback.h"
+#include "opencv_processor.h"
+#include "stream_sender.h"
+#include "subpixel_edges.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    int64_t nowUs() {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+    }
+
+    uint64_t readLe(const uint8_t* p, int bytes) {
+        uint64_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    double percentileMs(std::vector<int64_t>& values, double fraction) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index] / 1000.0;
+    }
+
+    // Receiver side of the link
+    struct Receiver {
+        int socket = -1;
+        double bytesPerSecond = 0.0;
+        std::atomic<bool> stop{false};
+        std::vector<int64_t> latenciesUs;
+        uint64_t frames = 0;
+        uint64_t corrupt = 0;
+        uint64_t bytes = 0;
+        uint64_t perEncoding[3] = {0, 0, 0};
+
+        // Read at the throttled rate and parse messages
+        void run() {
+            std::vector<uint8_t> pending;
+            std::vector<uint8_t> plane;
+            uint8_t chunk[4096];
+            const int64_t startUs = nowUs();
+
+            while (!stop) {
+                pollfd descriptor = {socket, POLLIN, 0};
+                if (poll(&descriptor, 1, 50) <= 0) {
+                    continue;
+                }
+                ssize_t received = recv(socket, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    break;
+                }
+                bytes += static_cast<uint64_t>(received);
+                pending.insert(pending.end(), chunk, chunk + received);
+                parse(pending, plane);
+
+                // Token bucket: never get ahead of the configured link rate
+                if (bytesPerSecond > 0.0) {
+                    int64_t dueUs = startUs + static_cast<int64_t>(bytes * 1e6 / bytesPerSecond);
+                    int64_t waitUs = dueUs - nowUs();
+                    if (waitUs > 0) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+                    }
+                }
+            }
+        }
+
+        void parse(std::vector<uint8_t>& pending, std::vector<uint8_t>& plane) {
+            size_t offset = 0;
+            while (pending.size() - offset >= STREAM_HEADER_SIZE) {
+                const uint8_t* header = pending.data() + offset;
+                if (readLe(header, 4) != STREAM_MAGIC) {
+                    // Lost framing; nothing after this can be trusted
+                    corrupt++;
+                    stop = true;
+                    break;
+                }
+                const size_t payloadSize = static_cast<size_t>(readLe(header + 4, 4));
+                if (pending.size() - offset < STREAM_HEADER_SIZE + payloadSize) {
+                    break;
+                }
+
+                const int encoding = header[8];
+                const int width = static_cast<int>(readLe(header + 12, 2));
+                const int height = static_cast<int>(readLe(header + 14, 2));
+                const int64_t capturedUs = static_cast<int64_t>(readLe(header + 24, 8));
+                const uint8_t* payload = header + STREAM_HEADER_SIZE;
+
+                bool valid = encoding >= STREAM_RASTER && encoding <= STREAM_GEOMETRY;
+                if (valid && encoding != STREAM_GEOMETRY) {
+                    plane.resize(static_cast<size_t>(width) * height);
+                    valid = GrayCodec::decode(payload, payloadSize, plane.data(), width, height);
+                } else if (valid) {
+                    valid = payloadSize % (2 * sizeof(int32_t)) == 0;
+                }
+
+                if (valid) {
+                    frames++;
+                    perEncoding[encoding]++;
+                    latenciesUs.push_back(nowUs() - capturedUs);
+                } else {
+                    corrupt++;
+                }
+                offset += STREAM_HEADER_SIZE + payloadSize;
+            }
+            pending.erase(pending.begin(), pending.begin() + offset);
+        }
+    };
+}
+
+// Format report as a single human-readable block
+std::string StreamLoopbackReport::toString() const {
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer),
+        "Duration: %.1fs, Published: %llu, Received: %llu (%.2f fps), Corrupt: %llu\n"
+        "Bytes received: %llu (%.0f KiB/s)\n"
+        "Latency ms: p50 %.2f, p95 %.2f, max %.2f\n"
+        "Encodings: raster %llu, mask %llu, geometry %llu\n"
+        "Final level %d, budget %.0f KiB/s, acked %.0f KiB/s",
+        durationSeconds,
+        static_cast<unsigned long long>(framesPublished),
+        static_cast<unsigned long long>(framesReceived),
+        receivedFps,
+        static_cast<unsigned long long>(framesCorrupt),
+        static_cast<unsigned long long>(bytesReceived),
+        durationSeconds > 0.0 ? bytesReceived / durationSeconds / 1024.0 : 0.0,
+        latencyP50Ms, latencyP95Ms, latencyMaxMs,
+        static_cast<unsigned long long>(framesPerEncoding[STREAM_RASTER]),
+        static_cast<unsigned long long>(framesPerEncoding[STREAM_MASK]),
+        static_cast<unsigned long long>(framesPerEncoding[STREAM_GEOMETRY]),
+        finalLevel, finalBudgetBytesPerSecond / 1024.0, finalAckedBytesPerSecond / 1024.0);
+    return std::string(buffer);
+}
+
+// Run the throttled-loopback test
+StreamLoopbackReport StreamLoopbackTest::run(const StreamLoopbackConfig& config) {
+    StreamLoopbackReport report = {};
+
+    SyntheticConfig sourceConfig = config.source;
+    sourceConfig.format = SYNTHETIC_RGBA;
+    SyntheticFrameSource source(sourceConfig);
+    if (!source.isValid() || config.durationSeconds <= 0) {
+        LOGE("Stream loopback configuration is invalid");
+        return report;
+    }
+
+    const bool edges = config.mode == MODE_EDGE;
+    const double fps = config.sourceFps > 0.0 ? config.sourceFps : 30.0;
+
+    StreamServer server;
+    int port = server.start(0, fps, edges);
+    if (port < 0) {
+        return report;
+    }
+
+    Receiver receiver;
+    receiver.bytesPerSecond = config.linkBytesPerSecond;
+    receiver.socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (config.receiveBufferBytes > 0) {
+        // Set before connecting so the advertised window stays small
+        setsockopt(receiver.socket, SOL_SOCKET, SO_RCVBUF,
+                   &config.receiveBufferBytes, sizeof(config.receiveBufferBytes));
+    }
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (connect(receiver.socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        LOGE("Stream loopback connect failed: %s", strerror(errno));
+        close(receiver.socket);
+        return report;
+    }
+    std::thread receiverThread(&Receiver::run, &receiver);
+
+    // Wait for the server to adopt the connection
+    for (int i = 0; i < 100 && server.viewerStats().empty(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    OpenCVProcessor processor;
+    processor.initialize();
+    processor.setSubpixelEdgesEnabled(edges);
+
+    const int width = sourceConfig.width;
+    const int height = sourceConfig.height;
+    TrackedBytes rgba(source.frameSize());
+    TrackedBytes plane(static_cast<size_t>(width) * height);
+    std::vector<float> points;
+    const int64_t periodUs = static_cast<int64_t>(1e6 / fps);
+    const int64_t startUs = nowUs();
+    const int64_t endUs = startUs + static_cast<int64_t>(config.durationSeconds) * 1000000;
+
+    for (uint64_t index = 0; ; index++) {
+        const int64_t dueUs = startUs + static_cast<int64_t>(index) * periodUs;
+        if (dueUs >= endUs) {
+            break;
+        }
+        int64_t waitUs = dueUs - nowUs();
+        if (waitUs > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+        }
+
+        source.generate(index, rgba.data());
+        std::shared_ptr<StreamFrame> frame = std::make_shared<StreamFrame>();
+        frame->index = index;
+        frame->capturedUs = nowUs();
+        frame->width = width;
+        frame->height = height;
+        frame->edges = edges;
+
+        // Edge frames are queued packed, gray frames as the plane itself
+        OutputTarget target = {plane.data(), width, height, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+        ProcessingMetrics metrics = processor.processFrame(
+            rgba.data(), width, height, static_cast<ProcessingMode>(config.mode), &target, 1);
+        if (!metrics.success) {
+            continue;
+        }
+        if (edges) {
+            frame->mask.pack(plane.data(), width, height);
+            processor.getSubpixelEdges(points);
+            SubpixelEdges::toFixed(points, frame->points);
+            frame->hasPoints = true;
+        } else {
+            frame->plane.assign(plane.begin(), plane.end());
+            frame->hasPoints = false;
+        }
+
+        server.publish(frame);
+        report.framesPublished++;
+    }
+
+    std::vector<ViewerStats> stats = server.viewerStats();
+    if (!stats.empty()) {
+        report.finalLevel = stats[0].level;
+        report.finalBudgetBytesPerSecond = stats[0].budgetBytesPerSecond;
+        report.finalAckedBytesPerSecond = stats[0].ackedBytesPerSecond;
+    }
+    report.durationSeconds = (nowUs() - startUs) / 1e6;
+
+    server.stop();
+    receiver.stop = true;
+    receiverThread.join();
+    close(receiver.socket);
+
+    report.framesReceived = receiver.frames;
+    report.framesCorrupt = receiver.corrupt;
+    report.bytesReceived = receiver.bytes;
+    report.receivedFps = report.durationSeconds > 0.0 ? receiver.frames / report.durationSeconds : 0.0;
+    report.latencyP50Ms = percentileMs(receiver.latenciesUs, 0.50);
+    report.latencyP95Ms = percentileMs(receiver.latenciesUs, 0.95);
+    report.latencyMaxMs = receiver.latenciesUs.empty() ? 0.0
+        : *std::max_element(receiver.latenciesUs.begin(), receiver.latenciesUs.end()) / 1000.0;
+    for (int i = 0; i < 3; i++) {
+        report.framesPerEncoding[i] = receiver.perEncoding[i];
+    }
+    return report;
+}
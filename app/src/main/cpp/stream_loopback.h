@@ -0,0 +1,50 @@
+#ifndef EDGEDETECTOR_STREAM_LOOPBACK_H
+#define EDGEDETECTOR_STREAM_LOOPBACK_H
+
+#include <cstdint>
+#include <string>
+#include "synthetic_source.h"
+
+// Throttled-loopback streaming test configuration
+struct StreamLoopbackConfig {
+    SyntheticConfig source;     // Rendered as RGBA regardless of format
+    int mode;                   // MODE_EDGE or MODE_GRAYSCALE
+    double sourceFps;
+    int durationSeconds;
+    double linkBytesPerSecond;  // Receiver read rate (0 = unthrottled)
+    int receiveBufferBytes;     // Receiver SO_RCVBUF (0 = system default)
+};
+
+// Throttled-loopback streaming test results
+struct StreamLoopbackReport {
+    uint64_t framesPublished;
+    uint64_t framesReceived;
+    uint64_t framesCorrupt;     // Bad header or payload that failed to decode
+    uint64_t bytesReceived;
+    double durationSeconds;
+    double receivedFps;
+    double latencyP50Ms;        // Capture-to-receipt latency
+    double latencyP95Ms;
+    double latencyMaxMs;
+    int finalLevel;
+    double finalBudgetBytesPerSecond;
+    double finalAckedBytesPerSecond;
+    uint64_t framesPerEncoding[3];
+
+    std::string toString() const;
+};
+
+/**
+ * Streams synthetic frames to a local viewer over TCP loopback whose reader
+ * drains at a fixed byte rate, so quality adaptation and latency under a
+ * constrained link can be checked without a network.
+ */
+class StreamLoopbackTest {
+public:
+    /**
+     * Run the test for the configured duration (blocks the caller)
+     */
+    static StreamLoopbackReport run(const StreamLoopbackConfig& config);
+};
+
+#endif // EDGEDETECTOR_STREAM_LOOPBACK_H
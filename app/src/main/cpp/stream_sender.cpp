@@ -0,0 +1,567 @@
+#include "stream_sender.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+    // Feedback tuning
+    const double kInitialBudget = 1024.0 * 1024.0;      // Bytes per second
+    const double kMinBudget = 16.0 * 1024.0;
+    const double kMaxBudget = 64.0 * 1024.0 * 1024.0;
+    const double kAdditiveIncrease = 256.0 * 1024.0;    // Bytes per second, per second
+    const double kDecreaseFactor = 0.7;
+    const int64_t kDecreaseIntervalUs = 250000;         // At most one cut per interval
+    const double kTargetQueueDelay = 0.1;               // Seconds of data allowed in the send queue
+    const long kMinQueueAllowance = 8 * 1024;
+    const int64_t kRateWindowUs = 100000;
+    const int kSendBufferBytes = 64 * 1024;
+
+    int64_t nowUs() {
+        auto now = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+    }
+
+    void putLe16(uint8_t* p, uint32_t value) {
+        p[0] = static_cast<uint8_t>(value);
+        p[1] = static_cast<uint8_t>(value >> 8);
+    }
+
+    void putLe32(uint8_t* p, uint32_t value) {
+        putLe16(p, value & 0xFFFF);
+        putLe16(p + 2, value >> 16);
+    }
+
+    void putLe64(uint8_t* p, uint64_t value) {
+        putLe32(p, static_cast<uint32_t>(value));
+        putLe32(p + 4, static_cast<uint32_t>(value >> 32));
+    }
+
+    // Initial encoded-size guess per source pixel, refined by observation
+    double initialBytesPerPixel(const StreamLevel& level) {
+        const double area = static_cast<double>(level.scale * level.scale);
+        if (level.encoding == STREAM_MASK) {
+            return 0.03 / area;
+        }
+        const double perPixel = level.quantBits >= 4 ? 0.12 : (level.quantBits >= 2 ? 0.25 : 0.4);
+        return perPixel / area;
+    }
+}
+
+// Constructor
+QualityController::QualityController(double sourceFps, bool edges)
+    : mSourceFps(sourceFps > 0.0 ? sourceFps : 30.0)
+    , mBudget(kInitialBudget)
+    , mLastSampleUs(0)
+    , mLastDecreaseUs(0)
+    , mCongested(false)
+{
+    // Ordered by preference; geometry keeps sub-pixel precision, so it
+    // ranks above a downscaled mask
+    if (edges) {
+        mLadder = {
+            {STREAM_MASK, 1, 1, 0},
+            {STREAM_GEOMETRY, 1, 1, 0},
+            {STREAM_MASK, 2, 1, 0},
+            {STREAM_GEOMETRY, 1, 2, 0},
+            {STREAM_MASK, 2, 2, 0},
+            {STREAM_MASK, 4, 3, 0}
+        };
+    } else {
+        mLadder = {
+            {STREAM_RASTER, 1, 1, 0},
+            {STREAM_RASTER, 1, 1, 2},
+            {STREAM_RASTER, 2, 1, 2},
+            {STREAM_RASTER, 2, 2, 4},
+            {STREAM_RASTER, 4, 3, 4}
+        };
+    }
+
+    for (const StreamLevel& level : mLadder) {
+        mBytesPerPixel.push_back(initialBytesPerPixel(level));
+    }
+    mComplexity = 1.0;
+}
+
+// Feed one feedback sample
+void QualityController::onSample(long queuedBytes, double ackedBytesPerSecond, int64_t nowUs) {
+    const double elapsed = mLastSampleUs > 0 ? static_cast<double>(nowUs - mLastSampleUs) / 1e6 : 0.0;
+    mLastSampleUs = nowUs;
+
+    const long allowance = std::max(kMinQueueAllowance,
+                                    static_cast<long>(ackedBytesPerSecond * kTargetQueueDelay));
+    mCongested = queuedBytes > allowance;
+
+    if (mCongested) {
+        // Multiplicative decrease, anchored to what the link actually delivered
+        if (nowUs - mLastDecreaseUs >= kDecreaseIntervalUs) {
+            double anchor = ackedBytesPerSecond > 0.0 ? std::min(mBudget, ackedBytesPerSecond) : mBudget;
+            mBudget = std::max(kMinBudget, anchor * kDecreaseFactor);
+            mLastDecreaseUs = nowUs;
+        }
+    } else {
+        mBudget = std::min(kMaxBudget, mBudget + kAdditiveIncrease * elapsed);
+    }
+}
+
+// Record an encoded frame size
+void QualityController::onFrameSent(int level, size_t bytes, size_t sourcePixels) {
+    if (level < 0 || level >= levelCount() || sourcePixels == 0 ||
+        mLadder[level].encoding == STREAM_GEOMETRY) {
+        return;
+    }
+    // Content complexity carries over to levels that have not been tried yet
+    double observed = static_cast<double>(bytes) / sourcePixels;
+    mComplexity = 0.8 * mComplexity + 0.2 * observed / mBytesPerPixel[level];
+}
+
+// Best level that fits the budget
+int QualityController::chooseLevel(size_t sourcePixels, int pointCount) {
+    int fallback = 0;
+    for (int i = 0; i < levelCount(); i++) {
+        const StreamLevel& level = mLadder[i];
+        if (level.encoding == STREAM_GEOMETRY && pointCount < 0) {
+            continue;
+        }
+        fallback = i;
+
+        double frameBytes = STREAM_HEADER_SIZE + (level.encoding == STREAM_GEOMETRY
+            ? static_cast<double>(pointCount) * 2 * sizeof(int32_t)
+            : mBytesPerPixel[i] * mComplexity * sourcePixels);
+        double rate = frameBytes * mSourceFps / level.decimation;
+        if (rate <= mBudget) {
+            return i;
+        }
+    }
+    return fallback;
+}
+
+const StreamLevel& QualityController::levelAt(int level) const {
+    return mLadder[std::max(0, std::min(level, levelCount() - 1))];
+}
+
+int QualityController::levelCount() const {
+    return static_cast<int>(mLadder.size());
+}
+
+// Constructor - starts the sender thread
+StreamViewer::StreamViewer(int socketFd, double sourceFps, bool edges)
+    : mSocket(socketFd)
+    , mSourceFps(sourceFps > 0.0 ? sourceFps : 30.0)
+    , mController(sourceFps, edges)
+    , mStopping(false)
+    , mConnected(true)
+    , mStats()
+    , mBytesWritten(0)
+    , mRateSampleUs(0)
+    , mRateSampleAcked(0)
+    , mAckedRate(0.0)
+    , mLastSentUs(0)
+{
+    // A small kernel buffer keeps the backlog visible to TIOCOUTQ instead of hidden in the socket
+    int sendBuffer = kSendBufferBytes;
+    setsockopt(mSocket, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+    int noDelay = 1;
+    setsockopt(mSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    struct timeval timeout = {1, 0};
+    setsockopt(mSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    mStats.connected = true;
+    mThread = std::thread(&StreamViewer::senderLoop, this);
+}
+
+// Destructor
+StreamViewer::~StreamViewer() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mReady.notify_one();
+    shutdown(mSocket, SHUT_RDWR);
+    mThread.join();
+    close(mSocket);
+}
+
+// Replace the pending frame with a newer one
+void StreamViewer::offer(const std::shared_ptr<const StreamFrame>& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.framesOffered++;
+        if (mSlot) {
+            mStats.framesReplaced++;
+        }
+        mSlot = frame;
+    }
+    mReady.notify_one();
+}
+
+ViewerStats StreamViewer::stats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+bool StreamViewer::isConnected() const {
+    return mConnected.load();
+}
+
+// Sample send queue and acknowledged throughput
+void StreamViewer::sampleFeedback(int64_t now) {
+    long queued = StreamServer::queuedBytes(mSocket);
+    if (queued < 0) {
+        queued = 0;
+    }
+    const uint64_t acked = mBytesWritten - std::min<uint64_t>(mBytesWritten, static_cast<uint64_t>(queued));
+
+    if (mRateSampleUs == 0) {
+        mRateSampleUs = now;
+        mRateSampleAcked = acked;
+    } else if (now - mRateSampleUs >= kRateWindowUs) {
+        double rate = static_cast<double>(acked - mRateSampleAcked) * 1e6 / (now - mRateSampleUs);
+        mAckedRate = mAckedRate > 0.0 ? 0.5 * mAckedRate + 0.5 * rate : rate;
+        mRateSampleUs = now;
+        mRateSampleAcked = acked;
+    }
+
+    mController.onSample(queued, mAckedRate, now);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.queuedBytes = queued;
+    mStats.ackedBytesPerSecond = mAckedRate;
+    mStats.budgetBytesPerSecond = mController.budget();
+}
+
+// Sender thread
+void StreamViewer::senderLoop() {
+    while (mConnected) {
+        std::shared_ptr<const StreamFrame> frame;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mReady.wait_for(lock, std::chrono::milliseconds(20),
+                            [this] { return mStopping || mSlot != nullptr; });
+            if (mStopping) {
+                break;
+            }
+        }
+
+        const int64_t now = nowUs();
+        sampleFeedback(now);
+
+        // Hold off while the socket is backed up; newer frames replace the slot meanwhile
+        if (mController.congested()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            frame = std::move(mSlot);
+            mSlot.reset();
+        }
+        if (!frame) {
+            continue;
+        }
+
+        const size_t sourcePixels = static_cast<size_t>(frame->width) * frame->height;
+        const int pointCount = frame->hasPoints ? static_cast<int>(frame->points.size() / 2) : -1;
+        const int levelIndex = mController.chooseLevel(sourcePixels, pointCount);
+        const StreamLevel& level = mController.levelAt(levelIndex);
+
+        // Frame-rate decimation by elapsed time, so slot replacement cannot skew it
+        const int64_t minIntervalUs = static_cast<int64_t>((level.decimation - 0.5) * 1e6 / mSourceFps);
+        if (level.decimation > 1 && now - mLastSentUs < minIntervalUs) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStats.framesDecimated++;
+            continue;
+        }
+
+        int width = 0;
+        int height = 0;
+        // Give up on frames that have gone stale while encoding
+        const int64_t staleMs = frame->capturedUs > 0 ? frame->capturedUs / 1000 + STREAM_MAX_FRAME_AGE_MS : 0;
+        const FrameDeadline deadline(staleMs);
+        if (!encodeFrame(*frame, level, width, height, deadline)) {
+            if (deadline.expired()) {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStats.framesExpired++;
+            }
+            continue;
+        }
+
+        mMessage.resize(STREAM_HEADER_SIZE + mPayload.size());
+        uint8_t* header = mMessage.data();
+        putLe32(header, STREAM_MAGIC);
+        putLe32(header + 4, static_cast<uint32_t>(mPayload.size()));
+        header[8] = static_cast<uint8_t>(level.encoding);
+        header[9] = static_cast<uint8_t>(level.scale);
+        header[10] = static_cast<uint8_t>(level.quantBits);
+        header[11] = 0;
+        putLe16(header + 12, static_cast<uint32_t>(width));
+        putLe16(header + 14, static_cast<uint32_t>(height));
+        putLe64(header + 16, frame->index);
+        putLe64(header + 24, static_cast<uint64_t>(frame->capturedUs));
+        std::memcpy(header + STREAM_HEADER_SIZE, mPayload.data(), mPayload.size());
+
+        if (!sendAll(mMessage.data(), mMessage.size())) {
+            break;
+        }
+        mLastSentUs = now;
+        mController.onFrameSent(levelIndex, mMessage.size(), sourcePixels);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.framesSent++;
+        mStats.bytesSent += mMessage.size();
+        mStats.level = levelIndex;
+    }
+
+    mConnected = false;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.connected = false;
+}
+
+// Encode a frame at a ladder level into mPayload
+bool StreamViewer::encodeFrame(const StreamFrame& frame, const StreamLevel& level, int& width, int& height,
+                               const FrameDeadline& deadline) {
+    if (level.encoding == STREAM_GEOMETRY) {
+        width = frame.width;
+        height = frame.height;
+        mPayload.resize(frame.points.size() * sizeof(int32_t));
+        uint8_t* out = mPayload.data();
+        for (int32_t value : frame.points) {
+            putLe32(out, static_cast<uint32_t>(value));
+            out += 4;
+        }
+        return true;
+    }
+
+    width = std::max(1, frame.width / level.scale);
+    height = std::max(1, frame.height / level.scale);
+    const size_t pixels = static_cast<size_t>(width) * height;
+    mScaled.resize(pixels);
+    uint8_t* values = mScaled.data();
+
+    if (frame.edges) {
+        // Any edge in a source cell keeps the edge; the mask is only expanded at the coded size
+        const BitMask* mask = &frame.mask;
+        if (level.scale > 1) {
+            frame.mask.downscaleAny(width, height, mScaledMask);
+            mask = &mScaledMask;
+        }
+        mask->unpack(values, level.encoding == STREAM_MASK ? 1 : 255);
+        if (level.encoding == STREAM_MASK) {
+            return mCodec.encode(values, width, height, 0, mPayload, PREDICT_MED, 0, &deadline);
+        }
+    } else if (level.scale > 1) {
+        OutputTarget target = {values, width, height, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+        if (!mScaler.write(frame.plane.data(), frame.width, frame.height, 1, &target, 1)) {
+            return false;
+        }
+    } else {
+        std::memcpy(values, frame.plane.data(), pixels);
+    }
+
+    if (level.encoding == STREAM_MASK) {
+        for (size_t i = 0; i < pixels; i++) {
+            values[i] = values[i] != 0 ? 1 : 0;
+        }
+    } else if (level.quantBits > 0) {
+        for (size_t i = 0; i < pixels; i++) {
+            values[i] = static_cast<uint8_t>(values[i] >> level.quantBits);
+        }
+    }
+
+    return mCodec.encode(values, width, height, 0, mPayload, PREDICT_MED, 0, &deadline);
+}
+
+// Blocking send of a whole message
+bool StreamViewer::sendAll(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(mSocket, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Send timeout: the peer stopped reading
+                LOGW("Viewer stalled, disconnecting");
+            } else {
+                LOGW("Viewer send failed: %s", strerror(errno));
+            }
+            mConnected = false;
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+        mBytesWritten += static_cast<uint64_t>(sent);
+    }
+    return true;
+}
+
+// Constructor
+StreamServer::StreamServer()
+    : mListenSocket(-1)
+    , mSourceFps(30.0)
+    , mEdges(false)
+    , mRunning(false)
+{
+}
+
+// Destructor
+StreamServer::~StreamServer() {
+    stop();
+}
+
+// Listen for viewers
+int StreamServer::start(int port, double sourceFps, bool edges) {
+    stop();
+    mSourceFps = sourceFps;
+    mEdges = edges;
+
+    mListenSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (mListenSocket < 0) {
+        LOGE("Cannot create stream socket: %s", strerror(errno));
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(mListenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    socklen_t length = sizeof(address);
+    if (bind(mListenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(mListenSocket, 8) != 0 ||
+        getsockname(mListenSocket, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        LOGE("Cannot listen on port %d: %s", port, strerror(errno));
+        close(mListenSocket);
+        mListenSocket = -1;
+        return -1;
+    }
+
+    mRunning = true;
+    mAcceptThread = std::thread(&StreamServer::acceptLoop, this);
+    int boundPort = ntohs(address.sin_port);
+    LOGI("Stream server listening on port %d", boundPort);
+    return boundPort;
+}
+
+// Stop accepting and disconnect all viewers
+void StreamServer::stop() {
+    if (mRunning.exchange(false)) {
+        mAcceptThread.join();
+    }
+    if (mListenSocket >= 0) {
+        close(mListenSocket);
+        mListenSocket = -1;
+    }
+
+    std::vector<std::unique_ptr<StreamViewer>> viewers;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        viewers.swap(mViewers);
+    }
+}
+
+// Adopt a connected socket
+void StreamServer::addViewer(int socketFd) {
+    std::unique_ptr<StreamViewer> viewer(new StreamViewer(socketFd, mSourceFps, mEdges));
+    std::lock_guard<std::mutex> lock(mMutex);
+    mViewers.push_back(std::move(viewer));
+}
+
+// Offer a frame to every viewer
+void StreamServer::publish(const std::shared_ptr<const StreamFrame>& frame) {
+    if (frame->width > STREAM_MAX_FRAME_SIDE || frame->height > STREAM_MAX_FRAME_SIDE) {
+        LOGE("Frame %dx%d exceeds the stream limit of %d per side",
+             frame->width, frame->height, STREAM_MAX_FRAME_SIDE);
+        return;
+    }
+
+    std::vector<std::unique_ptr<StreamViewer>> disconnected;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto it = mViewers.begin(); it != mViewers.end();) {
+            if ((*it)->isConnected()) {
+                (*it)->offer(frame);
+                ++it;
+            } else {
+                disconnected.push_back(std::move(*it));
+                it = mViewers.erase(it);
+            }
+        }
+    }
+
+    // Joined outside the lock
+    if (!disconnected.empty()) {
+        LOGI("%zu viewer(s) disconnected", disconnected.size());
+    }
+}
+
+std::vector<ViewerStats> StreamServer::viewerStats() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<ViewerStats> stats;
+    for (const auto& viewer : mViewers) {
+        stats.push_back(viewer->stats());
+    }
+    return stats;
+}
+
+// Per-viewer summary
+std::string StreamServer::getStatistics() const {
+    std::string text;
+    char line[256];
+    std::vector<ViewerStats> stats = viewerStats();
+    snprintf(line, sizeof(line), "Viewers: %zu", stats.size());
+    text += line;
+    for (size_t i = 0; i < stats.size(); i++) {
+        const ViewerStats& viewer = stats[i];
+        snprintf(line, sizeof(line),
+            "\n  #%zu: sent %llu/%llu, replaced %llu, decimated %llu, expired %llu, level %d, "
+            "budget %.0f KiB/s, acked %.0f KiB/s, queued %ld B",
+            i,
+            static_cast<unsigned long long>(viewer.framesSent),
+            static_cast<unsigned long long>(viewer.framesOffered),
+            static_cast<unsigned long long>(viewer.framesReplaced),
+            static_cast<unsigned long long>(viewer.framesDecimated),
+            static_cast<unsigned long long>(viewer.framesExpired),
+            viewer.level,
+            viewer.budgetBytesPerSecond / 1024.0,
+            viewer.ackedBytesPerSecond / 1024.0,
+            viewer.queuedBytes);
+        text += line;
+    }
+    return text;
+}
+
+// Socket send queue depth
+long StreamServer::queuedBytes(int socketFd) {
+    int queued = 0;
+    if (ioctl(socketFd, TIOCOUTQ, &queued) != 0) {
+        return -1;
+    }
+    return queued;
+}
+
+// Accept viewers until stopped
+void StreamServer::acceptLoop() {
+    while (mRunning) {
+        pollfd descriptor = {mListenSocket, POLLIN, 0};
+        if (poll(&descriptor, 1, 100) <= 0) {
+            continue;
+        }
+        int client = accept4(mListenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client >= 0) {
+            LOGI("Viewer connected");
+            addViewer(client);
+        }
+    }
+}
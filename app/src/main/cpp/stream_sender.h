@@ -0,0 +1,217 @@
+#ifndef EDGEDETECTOR_STREAM_SENDER_H
+#define EDGEDETECTOR_STREAM_SENDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bit_mask.h"
+#include "frame_output.h"
+#include "gray_codec.h"
+#include "native_memory.h"
+
+// Payload encodings on the wire
+enum StreamEncoding {
+    STREAM_RASTER = 0,      // GrayCodec plane, values shifted right by quantBits
+    STREAM_MASK = 1,        // GrayCodec plane of 0/1 edge flags
+    STREAM_GEOMETRY = 2     // Packed int32 (x, y) sub-pixel points (SUBPIXEL_FIXED_SHIFT)
+};
+
+// Message header, little-endian, followed by payloadSize bytes
+#define STREAM_HEADER_SIZE 32
+#define STREAM_MAGIC 0x53474445u   // "EDGS"
+
+// Width and height travel as u16 header fields; GrayCodec payloads further
+// limit coded planes to 0x7FFF per side
+#define STREAM_MAX_FRAME_SIDE 0x7FFF
+
+// A frame still being encoded this long after capture is dropped unsent
+#define STREAM_MAX_FRAME_AGE_MS 500
+
+// One rung of the quality ladder
+struct StreamLevel {
+    int encoding;           // StreamEncoding
+    int scale;              // Resolution divisor (1, 2, 4)
+    int decimation;         // Send at most every Nth source frame interval
+    int quantBits;          // RASTER: low bits dropped before coding
+};
+
+// Frame shared by all viewers
+struct StreamFrame {
+    uint64_t index;
+    int64_t capturedUs;     // steady_clock time the frame was produced
+    int width;
+    int height;
+    bool edges;             // Binary edge map (EDGE mode) held in mask
+    bool hasPoints;         // points holds sub-pixel edges for this frame
+    TrackedBytes plane;     // Gray plane, width x height (unused for edge frames)
+    BitMask mask;           // Edge mask, width x height (edge frames only)
+    std::vector<int32_t> points;
+};
+
+// Per-viewer counters
+struct ViewerStats {
+    uint64_t framesOffered;
+    uint64_t framesSent;
+    uint64_t framesReplaced;    // Overwritten in the slot before they could be sent
+    uint64_t framesDecimated;
+    uint64_t framesExpired;     // Encode abandoned past STREAM_MAX_FRAME_AGE_MS
+    uint64_t bytesSent;
+    int level;
+    double budgetBytesPerSecond;
+    double ackedBytesPerSecond;
+    long queuedBytes;
+    bool connected;
+};
+
+/**
+ * AIMD bitrate budget over a quality ladder. Each sample of the socket
+ * send queue and acknowledged throughput either grows the budget additively
+ * or, when the queue holds more than targetDelay worth of data, cuts it
+ * multiplicatively. The chosen level is the best one whose estimated rate
+ * (nominal per-level sizes scaled by the observed content complexity)
+ * fits the budget.
+ */
+class QualityController {
+public:
+    QualityController(double sourceFps, bool edges);
+
+    /**
+     * Feed one feedback sample
+     * @param queuedBytes Socket send queue (unsent + unacknowledged)
+     * @param ackedBytesPerSecond Acknowledged throughput estimate
+     * @param nowUs Sample time
+     */
+    void onSample(long queuedBytes, double ackedBytesPerSecond, int64_t nowUs);
+
+    /**
+     * Record the encoded size of a frame sent at a level
+     */
+    void onFrameSent(int level, size_t bytes, size_t sourcePixels);
+
+    /**
+     * Best level for the next frame
+     * @param sourcePixels Pixels in the full-resolution frame
+     * @param pointCount Sub-pixel points available (-1 if none)
+     */
+    int chooseLevel(size_t sourcePixels, int pointCount);
+
+    const StreamLevel& levelAt(int level) const;
+    int levelCount() const;
+    double budget() const { return mBudget; }
+
+    /**
+     * Whether the queue is congested right now
+     */
+    bool congested() const { return mCongested; }
+
+private:
+    std::vector<StreamLevel> mLadder;
+    std::vector<double> mBytesPerPixel;     // Nominal encoded size per source pixel
+    double mComplexity;                     // Observed / nominal size, smoothed
+    double mSourceFps;
+    double mBudget;                         // Bytes per second
+    int64_t mLastSampleUs;
+    int64_t mLastDecreaseUs;
+    bool mCongested;
+};
+
+/**
+ * One connected viewer. Frames are offered into a single latest-frame slot,
+ * so a slow link skips to the newest frame rather than queueing old ones;
+ * the sender thread also holds off while the kernel send queue is above its
+ * low-water mark so stale data never piles up in socket buffers.
+ */
+class StreamViewer {
+public:
+    StreamViewer(int socketFd, double sourceFps, bool edges);
+    ~StreamViewer();
+
+    void offer(const std::shared_ptr<const StreamFrame>& frame);
+    ViewerStats stats() const;
+    bool isConnected() const;
+
+private:
+    int mSocket;
+    double mSourceFps;
+    QualityController mController;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mReady;
+    std::shared_ptr<const StreamFrame> mSlot;
+    bool mStopping;
+    std::atomic<bool> mConnected;
+    ViewerStats mStats;
+
+    // Sender-thread state
+    GrayCodec mCodec;
+    MultiOutputWriter mScaler;
+    TrackedBytes mScaled;
+    BitMask mScaledMask;
+    TrackedBytes mPayload;
+    TrackedBytes mMessage;
+    uint64_t mBytesWritten;
+    int64_t mRateSampleUs;
+    uint64_t mRateSampleAcked;
+    double mAckedRate;
+    int64_t mLastSentUs;
+    std::thread mThread;
+
+    void senderLoop();
+    void sampleFeedback(int64_t nowUs);
+    bool encodeFrame(const StreamFrame& frame, const StreamLevel& level, int& width, int& height,
+                     const FrameDeadline& deadline);
+    bool sendAll(const uint8_t* data, size_t size);
+};
+
+/**
+ * Accepts viewer connections and fans published frames out to them
+ */
+class StreamServer {
+public:
+    StreamServer();
+    ~StreamServer();
+
+    /**
+     * Listen for viewers on a TCP port (0 picks a free port)
+     * @return Bound port, or -1 on failure
+     */
+    int start(int port, double sourceFps, bool edges);
+    void stop();
+
+    /**
+     * Adopt an already connected socket as a viewer
+     */
+    void addViewer(int socketFd);
+
+    /**
+     * Offer a frame to every viewer (latest frame wins per viewer)
+     * Frames wider or taller than STREAM_MAX_FRAME_SIDE are dropped.
+     */
+    void publish(const std::shared_ptr<const StreamFrame>& frame);
+
+    std::vector<ViewerStats> viewerStats() const;
+    std::string getStatistics() const;
+
+    /**
+     * Socket send queue in bytes (TIOCOUTQ), or -1 if unavailable
+     */
+    static long queuedBytes(int socketFd);
+
+private:
+    int mListenSocket;
+    double mSourceFps;
+    bool mEdges;
+    std::atomic<bool> mRunning;
+    std::thread mAcceptThread;
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<StreamViewer>> mViewers;
+
+    void acceptLoop();
+};
+
+#endif // EDGEDETECTOR_STREAM_SENDER_H
@@ -0,0 +1,142 @@
+#include "subpixel_edges.h"
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+    // Sobel gradient at (x, y); caller keeps (x, y) at least one pixel inside
+    inline void sobelAt(const uint8_t* image, int width, int x, int y, int* gx, int* gy) {
+        const uint8_t* above = image + (y - 1) * width + x;
+        const uint8_t* row = above + width;
+        const uint8_t* below = row + width;
+
+        *gx = (above[1] + 2 * row[1] + below[1]) - (above[-1] + 2 * row[-1] + below[-1]);
+        *gy = (below[-1] + 2 * below[0] + below[1]) - (above[-1] + 2 * above[0] + above[1]);
+    }
+
+    // Gradients sampled by per-pixel Sobel on the smoothed plane
+    struct PlaneGradients {
+        const uint8_t* image;
+        int width;
+
+        void at(int x, int y, int* gx, int* gy) const {
+            sobelAt(image, width, x, y, gx, gy);
+        }
+    };
+
+    // Gradients read from precomputed derivative planes
+    struct StoredGradients {
+        const int16_t* dx;
+        const int16_t* dy;
+        int width;
+
+        void at(int x, int y, int* gx, int* gy) const {
+            const size_t index = static_cast<size_t>(y) * width + x;
+            *gx = dx[index];
+            *gy = dy[index];
+        }
+    };
+
+    // Neighbour step across the edge: the gradient direction quantized to
+    // horizontal, vertical or one of the diagonals, as in Canny's non-maximum
+    // suppression (tan 22.5 degrees in Q15)
+    inline void gradientStep(int gx, int gy, int* stepX, int* stepY) {
+        const int64_t ax = std::abs(gx);
+        const int64_t ay = std::abs(gy);
+        const int64_t tan22 = 13573;
+        const int64_t y15 = ay << 15;
+        if (y15 < ax * tan22) {
+            *stepX = 1;
+            *stepY = 0;
+        } else if (y15 > (ax << 16) + ax * tan22) {
+            // tan 67.5 = 2 + tan 22.5
+            *stepX = 0;
+            *stepY = 1;
+        } else {
+            *stepX = (gx < 0) == (gy < 0) ? 1 : -1;
+            *stepY = 1;
+        }
+    }
+
+    template <typename Gradients>
+    inline float magnitudeAt(const Gradients& gradients, int x, int y) {
+        int gx, gy;
+        gradients.at(x, y, &gx, &gy);
+        return std::sqrt(static_cast<float>(gx * gx + gy * gy));
+    }
+
+    template <typename Gradients>
+    size_t locateWith(const Gradients& gradients, const BitMask& edges, std::vector<float>& points) {
+        const int width = edges.width();
+        const int height = edges.height();
+
+        for (int y = 0; y < height; y++) {
+            const bool interiorRow = y >= 2 && y < height - 2;
+
+            for (int x = edges.nextSet(y, 0); x < width; x = edges.nextSet(y, x + 1)) {
+                float px = static_cast<float>(x);
+                float py = static_cast<float>(y);
+
+                // Pixels too close to the border for the 5-wide stencil keep integer positions
+                if (interiorRow && x >= 2 && x < width - 2) {
+                    int gx, gy;
+                    gradients.at(x, y, &gx, &gy);
+                    float centre = std::sqrt(static_cast<float>(gx * gx + gy * gy));
+                    int stepX, stepY;
+                    gradientStep(gx, gy, &stepX, &stepY);
+
+                    float before = magnitudeAt(gradients, x - stepX, y - stepY);
+                    float after = magnitudeAt(gradients, x + stepX, y + stepY);
+
+                    // Vertex of the parabola through (-1, before), (0, centre), (1, after)
+                    float curvature = before - 2.0f * centre + after;
+                    if (centre >= before && centre >= after && curvature < 0.0f) {
+                        float offset = 0.5f * (before - after) / curvature;
+                        offset = offset < -0.5f ? -0.5f : (offset > 0.5f ? 0.5f : offset);
+                        px += offset * static_cast<float>(stepX);
+                        py += offset * static_cast<float>(stepY);
+                    }
+                }
+
+                points.push_back(px);
+                points.push_back(py);
+            }
+        }
+
+        return points.size() / 2;
+    }
+}
+
+namespace SubpixelEdges {
+    size_t locate(
+        const uint8_t* smoothed,
+        const BitMask& edges,
+        std::vector<float>& points
+    ) {
+        points.clear();
+        if (smoothed == nullptr || edges.empty()) {
+            return 0;
+        }
+        return locateWith(PlaneGradients{smoothed, edges.width()}, edges, points);
+    }
+
+    size_t locate(
+        const int16_t* dx,
+        const int16_t* dy,
+        const BitMask& edges,
+        std::vector<float>& points
+    ) {
+        points.clear();
+        if (dx == nullptr || dy == nullptr || edges.empty()) {
+            return 0;
+        }
+        return locateWith(StoredGradients{dx, dy, edges.width()}, edges, points);
+    }
+
+    void toFixed(const std::vector<float>& points, std::vector<int32_t>& fixed) {
+        const float scale = static_cast<float>(1 << SUBPIXEL_FIXED_SHIFT);
+        fixed.resize(points.size());
+        for (size_t i = 0; i < points.size(); i++) {
+            fixed[i] = static_cast<int32_t>(std::lround(points[i] * scale));
+        }
+    }
+}
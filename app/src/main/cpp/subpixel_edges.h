@@ -0,0 +1,52 @@
+#ifndef EDGEDETECTOR_SUBPIXEL_EDGES_H
+#define EDGEDETECTOR_SUBPIXEL_EDGES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_mask.h"
+
+// Fractional bits in fixed-point sub-pixel coordinates
+#define SUBPIXEL_FIXED_SHIFT 8
+
+namespace SubpixelEdges {
+    /**
+     * Refine every edge pixel to a sub-pixel position
+     * The gradient magnitude is sampled at the pixel and its two neighbours
+     * across the edge (the gradient direction quantized to horizontal,
+     * vertical or diagonal, as in Canny's non-maximum suppression) and the
+     * parabola peak through those samples gives the offset along that
+     * direction. Only edge pixels are evaluated; the mask scan skips empty
+     * runs 64 pixels at a time.
+     * @param smoothed Gray plane the edges were detected on (after blur),
+     *        the size of the mask
+     * @param edges Edge mask
+     * @param points Output packed (x, y) float pairs, replaced on each call
+     * @return Number of points
+     */
+    size_t locate(
+        const uint8_t* smoothed,
+        const BitMask& edges,
+        std::vector<float>& points
+    );
+
+    /**
+     * Same refinement from precomputed 3x3 Sobel derivatives of the
+     * smoothed plane (identical points, no per-pixel Sobel)
+     * @param dx Horizontal derivative, the size of the mask
+     * @param dy Vertical derivative, the size of the mask
+     */
+    size_t locate(
+        const int16_t* dx,
+        const int16_t* dy,
+        const BitMask& edges,
+        std::vector<float>& points
+    );
+
+    /**
+     * Convert packed float points to fixed point (SUBPIXEL_FIXED_SHIFT bits)
+     */
+    void toFixed(const std::vector<float>& points, std::vector<int32_t>& fixed);
+}
+
+#endif // EDGEDETECTOR_SUBPIXEL_EDGES_H
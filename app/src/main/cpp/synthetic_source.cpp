@@ -0,0 +1,183 @@
+#include "synthetic_source.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // 3x5 block digits, one bit per cell, top row in the high bits
+    const uint16_t kDigitGlyphs[10] = {
+        0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9,
+        0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF
+    };
+
+    const uint8_t kBackground = 35;
+    const uint8_t kForeground = 220;
+}
+
+// Constructor
+SyntheticFrameSource::SyntheticFrameSource(const SyntheticConfig& config)
+    : mConfig(config)
+{
+    mConfig.edgeDensity = std::min(1.0f, std::max(0.0f, mConfig.edgeDensity));
+}
+
+// Check configuration
+bool SyntheticFrameSource::isValid() const {
+    if (mConfig.width <= 0 || mConfig.height <= 0) {
+        return false;
+    }
+    if (mConfig.pattern < PATTERN_GRADIENT || mConfig.pattern > PATTERN_MIXED) {
+        return false;
+    }
+    if (mConfig.format == SYNTHETIC_YUV420) {
+        return (mConfig.width % 2) == 0 && (mConfig.height % 2) == 0;
+    }
+    return mConfig.format == SYNTHETIC_RGBA;
+}
+
+// Bytes per frame
+size_t SyntheticFrameSource::frameSize() const {
+    size_t pixels = static_cast<size_t>(mConfig.width) * mConfig.height;
+    return mConfig.format == SYNTHETIC_YUV420 ? pixels + pixels / 2 : pixels * 4;
+}
+
+// U plane offset in a YUV420 frame
+size_t SyntheticFrameSource::uPlaneOffset() const {
+    return static_cast<size_t>(mConfig.width) * mConfig.height;
+}
+
+// V plane offset in a YUV420 frame
+size_t SyntheticFrameSource::vPlaneOffset() const {
+    return uPlaneOffset() + uPlaneOffset() / 4;
+}
+
+// Render one frame
+bool SyntheticFrameSource::generate(uint64_t frameIndex, uint8_t* outputData) {
+    if (!isValid() || outputData == nullptr) {
+        LOGE("Invalid synthetic source configuration");
+        return false;
+    }
+
+    const int width = mConfig.width;
+    const int height = mConfig.height;
+    const int halfWidth = width / 2;
+    const int halfHeight = height / 2;
+    mLumaRow.resize(width);
+
+    // Slowly cycling tint so chroma is not constant across frames
+    const uint8_t tintU = static_cast<uint8_t>(112 + (frameIndex % 32));
+    const uint8_t tintV = static_cast<uint8_t>(144 - (frameIndex % 32));
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int pattern = mConfig.pattern;
+            if (pattern == PATTERN_MIXED) {
+                pattern = (y < halfHeight ? 0 : 2) + (x < halfWidth ? 0 : 1);
+            }
+            mLumaRow[x] = lumaAt(pattern, x, y, frameIndex);
+        }
+
+        if (mConfig.format == SYNTHETIC_RGBA) {
+            uint8_t* row = outputData + static_cast<size_t>(y) * width * 4;
+            for (int x = 0; x < width; x++) {
+                uint8_t luma = mLumaRow[x];
+                row[x * 4] = luma;
+                row[x * 4 + 1] = static_cast<uint8_t>(16 + (luma * 7) / 8);
+                row[x * 4 + 2] = static_cast<uint8_t>(255 - luma / 2);
+                row[x * 4 + 3] = 255;
+            }
+            continue;
+        }
+
+        // Limited-range luma, chroma written once per pair of rows
+        uint8_t* yRow = outputData + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++) {
+            yRow[x] = static_cast<uint8_t>(16 + (mLumaRow[x] * 219) / 255);
+        }
+
+        if ((y & 1) == 0) {
+            uint8_t* uRow = outputData + uPlaneOffset() + static_cast<size_t>(y / 2) * halfWidth;
+            uint8_t* vRow = outputData + vPlaneOffset() + static_cast<size_t>(y / 2) * halfWidth;
+            std::memset(uRow, tintU, halfWidth);
+            std::memset(vRow, tintV, halfWidth);
+        }
+    }
+
+    return true;
+}
+
+// Dispatch to pattern
+uint8_t SyntheticFrameSource::lumaAt(int pattern, int x, int y, uint64_t frameIndex) const {
+    switch (pattern) {
+        case PATTERN_GRADIENT:
+            return gradientAt(x, y, frameIndex);
+        case PATTERN_TEXT:
+            return textAt(x, y, frameIndex);
+        case PATTERN_CHECKERBOARD:
+            return checkerboardAt(x, y, frameIndex);
+        case PATTERN_NOISE:
+        default:
+            return noiseAt(x, y, frameIndex);
+    }
+}
+
+// Diagonal sawtooth: each wrap is one hard edge, density sets the band count
+uint8_t SyntheticFrameSource::gradientAt(int x, int y, uint64_t frameIndex) const {
+    const int bands = 1 + static_cast<int>(mConfig.edgeDensity * 31.0f);
+    const int span = mConfig.width + mConfig.height;
+    const int64_t pos = static_cast<int64_t>(x) + y + static_cast<int64_t>(frameIndex * 3);
+    return static_cast<uint8_t>(((pos * bands * 256) / span) & 0xFF);
+}
+
+// Lines of digits scrolling upwards, density shrinks the glyph scale
+uint8_t SyntheticFrameSource::textAt(int x, int y, uint64_t frameIndex) const {
+    const int scale = 1 + static_cast<int>((1.0f - mConfig.edgeDensity) * 7.0f);
+    const int cellWidth = 4 * scale;
+    const int cellHeight = 7 * scale;
+    const int64_t scrolled = static_cast<int64_t>(y) + static_cast<int64_t>(frameIndex);
+    const uint32_t line = static_cast<uint32_t>(scrolled / cellHeight);
+    const uint32_t column = static_cast<uint32_t>(x / cellWidth);
+    const int gx = (x % cellWidth) / scale;
+    const int gy = static_cast<int>(scrolled % cellHeight) / scale - 1;
+
+    if (gx >= 3 || gy < 0 || gy >= 5) {
+        return kBackground;
+    }
+
+    // Leave some blank cells so lines look like words
+    uint32_t h = hash(line, column, 0);
+    if ((h & 7) == 0) {
+        return kBackground;
+    }
+
+    uint16_t glyph = kDigitGlyphs[(h >> 3) % 10];
+    int bit = 14 - (gy * 3 + gx);
+    return ((glyph >> bit) & 1) ? kForeground : kBackground;
+}
+
+// Drifting checkerboard, density shrinks the cell size
+uint8_t SyntheticFrameSource::checkerboardAt(int x, int y, uint64_t frameIndex) const {
+    const int cell = 2 + static_cast<int>((1.0f - mConfig.edgeDensity) * 62.0f);
+    const int64_t sx = static_cast<int64_t>(x) + static_cast<int64_t>(frameIndex * 2);
+    const int64_t sy = static_cast<int64_t>(y) + static_cast<int64_t>(frameIndex);
+    return (((sx / cell) + (sy / cell)) & 1) ? kForeground : kBackground;
+}
+
+// Blocky value noise re-seeded every few frames
+uint8_t SyntheticFrameSource::noiseAt(int x, int y, uint64_t frameIndex) const {
+    const int cell = 1 + static_cast<int>((1.0f - mConfig.edgeDensity) * 15.0f);
+    const uint32_t epoch = static_cast<uint32_t>(frameIndex / 4);
+    uint32_t h = hash(static_cast<uint32_t>(x / cell), static_cast<uint32_t>(y / cell), epoch);
+    return static_cast<uint8_t>(h >> 24);
+}
+
+// Integer hash (seeded)
+uint32_t SyntheticFrameSource::hash(uint32_t a, uint32_t b, uint32_t c) const {
+    uint32_t h = mConfig.seed ^ (a * 0x9E3779B1u) ^ (b * 0x85EBCA77u) ^ (c * 0xC2B2AE3Du);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
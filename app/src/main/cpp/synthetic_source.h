@@ -0,0 +1,81 @@
+#ifndef EDGEDETECTOR_SYNTHETIC_SOURCE_H
+#define EDGEDETECTOR_SYNTHETIC_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Synthetic scene patterns
+enum SyntheticPattern {
+    PATTERN_GRADIENT = 0,     // Moving sawtooth gradient bands
+    PATTERN_TEXT = 1,         // Scrolling lines of block digits
+    PATTERN_CHECKERBOARD = 2, // Drifting checkerboard
+    PATTERN_NOISE = 3,        // Blocky value noise
+    PATTERN_MIXED = 4         // One pattern per quadrant
+};
+
+// Synthetic frame pixel formats
+enum SyntheticFormat {
+    SYNTHETIC_RGBA = 0,   // Interleaved RGBA, width * 4 bytes per row
+    SYNTHETIC_YUV420 = 1  // Planar Y, U, V (U/V at half resolution)
+};
+
+// Synthetic source configuration
+struct SyntheticConfig {
+    int width;
+    int height;
+    int pattern;        // SyntheticPattern
+    int format;         // SyntheticFormat
+    float edgeDensity;  // 0 = few large features, 1 = dense fine detail
+    uint32_t seed;
+};
+
+/**
+ * Deterministic moving-scene generator for exercising the pipeline without
+ * a camera. The same (config, frameIndex) always produces the same bytes.
+ */
+class SyntheticFrameSource {
+public:
+    explicit SyntheticFrameSource(const SyntheticConfig& config);
+
+    /**
+     * Check configuration (YUV420 requires even dimensions)
+     */
+    bool isValid() const;
+
+    /**
+     * Bytes needed for one frame in the configured format
+     */
+    size_t frameSize() const;
+
+    /**
+     * Plane layout for YUV420 frames (all planes packed back to back)
+     */
+    int yRowStride() const { return mConfig.width; }
+    int uvRowStride() const { return mConfig.width / 2; }
+    size_t uPlaneOffset() const;
+    size_t vPlaneOffset() const;
+
+    /**
+     * Render frame into output buffer
+     * @param frameIndex Frame number (controls motion)
+     * @param outputData Output buffer of frameSize() bytes
+     * @return true if successful
+     */
+    bool generate(uint64_t frameIndex, uint8_t* outputData);
+
+    const SyntheticConfig& config() const { return mConfig; }
+
+private:
+    SyntheticConfig mConfig;
+    std::vector<uint8_t> mLumaRow;
+
+    uint8_t lumaAt(int pattern, int x, int y, uint64_t frameIndex) const;
+    uint8_t gradientAt(int x, int y, uint64_t frameIndex) const;
+    uint8_t textAt(int x, int y, uint64_t frameIndex) const;
+    uint8_t checkerboardAt(int x, int y, uint64_t frameIndex) const;
+    uint8_t noiseAt(int x, int y, uint64_t frameIndex) const;
+    uint32_t hash(uint32_t a, uint32_t b, uint32_t c) const;
+};
+
+#endif // EDGEDETECTOR_SYNTHETIC_SOURCE_H
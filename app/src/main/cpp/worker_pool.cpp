@@ -0,0 +1,170 @@
+#include "worker_pool.h"
+#include "opencv_processor.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+// Process-wide pool
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool(std::max(2, static_cast<int>(std::thread::hardware_concurrency())));
+    return pool;
+}
+
+// Recycled once the caller and every helper task have let go, so helpers
+// that start after the caller returns find nothing to do
+struct WorkerPool::Batch {
+    std::atomic<int> next{0};
+    std::atomic<int> references{0};
+    int remaining = 0;
+    std::mutex mutex;
+    std::condition_variable done;
+    IndexFunction function = nullptr;
+    const void* context = nullptr;
+    int count = 0;
+
+    void work() {
+        int finished = 0;
+        for (int index = next++; index < count; index = next++) {
+            function(context, index);
+            finished++;
+        }
+        if (finished > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            remaining -= finished;
+            if (remaining == 0) {
+                done.notify_all();
+            }
+        }
+    }
+};
+
+// Constructor
+WorkerPool::WorkerPool(int threadCount)
+    : mNextSequence(0)
+    , mStopping(false)
+{
+    threadCount = std::max(1, threadCount);
+
+    // Helpers that start late still hold their batch, so overlapping
+    // parallelFor calls need a few; more are made if ever needed
+    const int batches = threadCount * 4;
+    mBatches.reserve(batches);
+    mIdleBatches.reserve(batches);
+    for (int i = 0; i < batches; i++) {
+        mBatches.push_back(std::unique_ptr<Batch>(new Batch()));
+        mIdleBatches.push_back(mBatches.back().get());
+    }
+
+    // Room for every helper of those batches without growing the queue
+    std::vector<Task> queue;
+    queue.reserve(static_cast<size_t>(batches) * threadCount);
+    mQueue = std::priority_queue<Task, std::vector<Task>, TaskOrder>(TaskOrder(), std::move(queue));
+
+    mThreads.reserve(threadCount);
+    for (int i = 0; i < threadCount; i++) {
+        mThreads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+    LOGI("Worker pool started with %d thread(s)", threadCount);
+}
+
+// Destructor - queued tasks still run before the threads exit
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mReady.notify_all();
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+// Queue a task
+void WorkerPool::submit(std::function<void()> task, int priority) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueue.push({priority, mNextSequence++, std::move(task)});
+    }
+    mReady.notify_one();
+}
+
+// Idle batch, or a new one when every preallocated batch is still held
+WorkerPool::Batch* WorkerPool::acquireBatch() {
+    std::lock_guard<std::mutex> lock(mBatchMutex);
+    if (mIdleBatches.empty()) {
+        mBatches.push_back(std::unique_ptr<Batch>(new Batch()));
+        mIdleBatches.reserve(mBatches.size());
+        return mBatches.back().get();
+    }
+    Batch* batch = mIdleBatches.back();
+    mIdleBatches.pop_back();
+    return batch;
+}
+
+void WorkerPool::releaseBatch(Batch* batch) {
+    if (batch->references.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mBatchMutex);
+        mIdleBatches.push_back(batch);
+    }
+}
+
+// Run indices in parallel, caller included
+void WorkerPool::runIndexed(int count, IndexFunction function, const void* context, int priority) {
+    if (count <= 0) {
+        return;
+    }
+    if (count == 1) {
+        function(context, 0);
+        return;
+    }
+
+    const int helpers = std::min(count, threadCount()) - 1;
+    Batch* batch = acquireBatch();
+    batch->next = 0;
+    batch->remaining = count;
+    batch->function = function;
+    batch->context = context;
+    batch->count = count;
+    batch->references = helpers + 1;
+
+    // Two pointers fit std::function's inline storage
+    for (int i = 0; i < helpers; i++) {
+        submit([this, batch] {
+            batch->work();
+            releaseBatch(batch);
+        }, priority);
+    }
+    batch->work();
+
+    {
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->done.wait(lock, [batch] { return batch->remaining == 0; });
+    }
+    releaseBatch(batch);
+}
+
+int WorkerPool::threadCount() const {
+    return static_cast<int>(mThreads.size());
+}
+
+size_t WorkerPool::pendingCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mQueue.size();
+}
+
+// Run tasks until stopped and drained
+void WorkerPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mReady.wait(lock, [this] { return mStopping || !mQueue.empty(); });
+            if (mQueue.empty()) {
+                return;
+            }
+            task = std::move(const_cast<Task&>(mQueue.top()).run);
+            mQueue.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef EDGEDETECTOR_WORKER_POOL_H
+#define EDGEDETECTOR_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads fed from one priority queue. Higher priority
+ * tasks run first; tasks of equal priority run in submission order.
+ */
+class WorkerPool {
+public:
+    /**
+     * Process-wide pool (one thread per core, started on first use)
+     */
+    static WorkerPool& shared();
+
+    explicit WorkerPool(int threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * Queue a task
+     * @param task Work to run on a pool thread
+     * @param priority Larger runs earlier
+     */
+    void submit(std::function<void()> task, int priority = 0);
+
+    /**
+     * Run body(0..count-1) across the pool and wait for all of them.
+     * The caller works through indices too, so this is safe to call from
+     * a pool thread and never waits on a task that cannot start. Nothing
+     * is allocated once the pool has warmed up: the body is called through
+     * a plain pointer and batches are recycled.
+     * @param count Number of indices
+     * @param body Called once per index
+     * @param priority Priority of the helper tasks
+     */
+    template <typename Body>
+    void parallelFor(int count, const Body& body, int priority = 0) {
+        runIndexed(count, [](const void* context, int index) {
+            (*static_cast<const Body*>(context))(index);
+        }, &body, priority);
+    }
+
+    int threadCount() const;
+
+    /**
+     * Tasks queued but not yet started
+     */
+    size_t pendingCount() const;
+
+private:
+    struct Task {
+        int priority;
+        uint64_t sequence;
+        std::function<void()> run;
+    };
+
+    struct TaskOrder {
+        bool operator()(const Task& a, const Task& b) const {
+            if (a.priority != b.priority) {
+                return a.priority < b.priority;
+            }
+            return a.sequence > b.sequence;
+        }
+    };
+
+    // One parallelFor, shared by the caller and its helper tasks
+    struct Batch;
+    using IndexFunction = void (*)(const void* context, int index);
+
+    mutable std::mutex mMutex;
+    std::condition_variable mReady;
+    std::priority_queue<Task, std::vector<Task>, TaskOrder> mQueue;
+    std::vector<std::thread> mThreads;
+    uint64_t mNextSequence;
+    bool mStopping;
+
+    std::mutex mBatchMutex;
+    std::vector<std::unique_ptr<Batch>> mBatches;
+    std::vector<Batch*> mIdleBatches;
+
+    void workerLoop();
+    void runIndexed(int count, IndexFunction function, const void* context, int priority);
+    Batch* acquireBatch();
+    void releaseBatch(Batch* batch);
+};
+
+#endif // EDGEDETECTOR_WORKER_POOL_H
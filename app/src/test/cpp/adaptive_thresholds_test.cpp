@@ -0,0 +1,113 @@
+// AdaptiveThresholds: deriving the Sobel rows from the smoothed plane
+// inside the histogram and rescale passes gives exactly what normalize()
+// gives on full derivative planes, for both apertures and an odd frame
+// size, and the shadowed half of the frame gets the lower scales
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "adaptive_thresholds.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 203;
+    const int kHeight = 77;
+    const int kTile = 32;
+
+    // Blocks of varying brightness, the left half at a quarter of the contrast
+    std::vector<uint8_t> scene() {
+        std::vector<uint8_t> image(static_cast<size_t>(kWidth) * kHeight);
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                const int block = (x / 9 * 7 + y / 11 * 13) % 5;
+                int value = 40 + block * 40 + (x * 3 + y * 5) % 7;
+                if (x < kWidth / 2) {
+                    value = 100 + (value - 100) / 4;
+                }
+                image[y * kWidth + x] = static_cast<uint8_t>(value);
+            }
+        }
+        return image;
+    }
+
+    // Separable Sobel (3x3 or 5x5) with replicated borders, as cv::Sobel on CV_16S
+    void referenceSobel(const std::vector<uint8_t>& image, int apertureSize,
+                        std::vector<int16_t>& dx, std::vector<int16_t>& dy) {
+        const int smooth3[] = {1, 2, 1};
+        const int diff3[] = {-1, 0, 1};
+        const int smooth5[] = {1, 4, 6, 4, 1};
+        const int diff5[] = {-1, -2, 0, 2, 1};
+        const int radius = apertureSize / 2;
+        const int* smooth = apertureSize == 3 ? smooth3 : smooth5;
+        const int* diff = apertureSize == 3 ? diff3 : diff5;
+        dx.assign(image.size(), 0);
+        dy.assign(image.size(), 0);
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                int sumX = 0;
+                int sumY = 0;
+                for (int j = -radius; j <= radius; j++) {
+                    const int sy = std::min(kHeight - 1, std::max(0, y + j));
+                    for (int i = -radius; i <= radius; i++) {
+                        const int sx = std::min(kWidth - 1, std::max(0, x + i));
+                        const int value = image[sy * kWidth + sx];
+                        sumX += smooth[j + radius] * diff[i + radius] * value;
+                        sumY += diff[j + radius] * smooth[i + radius] * value;
+                    }
+                }
+                dx[y * kWidth + x] = static_cast<int16_t>(sumX);
+                dy[y * kWidth + x] = static_cast<int16_t>(sumY);
+            }
+        }
+    }
+
+    void testMatchesPlanes(int apertureSize) {
+        const std::vector<uint8_t> image = scene();
+        std::vector<int16_t> dx;
+        std::vector<int16_t> dy;
+        referenceSobel(image, apertureSize, dx, dy);
+
+        AdaptiveThresholds planes;
+        planes.configure(true, kTile);
+        planes.normalize(dx.data(), dy.data(), kWidth, kHeight, apertureSize);
+        AdaptiveThresholds fused;
+        fused.configure(true, kTile);
+        fused.normalize(image.data(), kWidth, kHeight, apertureSize);
+
+        CHECK(fused.tileScales() == planes.tileScales());
+        const size_t pixels = image.size();
+        size_t mismatches = 0;
+        for (size_t i = 0; i < pixels; i++) {
+            if (fused.gradientX()[i] != planes.gradientX()[i] || fused.gradientY()[i] != planes.gradientY()[i]) {
+                mismatches++;
+            }
+        }
+        CHECK_EQ(mismatches, 0);
+
+        // Low-contrast tiles on the left get lower thresholds than the right
+        const std::vector<float>& scales = fused.tileScales();
+        const int tilesX = (kWidth + kTile - 1) / kTile;
+        const int tilesY = (kHeight + kTile - 1) / kTile;
+        float left = 0.0f;
+        float right = 0.0f;
+        for (int ty = 0; ty < tilesY; ty++) {
+            left += scales[ty * tilesX];
+            right += scales[ty * tilesX + tilesX - 1];
+        }
+        CHECK(left < right);
+        printf("aperture %d: %dx%d tiles, scales left %.2f right %.2f (mean)\n",
+               apertureSize, tilesX, tilesY, left / tilesY, right / tilesY);
+
+        // A second frame reuses the buffers and repeats the result
+        fused.normalize(image.data(), kWidth, kHeight, apertureSize);
+        CHECK(fused.tileScales() == planes.tileScales());
+        CHECK(fused.gradientX() == planes.gradientX());
+        CHECK_EQ(fused.stats().frames, 2);
+    }
+}
+
+int main() {
+    testMatchesPlanes(3);
+    testMatchesPlanes(5);
+    return testResult("adaptive_thresholds_test");
+}
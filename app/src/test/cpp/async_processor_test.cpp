@@ -0,0 +1,60 @@
+// AsyncProcessor: pooled processors produce the same output as the
+// configured processor, before and after its settings change
+
+#include <vector>
+#include "async_processor.h"
+#include "synthetic_source.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 320;
+    const int kHeight = 240;
+
+    std::vector<uint8_t> asyncOutput(AsyncProcessor& async, const std::vector<uint8_t>& rgba) {
+        const uint64_t ticket = async.submit(rgba.data(), kWidth, kHeight, MODE_EDGE, 0);
+        CHECK(ticket != 0);
+        AsyncCompletion completion;
+        CHECK(async.waitCompletion(completion, 10000));
+        CHECK_EQ(completion.ticket, ticket);
+        CHECK_EQ(completion.status, ASYNC_COMPLETED);
+        return std::vector<uint8_t>(completion.output.begin(), completion.output.end());
+    }
+
+    void testMatchesSync() {
+        SyntheticConfig config = {kWidth, kHeight, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+        SyntheticFrameSource source(config);
+        std::vector<uint8_t> rgba(source.frameSize());
+        source.generate(3, rgba.data());
+        std::vector<uint8_t> expected(rgba.size());
+
+        OpenCVProcessor processor;
+        processor.initialize();
+        AsyncProcessor async;
+        CHECK(processor.processFrame(rgba.data(), kWidth, kHeight, MODE_EDGE, expected.data()).success);
+        const std::vector<uint8_t> defaults = expected;
+        CHECK(asyncOutput(async, rgba) == expected);
+
+        // Stacked blur, fragment filter and a 5x5 aperture reach the pool
+        processor.setCannyThresholds(40.0, 120.0);
+        processor.setBlurSigma(4.0f);
+        processor.setFragmentFilter(20, 8);
+        CHECK(processor.setCannyApertureSize(5));
+        CHECK(!processor.setCannyApertureSize(4));
+        CHECK(processor.processFrame(rgba.data(), kWidth, kHeight, MODE_EDGE, expected.data()).success);
+        CHECK(expected != defaults);
+        CHECK(asyncOutput(async, rgba) == defaults);
+        async.setConfiguration(processor);
+        CHECK(asyncOutput(async, rgba) == expected);
+
+        // A later change is picked up by the processor already in the pool
+        processor.setFragmentFilter(0, 0);
+        CHECK(processor.processFrame(rgba.data(), kWidth, kHeight, MODE_EDGE, expected.data()).success);
+        async.setConfiguration(processor);
+        CHECK(asyncOutput(async, rgba) == expected);
+    }
+}
+
+int main() {
+    testMatchesSync();
+    return testResult("async_processor_test");
+}
@@ -0,0 +1,302 @@
+// BitMask against byte-mask references: pack/unpack round trips at widths
+// that are not multiples of 8 or 64 keep the padding bits clear, nextSet and
+// downscaleAny match a linear scan, logic operations reject size mismatches,
+// shift/dilate/erode match per-pixel morphology, and repeating an operation
+// into the same output mask does not allocate
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include "bit_mask.h"
+#include "simd_kernels.h"
+#include "test_support.h"
+
+namespace {
+    std::atomic<bool> g_counting(false);
+    std::atomic<int> g_allocations(0);
+}
+
+void* operator new(size_t size) {
+    if (g_counting) {
+        g_allocations++;
+    }
+    void* block = std::malloc(size > 0 ? size : 1);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    std::free(block);
+}
+
+namespace {
+    const int kWidths[] = {1, 5, 8, 13, 63, 64, 65, 100, 130};
+    const int kHeights[] = {1, 2, 7};
+
+    struct ByteMask {
+        int width;
+        int height;
+        std::vector<uint8_t> pixels;
+
+        bool at(int x, int y) const {
+            return pixels[static_cast<size_t>(y) * width + x] != 0;
+        }
+    };
+
+    ByteMask randomMask(int width, int height, std::mt19937& rng, int density) {
+        ByteMask mask = {width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height)};
+        for (uint8_t& pixel : mask.pixels) {
+            // Any non-zero byte counts as set
+            pixel = static_cast<int>(rng() % 100) < density ? static_cast<uint8_t>(1 + rng() % 255) : 0;
+        }
+        return mask;
+    }
+
+    // Same pixels, and nothing set in the padding past the width
+    bool matches(const BitMask& bits, const ByteMask& bytes) {
+        if (bits.width() != bytes.width || bits.height() != bytes.height) {
+            return false;
+        }
+        for (int y = 0; y < bytes.height; y++) {
+            for (int x = 0; x < bytes.width; x++) {
+                if (bits.test(x, y) != bytes.at(x, y)) {
+                    return false;
+                }
+            }
+            const int used = bytes.width & 63;
+            if (used != 0 && (bits.row(y)[bits.wordsPerRow() - 1] >> used) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 3x3 reference morphology; erosion treats the outside as set
+    ByteMask morphology(const ByteMask& source, bool dilate) {
+        ByteMask out = {source.width, source.height, std::vector<uint8_t>(source.pixels.size())};
+        for (int y = 0; y < source.height; y++) {
+            for (int x = 0; x < source.width; x++) {
+                bool any = false;
+                bool all = true;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        const int nx = x + dx;
+                        const int ny = y + dy;
+                        const bool inside = nx >= 0 && ny >= 0 && nx < source.width && ny < source.height;
+                        const bool value = inside ? source.at(nx, ny) : !dilate;
+                        any = any || value;
+                        all = all && value;
+                    }
+                }
+                out.pixels[static_cast<size_t>(y) * source.width + x] = (dilate ? any : all) ? 1 : 0;
+            }
+        }
+        return out;
+    }
+
+    void testPackUnpack() {
+        std::mt19937 rng(11);
+        for (int width : kWidths) {
+            for (int height : kHeights) {
+                const ByteMask source = randomMask(width, height, rng, 40);
+
+                // Strided source with garbage in the gaps, through both kernel sets
+                const int stride = width + 3;
+                std::vector<uint8_t> strided(static_cast<size_t>(stride) * height, 0xAA);
+                for (int y = 0; y < height; y++) {
+                    std::copy(source.pixels.begin() + static_cast<size_t>(y) * width,
+                              source.pixels.begin() + static_cast<size_t>(y + 1) * width,
+                              strided.begin() + static_cast<size_t>(y) * stride);
+                }
+                BitMask mask;
+                mask.pack(strided.data(), width, height, stride);
+                CHECK(matches(mask, source));
+                BitMask scalar;
+                scalar.pack(strided.data(), width, height, stride, &SimdKernels::reference());
+                CHECK(matches(scalar, source));
+
+                size_t expected = 0;
+                for (int y = 0; y < height; y++) {
+                    size_t rowCount = 0;
+                    for (int x = 0; x < width; x++) {
+                        rowCount += source.at(x, y) ? 1 : 0;
+                    }
+                    CHECK_EQ(mask.rowPopcount(y), rowCount);
+                    expected += rowCount;
+                }
+                CHECK_EQ(mask.popcount(), expected);
+
+                // Unpack into a strided plane leaves the gaps alone
+                std::vector<uint8_t> unpacked(static_cast<size_t>(stride) * height, 0x55);
+                mask.unpack(unpacked.data(), 200, stride);
+                bool same = true;
+                for (int y = 0; y < height; y++) {
+                    for (int x = 0; x < stride; x++) {
+                        const uint8_t value = unpacked[static_cast<size_t>(y) * stride + x];
+                        const uint8_t expectedValue = x < width ? (source.at(x, y) ? 200 : 0) : 0x55;
+                        same = same && value == expectedValue;
+                    }
+                }
+                CHECK(same);
+            }
+        }
+    }
+
+    void testNextSetAndDownscale() {
+        std::mt19937 rng(12);
+        for (int width : kWidths) {
+            for (int height : kHeights) {
+                for (int density : {2, 30}) {
+                    const ByteMask source = randomMask(width, height, rng, density);
+                    BitMask mask;
+                    mask.pack(source.pixels.data(), width, height);
+
+                    bool scans = true;
+                    for (int y = 0; y < height; y++) {
+                        for (int x = 0; x <= width; x++) {
+                            int expected = x;
+                            while (expected < width && !source.at(expected, y)) {
+                                expected++;
+                            }
+                            scans = scans && mask.nextSet(y, x) == expected;
+                        }
+                    }
+                    CHECK(scans);
+
+                    for (int outWidth : {1, width / 3, width / 2 + 1, width}) {
+                        for (int outHeight : {1, (height + 1) / 2, height}) {
+                            BitMask small;
+                            mask.downscaleAny(outWidth, outHeight, small);
+                            const int ow = std::max(1, std::min(outWidth, width));
+                            const int oh = std::max(1, std::min(outHeight, height));
+                            ByteMask expected = {ow, oh, std::vector<uint8_t>(static_cast<size_t>(ow) * oh)};
+                            for (int y = 0; y < oh; y++) {
+                                for (int x = 0; x < ow; x++) {
+                                    bool any = false;
+                                    for (int sy = y * height / oh; sy < (y + 1) * height / oh; sy++) {
+                                        for (int sx = x * width / ow; sx < (x + 1) * width / ow; sx++) {
+                                            any = any || source.at(sx, sy);
+                                        }
+                                    }
+                                    expected.pixels[static_cast<size_t>(y) * ow + x] = any ? 1 : 0;
+                                }
+                            }
+                            CHECK(matches(small, expected));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void testLogic() {
+        std::mt19937 rng(13);
+        for (int width : kWidths) {
+            const int height = 3;
+            const ByteMask a = randomMask(width, height, rng, 50);
+            const ByteMask b = randomMask(width, height, rng, 50);
+            BitMask other;
+            other.pack(b.pixels.data(), width, height);
+
+            for (int op = 0; op < 3; op++) {
+                BitMask mask;
+                mask.pack(a.pixels.data(), width, height);
+                const bool done = op == 0 ? mask.andWith(other) : op == 1 ? mask.orWith(other) : mask.xorWith(other);
+                CHECK(done);
+                ByteMask expected = a;
+                for (size_t i = 0; i < expected.pixels.size(); i++) {
+                    const bool x = a.pixels[i] != 0;
+                    const bool y = b.pixels[i] != 0;
+                    expected.pixels[i] = (op == 0 ? x && y : op == 1 ? x || y : x != y) ? 1 : 0;
+                }
+                CHECK(matches(mask, expected));
+
+                // A different size is rejected and leaves the mask as it was
+                BitMask wider;
+                wider.resize(width + 1, height);
+                BitMask taller;
+                taller.resize(width, height + 1);
+                CHECK(!mask.andWith(wider) && !mask.orWith(taller) && !mask.xorWith(wider));
+                CHECK(matches(mask, expected));
+            }
+        }
+    }
+
+    void testShiftAndMorphology() {
+        std::mt19937 rng(14);
+        for (int width : kWidths) {
+            for (int height : kHeights) {
+                const ByteMask source = randomMask(width, height, rng, 25);
+                BitMask mask;
+                mask.pack(source.pixels.data(), width, height);
+
+                const int shifts[][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {3, -2}, {-65, 1}, {64, 0}, {-7, 5}};
+                for (const auto& offset : shifts) {
+                    BitMask shifted;
+                    mask.shift(offset[0], offset[1], shifted);
+                    ByteMask expected = {width, height, std::vector<uint8_t>(source.pixels.size())};
+                    for (int y = 0; y < height; y++) {
+                        for (int x = 0; x < width; x++) {
+                            const int sx = x - offset[0];
+                            const int sy = y - offset[1];
+                            const bool inside = sx >= 0 && sy >= 0 && sx < width && sy < height;
+                            expected.pixels[static_cast<size_t>(y) * width + x] = inside && source.at(sx, sy) ? 1 : 0;
+                        }
+                    }
+                    CHECK(matches(shifted, expected));
+                }
+
+                BitMask dilated;
+                mask.dilate(dilated);
+                CHECK(matches(dilated, morphology(source, true)));
+                BitMask eroded;
+                mask.erode(eroded);
+                CHECK(matches(eroded, morphology(source, false)));
+            }
+        }
+    }
+
+    void testReuseDoesNotAllocate() {
+        std::mt19937 rng(15);
+        const ByteMask source = randomMask(333, 41, rng, 20);
+        BitMask mask;
+        mask.pack(source.pixels.data(), source.width, source.height);
+        BitMask dilated;
+        BitMask eroded;
+        BitMask small;
+        mask.dilate(dilated);
+        mask.erode(eroded);
+        mask.downscaleAny(97, 13, small);
+
+        g_allocations = 0;
+        g_counting = true;
+        for (int i = 0; i < 3; i++) {
+            mask.dilate(dilated);
+            mask.erode(eroded);
+            mask.downscaleAny(97, 13, small);
+        }
+        g_counting = false;
+        printf("allocations while reusing output masks: %d\n", g_allocations.load());
+        CHECK_EQ(g_allocations.load(), 0);
+        CHECK(matches(dilated, morphology(source, true)));
+    }
+}
+
+int main() {
+    testPackUnpack();
+    testNextSetAndDownscale();
+    testLogic();
+    testShiftAndMorphology();
+    testReuseDoesNotAllocate();
+    return testResult("bit_mask_test");
+}
@@ -0,0 +1,99 @@
+// Host driver for the conformance harness (the JNI runConformance entry
+// point runs the same checks on device).
+//
+// Usage: conformance_test [--recorded DIR] [--baseline FILE] [--iterations N]
+//                         [--width W] [--height H]
+//        conformance_test --compare OLD NEW [--alpha A] [--min-change C]
+// Exits non-zero if any implementation is outside its stated tolerance, or
+// in --compare mode if NEW is significantly slower than OLD in any case.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "conformance_harness.h"
+
+namespace {
+    // Welch t-test of two recorded baselines; 1 on a significant regression
+    int compareBaselines(const std::string& oldPath, const std::string& newPath,
+                         double alpha, double minRelativeChange) {
+        PerfBaseline baseline;
+        PerfBaseline current;
+        if (!baseline.load(oldPath) || !current.load(newPath)) {
+            fprintf(stderr, "Failed to read baseline files\n");
+            return 2;
+        }
+        if (baseline.entries().empty() || current.entries().empty()) {
+            fprintf(stderr, "Baseline file has no cases\n");
+            return 2;
+        }
+
+        std::vector<Regression> regressions = PerfBaseline::compare(baseline, current, alpha, minRelativeChange);
+        printf("%s\n", PerfBaseline::formatRegressions(regressions).c_str());
+        return regressions.empty() ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv) {
+    ConformanceConfig config = {320, 240, "", 10, 3};
+    std::string baselinePath;
+    std::string compareOld;
+    std::string compareNew;
+    double alpha = 0.05;
+    double minRelativeChange = 0.05;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* name = argv[i];
+        const char* value = argv[i + 1];
+        if (strcmp(name, "--compare") == 0) {
+            if (i + 2 >= argc) {
+                fprintf(stderr, "--compare needs OLD and NEW baseline files\n");
+                return 2;
+            }
+            compareOld = value;
+            compareNew = argv[i + 2];
+            i++;
+        } else if (strcmp(name, "--alpha") == 0) {
+            alpha = atof(value);
+        } else if (strcmp(name, "--min-change") == 0) {
+            minRelativeChange = atof(value);
+        } else if (strcmp(name, "--recorded") == 0) {
+            config.recordedDir = value;
+        } else if (strcmp(name, "--baseline") == 0) {
+            baselinePath = value;
+        } else if (strcmp(name, "--iterations") == 0) {
+            config.timingIterations = atoi(value);
+        } else if (strcmp(name, "--width") == 0) {
+            config.width = atoi(value);
+        } else if (strcmp(name, "--height") == 0) {
+            config.height = atoi(value);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", name);
+            return 2;
+        }
+    }
+
+    if (!compareOld.empty()) {
+        return compareBaselines(compareOld, compareNew, alpha, minRelativeChange);
+    }
+
+    ConformanceHarness harness(config);
+    harness.buildCorpus();
+    std::vector<ConformanceResult> results = harness.runConformance();
+    printf("%s\n", ConformanceHarness::formatResults(results).c_str());
+
+    if (!baselinePath.empty()) {
+        PerfBaseline baseline = harness.runTiming();
+        if (!baseline.save(baselinePath)) {
+            fprintf(stderr, "Failed to write baseline %s\n", baselinePath.c_str());
+            return 1;
+        }
+        printf("Baseline written to %s\n", baselinePath.c_str());
+    }
+
+    for (const ConformanceResult& result : results) {
+        if (!result.passed) {
+            return 1;
+        }
+    }
+    return results.empty() ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+// processFrameRequests: every derived image is computed once per frame and
+// reused by the other requests, outputs match single-mode processFrame,
+// and a late frame is abandoned with its targets untouched
+
+#include <vector>
+#include "opencv_processor.h"
+#include "synthetic_source.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 320;
+    const int kHeight = 240;
+
+    struct Outputs {
+        std::vector<uint8_t> edges;
+        std::vector<uint8_t> distance;
+        std::vector<uint8_t> thumbnail;
+        OutputTarget targets[3];
+        FrameRequest requests[3];
+
+        Outputs()
+            : edges(static_cast<size_t>(kWidth) * kHeight, 0xEE)
+            , distance(edges.size(), 0xEE)
+            , thumbnail(static_cast<size_t>(kWidth / 4) * (kHeight / 4), 0xEE)
+        {
+            targets[0] = {edges.data(), kWidth, kHeight, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+            targets[1] = {distance.data(), kWidth, kHeight, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+            targets[2] = {thumbnail.data(), kWidth / 4, kHeight / 4, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+            requests[0] = {MODE_EDGE, &targets[0], 1};
+            requests[1] = {MODE_DISTANCE, &targets[1], 1};
+            requests[2] = {MODE_GRAYSCALE, &targets[2], 1};
+        }
+    };
+
+    std::vector<uint8_t> frame(uint32_t index) {
+        SyntheticConfig config = {kWidth, kHeight, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+        SyntheticFrameSource source(config);
+        std::vector<uint8_t> rgba(source.frameSize());
+        source.generate(index, rgba.data());
+        return rgba;
+    }
+
+    std::vector<uint8_t> single(OpenCVProcessor& processor, const std::vector<uint8_t>& rgba, ProcessingMode mode) {
+        std::vector<uint8_t> plane(static_cast<size_t>(kWidth) * kHeight);
+        OutputTarget target = {plane.data(), kWidth, kHeight, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+        CHECK(processor.processFrame(rgba.data(), kWidth, kHeight, mode, &target, 1).success);
+        return plane;
+    }
+
+    void configure(OpenCVProcessor& processor) {
+        processor.initialize();
+        processor.setBlurSigma(4.0f);
+        processor.setFragmentFilter(12, 6);
+    }
+
+    // EDGE + DISTANCE + GRAYSCALE plus every extra image, over two frames
+    void testComputedOnce() {
+        OpenCVProcessor processor;
+        configure(processor);
+        const uint32_t extras = DERIVED_IMAGE_BIT(DERIVED_LUMA) | DERIVED_IMAGE_BIT(DERIVED_PYRAMID) |
+            DERIVED_IMAGE_BIT(DERIVED_GRADIENTS) | DERIVED_IMAGE_BIT(DERIVED_EDGES) |
+            DERIVED_IMAGE_BIT(DERIVED_DISTANCE);
+
+        for (uint32_t index = 1; index <= 2; index++) {
+            const std::vector<uint8_t> rgba = frame(index);
+            Outputs outputs;
+            const ProcessingMetrics metrics =
+                processor.processFrameRequests(rgba.data(), kWidth, kHeight, outputs.requests, 3, extras);
+            CHECK(metrics.success);
+            CHECK(!metrics.abandoned);
+
+            const DerivedImageReport& report = processor.getDerivedImages().report();
+            for (int image : {DERIVED_LUMA, DERIVED_BLURRED, DERIVED_GRADIENTS, DERIVED_EDGES, DERIVED_DISTANCE}) {
+                CHECK_EQ(report.computed[image], 1);
+            }
+            // One computation per level, the thumbnail's level reused by the extra
+            CHECK_EQ(report.computed[DERIVED_PYRAMID], DERIVED_PYRAMID_LEVELS);
+            for (int image : {DERIVED_LUMA, DERIVED_BLURRED, DERIVED_PYRAMID, DERIVED_EDGES, DERIVED_DISTANCE}) {
+                CHECK(report.reused[image] >= 1);
+            }
+            CHECK_EQ(report.reused[DERIVED_EDGES], 2);
+            CHECK_EQ(report.reused[DERIVED_DISTANCE], 1);
+
+            // Same planes as one mode at a time
+            OpenCVProcessor reference;
+            configure(reference);
+            CHECK(outputs.edges == single(reference, rgba, MODE_EDGE));
+            CHECK(outputs.distance == single(reference, rgba, MODE_DISTANCE));
+            CHECK(outputs.thumbnail[0] != 0xEE || outputs.thumbnail[1] != 0xEE);
+        }
+    }
+
+    // An expired deadline abandons the frame before any target is written
+    void testDeadline() {
+        OpenCVProcessor processor;
+        configure(processor);
+        const std::vector<uint8_t> rgba = frame(3);
+        Outputs outputs;
+        const ProcessingMetrics metrics =
+            processor.processFrameRequests(rgba.data(), kWidth, kHeight, outputs.requests, 3, 0, 1);
+        CHECK(metrics.abandoned);
+        CHECK(!metrics.success);
+        CHECK_EQ(metrics.abandonedStage, STAGE_INPUT);
+        CHECK(outputs.edges == std::vector<uint8_t>(outputs.edges.size(), 0xEE));
+        CHECK(processor.getStatistics().find("Abandoned: 1 (input 1") != std::string::npos);
+
+        // A deadline that has not passed changes nothing
+        Outputs timed;
+        CHECK(processor.processFrameRequests(rgba.data(), kWidth, kHeight, timed.requests, 3, 0,
+                                             FrameDeadline::nowMs() + 60000).success);
+        Outputs plain;
+        CHECK(processor.processFrameRequests(rgba.data(), kWidth, kHeight, plain.requests, 3).success);
+        CHECK(timed.edges == plain.edges);
+        CHECK(timed.distance == plain.distance);
+        CHECK(timed.thumbnail == plain.thumbnail);
+    }
+}
+
+int main() {
+    testComputedOnce();
+    testDeadline();
+    return testResult("derived_images_test");
+}
@@ -0,0 +1,94 @@
+// DistanceTransform: both metrics and nearest-edge indices against brute
+// force, including rows wider than float can resolve exactly
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "distance_transform.h"
+#include "test_support.h"
+
+namespace {
+    struct Edge {
+        int x;
+        int y;
+    };
+
+    int64_t metricDistance(int metric, int64_t dx, int64_t dy) {
+        return metric == DISTANCE_EUCLIDEAN ? dx * dx + dy * dy : std::llabs(dx) + std::llabs(dy);
+    }
+
+    // Compares u16 output (scale 1) and, for every pixel, that the reported
+    // nearest edge is at the minimum distance
+    void checkAgainstBruteForce(int width, int height, int edgeCount, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::vector<uint8_t> mask(static_cast<size_t>(width) * height, 0);
+        std::vector<Edge> edges;
+        for (int i = 0; i < edgeCount; i++) {
+            const Edge edge = {static_cast<int>(random() % width), static_cast<int>(random() % height)};
+            mask[static_cast<size_t>(edge.y) * width + edge.x] = 255;
+            edges.push_back(edge);
+        }
+
+        DistanceTransform transform;
+        std::vector<uint16_t> output(mask.size());
+        for (int metric : {DISTANCE_EUCLIDEAN, DISTANCE_CITY_BLOCK}) {
+            CHECK(transform.compute(mask.data(), width, height, metric, true));
+            transform.toU16(output.data(), 1.0f);
+            const int32_t* nearest = transform.nearest();
+
+            int valueErrors = 0;
+            int nearestErrors = 0;
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    int64_t best = INT64_MAX;
+                    for (const Edge& edge : edges) {
+                        best = std::min(best, metricDistance(metric, x - edge.x, y - edge.y));
+                    }
+                    const size_t index = static_cast<size_t>(y) * width + x;
+                    const double exact = metric == DISTANCE_EUCLIDEAN ? std::sqrt(static_cast<double>(best))
+                                                                      : static_cast<double>(best);
+                    const int expected = static_cast<int>(std::min(65535.0, std::floor(exact + 0.5)));
+                    valueErrors += std::abs(output[index] - expected) > (metric == DISTANCE_EUCLIDEAN ? 1 : 0);
+
+                    const int nx = nearest[index] % width;
+                    const int ny = nearest[index] / width;
+                    nearestErrors += mask[nearest[index]] == 0 || metricDistance(metric, x - nx, y - ny) != best;
+                }
+            }
+            CHECK_EQ(valueErrors, 0);
+            CHECK_EQ(nearestErrors, 0);
+        }
+    }
+
+    // Masks without edges report the clamp value, not a finite distance
+    void testEmptyMask() {
+        const int width = 40;
+        const int height = 30;
+        std::vector<uint8_t> mask(static_cast<size_t>(width) * height, 0);
+        std::vector<uint16_t> wide(mask.size());
+        std::vector<uint8_t> narrow(mask.size());
+        DistanceTransform transform;
+        for (int metric : {DISTANCE_EUCLIDEAN, DISTANCE_CITY_BLOCK}) {
+            CHECK(transform.compute(mask.data(), width, height, metric, true));
+            transform.toU16(wide.data(), 1.0f);
+            transform.toU8(narrow.data(), 1.0f);
+            CHECK(std::all_of(wide.begin(), wide.end(), [](uint16_t v) { return v == 65535; }));
+            CHECK(std::all_of(narrow.begin(), narrow.end(), [](uint8_t v) { return v == 255; }));
+            CHECK_EQ(transform.nearest()[0], -1);
+        }
+    }
+}
+
+int main() {
+    checkAgainstBruteForce(1, 1, 1, 1u);
+    checkAgainstBruteForce(64, 48, 12, 2u);
+    checkAgainstBruteForce(301, 77, 40, 3u);
+    // Parabola heights q^2 pass 2^24 beyond column 4096
+    checkAgainstBruteForce(6000, 3, 9, 4u);
+    checkAgainstBruteForce(3, 6000, 9, 5u);
+    testEmptyMask();
+    CHECK(!DistanceTransform().compute(nullptr, 4, 4, DISTANCE_EUCLIDEAN, false));
+    return testResult("distance_transform_test");
+}
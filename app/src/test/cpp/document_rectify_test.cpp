@@ -0,0 +1,160 @@
+// DocumentRectifier: an axis-aligned quad whose size matches the output
+// yields the exact crop (gray and RGBA, strided buffers, and a crop past the
+// frame edge replicates the border); corner movement within the tolerance
+// reuses the table, measured from the corners it was built for so drift
+// cannot accumulate, and movement beyond it, a new output size or
+// invalidate() rebuild it; degenerate quads are refused
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "document_rectify.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 97;
+    const int kHeight = 61;
+
+    std::vector<uint8_t> randomImage(int width, int height, int stride, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> image(static_cast<size_t>(stride) * height, 0);
+        for (uint8_t& value : image) {
+            value = static_cast<uint8_t>(rng() % 256);
+        }
+        return image;
+    }
+
+    // Corners of the output-sized rectangle at (left, top), in pixel centres
+    void axisQuad(float left, float top, int outWidth, int outHeight, float* quad) {
+        const float right = left + outWidth - 1;
+        const float bottom = top + outHeight - 1;
+        const float corners[8] = {left, top, right, top, right, bottom, left, bottom};
+        std::copy(corners, corners + 8, quad);
+    }
+
+    // Output pixels that differ from the source crop at (left, top), with the
+    // source coordinates clamped to the frame
+    int cropDifferences(const std::vector<uint8_t>& source, int stride, int channels, int left, int top,
+                        const std::vector<uint8_t>& output, int outWidth, int outHeight, int outStride) {
+        int differences = 0;
+        for (int v = 0; v < outHeight; v++) {
+            const int y = std::min(kHeight - 1, std::max(0, top + v));
+            for (int u = 0; u < outWidth; u++) {
+                const int x = std::min(kWidth - 1, std::max(0, left + u));
+                for (int c = 0; c < channels; c++) {
+                    const uint8_t expected = source[static_cast<size_t>(y) * stride + x * channels + c];
+                    const uint8_t actual = output[static_cast<size_t>(v) * outStride + u * channels + c];
+                    differences += expected != actual ? 1 : 0;
+                }
+            }
+        }
+        return differences;
+    }
+
+    void testAxisAlignedCrop() {
+        const int outWidth = 40;
+        const int outHeight = 25;
+        for (int channels : {1, 4}) {
+            const int stride = kWidth * channels + 5;
+            const int outStride = outWidth * channels + 3;
+            const std::vector<uint8_t> source = randomImage(kWidth, kHeight, stride, 21 + channels);
+            std::vector<uint8_t> output(static_cast<size_t>(outStride) * outHeight, 0);
+
+            // Inside the frame, then hanging over the right and bottom edges
+            const int origins[][2] = {{0, 0}, {13, 7}, {kWidth - outWidth, kHeight - outHeight}, {70, 50}, {-3, -2}};
+            for (const auto& origin : origins) {
+                DocumentRectifier rectifier;
+                float quad[8];
+                axisQuad(static_cast<float>(origin[0]), static_cast<float>(origin[1]), outWidth, outHeight, quad);
+                CHECK(rectifier.rectify(source.data(), kWidth, kHeight, stride, channels, quad,
+                                        output.data(), outWidth, outHeight, outStride));
+                const int differences = cropDifferences(source, stride, channels, origin[0], origin[1],
+                                                        output, outWidth, outHeight, outStride);
+                if (differences != 0) {
+                    fprintf(stderr, "%d channel(s), crop at %d,%d: %d values differ\n",
+                            channels, origin[0], origin[1], differences);
+                }
+                CHECK_EQ(differences, 0);
+            }
+        }
+    }
+
+    void testTableReuse() {
+        const int outWidth = 32;
+        const int outHeight = 20;
+        const std::vector<uint8_t> source = randomImage(kWidth, kHeight, kWidth, 31);
+        std::vector<uint8_t> output(static_cast<size_t>(outWidth) * outHeight, 0);
+        DocumentRectifier rectifier;
+        float quad[8];
+
+        axisQuad(10.0f, 10.0f, outWidth, outHeight, quad);
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad, output.data(), outWidth, outHeight, 0));
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad, output.data(), outWidth, outHeight, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 1u);
+        CHECK_EQ(rectifier.stats().tableReuses, 1u);
+
+        // Jitter within the 0.5 px tolerance keeps the table, and its output
+        axisQuad(10.3f, 9.8f, outWidth, outHeight, quad);
+        quad[5] += 0.2f;
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad, output.data(), outWidth, outHeight, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 1u);
+        CHECK_EQ(rectifier.stats().tableReuses, 2u);
+        CHECK_EQ(cropDifferences(source, kWidth, 1, 10, 10, output, outWidth, outHeight, outWidth), 0);
+
+        // A second small step is measured from the built corners, 0.6 px away
+        axisQuad(10.6f, 10.0f, outWidth, outHeight, quad);
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad, output.data(), outWidth, outHeight, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 2u);
+
+        // Movement beyond the tolerance rebuilds and follows the quad
+        axisQuad(14.0f, 11.0f, outWidth, outHeight, quad);
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad, output.data(), outWidth, outHeight, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 3u);
+        CHECK_EQ(cropDifferences(source, kWidth, 1, 14, 11, output, outWidth, outHeight, outWidth), 0);
+
+        // So do a new output size, invalidate() and a zero tolerance
+        std::vector<uint8_t> smaller(static_cast<size_t>(outWidth / 2) * (outHeight / 2), 0);
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad,
+                                smaller.data(), outWidth / 2, outHeight / 2, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 4u);
+        rectifier.invalidate();
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad,
+                                smaller.data(), outWidth / 2, outHeight / 2, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 5u);
+        rectifier.setTolerance(0.0f);
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad,
+                                smaller.data(), outWidth / 2, outHeight / 2, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 5u);
+        quad[0] += 0.01f;
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad,
+                                smaller.data(), outWidth / 2, outHeight / 2, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 6u);
+        CHECK_EQ(rectifier.stats().frames, 9u);
+
+        CHECK(rectifier.release() > 0);
+        CHECK(rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, quad,
+                                smaller.data(), outWidth / 2, outHeight / 2, 0));
+        CHECK_EQ(rectifier.stats().tableBuilds, 7u);
+    }
+
+    void testDegenerateQuads() {
+        const std::vector<uint8_t> source = randomImage(kWidth, kHeight, kWidth, 41);
+        std::vector<uint8_t> output(16 * 16, 0);
+        DocumentRectifier rectifier;
+
+        // Collapsed, and bottom corners swapped (a folded bow-tie)
+        const float collapsed[8] = {5, 5, 5, 5, 5, 5, 5, 5};
+        const float folded[8] = {10, 10, 40, 10, 10, 40, 40, 40};
+        CHECK(!rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, collapsed, output.data(), 16, 16, 0));
+        CHECK(!rectifier.rectify(source.data(), kWidth, kHeight, 0, 1, folded, output.data(), 16, 16, 0));
+        CHECK_EQ(rectifier.stats().frames, 0u);
+    }
+}
+
+int main() {
+    testAxisAlignedCrop();
+    testTableReuse();
+    testDegenerateQuads();
+    return testResult("document_rectify_test");
+}
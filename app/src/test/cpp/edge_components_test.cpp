@@ -0,0 +1,222 @@
+// EdgeComponentFilter: labels and statistics against a flood-fill reference,
+// fragment removal, filtered masks written without unpacking, dense 720p timing
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "edge_components.h"
+#include "frame_output.h"
+#include "opencv_processor.h"
+#include "test_support.h"
+
+namespace {
+    // 8-connected flood fill; components numbered in raster order of their first pixel
+    std::vector<EdgeComponent> referenceComponents(const BitMask& mask) {
+        const int width = mask.width();
+        const int height = mask.height();
+        std::vector<int> label(static_cast<size_t>(width) * height, -1);
+        std::vector<EdgeComponent> components;
+        std::vector<int> stack;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (!mask.test(x, y) || label[y * width + x] >= 0) {
+                    continue;
+                }
+                const int id = static_cast<int>(components.size());
+                EdgeComponent component = {x, y, x, y, 0, false};
+                label[y * width + x] = id;
+                stack.push_back(y * width + x);
+                while (!stack.empty()) {
+                    const int index = stack.back();
+                    stack.pop_back();
+                    const int px = index % width;
+                    const int py = index / width;
+                    component.minX = std::min(component.minX, px);
+                    component.maxX = std::max(component.maxX, px);
+                    component.minY = std::min(component.minY, py);
+                    component.maxY = std::max(component.maxY, py);
+                    component.pixels++;
+                    for (int dy = -1; dy <= 1; dy++) {
+                        for (int dx = -1; dx <= 1; dx++) {
+                            const int nx = px + dx;
+                            const int ny = py + dy;
+                            if (nx < 0 || ny < 0 || nx >= width || ny >= height ||
+                                !mask.test(nx, ny) || label[ny * width + nx] >= 0) {
+                                continue;
+                            }
+                            label[ny * width + nx] = id;
+                            stack.push_back(ny * width + nx);
+                        }
+                    }
+                }
+                components.push_back(component);
+            }
+        }
+        return components;
+    }
+
+    void randomMask(BitMask& mask, int width, int height, int percent, uint32_t seed) {
+        std::mt19937 random(seed);
+        mask.resize(width, height);
+        mask.clear();
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (static_cast<int>(random() % 100) < percent) {
+                    mask.set(x, y);
+                }
+            }
+        }
+    }
+
+    // Bounds and pixel counts match the reference, including components
+    // that span band seams, and exactly the small ones are cleared
+    void testAgainstReference() {
+        const int sizes[][2] = {{1, 1}, {70, 3}, {97, 130}, {320, 240}};
+        for (const auto& size : sizes) {
+            for (int percent : {5, 30, 60}) {
+                BitMask mask;
+                randomMask(mask, size[0], size[1], percent, static_cast<uint32_t>(size[0] + percent));
+                const std::vector<EdgeComponent> expected = referenceComponents(mask);
+
+                EdgeComponentFilter filter;
+                filter.setThresholds(4, 3);
+                BitMask filtered = mask;
+                const size_t kept = filter.filter(filtered);
+                const std::vector<EdgeComponent>& actual = filter.components();
+
+                CHECK_EQ(actual.size(), expected.size());
+                if (actual.size() != expected.size()) {
+                    continue;
+                }
+                int mismatches = 0;
+                size_t expectedKept = 0;
+                size_t expectedRemoved = 0;
+                for (size_t i = 0; i < expected.size(); i++) {
+                    mismatches += actual[i].minX != expected[i].minX || actual[i].maxX != expected[i].maxX ||
+                        actual[i].minY != expected[i].minY || actual[i].maxY != expected[i].maxY ||
+                        actual[i].pixels != expected[i].pixels;
+                    const bool keep = expected[i].pixels >= 4 &&
+                        std::max(expected[i].maxX - expected[i].minX, expected[i].maxY - expected[i].minY) + 1 >= 3;
+                    mismatches += actual[i].kept != keep;
+                    expectedKept += keep ? 1 : 0;
+                    expectedRemoved += keep ? 0 : expected[i].pixels;
+                }
+                CHECK_EQ(mismatches, 0);
+                CHECK_EQ(kept, expectedKept);
+                CHECK_EQ(filter.removedPixels(), expectedRemoved);
+
+                // Surviving pixels are exactly those of kept components
+                std::vector<EdgeComponent> survivors = referenceComponents(filtered);
+                CHECK_EQ(survivors.size(), expectedKept);
+            }
+        }
+    }
+
+    // Every target shape gets the same bytes from the mask as from its unpacked plane
+    void testMaskOutput() {
+        BitMask mask;
+        randomMask(mask, 97, 70, 30, 5u);
+        std::vector<uint8_t> plane(static_cast<size_t>(97) * 70);
+        mask.unpack(plane.data());
+
+        const int shapes[][3] = {
+            {97, 70, OUTPUT_FORMAT_GRAY}, {40, 33, OUTPUT_FORMAT_GRAY}, {97, 70, OUTPUT_FORMAT_RGBA},
+            {194, 140, OUTPUT_FORMAT_GRAY}, {48, 34, OUTPUT_FORMAT_NV12}
+        };
+        for (const auto& shape : shapes) {
+            const size_t bytes = static_cast<size_t>(shape[0]) * shape[1] *
+                MultiOutputWriter::bytesPerPixel(shape[2]);
+            std::vector<uint8_t> fromPlane(bytes, 0xEE);
+            std::vector<uint8_t> fromMask(bytes, 0xEE);
+            std::vector<uint8_t> uvPlane(bytes / 2, 0xEE);
+            std::vector<uint8_t> uvMask(bytes / 2, 0xEE);
+            OutputTarget target = {fromPlane.data(), shape[0], shape[1], shape[2], 0, uvPlane.data(), 0};
+            MultiOutputWriter writer;
+            CHECK(writer.write(plane.data(), 97, 70, 1, &target, 1));
+            target.data = fromMask.data();
+            target.uvData = uvMask.data();
+            CHECK(writer.write(mask, &target, 1));
+            CHECK(fromMask == fromPlane);
+            CHECK(uvMask == uvPlane);
+        }
+
+        // Empty masks pack and shift without touching any row
+        const uint8_t none = 0;
+        BitMask empty;
+        empty.pack(&none, 0, 5);
+        CHECK(empty.empty());
+        BitMask shifted;
+        empty.shift(1, 1, shifted);
+        CHECK(shifted.empty());
+        OutputTarget target = {plane.data(), 1, 1, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+        MultiOutputWriter writer;
+        CHECK(!writer.write(empty, &target, 1));
+    }
+
+    // An edge frame with fragments removed is written from the filtered mask
+    void testFilteredFrame() {
+        const int width = 160;
+        const int height = 120;
+        std::vector<uint8_t> gray(static_cast<size_t>(width) * height, 40);
+        for (int y = 20; y < 100; y++) {
+            for (int x = 30; x < 130; x++) {
+                gray[y * width + x] = 200;
+            }
+        }
+        // Isolated specks Canny outlines as short fragments
+        for (int i = 0; i < 6; i++) {
+            gray[(5 + i * 2) * width + 8 + i * 24] = 255;
+        }
+
+        OpenCVProcessor processor;
+        processor.initialize();
+        std::vector<uint8_t> plain(gray.size());
+        std::vector<uint8_t> filtered(gray.size());
+        OutputTarget target = {plain.data(), width, height, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+        CHECK(processor.processGrayFrame(gray.data(), width, height, MODE_EDGE, &target, 1).success);
+        processor.setFragmentFilter(20, 8);
+        target.data = filtered.data();
+        CHECK(processor.processGrayFrame(gray.data(), width, height, MODE_EDGE, &target, 1).success);
+
+        // Only fragment pixels are cleared; the rectangle outline survives
+        size_t removed = 0;
+        int added = 0;
+        for (size_t i = 0; i < gray.size(); i++) {
+            removed += plain[i] != 0 && filtered[i] == 0;
+            added += plain[i] == 0 && filtered[i] != 0;
+        }
+        CHECK(removed > 0);
+        CHECK_EQ(added, 0);
+        CHECK(filtered[20 * width + 80] != 0 || filtered[19 * width + 80] != 0 || filtered[21 * width + 80] != 0);
+    }
+
+    // Dense 1280x720 masks have tens of thousands of components
+    void reportDenseTiming() {
+        for (int percent : {30, 50}) {
+            BitMask mask;
+            randomMask(mask, 1280, 720, percent, 99u);
+            EdgeComponentFilter filter;
+            filter.setThresholds(8, 4);
+            std::vector<double> times;
+            BitMask work;
+            for (int i = 0; i < 11; i++) {
+                work = mask;
+                const double start = testNowMs();
+                filter.filter(work);
+                times.push_back(testNowMs() - start);
+            }
+            std::sort(times.begin(), times.end());
+            printf("1280x720 at %d%% density: %zu components, %.2f ms\n",
+                   percent, filter.components().size(), times[times.size() / 2]);
+        }
+    }
+}
+
+int main() {
+    testAgainstReference();
+    testMaskOutput();
+    testFilteredFrame();
+    reportDenseTiming();
+    return testResult("edge_components_test");
+}
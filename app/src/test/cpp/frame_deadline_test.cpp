@@ -0,0 +1,125 @@
+// Frame deadlines: banded stages stop once the deadline has passed and leave
+// their outputs alone, and a late frame returns soon after its deadline
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "distance_transform.h"
+#include "edge_components.h"
+#include "gray_codec.h"
+#include "opencv_processor.h"
+#include "stacked_blur.h"
+#include "synthetic_source.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 1280;
+    const int kHeight = 720;
+
+    std::vector<uint8_t> grayFrame(uint32_t index) {
+        SyntheticConfig config = {kWidth, kHeight, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+        SyntheticFrameSource source(config);
+        std::vector<uint8_t> rgba(source.frameSize());
+        source.generate(index, rgba.data());
+        std::vector<uint8_t> gray(static_cast<size_t>(kWidth) * kHeight);
+        for (size_t i = 0; i < gray.size(); i++) {
+            gray[i] = rgba[i * 4];
+        }
+        return gray;
+    }
+
+    // An expired deadline stops each component; a distant one changes nothing
+    void testComponents() {
+        const std::vector<uint8_t> gray = grayFrame(1);
+        const FrameDeadline expired(1);
+        const FrameDeadline distant(FrameDeadline::nowMs() + 60000);
+
+        StackedBlur blur;
+        std::vector<uint8_t> plain(gray.size());
+        std::vector<uint8_t> timed(gray.size());
+        blur.blur(gray.data(), plain.data(), kWidth, kHeight, 6.0f);
+        CHECK(blur.blur(gray.data(), timed.data(), kWidth, kHeight, 6.0f, &distant));
+        CHECK(timed == plain);
+        CHECK(!blur.blur(gray.data(), timed.data(), kWidth, kHeight, 6.0f, &expired));
+
+        GrayCodec codec;
+        TrackedBytes stream;
+        TrackedBytes reference;
+        CHECK(codec.encode(gray.data(), kWidth, kHeight, 0, reference));
+        CHECK(codec.encode(gray.data(), kWidth, kHeight, 0, stream, PREDICT_MED, 0, &distant));
+        CHECK(stream == reference);
+        stream.assign(3, 7);
+        CHECK(!codec.encode(gray.data(), kWidth, kHeight, 0, stream, PREDICT_MED, 0, &expired));
+        CHECK_EQ(stream.size(), 3u);
+
+        std::vector<uint8_t> edges(gray.size());
+        for (size_t i = 0; i < edges.size(); i++) {
+            edges[i] = gray[i] > 200 ? 255 : 0;
+        }
+        DistanceTransform distance;
+        CHECK(distance.compute(edges.data(), kWidth, kHeight, DISTANCE_EUCLIDEAN, true, &distant));
+        CHECK(!distance.compute(edges.data(), kWidth, kHeight, DISTANCE_EUCLIDEAN, true, &expired));
+
+        BitMask mask;
+        mask.pack(edges.data(), kWidth, kHeight);
+        EdgeComponentFilter filter;
+        filter.setThresholds(50, 10);
+        CHECK_EQ(filter.filter(mask, &expired), 0u);
+        CHECK(filter.components().empty());
+        std::vector<uint8_t> unpacked(edges.size());
+        mask.unpack(unpacked.data());
+        CHECK(unpacked == edges);
+    }
+
+    // Deadlines spread across one frame's duration: abandoned frames fail
+    // and the time past the deadline is reported
+    void reportOverrun() {
+        SyntheticConfig config = {kWidth, kHeight, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+        SyntheticFrameSource source(config);
+        std::vector<uint8_t> rgba(source.frameSize());
+        source.generate(2, rgba.data());
+        std::vector<uint8_t> output(rgba.size());
+
+        OpenCVProcessor processor;
+        processor.initialize();
+        processor.setBlurSigma(6.0f);
+        processor.setFragmentFilter(20, 8);
+        processor.setSubpixelEdgesEnabled(true);
+
+        std::vector<double> frameTimes;
+        for (int i = 0; i < 5; i++) {
+            const double start = testNowMs();
+            processor.processFrame(rgba.data(), kWidth, kHeight, MODE_EDGE, output.data());
+            frameTimes.push_back(testNowMs() - start);
+        }
+        std::sort(frameTimes.begin(), frameTimes.end());
+        const double frameMs = frameTimes[frameTimes.size() / 2];
+
+        double worst = 0.0;
+        double total = 0.0;
+        int abandoned = 0;
+        for (int step = 1; step <= 18; step++) {
+            const int64_t budget = std::max<int64_t>(1, static_cast<int64_t>(frameMs * step / 20));
+            const int64_t deadline = FrameDeadline::nowMs() + budget;
+            const ProcessingMetrics metrics =
+                processor.processFrame(rgba.data(), kWidth, kHeight, MODE_EDGE, output.data(), deadline);
+            const double overrun = static_cast<double>(FrameDeadline::nowMs() - deadline);
+            if (metrics.abandoned) {
+                CHECK(!metrics.success);
+                abandoned++;
+                worst = std::max(worst, overrun);
+                total += std::max(0.0, overrun);
+            }
+        }
+        CHECK(abandoned > 0);
+        printf("1280x720 EDGE, stacked blur + filter + sub-pixel, %.1f ms per frame: "
+               "%d abandoned, overrun mean %.1f ms, worst %.1f ms\n",
+               frameMs, abandoned, abandoned > 0 ? total / abandoned : 0.0, worst);
+    }
+}
+
+int main() {
+    testComponents();
+    reportOverrun();
+    return testResult("frame_deadline_test");
+}
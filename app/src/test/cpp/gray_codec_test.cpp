@@ -0,0 +1,174 @@
+// GrayCodec: lossless round trips, malformed streams, 720p encode timing
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "gray_codec.h"
+#include "opencv_processor.h"
+#include "synthetic_source.h"
+#include "test_support.h"
+
+namespace {
+    // Plane with row padding filled with a marker the codec must ignore
+    struct Plane {
+        std::vector<uint8_t> data;
+        int width;
+        int height;
+        int rowBytes;
+        int stride;     // As passed to encode (0 = tightly packed)
+
+        Plane(int w, int h, int padding)
+            : data(static_cast<size_t>(w + padding) * h, 0xA5)
+            , width(w), height(h), rowBytes(w + padding), stride(padding > 0 ? w + padding : 0) {}
+        uint8_t& at(int x, int y) { return data[static_cast<size_t>(y) * rowBytes + x]; }
+    };
+
+    void fill(Plane& plane, int kind, uint32_t seed) {
+        std::mt19937 random(seed);
+        for (int y = 0; y < plane.height; y++) {
+            for (int x = 0; x < plane.width; x++) {
+                uint8_t value;
+                switch (kind) {
+                    case 0: value = static_cast<uint8_t>(random()); break;                       // Noise
+                    case 1: value = static_cast<uint8_t>(x + 2 * y); break;                       // Gradient
+                    case 2: value = random() % 37 == 0 ? 255 : 0; break;                          // Sparse mask
+                    default: value = static_cast<uint8_t>((x / 8 + y / 8) * 16 + random() % 5); // Blocks + noise
+                }
+                plane.at(x, y) = value;
+            }
+        }
+    }
+
+    bool roundTrip(GrayCodec& codec, Plane& plane, int predictor, int bands) {
+        TrackedBytes stream;
+        if (!codec.encode(plane.data.data(), plane.width, plane.height, plane.stride, stream, predictor, bands)) {
+            return false;
+        }
+        int width = 0;
+        int height = 0;
+        if (!GrayCodec::readHeader(stream.data(), stream.size(), width, height) ||
+            width != plane.width || height != plane.height) {
+            return false;
+        }
+        std::vector<uint8_t> decoded(static_cast<size_t>(width) * height);
+        if (!GrayCodec::decode(stream.data(), stream.size(), decoded.data(), width, height)) {
+            return false;
+        }
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (decoded[static_cast<size_t>(y) * width + x] != plane.at(x, y)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Every predictor and band split reproduces the plane exactly
+    void testRoundTrips() {
+        GrayCodec codec;
+        const int sizes[][2] = {{1, 1}, {17, 5}, {64, 48}, {333, 97}, {640, 480}};
+        int failures = 0;
+        int cases = 0;
+        for (const auto& size : sizes) {
+            for (int kind = 0; kind < 4; kind++) {
+                for (int padding : {0, 13}) {
+                    Plane plane(size[0], size[1], padding);
+                    fill(plane, kind, static_cast<uint32_t>(size[0] * 131 + kind));
+                    for (int predictor : {PREDICT_LEFT, PREDICT_UP, PREDICT_MED}) {
+                        for (int bands : {0, 1, 3, 64}) {
+                            failures += roundTrip(codec, plane, predictor, bands) ? 0 : 1;
+                            cases++;
+                        }
+                    }
+                }
+            }
+        }
+        CHECK_EQ(failures, 0);
+        CHECK(cases > 0);
+    }
+
+    // Truncated or mismatched streams are rejected rather than misread
+    void testMalformedStreams() {
+        GrayCodec codec;
+        Plane plane(96, 64, 0);
+        fill(plane, 3, 9);
+        TrackedBytes stream;
+        CHECK(codec.encode(plane.data.data(), plane.width, plane.height, 0, stream, PREDICT_MED, 4));
+
+        std::vector<uint8_t> decoded(static_cast<size_t>(plane.width) * plane.height);
+        CHECK(!GrayCodec::decode(stream.data(), stream.size() - 1, decoded.data(), plane.width, plane.height));
+        CHECK(!GrayCodec::decode(stream.data(), 8, decoded.data(), plane.width, plane.height));
+        CHECK(!GrayCodec::decode(stream.data(), stream.size(), decoded.data(), plane.width + 1, plane.height));
+
+        TrackedBytes extended = stream;
+        extended.push_back(0);
+        CHECK(!GrayCodec::decode(extended.data(), extended.size(), decoded.data(), plane.width, plane.height));
+
+        // Sides past 0x7FFF cannot be described by the stream header
+        std::vector<uint8_t> wide(0x8000, 7);
+        CHECK(!codec.encode(wide.data(), 0x8000, 1, 0, stream));
+        CHECK(codec.encode(wide.data(), 0x7FFF, 1, 0, stream));
+    }
+
+    double medianEncodeMs(GrayCodec& codec, const uint8_t* gray, int width, int height, int bands,
+                          TrackedBytes& stream) {
+        std::vector<double> times;
+        for (int i = 0; i < 15; i++) {
+            const double start = testNowMs();
+            codec.encode(gray, width, height, 0, stream, PREDICT_MED, bands);
+            times.push_back(testNowMs() - start);
+        }
+        std::sort(times.begin(), times.end());
+        return times[times.size() / 2];
+    }
+
+    // 720p streamed GRAYSCALE and EDGE frames. One band on one thread is the
+    // serial cost; a quarter-height plane on one band is the critical path
+    // of the default split on a four-core device.
+    void reportEncodeTiming() {
+        const int width = 1280;
+        const int height = 720;
+        SyntheticConfig config = {width, height, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+        SyntheticFrameSource source(config);
+        std::vector<uint8_t> rgba(source.frameSize());
+        CHECK(source.generate(3, rgba.data()));
+
+        OpenCVProcessor processor;
+        processor.initialize();
+        std::vector<uint8_t> gray(static_cast<size_t>(width) * height * 4);
+        std::vector<uint8_t> edges(static_cast<size_t>(width) * height * 4);
+        CHECK(processor.processFrame(rgba.data(), width, height, MODE_GRAYSCALE, gray.data()).success);
+        CHECK(processor.processFrame(rgba.data(), width, height, MODE_EDGE, edges.data()).success);
+
+        // RGBA results carry the plane in every channel
+        Plane grayPlane(width, height, 0);
+        Plane edgePlane(width, height, 0);
+        for (size_t i = 0; i < grayPlane.data.size(); i++) {
+            grayPlane.data[i] = gray[i * 4];
+            edgePlane.data[i] = edges[i * 4];
+        }
+
+        GrayCodec codec;
+        TrackedBytes stream;
+        const struct { const char* name; Plane* plane; } planes[] = {
+            {"GRAYSCALE", &grayPlane}, {"EDGE", &edgePlane}};
+        for (const auto& entry : planes) {
+            const uint8_t* data = entry.plane->data.data();
+            const double serial = medianEncodeMs(codec, data, width, height, 1, stream);
+            const double ratio = static_cast<double>(entry.plane->data.size()) / stream.size();
+            const double band = medianEncodeMs(codec, data, width, height / 4, 1, stream);
+            CHECK(roundTrip(codec, *entry.plane, PREDICT_MED, 0));
+            printf("%s 1280x720: %.2f ms on one thread, %.2f ms per quarter band, ratio %.1fx\n",
+                   entry.name, serial, band, ratio);
+        }
+    }
+}
+
+int main() {
+    testRoundTrips();
+    testMalformedStreams();
+    reportEncodeTiming();
+    return testResult("gray_codec_test");
+}
@@ -0,0 +1,125 @@
+// LensUndistort: an identity calibration (no distortion, principal point at
+// the centre) reproduces ImageUtils::lumaFromVideoRange exactly, borders
+// included, at odd sizes and with a row stride wider than the frame; a
+// repeated frame is served from the cached table, and half-resolution output
+// builds a second table that alternating sizes then keep reusing
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "lens_undistort.h"
+#include "opencv_processor.h"
+#include "test_support.h"
+
+namespace {
+    LensCalibration identityCalibration(int width, int height) {
+        LensCalibration calibration = {};
+        calibration.width = width;
+        calibration.height = height;
+        calibration.fx = 0.8 * width;
+        calibration.fy = 0.8 * width;
+        calibration.cx = (width - 1) * 0.5;
+        calibration.cy = (height - 1) * 0.5;
+        return calibration;
+    }
+
+    // Video-range noise in a plane with padding bytes past the width
+    std::vector<uint8_t> randomPlane(int width, int height, int stride, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> plane(static_cast<size_t>(stride) * height, 0);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                plane[static_cast<size_t>(y) * stride + x] = static_cast<uint8_t>(rng() % 256);
+            }
+        }
+        return plane;
+    }
+
+    void testIdentityMatchesLumaConversion() {
+        const int sizes[][2] = {{2, 2}, {3, 5}, {17, 9}, {65, 33}, {321, 241}};
+        for (const auto& size : sizes) {
+            const int width = size[0];
+            const int height = size[1];
+            const int stride = width + 7;
+            const std::vector<uint8_t> plane = randomPlane(width, height, stride, width * 131 + height);
+
+            LensUndistort undistort;
+            CHECK(undistort.setCalibration(identityCalibration(width, height)));
+            std::vector<uint8_t> expected(static_cast<size_t>(width) * height, 0);
+            std::vector<uint8_t> actual(expected.size(), 0);
+            ImageUtils::lumaFromVideoRange(plane.data(), width, height, stride, expected.data());
+            CHECK(undistort.lumaFromVideoRange(plane.data(), width, height, stride, width, height, actual.data()));
+
+            int differences = 0;
+            for (size_t i = 0; i < expected.size(); i++) {
+                differences += expected[i] != actual[i] ? 1 : 0;
+            }
+            if (differences != 0) {
+                fprintf(stderr, "%dx%d: %d pixels differ from the plain conversion\n", width, height, differences);
+            }
+            CHECK_EQ(differences, 0);
+        }
+
+        // A frame smaller than 2x2 is refused
+        LensUndistort undistort;
+        CHECK(undistort.setCalibration(identityCalibration(1, 1)));
+        uint8_t pixel = 0;
+        uint8_t gray = 0;
+        CHECK(!undistort.lumaFromVideoRange(&pixel, 1, 1, 1, 1, 1, &gray));
+    }
+
+    void testTableReuse() {
+        const int width = 160;
+        const int height = 120;
+        const std::vector<uint8_t> plane = randomPlane(width, height, width, 5);
+        std::vector<uint8_t> full(static_cast<size_t>(width) * height, 0);
+        std::vector<uint8_t> half(static_cast<size_t>(width / 2) * (height / 2), 0);
+        std::vector<uint8_t> expectedHalf(half.size(), 0);
+
+        LensUndistort undistort;
+        CHECK(undistort.setCalibration(identityCalibration(width, height)));
+        for (int i = 0; i < 3; i++) {
+            CHECK(undistort.lumaFromVideoRange(plane.data(), width, height, width, width, height, full.data()));
+        }
+        CHECK_EQ(undistort.tableBuilds(), 1);
+        CHECK_EQ(undistort.tableReuses(), 2u);
+
+        // Half resolution under memory pressure is a second cached table,
+        // close to the 2x2 average of the plain conversion
+        CHECK(undistort.lumaFromVideoRange(plane.data(), width, height, width, width / 2, height / 2, half.data()));
+        CHECK_EQ(undistort.tableBuilds(), 2);
+        ImageUtils::lumaFromVideoRangeHalf(plane.data(), width, height, width, expectedHalf.data());
+        int maxDifference = 0;
+        for (size_t i = 0; i < half.size(); i++) {
+            maxDifference = std::max(maxDifference, std::abs(half[i] - expectedHalf[i]));
+        }
+        printf("half resolution: max difference %d from the 2x2 average\n", maxDifference);
+        CHECK(maxDifference <= 1);
+
+        // Switching between the two sizes rebuilds nothing
+        for (int i = 0; i < 4; i++) {
+            const bool halfSize = (i % 2) == 0;
+            CHECK(undistort.lumaFromVideoRange(plane.data(), width, height, width,
+                                               halfSize ? width / 2 : width, halfSize ? height / 2 : height,
+                                               halfSize ? half.data() : full.data()));
+        }
+        CHECK_EQ(undistort.tableBuilds(), 2);
+        CHECK_EQ(undistort.tableReuses(), 6u);
+
+        // Releasing drops the tables; a new calibration resets the counters
+        CHECK(undistort.release() > 0);
+        CHECK(undistort.lumaFromVideoRange(plane.data(), width, height, width, width, height, full.data()));
+        CHECK_EQ(undistort.tableBuilds(), 3);
+        CHECK(undistort.setCalibration(identityCalibration(width, height)));
+        CHECK_EQ(undistort.tableBuilds(), 0);
+        CHECK_EQ(undistort.tableReuses(), 0u);
+    }
+}
+
+int main() {
+    testIdentityMatchesLumaConversion();
+    testTableReuse();
+    return testResult("lens_undistort_test");
+}
@@ -0,0 +1,54 @@
+// Host driver for the sustained-load harness (the JNI runLoadTest entry
+// point runs the same LoadHarness on device).
+//
+// Usage: load_test [--width W] [--height H] [--mode M] [--pattern P]
+//                  [--format F] [--density D] [--pipelines N] [--fps R]
+//                  [--seconds S]
+// Exits non-zero if no frame was processed or any frame failed.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "load_harness.h"
+
+int main(int argc, char** argv) {
+    LoadTestConfig config = {};
+    config.source = {1280, 720, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+    config.mode = MODE_EDGE;
+    config.pipelineCount = 1;
+    config.targetFps = 30.0;
+    config.durationSeconds = 10;
+    config.preGeneratedFrames = 60;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* name = argv[i];
+        const char* value = argv[i + 1];
+        if (strcmp(name, "--width") == 0) {
+            config.source.width = atoi(value);
+        } else if (strcmp(name, "--height") == 0) {
+            config.source.height = atoi(value);
+        } else if (strcmp(name, "--mode") == 0) {
+            config.mode = atoi(value);
+        } else if (strcmp(name, "--pattern") == 0) {
+            config.source.pattern = atoi(value);
+        } else if (strcmp(name, "--format") == 0) {
+            config.source.format = atoi(value);
+        } else if (strcmp(name, "--density") == 0) {
+            config.source.edgeDensity = static_cast<float>(atof(value));
+        } else if (strcmp(name, "--pipelines") == 0) {
+            config.pipelineCount = atoi(value);
+        } else if (strcmp(name, "--fps") == 0) {
+            config.targetFps = atof(value);
+        } else if (strcmp(name, "--seconds") == 0) {
+            config.durationSeconds = atoi(value);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", name);
+            return 2;
+        }
+    }
+
+    LoadHarness harness(config);
+    LoadTestReport report = harness.run();
+    printf("%s\n", report.toString().c_str());
+    return report.framesProcessed > 0 && report.framesFailed == 0 ? 0 : 1;
+}
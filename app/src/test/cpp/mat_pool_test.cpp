@@ -0,0 +1,163 @@
+// BlockPool: system allocations drop to zero in steady state, including when
+// blocks are freed on a different thread than the one that allocated them,
+// and the host processing loop itself stops calling malloc after warm-up
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mat_allocator.h"
+#include "opencv_processor.h"
+#include "synthetic_source.h"
+#include "test_support.h"
+
+// Count every heap allocation in the process while enabled. glibc's
+// __libc_* entry points do the real work.
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* block, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* block);
+}
+
+namespace {
+    std::atomic<bool> g_counting(false);
+    std::atomic<uint64_t> g_allocations(0);
+
+    inline void count() {
+        if (g_counting.load(std::memory_order_relaxed)) {
+            g_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+extern "C" {
+    void* malloc(size_t size) { count(); return __libc_malloc(size); }
+    void* calloc(size_t count_, size_t size) { count(); return __libc_calloc(count_, size); }
+    void* realloc(void* block, size_t size) { count(); return __libc_realloc(block, size); }
+    void free(void* block) { __libc_free(block); }
+    int posix_memalign(void** block, size_t alignment, size_t size) {
+        count();
+        *block = __libc_memalign(alignment, size);
+        return *block != nullptr ? 0 : 12;  // ENOMEM
+    }
+}
+
+namespace {
+    // Allocations made by fn()
+    template <typename Fn>
+    uint64_t countAllocations(Fn fn) {
+        g_allocations.store(0);
+        g_counting.store(true);
+        fn();
+        g_counting.store(false);
+        return g_allocations.load();
+    }
+
+    // Canny-sized temporaries of a 720p frame whose width wobbles by a few pixels
+    size_t blockSize(int frame, int block) {
+        const size_t width = 1280 - (frame % 3) * 4;
+        return width * 720 * (block % 2 == 0 ? 2 : 1) + block * 64;
+    }
+
+    const int kBlocksPerFrame = 10;
+
+    // One thread allocates each frame's blocks, another frees them, as when a
+    // result allocated on a worker is released by the consumer
+    void testCrossThreadFrees() {
+        BlockPool& pool = BlockPool::instance();
+        std::mutex mutex;
+        std::condition_variable ready;
+        void* blocks[kBlocksPerFrame];
+        int produced = -1;
+        int consumed = -1;
+        bool stop = false;
+
+        std::thread consumer([&] {
+            for (;;) {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return stop || produced > consumed; });
+                if (stop && produced == consumed) {
+                    return;
+                }
+                for (int i = 0; i < kBlocksPerFrame; i++) {
+                    pool.deallocate(blocks[i], blockSize(produced, i));
+                }
+                consumed = produced;
+                ready.notify_all();
+            }
+        });
+
+        auto runFrames = [&](int first, int last) {
+            for (int frame = first; frame < last; frame++) {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return consumed == produced; });
+                for (int i = 0; i < kBlocksPerFrame; i++) {
+                    blocks[i] = pool.allocate(blockSize(frame, i));
+                }
+                produced = frame;
+                ready.notify_all();
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&] { return consumed == produced; });
+        };
+
+        runFrames(0, 10);
+        pool.resetCounters();
+        const uint64_t allocations = countAllocations([&] { runFrames(10, 60); });
+        const BlockPoolStats stats = pool.stats();
+        printf("Cross-thread frees, frames 10-59: %llu system allocations, %llu hits, %llu misses\n",
+               static_cast<unsigned long long>(allocations),
+               static_cast<unsigned long long>(stats.hits),
+               static_cast<unsigned long long>(stats.misses));
+        CHECK_EQ(allocations, 0u);
+        CHECK_EQ(stats.misses, 0u);
+        CHECK_EQ(stats.hits, 50u * kBlocksPerFrame);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        ready.notify_all();
+        consumer.join();
+        pool.releaseCached();
+        CHECK_EQ(pool.stats().cachedBytes, 0u);
+    }
+
+    // Once warmed up, the host EDGE path runs without touching the heap
+    void testProcessorSteadyState() {
+        const int width = 640;
+        const int height = 480;
+        SyntheticConfig config = {width, height, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+        SyntheticFrameSource source(config);
+        std::vector<std::vector<uint8_t>> frames(4, std::vector<uint8_t>(source.frameSize()));
+        for (size_t i = 0; i < frames.size(); i++) {
+            source.generate(static_cast<int>(i), frames[i].data());
+        }
+        std::vector<uint8_t> output(static_cast<size_t>(width) * height * 4);
+
+        OpenCVProcessor processor;
+        processor.initialize();
+        processor.setFragmentFilter(8, 4);
+        for (int i = 0; i < 8; i++) {
+            processor.processFrame(frames[i % frames.size()].data(), width, height, MODE_EDGE, output.data());
+        }
+        const uint64_t allocations = countAllocations([&] {
+            for (int i = 0; i < 20; i++) {
+                processor.processFrame(frames[i % frames.size()].data(), width, height, MODE_EDGE, output.data());
+            }
+        });
+        printf("Host EDGE frames 8-27: %llu heap allocations\n", static_cast<unsigned long long>(allocations));
+        CHECK_EQ(allocations, 0u);
+    }
+}
+
+int main() {
+    testCrossThreadFrees();
+    testProcessorSteadyState();
+    return testResult("mat_pool_test");
+}
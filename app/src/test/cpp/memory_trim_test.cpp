@@ -0,0 +1,53 @@
+// trimMemory racing frame processing: listeners run outside the budget
+// lock, so neither side can wait on the other (ctest times out otherwise)
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "native_memory.h"
+#include "opencv_processor.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 320;
+    const int kHeight = 240;
+
+    void testTrimDuringFrames() {
+        OpenCVProcessor processor;
+        CHECK(processor.initialize());
+
+        std::vector<uint8_t> rgba(static_cast<size_t>(kWidth) * kHeight * 4);
+        for (size_t i = 0; i < rgba.size(); i++) rgba[i] = static_cast<uint8_t>(i * 31);
+        std::vector<uint8_t> out(static_cast<size_t>(kWidth) * kHeight * 4);
+
+        std::atomic<bool> done(false);
+        std::atomic<int> trims(0);
+        std::thread trimmer([&] {
+            while (!done.load()) {
+                MemoryBudget::instance().trimMemory(TRIM_MEMORY_RUNNING_CRITICAL);
+                trims++;
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+            }
+        });
+
+        int failures = 0;
+        const double start = testNowMs();
+        int frames = 0;
+        while (testNowMs() - start < 1000.0 || frames < 20) {
+            ProcessingMetrics metrics = processor.processFrame(rgba.data(), kWidth, kHeight, MODE_EDGE, out.data());
+            failures += metrics.success ? 0 : 1;
+            frames++;
+        }
+        done = true;
+        trimmer.join();
+
+        CHECK_EQ(failures, 0);
+        CHECK(trims.load() > 0);
+    }
+}
+
+int main() {
+    testTrimDuringFrames();
+    return testResult("memory_trim_test");
+}
@@ -0,0 +1,177 @@
+// NV12 output: camera passthrough, RGBA and gray conversion, strided targets
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "frame_output.h"
+#include "opencv_processor.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 64;
+    const int kHeight = 48;
+    const int kYStride = 80;    // Padded target rows
+    const int kUvStride = 96;
+
+    struct Nv12Buffer {
+        std::vector<uint8_t> y;
+        std::vector<uint8_t> uv;
+        OutputTarget target;
+
+        Nv12Buffer(int width, int height)
+            : y(static_cast<size_t>(kYStride) * height, 0xEE)
+            , uv(static_cast<size_t>(kUvStride) * height / 2, 0xEE)
+        {
+            target = {y.data(), width, height, OUTPUT_FORMAT_NV12, kYStride, uv.data(), kUvStride};
+        }
+    };
+
+    // Camera planes with row padding; pixelStride 2 shares one interleaved buffer like NV21/NV12 cameras
+    struct CameraFrame {
+        std::vector<uint8_t> y;
+        std::vector<uint8_t> chroma;
+        YuvPlanes planes;
+
+        CameraFrame(int pixelStride, uint32_t seed) {
+            std::mt19937 random(seed);
+            const int yRowStride = kWidth + 16;
+            const int uvRowStride = (kWidth / 2) * pixelStride + 8;
+            y.resize(static_cast<size_t>(yRowStride) * kHeight);
+            chroma.resize(static_cast<size_t>(uvRowStride) * kHeight / 2 * (pixelStride == 2 ? 1 : 2) + 1);
+            for (uint8_t& value : y) value = static_cast<uint8_t>(random());
+            for (uint8_t& value : chroma) value = static_cast<uint8_t>(random());
+            const uint8_t* u = chroma.data();
+            const uint8_t* v = pixelStride == 2 ? u + 1 : u + static_cast<size_t>(uvRowStride) * kHeight / 2;
+            planes = {y.data(), u, v, yRowStride, uvRowStride, pixelStride};
+        }
+    };
+
+    void checkPassthrough(const CameraFrame& frame, const Nv12Buffer& out) {
+        int mismatches = 0;
+        for (int row = 0; row < kHeight; row++) {
+            for (int x = 0; x < kWidth; x++) {
+                mismatches += out.y[row * kYStride + x] != frame.planes.y[row * frame.planes.yRowStride + x];
+            }
+            // Padding past the width is left alone
+            mismatches += out.y[row * kYStride + kWidth] != 0xEE;
+        }
+        for (int row = 0; row < kHeight / 2; row++) {
+            for (int x = 0; x < kWidth / 2; x++) {
+                const size_t offset = static_cast<size_t>(row) * frame.planes.uvRowStride + x * frame.planes.uvPixelStride;
+                mismatches += out.uv[row * kUvStride + 2 * x] != frame.planes.u[offset];
+                mismatches += out.uv[row * kUvStride + 2 * x + 1] != frame.planes.v[offset];
+            }
+        }
+        CHECK_EQ(mismatches, 0);
+    }
+
+    void testPassthrough() {
+        for (int pixelStride : {1, 2}) {
+            CameraFrame frame(pixelStride, 17u + pixelStride);
+            Nv12Buffer out(kWidth, kHeight);
+            CHECK(MultiOutputWriter::writeNv12Passthrough(frame.planes, kWidth, kHeight, out.target));
+            checkPassthrough(frame, out);
+
+            // RAW camera frames take the same path through the processor
+            OpenCVProcessor processor;
+            processor.initialize();
+            Nv12Buffer viaProcessor(kWidth, kHeight);
+            ProcessingMetrics metrics = processor.processFrameYuv(frame.planes, kWidth, kHeight, MODE_RAW,
+                                                                  &viaProcessor.target, 1);
+            CHECK(metrics.success);
+            checkPassthrough(frame, viaProcessor);
+        }
+
+        // Passthrough needs a full-size target
+        CameraFrame frame(2, 5u);
+        Nv12Buffer small(kWidth / 2, kHeight / 2);
+        CHECK(!MultiOutputWriter::writeNv12Passthrough(frame.planes, kWidth, kHeight, small.target));
+    }
+
+    // RGBA frames are converted with BT.601 limited range, chroma from 2x2 means
+    void testRgbaConversion() {
+        std::mt19937 random(3);
+        std::vector<uint8_t> rgba(static_cast<size_t>(kWidth) * kHeight * 4);
+        for (uint8_t& value : rgba) value = static_cast<uint8_t>(random());
+
+        Nv12Buffer out(kWidth, kHeight);
+        MultiOutputWriter writer;
+        CHECK(writer.write(rgba.data(), kWidth, kHeight, 4, &out.target, 1));
+
+        auto channel = [&](int x, int y, int c) { return static_cast<double>(rgba[(y * kWidth + x) * 4 + c]); };
+        int worstY = 0;
+        int worstUv = 0;
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                const double expected = 16.0 + (65.738 * channel(x, y, 0) + 129.057 * channel(x, y, 1) +
+                                                 25.064 * channel(x, y, 2)) / 256.0;
+                worstY = std::max(worstY, std::abs(out.y[y * kYStride + x] - static_cast<int>(std::lround(expected))));
+            }
+        }
+        for (int y = 0; y < kHeight / 2; y++) {
+            for (int x = 0; x < kWidth / 2; x++) {
+                double r = 0, g = 0, b = 0;
+                for (int dy = 0; dy < 2; dy++) {
+                    for (int dx = 0; dx < 2; dx++) {
+                        r += channel(2 * x + dx, 2 * y + dy, 0) / 4;
+                        g += channel(2 * x + dx, 2 * y + dy, 1) / 4;
+                        b += channel(2 * x + dx, 2 * y + dy, 2) / 4;
+                    }
+                }
+                const double u = 128.0 + (-37.945 * r - 74.494 * g + 112.439 * b) / 256.0;
+                const double v = 128.0 + (112.439 * r - 94.154 * g - 18.285 * b) / 256.0;
+                worstUv = std::max(worstUv, std::abs(out.uv[y * kUvStride + 2 * x] - static_cast<int>(std::lround(u))));
+                worstUv = std::max(worstUv, std::abs(out.uv[y * kUvStride + 2 * x + 1] - static_cast<int>(std::lround(v))));
+            }
+        }
+        CHECK(worstY <= 1);
+        CHECK(worstUv <= 1);
+    }
+
+    // Gray results keep their values in Y and carry neutral chroma
+    void testGrayPlane() {
+        std::vector<uint8_t> gray(static_cast<size_t>(kWidth) * kHeight);
+        for (size_t i = 0; i < gray.size(); i++) gray[i] = static_cast<uint8_t>(i * 7);
+
+        Nv12Buffer out(kWidth, kHeight);
+        MultiOutputWriter writer;
+        CHECK(writer.write(gray.data(), kWidth, kHeight, 1, &out.target, 1));
+        int mismatches = 0;
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                mismatches += out.y[y * kYStride + x] != gray[y * kWidth + x];
+            }
+        }
+        for (int y = 0; y < kHeight / 2; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                mismatches += out.uv[y * kUvStride + x] != 128;
+            }
+        }
+        CHECK_EQ(mismatches, 0);
+    }
+
+    // Odd sizes and short UV strides are rejected before anything is written
+    void testInvalidTargets() {
+        std::vector<uint8_t> gray(static_cast<size_t>(kWidth) * kHeight, 10);
+        Nv12Buffer odd(kWidth - 1, kHeight - 1);
+        MultiOutputWriter writer;
+        CHECK(!writer.write(gray.data(), kWidth, kHeight, 1, &odd.target, 1));
+
+        Nv12Buffer narrow(kWidth, kHeight);
+        narrow.target.uvStride = kWidth - 2;
+        CHECK(!writer.write(gray.data(), kWidth, kHeight, 1, &narrow.target, 1));
+
+        Nv12Buffer noChroma(kWidth, kHeight);
+        noChroma.target.uvData = nullptr;
+        CHECK(!writer.write(gray.data(), kWidth, kHeight, 1, &noChroma.target, 1));
+    }
+}
+
+int main() {
+    testPassthrough();
+    testRgbaConversion();
+    testGrayPlane();
+    testInvalidTargets();
+    return testResult("nv12_output_test");
+}
@@ -0,0 +1,176 @@
+// OutputSubscriptions: a 30 fps source feeding 15 and 5 fps consumers
+// delivers evenly spaced frames (also with timestamp jitter), a failed frame
+// leaves its consumers due for the next one instead of costing them a
+// period, and fitSize keeps the aspect ratio with even NV12 sizes
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "output_policy.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 1280;
+    const int kHeight = 720;
+    const int64_t kSourcePeriodUs = 33333;
+
+    struct Consumed {
+        int id;
+        std::vector<int64_t> timestamps;
+    };
+
+    // Run one source frame; record what each consumer received
+    void runFrame(OutputSubscriptions& subscriptions, int64_t timestampUs, bool success,
+                  std::vector<Consumed>& consumers) {
+        std::vector<OutputTarget> targets;
+        const int count = subscriptions.prepare(timestampUs, kWidth, kHeight, targets);
+        for (int i = 0; i < count; i++) {
+            // Stand-in for processFrame: fill the Y/gray plane
+            for (int y = 0; y < targets[i].height; y++) {
+                const int bytes = targets[i].width * MultiOutputWriter::bytesPerPixel(targets[i].format);
+                std::fill(targets[i].data + static_cast<size_t>(y) * bytes,
+                          targets[i].data + static_cast<size_t>(y + 1) * bytes, static_cast<uint8_t>(i + 1));
+            }
+        }
+        subscriptions.commit(success);
+
+        for (Consumed& consumer : consumers) {
+            ConsumerFrameInfo info = {};
+            CHECK(subscriptions.readLatest(consumer.id, nullptr, 0, info));
+            if (info.sequence > consumer.timestamps.size()) {
+                consumer.timestamps.push_back(info.timestampUs);
+            }
+        }
+    }
+
+    // Every delivered interval within jitter of the consumer period
+    void checkEvenSpacing(const Consumed& consumer, int64_t periodUs, int64_t toleranceUs) {
+        for (size_t i = 1; i < consumer.timestamps.size(); i++) {
+            const int64_t interval = consumer.timestamps[i] - consumer.timestamps[i - 1];
+            if (std::llabs(interval - periodUs) > toleranceUs) {
+                fprintf(stderr, "consumer %d: interval %lld us at frame %zu, expected %lld\n", consumer.id,
+                        static_cast<long long>(interval), i, static_cast<long long>(periodUs));
+            }
+            CHECK(std::llabs(interval - periodUs) <= toleranceUs);
+        }
+    }
+
+    void testDecimation(int64_t jitterUs) {
+        OutputSubscriptions subscriptions;
+        std::vector<Consumed> consumers = {
+            {subscriptions.addConsumer({15.0, 640, 360, OUTPUT_FORMAT_GRAY}), {}},
+            {subscriptions.addConsumer({5.0, 320, 180, OUTPUT_FORMAT_NV12}), {}},
+            {subscriptions.addConsumer({0.0, 0, 0, OUTPUT_FORMAT_RGBA}), {}}
+        };
+
+        const int frames = 90;
+        srand(7);
+        for (int i = 0; i < frames; i++) {
+            const int64_t jitter = jitterUs > 0 ? rand() % (2 * jitterUs + 1) - jitterUs : 0;
+            runFrame(subscriptions, 1000000 + i * kSourcePeriodUs + jitter, true, consumers);
+        }
+
+        printf("jitter %lld us: 15 fps took %zu, 5 fps took %zu, every frame took %zu of %d\n",
+               static_cast<long long>(jitterUs), consumers[0].timestamps.size(),
+               consumers[1].timestamps.size(), consumers[2].timestamps.size(), frames);
+        CHECK_EQ(consumers[0].timestamps.size(), frames / 2);
+        CHECK_EQ(consumers[1].timestamps.size(), frames / 6);
+        CHECK_EQ(consumers[2].timestamps.size(), frames);
+        checkEvenSpacing(consumers[0], 2 * kSourcePeriodUs, 2 * jitterUs + 1);
+        checkEvenSpacing(consumers[1], 6 * kSourcePeriodUs, 2 * jitterUs + 1);
+
+        ConsumerFrameInfo info = {};
+        CHECK(subscriptions.readLatest(consumers[1].id, nullptr, 0, info));
+        CHECK_EQ(info.width, 320);
+        CHECK_EQ(info.height, 180);
+        CHECK_EQ(info.size, 320 * 180 * 3 / 2);
+        std::vector<uint8_t> small(info.size - 1);
+        CHECK(!subscriptions.readLatest(consumers[1].id, small.data(), small.size(), info));
+    }
+
+    void testFailedFrameKeepsConsumerDue() {
+        OutputSubscriptions subscriptions;
+        std::vector<Consumed> consumers = {{subscriptions.addConsumer({5.0, 0, 0, OUTPUT_FORMAT_GRAY}), {}}};
+
+        // Frames 0, 6 and 12 are due; frame 6 fails, so frame 7 takes its
+        // place and the schedule carries on at frame 12
+        for (int i = 0; i < 13; i++) {
+            runFrame(subscriptions, 1000000 + i * kSourcePeriodUs, i != 6, consumers);
+        }
+        const std::vector<int64_t>& taken = consumers[0].timestamps;
+        CHECK_EQ(taken.size(), 3);
+        if (taken.size() == 3) {
+            CHECK_EQ(taken[0], 1000000);
+            CHECK_EQ(taken[1], 1000000 + 7 * kSourcePeriodUs);
+            CHECK_EQ(taken[2], 1000000 + 12 * kSourcePeriodUs);
+        }
+
+        // The same holds for the very first frame
+        OutputSubscriptions fresh;
+        std::vector<Consumed> first = {{fresh.addConsumer({5.0, 0, 0, OUTPUT_FORMAT_GRAY}), {}}};
+        runFrame(fresh, 1000000, false, first);
+        runFrame(fresh, 1000000 + kSourcePeriodUs, true, first);
+        CHECK_EQ(first[0].timestamps.size(), 1);
+    }
+
+    void testFitSize() {
+        const int sources[][2] = {{1280, 720}, {1920, 1080}, {641, 479}, {1001, 3}, {3, 1001}};
+        const int bounds[][2] = {{0, 0}, {640, 0}, {0, 240}, {333, 333}, {101, 57}, {1, 1}};
+        for (const auto& source : sources) {
+            for (const auto& bound : bounds) {
+                for (int format = OUTPUT_FORMAT_RGBA; format <= OUTPUT_FORMAT_NV12; format++) {
+                    const ConsumerPolicy policy = {0.0, bound[0], bound[1], format};
+                    int width = 0;
+                    int height = 0;
+                    OutputSubscriptions::fitSize(policy, source[0], source[1], width, height);
+
+                    const int minSize = format == OUTPUT_FORMAT_NV12 ? 2 : 1;
+                    CHECK(width >= minSize && height >= minSize);
+                    CHECK(width <= source[0] && height <= source[1]);
+                    if (bound[0] >= minSize) {
+                        CHECK(width <= bound[0]);
+                    }
+                    if (bound[1] >= minSize) {
+                        CHECK(height <= bound[1]);
+                    }
+                    if (format == OUTPUT_FORMAT_NV12) {
+                        CHECK_EQ(width % 2, 0);
+                        CHECK_EQ(height % 2, 0);
+                    }
+
+                    // Aspect ratio within the rounding of the shorter side (plus evening for NV12)
+                    if (width > minSize && height > minSize) {
+                        const double slack = format == OUTPUT_FORMAT_NV12 ? 2.0 : 1.0;
+                        const double expectedHeight = static_cast<double>(width) * source[1] / source[0];
+                        const double expectedWidth = static_cast<double>(height) * source[0] / source[1];
+                        const bool keeps = (expectedHeight - height <= slack + 1e-9 && height - expectedHeight <= slack + 1e-9) ||
+                                           (expectedWidth - width <= slack + 1e-9 && width - expectedWidth <= slack + 1e-9);
+                        if (!keeps) {
+                            fprintf(stderr, "%dx%d in %dx%d format %d -> %dx%d\n",
+                                    source[0], source[1], bound[0], bound[1], format, width, height);
+                        }
+                        CHECK(keeps);
+                    }
+                }
+            }
+        }
+
+        int width = 0;
+        int height = 0;
+        OutputSubscriptions::fitSize({0.0, 641, 0, OUTPUT_FORMAT_NV12}, 1280, 720, width, height);
+        CHECK_EQ(width, 640);
+        CHECK_EQ(height, 360);
+        OutputSubscriptions::fitSize({0.0, 0, 0, OUTPUT_FORMAT_GRAY}, 641, 479, width, height);
+        CHECK_EQ(width, 641);
+        CHECK_EQ(height, 479);
+    }
+}
+
+int main() {
+    testDecimation(0);
+    testDecimation(3000);
+    testFailedFrameKeepsConsumerDue();
+    testFitSize();
+    return testResult("output_policy_test");
+}
@@ -0,0 +1,148 @@
+// PerceptualHash: stable under exposure and resolution changes, sensitive to
+// moved content, single-linkage clustering; the processor publishes a frame's
+// hash only when the frame succeeds
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "opencv_processor.h"
+#include "perceptual_hash.h"
+#include "synthetic_source.h"
+#include "test_support.h"
+
+namespace {
+    const int kSceneWidth = 400;
+    const int kSceneHeight = 300;
+    const int kWidth = 320;
+    const int kHeight = 240;
+
+    std::vector<uint8_t> scene() {
+        SyntheticConfig config = {kSceneWidth, kSceneHeight, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+        SyntheticFrameSource source(config);
+        std::vector<uint8_t> rgba(source.frameSize());
+        source.generate(4, rgba.data());
+        std::vector<uint8_t> gray(static_cast<size_t>(kSceneWidth) * kSceneHeight);
+        for (size_t i = 0; i < gray.size(); i++) {
+            gray[i] = rgba[i * 4];
+        }
+        return gray;
+    }
+
+    EdgeHash hashWindow(const std::vector<uint8_t>& gray, int x0, int y0) {
+        EdgeHash hash;
+        CHECK(PerceptualHash::compute(gray.data() + y0 * kSceneWidth + x0, kWidth, kHeight, kSceneWidth, hash));
+        return hash;
+    }
+
+    void testDistances() {
+        const std::vector<uint8_t> gray = scene();
+        const EdgeHash reference = hashWindow(gray, 20, 20);
+        CHECK_EQ(PerceptualHash::distance(reference, hashWindow(gray, 20, 20)), 0);
+
+        // Brighter exposure
+        std::vector<uint8_t> brighter(gray.size());
+        std::transform(gray.begin(), gray.end(), brighter.begin(),
+                       [](uint8_t value) { return static_cast<uint8_t>(std::min(255, value + 12)); });
+        const int exposure = PerceptualHash::distance(reference, hashWindow(brighter, 20, 20));
+        CHECK(exposure < EDGE_HASH_DUPLICATE_DISTANCE);
+
+        // Same window at half resolution
+        std::vector<uint8_t> half(static_cast<size_t>(kWidth / 2) * (kHeight / 2));
+        for (int y = 0; y < kHeight / 2; y++) {
+            for (int x = 0; x < kWidth / 2; x++) {
+                const uint8_t* p = gray.data() + (20 + y * 2) * kSceneWidth + 20 + x * 2;
+                half[y * (kWidth / 2) + x] = static_cast<uint8_t>((p[0] + p[1] + p[kSceneWidth] + p[kSceneWidth + 1] + 2) / 4);
+            }
+        }
+        EdgeHash halfHash;
+        CHECK(PerceptualHash::compute(half.data(), kWidth / 2, kHeight / 2, 0, halfHash));
+        const int resized = PerceptualHash::distance(reference, halfHash);
+        CHECK(resized < EDGE_HASH_DUPLICATE_DISTANCE);
+
+        // Content moved by a cell and a half
+        const int shifted = PerceptualHash::distance(reference, hashWindow(gray, 80, 60));
+        CHECK(shifted > 3 * EDGE_HASH_DUPLICATE_DISTANCE);
+
+        // Too small for the grid
+        EdgeHash tiny;
+        CHECK(!PerceptualHash::compute(gray.data(), EDGE_HASH_GRID, EDGE_HASH_GRID, 0, tiny));
+        printf("Hamming distance: exposure %d, half resolution %d, shifted %d bits\n", exposure, resized, shifted);
+    }
+
+    EdgeHash flipped(const EdgeHash& hash, int first, int count) {
+        EdgeHash result = hash;
+        for (int bit = first; bit < first + count; bit++) {
+            result.words[bit / 64] ^= uint64_t(1) << (bit % 64);
+        }
+        return result;
+    }
+
+    // a-b and b-c are close, a-c is not: single linkage still joins all three
+    void testCluster() {
+        const EdgeHash a = {{0x0123456789ABCDEFull, 0xFEDCBA9876543210ull}};
+        const EdgeHash b = flipped(a, 0, 10);
+        const EdgeHash c = flipped(b, 10, 10);
+        const EdgeHash far = flipped(a, 40, 60);
+        CHECK(PerceptualHash::distance(a, c) > EDGE_HASH_DUPLICATE_DISTANCE);
+
+        const std::vector<EdgeHash> hashes = {far, c, a, flipped(far, 100, 3), b};
+        std::vector<int> clusterOf;
+        CHECK_EQ(PerceptualHash::cluster(hashes, EDGE_HASH_DUPLICATE_DISTANCE, clusterOf), 2);
+        const std::vector<int> expected = {0, 1, 1, 0, 1};
+        CHECK(clusterOf == expected);
+        int firsts = 0;
+        for (size_t i = 0; i < clusterOf.size(); i++) {
+            firsts += clusterOf[i] == static_cast<int>(i) ? 1 : 0;
+        }
+        CHECK_EQ(firsts, 2);
+
+        CHECK_EQ(PerceptualHash::cluster({}, EDGE_HASH_DUPLICATE_DISTANCE, clusterOf), 0);
+        CHECK(clusterOf.empty());
+    }
+
+    // A failed or abandoned frame leaves no hash behind
+    void testProcessorPublishes() {
+        const std::vector<uint8_t> gray = scene();
+        std::vector<uint8_t> window(static_cast<size_t>(kWidth) * kHeight);
+        for (int y = 0; y < kHeight; y++) {
+            std::copy_n(gray.data() + (20 + y) * kSceneWidth + 20, kWidth, window.data() + y * kWidth);
+        }
+        std::vector<uint8_t> output(window.size());
+        OutputTarget target = {output.data(), kWidth, kHeight, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+
+        OpenCVProcessor processor;
+        processor.initialize();
+        processor.setEdgeHashEnabled(true);
+        EdgeHash hash;
+        CHECK(processor.processGrayFrame(window.data(), kWidth, kHeight, MODE_EDGE, &target, 1).success);
+        CHECK(processor.getEdgeHash(hash));
+        CHECK(hash == hashWindow(gray, 20, 20));
+
+        // Frames abandoned after hashing (in the blur or later) publish nothing
+        processor.setBlurSigma(6.0f);
+        processor.setFragmentFilter(20, 8);
+        int lateAbandoned = 0;
+        for (int64_t budget = 0; budget < 20 && lateAbandoned < 3; budget++) {
+            CHECK(processor.processGrayFrame(window.data(), kWidth, kHeight, MODE_EDGE, &target, 1).success);
+            CHECK(processor.getEdgeHash(hash));
+            const ProcessingMetrics metrics = processor.processGrayFrame(
+                window.data(), kWidth, kHeight, MODE_EDGE, &target, 1, FrameDeadline::nowMs() + budget / 4);
+            if (metrics.abandoned && metrics.abandonedStage > STAGE_INPUT) {
+                CHECK(!processor.getEdgeHash(hash));
+                lateAbandoned++;
+            }
+        }
+        CHECK(lateAbandoned > 0);
+        CHECK(!processor.processGrayFrame(window.data(), kWidth, kHeight, MODE_EDGE, &target, 1, 1).success);
+        CHECK(!processor.getEdgeHash(hash));
+        CHECK(processor.processGrayFrame(window.data(), kWidth, kHeight, MODE_EDGE, &target, 1).success);
+        CHECK(processor.getEdgeHash(hash));
+    }
+}
+
+int main() {
+    testDistances();
+    testCluster();
+    testProcessorPublishes();
+    return testResult("perceptual_hash_test");
+}
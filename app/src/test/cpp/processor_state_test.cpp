@@ -0,0 +1,151 @@
+// saveState/restoreState: every setting survives the round trip, malformed
+// blobs leave the processor untouched, restored first-frame timing
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "opencv_processor.h"
+#include "synthetic_source.h"
+#include "test_support.h"
+
+namespace {
+    const int kWidth = 640;
+    const int kHeight = 480;
+
+    struct Frames {
+        std::vector<uint8_t> rgba;
+        std::vector<uint8_t> y;
+        std::vector<uint8_t> uv;
+        YuvPlanes planes;
+
+        Frames() {
+            SyntheticConfig config = {kWidth, kHeight, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+            SyntheticFrameSource source(config);
+            rgba.resize(source.frameSize());
+            source.generate(7, rgba.data());
+
+            std::mt19937 random(11);
+            y.resize(static_cast<size_t>(kWidth) * kHeight);
+            uv.resize(static_cast<size_t>(kWidth) * kHeight / 2 + 1);
+            for (size_t i = 0; i < y.size(); i++) y[i] = rgba[i * 4];
+            for (uint8_t& value : uv) value = static_cast<uint8_t>(120 + random() % 16);
+            planes = {y.data(), uv.data(), uv.data() + 1, kWidth, kWidth, 2};
+        }
+    };
+
+    void configure(OpenCVProcessor& processor) {
+        processor.initialize();
+        processor.setCannyThresholds(40.0, 120.0);
+        processor.setBlurSigma(3.0f);
+        processor.setSubpixelEdgesEnabled(true);
+        processor.setFragmentFilter(10, 5);
+        processor.setDistanceOptions(DISTANCE_CITY_BLOCK, true);
+        processor.setAdaptiveThresholds(true, 48);
+        processor.setEdgeHashEnabled(true);
+        const LensCalibration lens = {kWidth, kHeight, 520.0, 515.0, 322.0, 238.0, -0.21, 0.06, 0.001, -0.002, 0.0};
+        processor.setLensCalibration(&lens);
+    }
+
+    // Outputs of one RGBA EDGE frame and one YUV EDGE frame (the latter undistorted)
+    std::vector<uint8_t> outputs(OpenCVProcessor& processor, const Frames& frames) {
+        std::vector<uint8_t> result(static_cast<size_t>(kWidth) * kHeight * 5);
+        CHECK(processor.processFrame(frames.rgba.data(), kWidth, kHeight, MODE_EDGE, result.data()).success);
+        OutputTarget gray = {result.data() + static_cast<size_t>(kWidth) * kHeight * 4, kWidth, kHeight,
+                             OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+        CHECK(processor.processFrameYuv(frames.planes, kWidth, kHeight, MODE_EDGE, &gray, 1).success);
+        return result;
+    }
+
+    void testRoundTrip() {
+        Frames frames;
+        OpenCVProcessor original;
+        configure(original);
+        const std::vector<uint8_t> expected = outputs(original, frames);
+        std::vector<uint8_t> blob;
+        original.saveState(blob);
+
+        OpenCVProcessor restored;
+        CHECK(restored.restoreState(blob.data(), blob.size()));
+        CHECK_EQ(restored.configurationHash(), original.configurationHash());
+        CHECK(restored.getAdaptiveThresholds().isEnabled());
+        CHECK_EQ(restored.getAdaptiveThresholds().tileSize(), 48);
+
+        // A restored processor snapshots to the same blob before any frame
+        std::vector<uint8_t> again;
+        restored.saveState(again);
+        CHECK(again == blob);
+
+        CHECK(outputs(restored, frames) == expected);
+        EdgeHash hash;
+        CHECK(restored.getEdgeHash(hash));
+    }
+
+    void testMalformedBlobs() {
+        OpenCVProcessor original;
+        configure(original);
+        std::vector<uint8_t> blob;
+        original.saveState(blob);
+
+        OpenCVProcessor target;
+        target.initialize();
+        const uint64_t before = target.configurationHash();
+
+        CHECK(!target.restoreState(blob.data(), blob.size() - 1));
+        std::vector<uint8_t> oldVersion = blob;
+        oldVersion[3] = '1';
+        CHECK(!target.restoreState(oldVersion.data(), oldVersion.size()));
+        std::vector<uint8_t> badAperture = blob;
+        const int32_t aperture = 4;
+        std::memcpy(badAperture.data() + 4 + 4 + 4 + 8 + 8, &aperture, sizeof(aperture));
+        CHECK(!target.restoreState(badAperture.data(), badAperture.size()));
+        CHECK_EQ(target.configurationHash(), before);
+
+        // An unknown implementation restores everything else on the automatic path
+        std::vector<uint8_t> unknown = blob;
+        const int32_t implementation = 99;
+        std::memcpy(unknown.data() + 8, &implementation, sizeof(implementation));
+        CHECK(target.restoreState(unknown.data(), unknown.size()));
+        std::vector<uint8_t> saved;
+        target.saveState(saved);
+        int32_t restoredImplementation = -1;
+        std::memcpy(&restoredImplementation, saved.data() + 8, sizeof(restoredImplementation));
+        CHECK_EQ(restoredImplementation, IMPL_AUTO);
+        Frames frames;
+        std::vector<uint8_t> result(static_cast<size_t>(kWidth) * kHeight * 4);
+        CHECK(target.processFrame(frames.rgba.data(), kWidth, kHeight, MODE_EDGE, result.data()).success);
+    }
+
+    // First frame after creation, cold versus restored
+    void reportFirstFrame() {
+        Frames frames;
+        std::vector<uint8_t> blob;
+        {
+            OpenCVProcessor warm;
+            configure(warm);
+            outputs(warm, frames);
+            warm.saveState(blob);
+        }
+        std::vector<uint8_t> result(static_cast<size_t>(kWidth) * kHeight * 4);
+
+        OpenCVProcessor cold;
+        configure(cold);
+        double start = testNowMs();
+        cold.processFrame(frames.rgba.data(), kWidth, kHeight, MODE_EDGE, result.data());
+        const double coldMs = testNowMs() - start;
+
+        OpenCVProcessor restored;
+        CHECK(restored.restoreState(blob.data(), blob.size()));
+        start = testNowMs();
+        restored.processFrame(frames.rgba.data(), kWidth, kHeight, MODE_EDGE, result.data());
+        const double restoredMs = testNowMs() - start;
+        printf("First 640x480 EDGE frame: cold %.2f ms, restored %.2f ms\n", coldMs, restoredMs);
+    }
+}
+
+int main() {
+    testRoundTrip();
+    testMalformedBlobs();
+    reportFirstFrame();
+    return testResult("processor_state_test");
+}
@@ -0,0 +1,255 @@
+// ResultCache: round trip across reopen, LRU eviction with compaction,
+// damaged and torn records, lookups while another thread compacts, and the
+// processor side outputs that keep results out of the cache
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "opencv_processor.h"
+#include "result_cache.h"
+#include "test_support.h"
+
+namespace {
+    const int kSize = 64;
+
+    // Noise frame (barely compressible), gray or colour
+    std::vector<uint8_t> frame(uint32_t seed, bool gray) {
+        std::mt19937 random(seed);
+        std::vector<uint8_t> rgba(static_cast<size_t>(kSize) * kSize * 4);
+        for (size_t i = 0; i < rgba.size(); i += 4) {
+            const uint8_t value = static_cast<uint8_t>(random());
+            rgba[i] = value;
+            rgba[i + 1] = gray ? value : static_cast<uint8_t>(random());
+            rgba[i + 2] = gray ? value : static_cast<uint8_t>(random());
+            rgba[i + 3] = gray ? 255 : static_cast<uint8_t>(random());
+        }
+        return rgba;
+    }
+
+    ResultCacheKey keyFor(uint32_t index) {
+        return {0xC0FFEE00ull + index, 42};
+    }
+
+    bool matches(ResultCache& cache, uint32_t index, const std::vector<uint8_t>& expected) {
+        int width = 0;
+        int height = 0;
+        TrackedBytes rgba;
+        return cache.lookup(keyFor(index), width, height, rgba) && width == kSize && height == kSize &&
+               std::equal(expected.begin(), expected.end(), rgba.begin());
+    }
+
+    struct TempDirectory {
+        std::string path;
+
+        TempDirectory() {
+            char pattern[] = "/tmp/result_cache_testXXXXXX";
+            path = mkdtemp(pattern);
+        }
+
+        ~TempDirectory() {
+            for (const char* name : {"/results.pack", "/results.idx", "/results.pack.tmp", "/results.idx.tmp"}) {
+                unlink((path + name).c_str());
+            }
+            rmdir(path.c_str());
+        }
+
+        std::string pack() const { return path + "/results.pack"; }
+    };
+
+    void testRoundTrip() {
+        TempDirectory directory;
+        const std::vector<uint8_t> gray = frame(1, true);
+        const std::vector<uint8_t> colour = frame(2, false);
+        {
+            ResultCache cache;
+            CHECK(cache.open(directory.path, 1 << 20));
+            CHECK(cache.store(keyFor(1), gray.data(), kSize, kSize));
+            CHECK(cache.store(keyFor(2), colour.data(), kSize, kSize));
+            CHECK(matches(cache, 1, gray));
+            CHECK(matches(cache, 2, colour));
+            CHECK(!matches(cache, 3, gray));
+            // Gray results keep one plane
+            CHECK(cache.stats().packBytes < colour.size() + gray.size() / 2);
+        }
+
+        // The index written on close restores both entries
+        ResultCache cache;
+        CHECK(cache.open(directory.path, 1 << 20));
+        CHECK_EQ(cache.stats().entries, 2u);
+        CHECK(matches(cache, 1, gray));
+        CHECK(matches(cache, 2, colour));
+    }
+
+    // Untouched entries go first; the compacted pack survives a reopen
+    void testEviction() {
+        TempDirectory directory;
+        std::vector<std::vector<uint8_t>> frames;
+        for (uint32_t i = 0; i < 12; i++) {
+            frames.push_back(frame(100 + i, false));
+        }
+        uint64_t recordBytes;
+        {
+            ResultCache probe;
+            CHECK(probe.open(directory.path, 1 << 20));
+            CHECK(probe.store(keyFor(0), frames[0].data(), kSize, kSize));
+            recordBytes = probe.stats().packBytes;
+            probe.clear();
+        }
+
+        const uint64_t capacity = recordBytes * 8 + recordBytes / 2;
+        {
+            ResultCache cache;
+            CHECK(cache.open(directory.path, capacity));
+            for (uint32_t i = 0; i < 8; i++) {
+                CHECK(cache.store(keyFor(i), frames[i].data(), kSize, kSize));
+            }
+            CHECK(matches(cache, 0, frames[0]));
+            CHECK_EQ(cache.stats().compactions, 0u);
+
+            CHECK(cache.store(keyFor(8), frames[8].data(), kSize, kSize));
+            const ResultCacheStats stats = cache.stats();
+            CHECK_EQ(stats.compactions, 1u);
+            CHECK(stats.evictions >= 2u);
+            CHECK(stats.packBytes <= static_cast<uint64_t>(capacity * RESULT_CACHE_LOW_WATER));
+            CHECK_EQ(stats.packBytes, stats.liveBytes);
+            CHECK(matches(cache, 0, frames[0]));
+            CHECK(!matches(cache, 1, frames[1]));
+            CHECK(matches(cache, 8, frames[8]));
+        }
+
+        ResultCache cache;
+        CHECK(cache.open(directory.path, capacity));
+        CHECK(matches(cache, 0, frames[0]));
+        CHECK(matches(cache, 8, frames[8]));
+        CHECK(!matches(cache, 1, frames[1]));
+    }
+
+    // A flipped payload byte drops the record; a torn append is cut off
+    void testCorruption() {
+        TempDirectory directory;
+        const std::vector<uint8_t> first = frame(7, false);
+        const std::vector<uint8_t> second = frame(8, true);
+        uint64_t firstBytes;
+        uint64_t packBytes;
+        {
+            ResultCache cache;
+            CHECK(cache.open(directory.path, 1 << 20));
+            CHECK(cache.store(keyFor(1), first.data(), kSize, kSize));
+            firstBytes = cache.stats().packBytes;
+            CHECK(cache.store(keyFor(2), second.data(), kSize, kSize));
+            packBytes = cache.stats().packBytes;
+        }
+
+        FILE* pack = fopen(directory.pack().c_str(), "r+b");
+        CHECK(pack != nullptr);
+        if (pack == nullptr) {
+            return;
+        }
+        fseek(pack, static_cast<long>(firstBytes / 2), SEEK_SET);
+        const int byte = fgetc(pack);
+        fseek(pack, static_cast<long>(firstBytes / 2), SEEK_SET);
+        fputc(byte ^ 0x5A, pack);
+        // Half a record header past the end, as after a crash mid-append
+        fseek(pack, 0, SEEK_END);
+        fwrite("ERC1\x10\x00\x00\x00", 1, 8, pack);
+        fclose(pack);
+        unlink((directory.path + "/results.idx").c_str());
+
+        ResultCache cache;
+        CHECK(cache.open(directory.path, 1 << 20));
+        CHECK_EQ(cache.stats().entries, 2u);
+        CHECK(!matches(cache, 1, first));
+        CHECK(matches(cache, 2, second));
+        const ResultCacheStats stats = cache.stats();
+        CHECK_EQ(stats.corrupt, 1u);
+        CHECK_EQ(stats.entries, 1u);
+        CHECK_EQ(stats.packBytes, packBytes);
+    }
+
+    // Side outputs bypass the cache; a counted hit is the last frame
+    void testSideOutputs() {
+        OpenCVProcessor processor;
+        processor.initialize();
+        CHECK(!processor.hasFrameSideOutputs(MODE_EDGE));
+        processor.setSubpixelEdgesEnabled(true);
+        CHECK(processor.hasFrameSideOutputs(MODE_EDGE));
+        CHECK(processor.hasFrameSideOutputs(MODE_DISTANCE));
+        CHECK(!processor.hasFrameSideOutputs(MODE_GRAYSCALE));
+        processor.setSubpixelEdgesEnabled(false);
+        processor.setDistanceOptions(DISTANCE_EUCLIDEAN, true);
+        CHECK(processor.hasFrameSideOutputs(MODE_DISTANCE));
+        CHECK(!processor.hasFrameSideOutputs(MODE_EDGE));
+        processor.setDistanceOptions(DISTANCE_EUCLIDEAN, false);
+
+        const std::vector<uint8_t> rgba = frame(3, true);
+        std::vector<uint8_t> output(rgba.size());
+        processor.setEdgeHashEnabled(true);
+        CHECK(processor.hasFrameSideOutputs(MODE_GRAYSCALE));
+        CHECK(processor.processFrame(rgba.data(), kSize, kSize, MODE_EDGE, output.data()).success);
+        EdgeHash hash;
+        CHECK(processor.getEdgeHash(hash));
+        processor.recordCachedFrame({1, kSize, kSize, MODE_EDGE, true, false, 0});
+        CHECK(!processor.getEdgeHash(hash));
+        CHECK(processor.getStatistics().find("Frames: 2 (cached 1)") != std::string::npos);
+    }
+
+    // Lookups keep being served while a store compacts a large pack
+    void reportLookupsDuringCompaction() {
+        TempDirectory directory;
+        const int size = 512;
+        std::vector<uint8_t> rgba(static_cast<size_t>(size) * size * 4);
+        std::mt19937 random(9);
+        for (uint8_t& value : rgba) {
+            value = static_cast<uint8_t>(random());
+        }
+        ResultCache cache;
+        CHECK(cache.open(directory.path, 64ull << 20));
+        uint32_t stored = 0;
+        while (cache.stats().packBytes + rgba.size() + 64 <= (64ull << 20)) {
+            CHECK(cache.store(keyFor(stored), rgba.data(), size, size));
+            stored++;
+        }
+
+        std::atomic<bool> done(false);
+        double worst = 0.0;
+        int lookups = 0;
+        int failures = 0;
+        std::thread reader([&] {
+            TrackedBytes result;
+            while (!done.load()) {
+                int width = 0;
+                int height = 0;
+                const double start = testNowMs();
+                // The newest entry survives eviction
+                failures += cache.lookup(keyFor(stored - 1), width, height, result) ? 0 : 1;
+                worst = std::max(worst, testNowMs() - start);
+                lookups++;
+            }
+        });
+        const double start = testNowMs();
+        CHECK(cache.store(keyFor(stored), rgba.data(), size, size));
+        const double storeMs = testNowMs() - start;
+        done.store(true);
+        reader.join();
+
+        CHECK_EQ(cache.stats().compactions, 1u);
+        CHECK_EQ(failures, 0);
+        printf("Compacting %u records (%.1f MB): store %.1f ms, %d lookups meanwhile, worst %.1f ms\n",
+               stored, (64ull << 20) / (1024.0 * 1024.0), storeMs, lookups, worst);
+    }
+}
+
+int main() {
+    testRoundTrip();
+    testEviction();
+    testCorruption();
+    testSideOutputs();
+    reportLookupsDuringCompaction();
+    return testResult("result_cache_test");
+}
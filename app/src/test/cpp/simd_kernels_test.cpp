@@ -0,0 +1,74 @@
+// SimdKernels: the vectorized set matches the scalar reference bit for bit
+// at sizes that leave scalar tails (a real comparison in builds with a SIMD
+// backend), and the output writer and bit mask use the kernel set they are
+// given rather than always the vectorized one
+
+#include <cstdio>
+#include <vector>
+#include "bit_mask.h"
+#include "frame_output.h"
+#include "simd_kernels.h"
+#include "test_support.h"
+
+namespace {
+    // Marks every converted pixel so the kernel in use is visible in the output
+    void markedGray(const uint8_t* /* rgba */, int width, int height, uint8_t* gray) {
+        for (int i = 0; i < width * height; i++) {
+            gray[i] = 7;
+        }
+    }
+
+    void markedPack(const uint8_t* /* mask */, size_t count, uint8_t* bits) {
+        for (size_t i = 0; i < (count + 7) / 8; i++) {
+            bits[i] = 0xFF;
+        }
+    }
+
+    void testSelfTest() {
+        printf("backend %s, %d lanes, vectorized %s\n",
+               SimdKernels::backend(), SimdKernels::lanes(), SimdKernels::isVectorized() ? "yes" : "no");
+        const int sizes[][2] = {{2, 2}, {3, 5}, {15, 3}, {17, 9}, {33, 7}, {63, 31}, {65, 33}, {321, 241}};
+        for (const auto& size : sizes) {
+            for (uint32_t seed = 1; seed <= 3; seed++) {
+                const int failures = SimdKernels::selfTest(size[0], size[1], seed * 0x9E3779B9u);
+                if (failures != 0) {
+                    fprintf(stderr, "%dx%d seed %u: %d kernel(s) differ\n", size[0], size[1], seed, failures);
+                }
+                CHECK_EQ(failures, 0);
+            }
+        }
+    }
+
+    void testKernelSelection() {
+        ImageKernels marked = SimdKernels::reference();
+        marked.rgbaToGray = markedGray;
+        marked.packMask = markedPack;
+
+        const int width = 13;
+        const int height = 5;
+        std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4, 200);
+        std::vector<uint8_t> gray(static_cast<size_t>(width) * height, 0);
+        OutputTarget target = {gray.data(), width, height, OUTPUT_FORMAT_GRAY, 0, nullptr, 0};
+
+        MultiOutputWriter writer;
+        CHECK(writer.write(rgba.data(), width, height, 4, &target, 1));
+        CHECK_EQ(gray[0], 200);
+        writer.setKernels(&marked);
+        CHECK(writer.write(rgba.data(), width, height, 4, &target, 1));
+        CHECK_EQ(gray[0], 7);
+        CHECK_EQ(gray[gray.size() - 1], 7);
+
+        std::vector<uint8_t> empty(static_cast<size_t>(width) * height, 0);
+        BitMask mask;
+        mask.pack(empty.data(), width, height);
+        CHECK_EQ(mask.popcount(), 0);
+        mask.pack(empty.data(), width, height, 0, &marked);
+        CHECK(mask.test(width - 1, height - 1));
+    }
+}
+
+int main() {
+    testSelfTest();
+    testKernelSelection();
+    return testResult("simd_kernels_test");
+}
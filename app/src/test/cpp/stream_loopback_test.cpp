@@ -0,0 +1,50 @@
+// Host driver for the throttled-loopback streaming test (the JNI
+// runStreamLoopbackTest entry point runs the same test on device).
+//
+// Usage: stream_loopback_test [--width W] [--height H] [--mode M]
+//                             [--pattern P] [--fps R] [--seconds S]
+//                             [--link BYTES_PER_SECOND]
+// Exits non-zero if no frame arrived or any frame was corrupt.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "opencv_processor.h"
+#include "stream_loopback.h"
+
+int main(int argc, char** argv) {
+    StreamLoopbackConfig config = {};
+    config.source = {1280, 720, PATTERN_MIXED, SYNTHETIC_RGBA, 0.5f, 0x5EED1234u};
+    config.mode = MODE_EDGE;
+    config.sourceFps = 30.0;
+    config.durationSeconds = 5;
+    config.linkBytesPerSecond = 2.0 * 1024 * 1024;
+    config.receiveBufferBytes = 4 * 1024;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* name = argv[i];
+        const char* value = argv[i + 1];
+        if (strcmp(name, "--width") == 0) {
+            config.source.width = atoi(value);
+        } else if (strcmp(name, "--height") == 0) {
+            config.source.height = atoi(value);
+        } else if (strcmp(name, "--mode") == 0) {
+            config.mode = atoi(value);
+        } else if (strcmp(name, "--pattern") == 0) {
+            config.source.pattern = atoi(value);
+        } else if (strcmp(name, "--fps") == 0) {
+            config.sourceFps = atof(value);
+        } else if (strcmp(name, "--seconds") == 0) {
+            config.durationSeconds = atoi(value);
+        } else if (strcmp(name, "--link") == 0) {
+            config.linkBytesPerSecond = atof(value);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", name);
+            return 2;
+        }
+    }
+
+    StreamLoopbackReport report = StreamLoopbackTest::run(config);
+    printf("%s\n", report.toString().c_str());
+    return report.framesReceived > 0 && report.framesCorrupt == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// SubpixelEdges: blurred step edges at known fractional positions are
+// refined onto the edge along the gradient at 0, 45 and 90 degrees, and
+// the stored-derivative path gives the same points as the plane path
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "subpixel_edges.h"
+#include "test_support.h"
+
+namespace {
+    const int kSize = 64;
+
+    struct Edge {
+        const char* name;
+        float nx;       // Unit normal (gradient direction)
+        float ny;
+        float offset;   // Edge where nx * x + ny * y == offset
+    };
+
+    // Step from 50 to 200 blurred by a Gaussian of sigma 1.2 across the edge
+    std::vector<uint8_t> render(const Edge& edge) {
+        std::vector<uint8_t> image(static_cast<size_t>(kSize) * kSize);
+        for (int y = 0; y < kSize; y++) {
+            for (int x = 0; x < kSize; x++) {
+                const float distance = edge.nx * x + edge.ny * y - edge.offset;
+                const float value = 50.0f + 150.0f * 0.5f * (1.0f + std::erf(distance / (1.2f * std::sqrt(2.0f))));
+                image[y * kSize + x] = static_cast<uint8_t>(std::lround(value));
+            }
+        }
+        return image;
+    }
+
+    // One pixel per step along the edge, the one closest to it across
+    void markEdge(const Edge& edge, BitMask& mask) {
+        mask.resize(kSize, kSize);
+        const float step = std::max(std::fabs(edge.nx), std::fabs(edge.ny));
+        for (int y = 0; y < kSize; y++) {
+            for (int x = 0; x < kSize; x++) {
+                const float distance = edge.nx * x + edge.ny * y - edge.offset;
+                if (distance >= -0.5f * step && distance < 0.5f * step) {
+                    mask.set(x, y);
+                }
+            }
+        }
+    }
+
+    void testAngles() {
+        const float diagonal = std::sqrt(0.5f);
+        const Edge edges[] = {
+            {"0 degrees", 1.0f, 0.0f, 31.3f},
+            {"45 degrees", diagonal, diagonal, 45.3f * diagonal},
+            {"90 degrees", 0.0f, 1.0f, 30.7f},
+            {"135 degrees", -diagonal, diagonal, 0.4f * diagonal}
+        };
+        for (const Edge& edge : edges) {
+            const std::vector<uint8_t> image = render(edge);
+            BitMask mask;
+            markEdge(edge, mask);
+            std::vector<float> points;
+            const size_t count = SubpixelEdges::locate(image.data(), mask, points);
+            CHECK(count > 20);
+
+            // Interior points land on the edge and move only along the normal
+            float worstDistance = 0.0f;
+            float worstTangent = 0.0f;
+            float worstBefore = 0.0f;
+            for (size_t i = 0; i < count; i++) {
+                const float px = points[i * 2];
+                const float py = points[i * 2 + 1];
+                const float ix = std::round(px);
+                const float iy = std::round(py);
+                if (ix < 3 || iy < 3 || ix > kSize - 4 || iy > kSize - 4) {
+                    continue;
+                }
+                const float tangent = -edge.ny * (px - ix) + edge.nx * (py - iy);
+                worstDistance = std::max(worstDistance, std::fabs(edge.nx * px + edge.ny * py - edge.offset));
+                worstTangent = std::max(worstTangent, std::fabs(tangent));
+                worstBefore = std::max(worstBefore, std::fabs(edge.nx * ix + edge.ny * iy - edge.offset));
+            }
+            CHECK(worstBefore > 0.2f);
+            CHECK(worstDistance < 0.08f);
+            CHECK(worstTangent < 1e-4f);
+            printf("%s: %zu points, distance to edge %.3f px before refinement, %.3f px after\n",
+                   edge.name, count, worstBefore, worstDistance);
+
+            // The stored-derivative path reproduces the plane path
+            std::vector<int16_t> dx(image.size(), 0);
+            std::vector<int16_t> dy(image.size(), 0);
+            for (int y = 1; y < kSize - 1; y++) {
+                for (int x = 1; x < kSize - 1; x++) {
+                    const uint8_t* p = image.data() + y * kSize + x;
+                    dx[y * kSize + x] = static_cast<int16_t>((p[-kSize + 1] + 2 * p[1] + p[kSize + 1]) -
+                                                             (p[-kSize - 1] + 2 * p[-1] + p[kSize - 1]));
+                    dy[y * kSize + x] = static_cast<int16_t>((p[kSize - 1] + 2 * p[kSize] + p[kSize + 1]) -
+                                                             (p[-kSize - 1] + 2 * p[-kSize] + p[-kSize + 1]));
+                }
+            }
+            std::vector<float> stored;
+            SubpixelEdges::locate(dx.data(), dy.data(), mask, stored);
+            CHECK(stored == points);
+        }
+    }
+}
+
+int main() {
+    testAngles();
+    return testResult("subpixel_edges_test");
+}
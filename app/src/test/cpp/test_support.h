@@ -0,0 +1,43 @@
+#ifndef EDGEDETECTOR_TEST_SUPPORT_H
+#define EDGEDETECTOR_TEST_SUPPORT_H
+
+#include <chrono>
+#include <cstdio>
+
+// Minimal checks for the host tests: failures are counted and reported,
+// and main() returns testResult() so ctest sees a non-zero exit code.
+inline int g_testFailures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+        g_testFailures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+    const auto checkActual = (actual); \
+    const auto checkExpected = (expected); \
+    if (!(checkActual == checkExpected)) { \
+        std::fprintf(stderr, "%s:%d: CHECK_EQ failed: %s = %lld, expected %lld\n", __FILE__, __LINE__, \
+                     #actual, static_cast<long long>(checkActual), static_cast<long long>(checkExpected)); \
+        g_testFailures++; \
+    } \
+} while (0)
+
+inline int testResult(const char* name) {
+    if (g_testFailures == 0) {
+        std::printf("%s: all checks passed\n", name);
+        return 0;
+    }
+    std::printf("%s: %d check(s) failed\n", name, g_testFailures);
+    return 1;
+}
+
+// Wall-clock milliseconds for timing reports
+inline double testNowMs() {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // EDGEDETECTOR_TEST_SUPPORT_H